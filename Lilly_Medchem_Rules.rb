@@ -55,12 +55,13 @@ def usage (rc)
   $stderr.print " -okiso         allow isotopic atoms to pass through\n";
   $stderr.print " -noapdm        do not append demerit reasons\n"
   $stderr.print " -i <type>      input type\n" if ($expert)
+  $stderr.print " -shard <k/N>   process only slice K (0 to N-1) of N of the input, merge with merge_shards.rb\n"
   $stderr.print " -expert        more options\n" unless ($expert);
   $stderr.print " -v             verbose output\n"
   exit(rc)
 end
 
-cl = IWCmdline.new("-v-noapdm-i=s-expert-b=fraction-B=s-q=dir-log=s-tp=close-iwd=close-bindir=dir-smarts=s-rej=s-c=ipos-Cs=ipos-Ch=ipos-okiso-odm=s-edm=sfile-relaxed-nodemerit-S=s-dcf=sfile-nobadfiles")
+cl = IWCmdline.new("-v-noapdm-i=s-expert-b=fraction-B=s-q=dir-log=s-tp=close-iwd=close-bindir=dir-smarts=s-rej=s-c=ipos-Cs=ipos-Ch=ipos-okiso-odm=s-edm=sfile-relaxed-nodemerit-S=s-dcf=sfile-nobadfiles-shard=s")
 
 if cl.unrecognised_options_encountered()
   $stderr.print "Unrecognised options encountered\n"
@@ -105,6 +106,22 @@ end
 
 mc_first_pass_options << ' -A I -A ipp'
 
+# With sharding, all the files we create get a per shard suffix
+
+shard_suffix = ""
+
+if (cl.option_present('shard'))
+  s = cl.value('shard')
+  m = /^(\d+)\/(\d+)$/.match(s)
+  unless (m && m[1].to_i < m[2].to_i)
+    $stderr.print "Invalid shard specification '#{s}', must be 'k/N', 0 <= k < N\n"
+    usage(1)
+  end
+
+  mc_first_pass_options << " -i shard=#{s}"
+  shard_suffix = "_shard#{m[1]}of#{m[2]}"
+end
+
 bindir = Bindir.new(ianhome)
 
 cl.values('bindir').each do |d|
@@ -318,30 +335,30 @@ cmd << " #{mc_first_pass_options}" if (mc_first_pass_options.length > 0)
 cmd << " #{input_type} " if (input_type.length > 0)
 
 cmd << " -c #{lower_atom_count_cutoff} -C #{hard_upper_atom_count_cutoff} -E autocreate -o smi -V -g all -g ltltr -i ICTE "
-cmd << "-L #{bad_stem}0 -K TP1 " if (bad_stem)
-cmd << "-a -S - #{ARGV.join(' ')} 2> #{logfilestem}0.log "
+cmd << "-L #{bad_stem}0#{shard_suffix} -K TP1 " if (bad_stem)
+cmd << "-a -S - #{ARGV.join(' ')} 2> #{logfilestem}0#{shard_suffix}.log "
 
 if (stop_afer_completing_step >= 1)
-  cmd << "| #{tsubstructure} -E autocreate -b -u -i smi -o smi -A D "
-  cmd << "-m #{bad_stem}1 -m QDT " if (bad_stem)
+  cmd << "| #{tsubstructure} -E autocreate -b -u -i smi -o smi -o asread -A D -M usefp "
+  cmd << "-m #{bad_stem}1#{shard_suffix} -m QDT " if (bad_stem)
   cmd << "-n - -q F:#{query_dir}/#{query_file[1]} "
 
   cmd << optional_queries if (optional_queries.length > 0)
 
-  cmd << " - 2> #{logfilestem}1.log ";
+  cmd << " - 2> #{logfilestem}1#{shard_suffix}.log ";
 
   if (stop_afer_completing_step >= 2)
-    cmd << "| #{tsubstructure} -A D -E autocreate -b -u -i smi -o smi "
-    cmd << "-m #{bad_stem}2 -m QDT " if (bad_stem)
-    cmd << "-n - -q F:#{query_dir}/#{query_file[2]} - 2> #{logfilestem}2.log ";
+    cmd << "| #{tsubstructure} -A D -E autocreate -b -u -i smi -o smi -o asread -M usefp "
+    cmd << "-m #{bad_stem}2#{shard_suffix} -m QDT " if (bad_stem)
+    cmd << "-n - -q F:#{query_dir}/#{query_file[2]} - 2> #{logfilestem}2#{shard_suffix}.log ";
     if (stop_afer_completing_step >= 3)
-      cmd << " | #{iwdemerit} -x #{extra_iwdemerit_options} -E autocreate -A D -i smi -o smi -q F:#{query_file3} "
-      cmd << "-R #{bad_stem}3 " if (bad_stem)
+      cmd << " | #{iwdemerit} -x -F #{extra_iwdemerit_options} -E autocreate -A D -i smi -o smi -o asread -q F:#{query_file3} "
+      cmd << "-R #{bad_stem}3#{shard_suffix} " if (bad_stem)
       cmd << "-G - -c smax=#{soft_upper_atom_count_cutoff} -c hmax=#{hard_upper_atom_count_cutoff} "
       cmd << "-q F:#{additional_demerits} " if (additional_demerits)
       cmd << "-C #{iwdemerit_optional_control_file} " if (iwdemerit_optional_control_file)
       cmd << "-t " if (append_demerit_reason)
-      cmd << "- 2> #{logfilestem}3.log "
+      cmd << "- 2> #{logfilestem}3#{shard_suffix}.log "
     end
   end
 end
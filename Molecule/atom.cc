@@ -183,9 +183,7 @@ Atom::_constructor_copy_atom_attributes (const Atom & other_atom)
 
   _default_values(other_atom._element);
 
-  _x = other_atom._x;
-  _y = other_atom._y;
-  _z = other_atom._z;
+  setxyz(other_atom.x(), other_atom.y(), other_atom.z());
 
   _implicit_hydrogens_known = other_atom._implicit_hydrogens_known;
 
@@ -249,7 +247,7 @@ Atom::debug_print (ostream & os) const
   }
 
   os.setf(std::ios::showpoint);
-  os << "Coordinates (" << _x << "," << _y << "," << _z << ")\n";
+  os << "Coordinates (" << x() << "," << y() << "," << z() << ")\n";
 
   return 1;
 }
@@ -1499,16 +1497,16 @@ Atom::write_coordinates (ostream & os,
   int old_precision  = os.precision(4);
 
   if (include_space)
-    os << setw(10) << _x << ' ' << setw(10) << _y << ' ';
+    os << setw(10) << x() << ' ' << setw(10) << y() << ' ';
   else
-    os << setw(10) << _x << setw(10) << _y;
+    os << setw(10) << x() << setw(10) << y();
 
 // Writing 0.0 Z coordinates is common when writing 2d files
 
-  if (static_cast<coord_t>(0.0) == _z)
+  if (static_cast<coord_t>(0.0) == z())
     os << "    0.0000 ";
   else
-    os << setw(10) << _z << ' ';
+    os << setw(10) << z() << ' ';
   
   os.precision(old_precision);
   os.flags(old_flags);
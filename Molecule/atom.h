@@ -39,7 +39,7 @@ using namespace std;
 
 #include "iwaray.h"
 
-class Atom : public resizable_array <Bond *>, public Coordinates
+class Atom : public small_resizable_array <Bond *, 4>, public Atom_Position
 {
   private:
     const Element *_element;
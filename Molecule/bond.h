@@ -189,6 +189,11 @@ class Bond: public Connection
     int           is_directional_up () const { return (_directional & IW_BOND_DIRECTIONAL_UP);}
     int           is_directional_down () const { return (_directional & IW_BOND_DIRECTIONAL_DOWN);}
 
+//  Oct 2026. The binary interchange format copies all the flags at once
+
+    int           directional_flags () const { return _directional;}
+    void          set_directional_flags (int s) { _directional = s;}
+
 //  Double bonds can be part of a cis-trans grouping
 
     int           part_of_cis_trans_grouping () const { return (_directional & IW_BOND_DIRECTIONAL_DOUBLE_BOND);}
@@ -166,15 +166,16 @@ Molecule::_identify_fragment_undesirable_groups (int * exclude) const
   return 1;
 }
 
+/*
+  Returns the fragment to be kept. Everything needed is accumulated per
+  fragment in one pass over the atoms
+*/
+
 int
-Molecule::identify_largest_organic_fragment (Set_of_Atoms & atoms_to_be_removed,
-                                             int & fragments_same_size_as_largest_organic)
+Molecule::_identify_largest_organic_fragment (int & fragments_same_size_as_largest_organic)
 {
   int nf = number_fragments();
 
-  if (nf <= 1)
-    return 1;
-
   int max_atoms_in_fragment = 0;
   int fragment_with_max_atoms = -1;
   int max_organic_atoms_in_fragment = 0;
@@ -185,48 +186,45 @@ Molecule::identify_largest_organic_fragment (Set_of_Atoms & atoms_to_be_removed,
   const int * fragment_membership = _fragment_information.fragment_membership();
   const resizable_array<int> & atoms_in_fragment = _fragment_information.atoms_in_fragment();
 
-  int * exclude = new_int(_number_elements); iw_auto_array<int> free_exclude(exclude);
+  int * exclude = new_int(_number_elements + nf + nf); iw_auto_array<int> free_exclude(exclude);
+  int * organic_atoms = exclude + _number_elements;
+  int * very_undesirable = organic_atoms + nf;
 
   _identify_fragment_undesirable_groups (exclude);
 
-  for (int i = 0; i < nf; i++)
+  for (int i = 0; i < _number_elements; i++)
   {
-    if (atoms_in_fragment[i] > max_atoms_in_fragment)
-    {
-      max_atoms_in_fragment = atoms_in_fragment[i];
-      fragment_with_max_atoms = i;
-    }
+    int f = fragment_membership[i];
 
-    int organic_atoms_this_fragment = 0;
-    int very_undesirable_this_fragment = 0;
-    for (int j = 0; j < _number_elements; j++)
+    if (exclude[i])
     {
-//    cerr << "Atom " << j << " in fragment " << aj->fragment_membership() << endl;
-
-      if (fragment_membership[j] != i)
-        continue;
-
-      if (exclude[j])
-      {
-        if (exclude[j] > 1)
-          very_undesirable_this_fragment++;
-        continue;
-      }
+      if (exclude[i] > 1)
+        very_undesirable[f]++;
+      continue;
+    }
 
-      const Atom * aj = _things[j];
+    const Atom * ai = _things[i];
 
-      if (! aj->element()->organic())
-        continue;
+    if (! ai->element()->organic())
+      continue;
 
-      atomic_number_t z = aj->atomic_number();
+    organic_atoms[f] += organic_desirability[ai->atomic_number()];
+  }
 
-      organic_atoms_this_fragment += organic_desirability[z];
+  for (int i = 0; i < nf; i++)
+  {
+    if (atoms_in_fragment[i] > max_atoms_in_fragment)
+    {
+      max_atoms_in_fragment = atoms_in_fragment[i];
+      fragment_with_max_atoms = i;
     }
 
-//  cerr << very_undesirable_this_fragment << " very_undesirable_this_fragment\n";
+    int organic_atoms_this_fragment = organic_atoms[i];
 
-    if (very_undesirable_this_fragment)
-      organic_atoms_this_fragment -= 10 * very_undesirable_this_fragment;
+//  cerr << very_undesirable[i] << " very_undesirable_this_fragment\n";
+
+    if (very_undesirable[i])
+      organic_atoms_this_fragment -= 10 * very_undesirable[i];
 
 //  cerr << "organic_atoms_this_fragment " << organic_atoms_this_fragment << endl;
 
@@ -243,16 +241,28 @@ Molecule::identify_largest_organic_fragment (Set_of_Atoms & atoms_to_be_removed,
 //if (max_organic_atoms_in_fragment > 0 && fragments_same_size_as_largest_organic > 1)
 //  cerr << fragments_same_size_as_largest_organic << " fragments size " << max_organic_atoms_in_fragment << ' ' << _molecule_name << endl;
 
-  int fragment_to_keep;
-
   if (0 == max_organic_atoms_in_fragment)     // no fragments contain organic atoms
-    fragment_to_keep = fragment_with_max_atoms;
-  else
-    fragment_to_keep = fragment_with_most_organic_atoms;
+    return fragment_with_max_atoms;
+
+  return fragment_with_most_organic_atoms;
+}
+
+int
+Molecule::identify_largest_organic_fragment (Set_of_Atoms & atoms_to_be_removed,
+                                             int & fragments_same_size_as_largest_organic)
+{
+  int nf = number_fragments();
+
+  if (nf <= 1)
+    return 1;
+
+  int fragment_to_keep = _identify_largest_organic_fragment (fragments_same_size_as_largest_organic);
 
 //cerr << "Keeping fragment " << fragment_to_keep << endl;
-   
-  atoms_to_be_removed.resize (max_atoms_in_fragment);
+
+  const int * fragment_membership = _fragment_information.fragment_membership();
+
+  atoms_to_be_removed.resize (_number_elements);
 
   for (int i = 0; i < _number_elements; i++)
   {
@@ -268,14 +278,14 @@ Molecule::identify_largest_organic_fragment (Set_of_Atoms & atoms_to_be_removed,
 int
 Molecule::reduce_to_largest_organic_fragment()
 {
-  Set_of_Atoms atoms_to_be_removed;
+  if (number_fragments() <= 1)
+    return 1;
 
   int notused;
 
-  (void) identify_largest_organic_fragment (atoms_to_be_removed, notused);
+  int fragment_to_keep = _identify_largest_organic_fragment (notused);
 
-  if (atoms_to_be_removed.number_elements())
-    remove_atoms (atoms_to_be_removed);
+  delete_all_fragments_except (fragment_to_keep);
 
   return 1;
 }
@@ -362,26 +372,22 @@ Molecule::reduce_to_largest_fragment_carefully()
 {
   int nf = number_fragments();
   
-  if (1 == nf)
+  if (nf <= 1)
     return 1;
 
 #ifdef DEBUG_CAREFUL_FRAG
   cerr << "Reducing '" << _molecule_name << "' from " << nf << " fragments\n";
 #endif
 
-  Set_of_Atoms atoms_to_be_removed;
   int number_instances_of_largest_fragment;
 
-  identify_largest_organic_fragment (atoms_to_be_removed, number_instances_of_largest_fragment);
-
-  if (0 == atoms_to_be_removed.number_elements())
-    return 1;
+  int fragment_to_keep = _identify_largest_organic_fragment (number_instances_of_largest_fragment);
 
 // If there are no organic fragments, NUMBER_INSTANCES_OF_LARGEST_FRAGMENT will be 0
 
   if (number_instances_of_largest_fragment <= 1)
   {
-    remove_atoms (atoms_to_be_removed);
+    delete_all_fragments_except (fragment_to_keep);
 
     return 1;
   }
@@ -578,7 +584,14 @@ Molecule::_reduce_to_largest_fragment_carefully (Fragment_Data * fd,
     fdi.another_oxygen();
   }
 
-  qsort (fd, nf, sizeof (Fragment_Data), fragment_data_comparitor);
+// We only need the most favoured fragment, no need to sort them all
+
+  int best = 0;
+  for (int i = 1; i < nf; i++)
+  {
+    if (fragment_data_comparitor (fd + i, fd + best) < 0)
+      best = i;
+  }
 
 #ifdef DEBUG_CAREFUL_FRAG
   for (int i = 0; i < nf; i++)
@@ -587,20 +600,7 @@ Molecule::_reduce_to_largest_fragment_carefully (Fragment_Data * fd,
   }
 #endif
 
-  int fragment_to_keep = fd[0].frag_id();
-
-  Set_of_Atoms atoms_to_be_removed;
-  atoms_to_be_removed.resize (_number_elements);
-
-  for (int i = 0; i < _number_elements; i++)
-  {
-    int f = fragment_membership[i];
-
-    if (f != fragment_to_keep)
-      atoms_to_be_removed.add (i);
-  }
-
-  return remove_atoms (atoms_to_be_removed);
+  return delete_all_fragments_except (fd[best].frag_id());
 }
 
 /*
@@ -23,6 +23,7 @@
 #ifndef CAREFUL_FRAG_H
 #define CAREFUL_FRAG_H
 
+    int _identify_largest_organic_fragment (int & fragments_same_size_as_largest_organic);
     int _reduce_to_largest_fragment_carefully (Fragment_Data * fc, int * already_counted);
     int _is_nitro (atom_number_t, int *) const;
     int _is_sulphate_like (atom_number_t, int *) const;
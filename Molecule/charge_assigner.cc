@@ -611,105 +611,232 @@ Charge_Assigner::_remove_positive_charge_hits_on_chiral_atoms (Molecule & m,
   return;
 }
 
-static int
-advance_shell (const Molecule & m,
-               int * tmp,
-               int flag)
+/*
+  Resolving charges that are too close to each other only ever needs the
+  distances between the candidate charge sites and, for sites in a close
+  pair, the number of atoms in each successive shell around them.
+  Rather than asking the molecule for its full distance matrix, and growing
+  shells over the whole molecule for every close pair, we do one breadth
+  first search from each site. That search stops at the minimum separation,
+  and shell sizes are only computed for sites that turn out to need them.
+*/
+
+class Charge_Site_Distances
 {
-  int matoms = m.natoms();
+  private:
+    const Molecule & _m;
+    const int _matoms;
+    const int _max_distance;
 
-  int frontier_flag = (flag << 1) | flag;    // two bits
+    int _nsites;
+    atom_number_t * _site;
 
-  int expanded = 0;
+//  For each atom, its index in _site, or -1
 
-  for (int i = 0; i < matoms; i++)
-  {
-    if (0 == (tmp[i] & flag))   // not part of this expansion
-      continue;
+    int * _site_index;
 
-    if (frontier_flag == (tmp[i] & frontier_flag))  // already part of frontier
-      continue;
+//  _nsites * _nsites matrix, non zero if two sites are within _max_distance
 
-    const Atom * a = m.atomi(i);
+    int * _close;
 
-    int acon = a->ncon();
+//  Number of atoms in each shell around a site, computed on demand
 
-//  cerr << "Growing frontier from atom " << i << endl;
-    for (int j = 0; j < acon; j++)
-    {
-      atom_number_t k = a->other(i, j);
+    resizable_array<int> * _shell_size;
+    int * _shell_size_computed;
+
+//  scratch arrays for the searches
+
+    int * _dist;
+    atom_number_t * _queue;
+
+//  private functions
+
+    int _breadth_first_search (atom_number_t zatom, int maxd, resizable_array<int> * shell_size);
+    const resizable_array<int> & _shells (int isite);
+
+  public:
+    Charge_Site_Distances (const Molecule & m, const Set_of_Atoms & s, int max_distance);
+    ~Charge_Site_Distances ();
+
+    int too_close (atom_number_t a1, atom_number_t a2) const;
+
+    atom_number_t identify_survivor (atom_number_t a1, atom_number_t a2);
+};
+
+Charge_Site_Distances::Charge_Site_Distances (const Molecule & m,
+                                              const Set_of_Atoms & s,
+                                              int max_distance) :
+                        _m (m),
+                        _matoms (m.natoms()),
+                        _max_distance (max_distance)
+{
+  _nsites = s.number_elements();
+
+  _site = new atom_number_t[_nsites];
+  _site_index = new_int(_matoms, -1);
+  _close = new_int(_nsites * _nsites);
+  _shell_size = new resizable_array<int>[_nsites];
+  _shell_size_computed = new_int(_nsites);
+
+  _dist = new int[_matoms];
+  _queue = new atom_number_t[_matoms];
 
-      if (flag & tmp[k])   // already part of this expansion
+  for (int i = 0; i < _nsites; i++)
+  {
+    _site[i] = s[i];
+    _site_index[s[i]] = i;
+  }
+
+  for (int i = 0; i < _nsites; i++)
+  {
+    _breadth_first_search(_site[i], _max_distance, NULL);
+
+    for (int j = i + 1; j < _nsites; j++)
+    {
+      if (_dist[_site[j]] < 0)    // beyond _max_distance, or a different fragment
         continue;
 
-      tmp[k] |= frontier_flag;
-      expanded = 1;
-//    cerr << "Atom " << k << " added to frontier\n";
+      _close[i * _nsites + j] = 1;
+      _close[j * _nsites + i] = 1;
     }
   }
 
-  if (0 == expanded)
-    return 0;
+  return;
+}
+
+Charge_Site_Distances::~Charge_Site_Distances ()
+{
+  delete [] _site;
+  delete [] _site_index;
+  delete [] _close;
+  delete [] _shell_size;
+  delete [] _shell_size_computed;
+  delete [] _dist;
+  delete [] _queue;
 
-  frontier_flag = (flag << 1);   // we now need to turn off this bit
+  return;
+}
 
-  int rc = 0;
+/*
+  Fill _dist with the distance of each atom from ZATOM, stopping at MAXD
+  (a negative MAXD means no limit). Atoms not reached are -1.
+  If SHELL_SIZE is present, it gets the number of atoms in each shell
+*/
 
-  for (int i = 0; i < matoms; i++)
+int
+Charge_Site_Distances::_breadth_first_search (atom_number_t zatom,
+                                              int maxd,
+                                              resizable_array<int> * shell_size)
+{
+  set_vector(_dist, _matoms, -1);
+
+  _dist[zatom] = 0;
+  _queue[0] = zatom;
+
+  int layer_start = 0;
+  int layer_end = 1;
+
+  for (int d = 1; layer_start < layer_end && (maxd < 0 || d <= maxd); d++)
   {
-    if (tmp[i] & frontier_flag)
+    int next = layer_end;
+
+    for (int i = layer_start; i < layer_end; i++)
     {
-//    cerr << "Atom " << i << " was on frontier\n";
-      tmp[i] ^= frontier_flag;
-      rc++;
+      atom_number_t j = _queue[i];
+
+      const Atom * a = _m.atomi(j);
+
+      int acon = a->ncon();
+
+      for (int k = 0; k < acon; k++)
+      {
+        atom_number_t l = a->other(j, k);
+
+        if (_dist[l] >= 0)
+          continue;
+
+        _dist[l] = d;
+        _queue[next] = l;
+        next++;
+      }
     }
+
+    if (NULL != shell_size && next > layer_end)
+      shell_size->add(next - layer_end);
+
+    layer_start = layer_end;
+    layer_end = next;
   }
 
-  return rc;
+  return layer_end;
 }
 
-static atom_number_t
-identify_survivor (Molecule & m,
-                   atom_number_t a1,
-                   atom_number_t a2,
-                   int * tmp)
+const resizable_array<int> &
+Charge_Site_Distances::_shells (int isite)
+{
+  if (! _shell_size_computed[isite])
+  {
+    _breadth_first_search(_site[isite], -1, _shell_size + isite);
+    _shell_size_computed[isite] = 1;
+  }
+
+  return _shell_size[isite];
+}
+
+int
+Charge_Site_Distances::too_close (atom_number_t a1,
+                                  atom_number_t a2) const
 {
-  set_vector(tmp, m.natoms(), 0);
+  if (a1 == a2)
+    return 1;
+
+  return _close[_site_index[a1] * _nsites + _site_index[a2]];
+}
 
-  tmp[a1] = 1;   // some non overlapping bits
-  tmp[a2] = 8;
+/*
+  Of two charged atoms that are too close, keep the one that is least
+  connected, and if that is a tie, the one whose successive shells
+  contain the fewest atoms - the more isolated one.
+*/
 
+atom_number_t
+Charge_Site_Distances::identify_survivor (atom_number_t a1,
+                                          atom_number_t a2)
+{
 //cerr << "Checking atoms " << a1 << " and " << a2 << endl;
 
-  if (m.ncon(a1) < m.ncon(a2))
+  if (_m.ncon(a1) < _m.ncon(a2))
     return a1;
-  else if (m.ncon(a1) > m.ncon(a2))
+  else if (_m.ncon(a1) > _m.ncon(a2))
     return a2;
 
-  while (1)
+  const resizable_array<int> & s1 = _shells(_site_index[a1]);
+  const resizable_array<int> & s2 = _shells(_site_index[a2]);
+
+  int n = s1.number_elements();
+  if (s2.number_elements() > n)
+    n = s2.number_elements();
+
+  for (int i = 0; i < n; i++)
   {
-//  cerr << "Advancing shell for atom " << a1 << endl;
-    int c1 = advance_shell(m, tmp, 1);
-//  cerr << "Advancing shell for atom " << a2 << endl;
-    int c2 = advance_shell(m, tmp, 8);
+    int c1 = (i < s1.number_elements()) ? s1[i] : 0;
+    int c2 = (i < s2.number_elements()) ? s2[i] : 0;
+
 //  cerr << "Shells expanded " << c1 << " and " << c2 << endl;
 
     if (c1 < c2)
       return a1;
     if (c1 > c2)
       return a2;
-
-//  scores are identical
-
-    if (0 == c1)        // exhausted, return a random choice
-      return a1;
   }
+
+  return a1;     // exhausted, return a random choice
 }
 
 //#define DEBUG_IDENTIFY_CHARGED_ATOMS_TOO_CLOSE
 
 int
-Charge_Assigner::_identify_charged_atoms_too_close (Molecule & m,
+Charge_Assigner::_identify_charged_atoms_too_close (const Charge_Site_Distances & sites,
                                                     const Set_of_Atoms & s,
                                                     int * times_too_close) const
 {
@@ -723,26 +850,15 @@ Charge_Assigner::_identify_charged_atoms_too_close (Molecule & m,
   {
     atom_number_t ai = s[i];
 
-    int fi = m.fragment_membership (ai);
-
     for (int j = i + 1; j < s.number_elements (); j++)
     {
       atom_number_t aj = s[j];
 
-      if (m.fragment_membership (aj) != fi)
+      if (! sites.too_close(ai, aj))
         continue;
 
 #ifdef DEBUG_IDENTIFY_CHARGED_ATOMS_TOO_CLOSE
-      cerr << m.bonds_between (ai, aj) << " bonds between " << ai << " and " << aj << endl;
-#endif
-
-      if (ai == aj)    // can this happen?
-        ;
-      else if (m.bonds_between (ai, aj) > _min_distance_between_charges)
-        continue;
-
-#ifdef DEBUG_IDENTIFY_CHARGED_ATOMS_TOO_CLOSE
-      cerr << "Atoms " << ai << " '" << m.smarts_equivalent_for_atom(ai) << "' and " << aj << " '" << m.smarts_equivalent_for_atom (aj) << "' too close " << m.bonds_between(ai, aj) << endl;
+      cerr << "Atoms " << ai << " and " << aj << " too close\n";
 #endif
 
       too_close.add(ai);
@@ -753,7 +869,10 @@ Charge_Assigner::_identify_charged_atoms_too_close (Molecule & m,
   if (0 == too_close.number_elements())   // no atoms too close
     return 0;
 
-  set_vector(times_too_close, m.natoms(), 0);
+  for (int i = 0; i < too_close.number_elements(); i++)
+  {
+    times_too_close[too_close[i]] = 0;
+  }
 
   too_close.increment_vector(times_too_close);
 
@@ -770,19 +889,24 @@ Charge_Assigner::_remove_hits_too_close_isolation_score (Molecule & m,
 
   int matoms = m.natoms();
 
+  Charge_Site_Distances sites(m, s, _min_distance_between_charges);
+
   int * times_too_close = new_int(matoms); iw_auto_array<int> free_times_too_close(times_too_close);
 
-  if (0 == _identify_charged_atoms_too_close(m, s, times_too_close))  // great, nothing too close
+  if (0 == _identify_charged_atoms_too_close(sites, s, times_too_close))  // great, nothing too close
     return;
 
 // We have atoms too close. If there is an atom that is in a too-close
 // relationship multiple times, remove the charge from it
 
-  int istart = iwmax_of_array(times_too_close, matoms);   // most likely 2 or maybe 3
+  int istart = 0;
+  for (int i = 0; i < s.number_elements(); i++)
+  {
+    if (times_too_close[s[i]] > istart)
+      istart = times_too_close[s[i]];     // most likely 2 or maybe 3
+  }
 //cerr << "istart " << istart << endl;
 
-  int charges_removed = 0;
-
   for (int i = istart; i>= 2; i--)
   {
     int charges_removed_this_loop = 0;
@@ -802,8 +926,12 @@ Charge_Assigner::_remove_hits_too_close_isolation_score (Molecule & m,
     if (0 == charges_removed_this_loop)
       continue;
 
-    charges_removed = 1;
-    if (0 == _identify_charged_atoms_too_close(m, s, times_too_close))
+    for (int j = 0; j < s.number_elements(); j++)
+    {
+      times_too_close[s[j]] = 0;
+    }
+
+    if (0 == _identify_charged_atoms_too_close(sites, s, times_too_close))
       return;
   }
 
@@ -819,13 +947,10 @@ Charge_Assigner::_remove_hits_too_close_isolation_score (Molecule & m,
     {
       atom_number_t aj = s[j];
 
-      if (m.fragment_membership(ai) != m.fragment_membership(aj))
-        continue;
-
-      if (m.bonds_between (ai, aj) > _min_distance_between_charges)
+      if (! sites.too_close(ai, aj))
         continue;
 
-      atom_number_t survivor = identify_survivor(m, ai, aj, times_too_close);
+      atom_number_t survivor = sites.identify_survivor(ai, aj);
 
       if (ai == survivor)
         charges_assigned[aj] = 0;
@@ -853,26 +978,17 @@ Charge_Assigner::_remove_hits_too_close (Molecule & m,
   cerr << "Atoms are " << s << endl;
 #endif
 
+  Charge_Site_Distances sites(m, s, _min_distance_between_charges);
+
   for (int i = 0; i < s.number_elements (); i++)
   {
     atom_number_t ai = s[i];
 
-    int fi = m.fragment_membership (ai);
-
     for (int j = i + 1; j < s.number_elements (); j++)
     {
       atom_number_t aj = s[j];
 
-      if (m.fragment_membership (aj) != fi)
-        continue;
-
-#ifdef DEBUG_REMOVE_HITS_TOO_CLOSE
-      cerr << m.bonds_between (ai, aj) << " bonds between " << ai << " and " << aj << endl;
-#endif
-
-      if (ai == aj)
-        ;
-      else if (m.bonds_between (ai, aj) > _min_distance_between_charges)
+      if (! sites.too_close(ai, aj))
         continue;
 
 #ifdef DEBUG_REMOVE_HITS_TOO_CLOSE
@@ -888,6 +1004,16 @@ Charge_Assigner::_remove_hits_too_close (Molecule & m,
   return;
 }
 
+/*
+  Each charged form is a largest arrangement of the positive sites in which
+  no two are too close: no site can be added without conflicting with one
+  already present.
+  Sites are considered in order, and each is either included or excluded.
+  A branch is abandoned as soon as an included site conflicts with one
+  already chosen, and excluding a site is only explored if some later site
+  could conflict with it - otherwise the result could not be maximal.
+*/
+
 int
 Charge_Assigner::_enumerate_possibilities0 (Molecule & m,
                                           const Set_of_Atoms & s,
@@ -895,8 +1021,6 @@ Charge_Assigner::_enumerate_possibilities0 (Molecule & m,
 {
   int n = s.number_elements();
 
-  cerr << "Enumerating " << s << endl;
-
   if (n < 2)
   {
     Set_of_Atoms * t = new Set_of_Atoms(s);
@@ -905,93 +1029,73 @@ Charge_Assigner::_enumerate_possibilities0 (Molecule & m,
     return 1;
   }
 
-  return _enumerate_possibilities1 (m, s, 0, possibilities);
+  Charge_Site_Distances sites(m, s, _min_distance_between_charges);
+
+  Set_of_Atoms current;
+
+  _enumerate_possibilities1 (sites, s, 0, current, possibilities);
+
+  return possibilities.number_elements();
 }
 
-int
-Charge_Assigner::_enumerate_possibilities1 (Molecule & m,
+static int
+conflicts_with_any (const Charge_Site_Distances & sites,
+                    atom_number_t zatom,
+                    const Set_of_Atoms & current)
+{
+  for (int i = 0; i < current.number_elements(); i++)
+  {
+    if (sites.too_close(zatom, current[i]))
+      return 1;
+  }
+
+  return 0;
+}
+
+void
+Charge_Assigner::_enumerate_possibilities1 (const Charge_Site_Distances & sites,
                                           const Set_of_Atoms & s,
                                           int istart,
+                                          Set_of_Atoms & current,
                                           resizable_array_p<Set_of_Atoms> & possibilities) const
 {
-  Set_of_Atoms equivalent;
-
   int n = s.number_elements();
 
-  for (int i = istart; i < n; i++)
+  if (istart == n)
   {
-    atom_number_t ai = s[i];
-
-    int fi = m.fragment_membership(ai);
-
-    for (int j = i + 1; j < n; j++)
+    for (int i = 0; i < n; i++)     // is it maximal
     {
-      atom_number_t aj = s[j];
-
-      if (m.fragment_membership(aj) != fi)
-        continue;
+      if (! current.contains(s[i]) && ! conflicts_with_any(sites, s[i], current))
+        return;
+    }
 
-      if (m.bonds_between(ai, aj) > _min_distance_between_charges)
-        continue;
+    possibilities.add(new Set_of_Atoms(current));
 
-      equivalent.add_if_not_already_present(ai);
-      equivalent.add_if_not_already_present(aj);
-    }
+    return;
   }
 
-  if (0 == equivalent.number_elements())   // just one item
+  atom_number_t ai = s[istart];
+
+  if (conflicts_with_any(sites, ai, current))    // cannot be included
   {
-    if (0 == possibilities.number_elements())
-    {
-      Set_of_Atoms * t = new Set_of_Atoms;
-      t->add(s[istart]);
-      possibilities.add(t);
-    }
-    else
-    {
-      int n = possibilities.number_elements();
-      for (int i = 0; i < n; i++)
-      {
-        Set_of_Atoms * t = new Set_of_Atoms(*(possibilities[i]));
-        t->add(s[istart]);
-        possibilities.add(t);
-      }
-    }
+    _enumerate_possibilities1(sites, s, istart + 1, current, possibilities);
+    return;
   }
-  else    // multiple possibilities
+
+  current.add(ai);
+  _enumerate_possibilities1(sites, s, istart + 1, current, possibilities);
+  current.chop();
+
+  for (int j = istart + 1; j < n; j++)
   {
-    if (0 == possibilities.number_elements())
-    {
-      int n = equivalent.number_elements();
-      for (int i = 0; i < n; i++)
-      {
-        Set_of_Atoms * t = new Set_of_Atoms;
-        t->add(equivalent[i]);
-        possibilities.add(t);
-      }
-    }
-    else
+    if (sites.too_close(ai, s[j]))
     {
-      int np = possibilities.number_elements();
-      int ne = equivalent.number_elements();
-
-      for (int i = 0; i < ne; i++)
-      {
-        atom_number_t ei = equivalent[i];
-        for (int j = 0; j < np; j++)
-        {
-          Set_of_Atoms * t = new Set_of_Atoms(*(possibilities[j]));
-          t->add(ei);
-          possibilities.add(t);
-        }
-      }
+      _enumerate_possibilities1(sites, s, istart + 1, current, possibilities);
+      return;
     }
   }
 
-  if (istart < s.number_elements() - 1)
-    return _enumerate_possibilities1(m, s, istart + 1, possibilities);
-
-  return possibilities.number_elements();
+  return;
 }
 
 /*
@@ -33,6 +33,7 @@ class Single_Substructure_Query;
 class Substructure_Atom;
 class Molecule_to_Match;
 class Command_Line;
+class Charge_Site_Distances;
 
 class Charge_Assigner : public resizable_array_p<Substructure_Hit_Statistics>
 {
@@ -110,9 +111,10 @@ class Charge_Assigner : public resizable_array_p<Substructure_Hit_Statistics>
     int _enumerate_possibilities0 (Molecule & m,
                                           const Set_of_Atoms & s,
                                           resizable_array_p<Set_of_Atoms> & possibilities) const;
-    int _enumerate_possibilities1 (Molecule & m,
+    void _enumerate_possibilities1 (const Charge_Site_Distances & sites,
                                           const Set_of_Atoms & s,
                                           int istart,
+                                          Set_of_Atoms & current,
                                           resizable_array_p<Set_of_Atoms> & possibilities) const;
     void _remove_positive_charge_hits_on_chiral_atoms (Molecule & m,
                         Set_of_Atoms & positive_charges_assigned,
@@ -125,7 +127,7 @@ class Charge_Assigner : public resizable_array_p<Substructure_Hit_Statistics>
                            atom_number_t zatom,
                            formal_charge_t fc) const;
 
-    int _identify_charged_atoms_too_close (Molecule & m,
+    int _identify_charged_atoms_too_close (const Charge_Site_Distances & sites,
                                            const Set_of_Atoms & s,
                                            int * times_too_close) const;
     void _remove_hits_too_close (Molecule & m,
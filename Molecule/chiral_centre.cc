@@ -675,6 +675,27 @@ Chiral_Centre::adjust_for_loss_of_atom (atom_number_t l)
   return;
 }
 
+/*
+  Implicit hydrogens and lone pairs are negative and are not changed
+*/
+
+int
+Chiral_Centre::new_atom_numbers (const int * xref)
+{
+  _a = xref[_a];
+
+  if (_top_front >= 0)
+    _top_front = xref[_top_front];
+  if (_top_back >= 0)
+    _top_back = xref[_top_back];
+  if (_left_down >= 0)
+    _left_down = xref[_left_down];
+  if (_right_down >= 0)
+    _right_down = xref[_right_down];
+
+  return 1;
+}
+
 /*
   When creating a molecule, there are cases where one of the "connections"
   to a chiral centre is a lone pair. This function is called whenever
@@ -151,6 +151,10 @@ class Chiral_Centre
     int atom_is_now_lone_pair         (atom_number_t);
 
     int change_atom_number (atom_number_t, atom_number_t);
+
+//  When many atoms are removed at once, each atom gets its new number from a cross reference
+
+    int new_atom_numbers (const int * xref);
     int move_atom_to_end_of_atom_list (atom_number_t, int);
 
     int atom_numbers_are_swapped (atom_number_t, atom_number_t);
@@ -21,7 +21,7 @@
 #include "coordinates.h"
 #include "atom.h"
 
-Coordinates::Coordinates (const Atom & a) : Space_Vector<coord_t> (a._x, a._y, a._z)
+Coordinates::Coordinates (const Atom & a) : Space_Vector<coord_t> (a.x (), a.y (), a.z ())
 {
 }
 
@@ -50,4 +50,47 @@ class Coordinates_double : public Space_Vector<double>
     Coordinates_double (const Atom & a);
 };
 
+/*
+  Oct 2026. SMILES only workloads never look at geometry, yet every Atom
+  carries three coordinates. When built with IW_NO_COORDINATES, Atom
+  derives from this class instead of Coordinates. It has the parts of
+  the Space_Vector interface that get used on atoms, but no storage:
+  every atom sits at the origin and attempts to move it are ignored.
+  Connection tables from MDL files are still read, the coordinates are
+  discarded. Input options perceiving stereo from geometry are rejected.
+*/
+
+class No_Coordinates
+{
+  public:
+    coord_t x () const { return static_cast<coord_t> (0.0);}
+    coord_t y () const { return static_cast<coord_t> (0.0);}
+    coord_t z () const { return static_cast<coord_t> (0.0);}
+
+    void setxyz (coord_t, coord_t, coord_t) {}
+    void setxyz (const Space_Vector<coord_t> &) {}
+
+    void getxyz (double * c) const { c[0] = c[1] = c[2] = 0.0;}
+
+    void add (coord_t, coord_t, coord_t) {}
+    void translate (coord_t, coord_t, coord_t) {}
+    void translate (const Space_Vector<coord_t> &) {}
+    void operator += (const Space_Vector<coord_t> &) {}
+
+    coord_t distance (const Space_Vector<coord_t> & v) const { return v.norm ();}
+    coord_t distance_squared (const Space_Vector<coord_t> & v) const { return v.normsquared ();}
+
+    angle_t angle_between (const Space_Vector<coord_t> & a1, const Space_Vector<coord_t> & a2) const { return a1.angle_between (a2);}
+
+    Space_Vector<coord_t> operator - (const No_Coordinates &) const { return Space_Vector<coord_t> (0.0, 0.0, 0.0);}
+
+    operator Space_Vector<coord_t> () const { return Space_Vector<coord_t> (0.0, 0.0, 0.0);}
+};
+
+#ifdef IW_NO_COORDINATES
+typedef No_Coordinates Atom_Position;
+#else
+typedef Coordinates Atom_Position;
+#endif
+
 #endif
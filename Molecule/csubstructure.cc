@@ -304,6 +304,18 @@ Substructure_Query::substructure_search_do_each_component (Molecule_to_Match & t
   return sresults.number_embeddings ();
 }
 
+int
+Substructure_Query::required_elements (int * count) const
+{
+  if (1 != _number_elements)
+    return 0;
+
+  if (0 == _operator.number_results () || 0 == _operator.unary_operator (0))
+    return 0;
+
+  return _things[0]->required_elements (count);
+}
+
 int
 Substructure_Query::set_find_one_embedding_per_atom (int s)
 {
@@ -16,9 +16,11 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 **************************************************************************/
+#include <string.h>
 #include "assert.h"
 
 #include "demerit.h"
+#include "iw_stl_hash_map.h"
 
 static int demerit_reason_contains_individual_demerits = 0;
 
@@ -40,6 +42,72 @@ set_store_demerit_reasons_like_tsubstructure (int s)
   return;
 }
 
+static IW_STL_Hash_Map_int rule_name_to_id;
+static resizable_array_p<IWString> rule_names;
+
+static int
+intern_rule_name (const const_IWSubstring & reason)
+{
+  IWString tmp(reason);
+
+  IW_STL_Hash_Map_int::const_iterator f = rule_name_to_id.find(tmp);
+  if (f != rule_name_to_id.end())
+    return (*f).second;
+
+  int rc = rule_names.number_elements();
+
+  rule_name_to_id[tmp] = rc;
+  rule_names.add(new IWString(tmp));
+
+  return rc;
+}
+
+/*
+  Reasons nearly always come from storage that lives as long as the
+  process - query comments and string literals - so remember the id
+  last seen for each address. The text is still compared, in case the
+  storage was reused for something else
+*/
+
+#define RULE_ID_CACHE_SIZE 256
+
+static const char * rule_id_cache_address[RULE_ID_CACHE_SIZE];
+static int rule_id_cache_id[RULE_ID_CACHE_SIZE];
+
+int
+demerit_rule_id (const const_IWSubstring & reason)
+{
+  const char * address = reason.rawchars();
+
+  const unsigned int h = static_cast<unsigned int>(reinterpret_cast<unsigned long>(address) >> 3) % RULE_ID_CACHE_SIZE;
+
+  if (address == rule_id_cache_address[h])
+  {
+    const IWString & r = *(rule_names[rule_id_cache_id[h]]);
+    if (r.length() == reason.length() && 0 == memcmp(r.rawchars(), address, r.length()))
+      return rule_id_cache_id[h];
+  }
+
+  int rc = intern_rule_name(reason);
+
+  rule_id_cache_address[h] = address;
+  rule_id_cache_id[h] = rc;
+
+  return rc;
+}
+
+const IWString &
+demerit_rule_name (int r)
+{
+  return *(rule_names[r]);
+}
+
+int
+number_demerit_rules ()
+{
+  return rule_names.number_elements();
+}
+
 static int _rejection_threshold = DEFAULT_REJECTION_THRESHOLD;
 
 void
@@ -58,6 +126,7 @@ Demerit::Demerit ()
 {
   _score = 0;
   _number_different_demerits_applied = 0;
+  _types_formatted = 0;
 
   return;
 }
@@ -71,7 +140,7 @@ Demerit::debug_print (ostream & os) const
   else
     os << "total " << _score;
 
-  os << ", origin '" << _types << "'\n";
+  os << ", origin '" << types () << "'\n";
 
   return 1;
 }
@@ -99,28 +168,155 @@ Demerit::_increment (int increment)
 }
 
 int 
-Demerit::reject (const const_IWSubstring reason)
+Demerit::reject (const const_IWSubstring reason, int nhits)
 {
   _increment (_rejection_threshold);
 
-  _add_hit_type (_rejection_threshold, reason);
+  _record_rule (_rejection_threshold, reason, nhits, 1);
 
   return 1;
 }
 
 int
-Demerit::extra (int increment, const const_IWSubstring reason)
+Demerit::extra (int increment, const const_IWSubstring reason, int nhits)
 {
   _increment (increment);
 
-  _add_hit_type (increment, reason);
+  _record_rule (increment, reason, nhits, 0);
+
+  return 1;
+}
+
+void
+Demerit::_record_rule (int increment,
+                       const const_IWSubstring & reason,
+                       int nhits,
+                       int rejection)
+{
+  _rule.add(demerit_rule_id(reason));
+  _rule_hits.add(nhits);
+  _rule_demerit.add(increment);
+  _rule_rejection.add(rejection);
+
+  return;
+}
+
+static void
+append_int (IWString & s, int v)
+{
+  s.strncat(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+static int
+fetch_int (const const_IWSubstring & s, int & i, int & v)
+{
+  if (i + static_cast<int>(sizeof(v)) > s.length())
+    return 0;
+
+  memcpy(&v, s.rawchars() + i, sizeof(v));
+  i += sizeof(v);
+
+  return 1;
+}
+
+static int
+fetch_string (const const_IWSubstring & s, int & i, const_IWSubstring & result)
+{
+  int n;
+  if (! fetch_int(s, i, n) || n < 0 || i + n > s.length())
+    return 0;
+
+  result.set(s.rawchars() + i, n);
+  i += n;
+
+  return 1;
+}
+
+/*
+  score, number of demerits, types, then number of rules and for each,
+  hits, demerit and the name
+*/
+
+int
+Demerit::append_binary_form (IWString & s) const
+{
+  append_int(s, _score);
+  append_int(s, _number_different_demerits_applied);
+  const IWString & t = types();
+
+  append_int(s, t.length());
+  s << t;
+
+  append_int(s, _rule.number_elements());
+
+  for (int i = 0; i < _rule.number_elements(); i++)
+  {
+    const IWString & r = demerit_rule_name(_rule[i]);
+
+    append_int(s, _rule_hits[i]);
+    append_int(s, _rule_demerit[i]);
+    append_int(s, r.length());
+    s << r;
+  }
 
   return 1;
 }
 
+int
+Demerit::build_from_binary_form (const const_IWSubstring & s)
+{
+  int i = 0;
+
+  const_IWSubstring types;
+  int nrules;
+
+  if (! fetch_int(s, i, _score) || ! fetch_int(s, i, _number_different_demerits_applied) ||
+      ! fetch_string(s, i, types) || ! fetch_int(s, i, nrules))
+    return 0;
+
+  _types = types;
+
+  _rule.resize_keep_storage(0);
+  _rule_hits.resize_keep_storage(0);
+  _rule_demerit.resize_keep_storage(0);
+  _rule_rejection.resize_keep_storage(0);
+
+  for (int j = 0; j < nrules; j++)
+  {
+    int hits, demerit;
+    const_IWSubstring r;
+
+    if (! fetch_int(s, i, hits) || ! fetch_int(s, i, demerit) || ! fetch_string(s, i, r))
+      return 0;
+
+    _record_rule(demerit, r, hits, 0);
+  }
+
+  _types_formatted = _rule.number_elements();   // _types came with the rules
+
+  return i == s.length();
+}
+
+/*
+  Bring _types up to date with the rules recorded
+*/
+
+const IWString &
+Demerit::types () const
+{
+  for ( ; _types_formatted < _rule.number_elements(); _types_formatted++)
+  {
+    const int i = _types_formatted;
+
+    _add_hit_type(_rule_demerit[i], demerit_rule_name(_rule[i]));
+  }
+
+  return _types;
+}
+
 void
 Demerit::_add_hit_type (int increment,
-                        const const_IWSubstring & reason)
+                        const const_IWSubstring & reason) const
 {
   if (store_demerit_reasons_like_tsubstructure)
   {
@@ -151,7 +347,7 @@ Demerit::write_in_tdt_form (ostream & os) const
 
   os << "DMRT<" << _score << ">\n";
   os << "NDMRT<" << _number_different_demerits_applied << ">\n";
-  os << "DMRTYP<" << _types << ">\n";
+  os << "DMRTYP<" << types () << ">\n";
 
   return 1;
 }
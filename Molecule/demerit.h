@@ -21,6 +21,7 @@
 
 #include <iostream>
 #include "iwstring.h"
+#include "iwaray.h"
 
 #define DEFAULT_REJECTION_THRESHOLD 100
 
@@ -34,14 +35,27 @@ class Demerit
   private:
     int _score;
     int _number_different_demerits_applied;
-    IWString _types;
+
+//  Oct 2026. Each demerit applied is kept as an interned rule id, the
+//  number of matches and the demerit. The text in _types is only
+//  formatted when someone asks for it, most molecules never need it.
+//  _types_formatted is the number of rules already in _types
+
+    small_resizable_array<int, 8> _rule;
+    small_resizable_array<int, 8> _rule_hits;
+    small_resizable_array<int, 8> _rule_demerit;
+    small_resizable_array<int, 8> _rule_rejection;
+
+    mutable IWString _types;
+    mutable int _types_formatted;
 
 //  private functions
 
     void _increment (int);
 //  void _add_hit_type (const char *);
 //  void _add_hit_type (const IWString &);
-    void _add_hit_type (int, const const_IWSubstring &);
+    void _add_hit_type (int, const const_IWSubstring &) const;
+    void _record_rule (int, const const_IWSubstring &, int, int);
 
   public:
     Demerit ();
@@ -52,18 +66,34 @@ class Demerit
     int score () const { return _score;};
     int number_different_demerits_applied () const { return _number_different_demerits_applied;}
 
-    const IWString & types () const { return _types;}
+    const IWString & types () const;
 
 //  int extra (int, const char *);
 //  int extra (int, const IWString &);
-    int extra (int, const const_IWSubstring);
-    int reject (const const_IWSubstring);
+    int extra (int, const const_IWSubstring, int nhits = 1);
+    int reject (const const_IWSubstring, int nhits = 1);
 //  int reject (const char *);
 //  int reject (const IWString &);
     int rejected () const;
     int rejected_by_single_rule () const { return 1 == _number_different_demerits_applied;}
 
     int write_in_tdt_form (ostream &) const;
+
+    int number_rules_recorded () const { return _rule.number_elements();}
+    int rule (int i) const { return _rule[i];}
+    int rule_hits (int i) const { return _rule_hits[i];}
+    int rule_demerit (int i) const { return _rule_demerit[i];}
+
+//  Whether the rule was applied by reject() rather than extra(). Not
+//  kept in the binary form
+
+    int rule_is_rejection (int i) const { return _rule_rejection[i];}
+
+//  Oct 2026. Compact binary form, for the iwdemerit result cache. Rules
+//  are stored by name, since ids are only valid within a process
+
+    int append_binary_form (IWString &) const;
+    int build_from_binary_form (const const_IWSubstring &);
 };
 
 extern void set_rejection_threshold (int);
@@ -78,4 +108,13 @@ extern int  rejection_threshold ();
 extern void set_demerit_reason_contains_individual_demerits (int);
 extern void set_store_demerit_reasons_like_tsubstructure (int);
 
+/*
+  Oct 2026. Rule names are interned so results can be written as
+  numbers. Ids are assigned in order of first use within a process
+*/
+
+extern int  demerit_rule_id (const const_IWSubstring &);
+extern const IWString & demerit_rule_name (int);
+extern int  number_demerit_rules ();
+
 #endif
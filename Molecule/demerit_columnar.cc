@@ -0,0 +1,400 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+#include "demerit.h"
+#include "demerit_columnar.h"
+
+#define IWDC_MAGIC "IWDC"
+#define IWDC_VERSION 1
+
+Demerit_Columnar_Writer::Demerit_Columnar_Writer ()
+{
+  _rules_written = 0;
+
+  return;
+}
+
+Demerit_Columnar_Writer::~Demerit_Columnar_Writer ()
+{
+  if (_output.is_open())
+    close();
+
+  return;
+}
+
+/*
+  When appending to an existing file the header is already there
+*/
+
+int
+Demerit_Columnar_Writer::open (const char * fname,
+                               int append)
+{
+  if (append)
+    _output.open(fname, std::ios::out | std::ios::app | std::ios::binary);
+  else
+    _output.open(fname, std::ios::out | std::ios::binary);
+
+  if (! _output.good())
+  {
+    cerr << "Demerit_Columnar_Writer::open:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+  _fname = fname;
+
+  _rules_written = 0;
+
+  if (append && _output.tellp() > 0)
+    return 1;
+
+  unsigned int version = IWDC_VERSION;
+
+  _output.write(IWDC_MAGIC, 4);
+  _output.write(reinterpret_cast<const char *>(&version), sizeof(version));
+
+  return _output.good();
+}
+
+int
+Demerit_Columnar_Writer::_write_block (unsigned int block_type,
+                                       const IWString & payload)
+{
+  unsigned int nbytes = payload.length();
+
+  _output.write(reinterpret_cast<const char *>(&block_type), sizeof(block_type));
+  _output.write(reinterpret_cast<const char *>(&nbytes), sizeof(nbytes));
+  _output.write(payload.rawchars(), nbytes);
+
+  return _output.good();
+}
+
+template <typename T>
+void
+append_column (IWString & payload, const T * v, int n)
+{
+  payload.strncat(reinterpret_cast<const char *>(v), n * sizeof(T));
+}
+
+/*
+  Names must be in the file before the first block that uses them
+*/
+
+int
+Demerit_Columnar_Writer::_write_new_rules ()
+{
+  int nrules = number_demerit_rules();
+
+  if (_rules_written == nrules)
+    return 1;
+
+  IWString payload;
+
+  for (int i = _rules_written; i < nrules; i++)
+  {
+    const IWString & r = demerit_rule_name(i);
+
+    unsigned int tmp[2];
+    tmp[0] = i;
+    tmp[1] = r.length();
+
+    append_column(payload, tmp, 2);
+    payload << r;
+  }
+
+  _rules_written = nrules;
+
+  return _write_block(IWDC_BLOCK_RULES, payload);
+}
+
+int
+Demerit_Columnar_Writer::_write_molecules ()
+{
+  int n = _score.number_elements();
+
+  if (0 == n)
+    return 1;
+
+  if (! _write_new_rules())
+    return 0;
+
+  unsigned int tmp[2];
+  tmp[0] = n;
+  tmp[1] = _rule.number_elements();
+
+  IWString payload;
+  payload.resize(8 + 20 * n + 12 * _rule.number_elements() + _ids.length() + 4);
+
+  append_column(payload, tmp, 2);
+  append_column(payload, _score.rawdata(), n);
+  append_column(payload, _hit_end.rawdata(), n);
+  append_column(payload, _rule.rawdata(), _rule.number_elements());
+  append_column(payload, _hits.rawdata(), _hits.number_elements());
+  append_column(payload, _demerit.rawdata(), _demerit.number_elements());
+  append_column(payload, _id_end.rawdata(), n);
+  payload << _stage;
+  payload << _ids;
+
+  while (0 != payload.length() % 4)
+  {
+    payload << ' ';
+  }
+
+  _score.resize_keep_storage(0);
+  _hit_end.resize_keep_storage(0);
+  _rule.resize_keep_storage(0);
+  _hits.resize_keep_storage(0);
+  _demerit.resize_keep_storage(0);
+  _id_end.resize_keep_storage(0);
+  _stage.resize_keep_storage(0);
+  _ids.resize_keep_storage(0);
+
+  return _write_block(IWDC_BLOCK_MOLECULES, payload);
+}
+
+int
+Demerit_Columnar_Writer::add (const const_IWSubstring & id,
+                              int stage,
+                              const Demerit & demerit)
+{
+  _score.add(demerit.score());
+
+  int nr = demerit.number_rules_recorded();
+
+  for (int i = 0; i < nr; i++)
+  {
+    _rule.add(demerit.rule(i));
+    _hits.add(demerit.rule_hits(i));
+    _demerit.add(demerit.rule_demerit(i));
+  }
+
+  _hit_end.add(_rule.number_elements());
+
+  _ids << id;
+  _id_end.add(_ids.length());
+
+  _stage.add(static_cast<char>(stage));
+
+  if (_score.number_elements() >= IWDC_MOLECULES_PER_BLOCK)
+    return _write_molecules();
+
+  return 1;
+}
+
+int
+Demerit_Columnar_Writer::flush ()
+{
+  if (! _write_molecules())
+    return 0;
+
+  _output.flush();
+
+  return _output.good();
+}
+
+int
+Demerit_Columnar_Writer::close ()
+{
+  int rc = flush();
+
+  _output.close();
+
+  return rc;
+}
+
+Demerit_Columnar_Reader::Demerit_Columnar_Reader ()
+{
+  _block = NULL;
+  _block_allocated = 0;
+
+  _n = 0;
+  _nhits = 0;
+
+  return;
+}
+
+Demerit_Columnar_Reader::~Demerit_Columnar_Reader ()
+{
+  if (NULL != _block)
+    delete [] _block;
+
+  return;
+}
+
+int
+Demerit_Columnar_Reader::open (const char * fname)
+{
+  if (! _input.open(fname))
+  {
+    cerr << "Demerit_Columnar_Reader::open:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+  char header[8];
+  if (8 != _input.read_bytes(header, 8) || 0 != strncmp(header, IWDC_MAGIC, 4))
+  {
+    cerr << "Demerit_Columnar_Reader::open:'" << fname << "' is not a columnar demerit file\n";
+    return 0;
+  }
+
+  unsigned int version;
+  memcpy(&version, header + 4, sizeof(version));
+
+  if (IWDC_VERSION != version)
+  {
+    cerr << "Demerit_Columnar_Reader::open:unsupported version " << version << endl;
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+Demerit_Columnar_Reader::_read_rules (unsigned int nbytes)
+{
+  unsigned int i = 0;
+
+  while (i + 8 <= nbytes)
+  {
+    unsigned int tmp[2];
+    memcpy(tmp, _block + i, 8);
+    i += 8;
+
+    if (i + tmp[1] > nbytes)
+      break;
+
+    while (_rule_name.number_elements() <= static_cast<int>(tmp[0]))
+    {
+      _rule_name.add(new IWString);
+    }
+
+    _rule_name[tmp[0]]->set(_block + i, static_cast<int>(tmp[1]));
+
+    i += tmp[1];
+  }
+
+  if (i != nbytes)
+  {
+    cerr << "Demerit_Columnar_Reader::_read_rules:corrupt rule block\n";
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+Demerit_Columnar_Reader::_set_columns (unsigned int nbytes)
+{
+  if (nbytes < 8)
+    return 0;
+
+  const unsigned int * tmp = reinterpret_cast<const unsigned int *>(_block);
+  _n = tmp[0];
+  _nhits = tmp[1];
+
+  if (static_cast<unsigned int>(8 + 13 * _n + 12 * _nhits) > nbytes)
+  {
+    cerr << "Demerit_Columnar_Reader::_set_columns:corrupt molecule block\n";
+    return 0;
+  }
+
+  _score = reinterpret_cast<const int *>(tmp + 2);
+  _hit_end = reinterpret_cast<const unsigned int *>(_score + _n);
+  _rule = _hit_end + _n;
+  _hits = reinterpret_cast<const int *>(_rule + _nhits);
+  _demerit = _hits + _nhits;
+  _id_end = reinterpret_cast<const unsigned int *>(_demerit + _nhits);
+  _stage = reinterpret_cast<const unsigned char *>(_id_end + _n);
+  _ids = reinterpret_cast<const char *>(_stage + _n);
+
+  for (int i = 0; i < _nhits; i++)
+  {
+    if (_rule[i] >= static_cast<unsigned int>(_rule_name.number_elements()))
+    {
+      cerr << "Demerit_Columnar_Reader::_set_columns:undefined rule " << _rule[i] << endl;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int
+Demerit_Columnar_Reader::next_block ()
+{
+  _n = 0;
+  _nhits = 0;
+
+  while (1)
+  {
+    unsigned int tmp[2];
+    int nread = _input.read_bytes(tmp, 8);
+
+    if (0 == nread)
+      return 0;     // EOF
+
+    if (8 != nread)
+    {
+      cerr << "Demerit_Columnar_Reader::next_block:truncated block header\n";
+      return -1;
+    }
+
+    if (tmp[1] > _block_allocated)
+    {
+      if (NULL != _block)
+        delete [] _block;
+
+      _block_allocated = tmp[1];
+      _block = new char[_block_allocated];
+    }
+
+    if (tmp[1] > 0 && static_cast<int>(tmp[1]) != _input.read_bytes(_block, tmp[1]))
+    {
+      cerr << "Demerit_Columnar_Reader::next_block:truncated block\n";
+      return -1;
+    }
+
+    if (IWDC_BLOCK_RULES == tmp[0])
+    {
+      if (! _read_rules(tmp[1]))
+        return -1;
+    }
+    else if (IWDC_BLOCK_MOLECULES == tmp[0])
+      return _set_columns(tmp[1]) ? 1 : -1;
+    else
+    {
+      cerr << "Demerit_Columnar_Reader::next_block:unrecognised block type " << tmp[0] << endl;
+      return -1;
+    }
+  }
+}
+
+const_IWSubstring
+Demerit_Columnar_Reader::id (int i) const
+{
+  int istart = (0 == i) ? 0 : _id_end[i - 1];
+
+  return const_IWSubstring(_ids + istart, _id_end[i] - istart);
+}
@@ -0,0 +1,175 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_DEMERIT_COLUMNAR_H
+#define IW_DEMERIT_COLUMNAR_H
+
+/*
+  Oct 2026. Compact per molecule results from iwdemerit, so downstream
+  aggregation does not have to parse text with regular expressions.
+
+  The file is "IWDC" and a uint32 version, then a sequence of blocks, each
+  a uint32 block type and a uint32 payload size. Numbers are native byte
+  order - this is for passing results between programs, not archiving.
+
+  Rule dictionary blocks hold (uint32 id, uint32 length, name) entries.
+  A later definition of an id replaces an earlier one, so a file written
+  in several runs (resumed from a checkpoint for example) is still valid.
+
+  Molecule blocks hold up to IWDC_MOLECULES_PER_BLOCK molecules, stored
+  by column so that a reader can scan a column as an array
+
+    uint32 n, uint32 nhits
+    int32  score[n]
+    uint32 hit_end[n]         hits for molecule i end at hit_end[i]
+    uint32 rule[nhits]
+    int32  hits[nhits]        number of query matches
+    int32  demerit[nhits]
+    uint32 id_end[n]          end of each id in ids
+    uint8  stage[n]           IWDC_STAGE_*, where the molecule was rejected
+    char   ids[id_end[n-1]]
+
+  padded to a multiple of 4 bytes.
+*/
+
+#include <fstream>
+
+#include "iwstring.h"
+#include "iwaray.h"
+#include "iwstring_data_source.h"
+
+class Demerit;
+
+#define IWDC_BLOCK_RULES 1
+#define IWDC_BLOCK_MOLECULES 2
+
+#define IWDC_MOLECULES_PER_BLOCK 4096
+
+#define IWDC_STAGE_NOT_REJECTED 0
+#define IWDC_STAGE_ATOM_COUNT 1
+#define IWDC_STAGE_VALENCE 2
+#define IWDC_STAGE_HARD_CODED 3
+#define IWDC_STAGE_QUERIES 4
+#define IWDC_STAGE_LARGEST_FRAGMENT_QUERIES 5
+
+class Demerit_Columnar_Writer
+{
+  private:
+    std::ofstream _output;
+
+    IWString _fname;
+
+//  Number of rule names already in the file
+
+    int _rules_written;
+
+//  Columns for the block being built
+
+    resizable_array<int> _score;
+    resizable_array<int> _hit_end;
+    resizable_array<int> _rule;
+    resizable_array<int> _hits;
+    resizable_array<int> _demerit;
+    resizable_array<int> _id_end;
+    IWString _stage;
+    IWString _ids;
+
+//  private functions
+
+    int _write_block (unsigned int, const IWString &);
+    int _write_new_rules ();
+    int _write_molecules ();
+
+  public:
+    Demerit_Columnar_Writer ();
+    ~Demerit_Columnar_Writer ();
+
+    int open (const char *, int append = 0);
+    int is_open () const { return _output.is_open();}
+
+    const IWString & fname () const { return _fname;}
+
+    int add (const const_IWSubstring & id, int stage, const Demerit &);
+
+//  Write any partial block so the file on disk is complete
+
+    int flush ();
+    int close ();
+};
+
+class Demerit_Columnar_Reader
+{
+  private:
+    iwstring_data_source _input;
+
+    resizable_array_p<IWString> _rule_name;
+
+    char * _block;
+    unsigned int _block_allocated;
+
+    int _n;
+    int _nhits;
+
+    const int * _score;
+    const unsigned int * _hit_end;
+    const unsigned int * _rule;
+    const int * _hits;
+    const int * _demerit;
+    const unsigned int * _id_end;
+    const unsigned char * _stage;
+    const char * _ids;
+
+//  private functions
+
+    int _read_rules (unsigned int);
+    int _set_columns (unsigned int);
+
+  public:
+    Demerit_Columnar_Reader ();
+    ~Demerit_Columnar_Reader ();
+
+    int open (const char *);
+
+//  Read the next block of molecules. Returns 0 at EOF, -1 on error
+
+    int next_block ();
+
+    int number_molecules () const { return _n;}
+
+    int score (int i) const { return _score[i];}
+    int stage (int i) const { return _stage[i];}
+
+    const_IWSubstring id (int i) const;
+
+    int hits_start (int i) const { return 0 == i ? 0 : _hit_end[i - 1];}
+    int hits_end (int i) const { return _hit_end[i];}
+
+    int rule (int h) const { return _rule[h];}
+    int hits (int h) const { return _hits[h];}
+    int demerit (int h) const { return _demerit[h];}
+
+    const IWString & rule_name (int r) const { return *(_rule_name[r]);}
+
+//  Whole columns, for scans across a block
+
+    const int * score_column () const { return _score;}
+    const unsigned char * stage_column () const { return _stage;}
+    const unsigned int * rule_column () const { return _rule;}
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include <iostream>
 using namespace std;
 #include <assert.h>
+#include <pthread.h>
 
 #ifdef IW_USE_TBB_SCALABLE_ALLOCATOR
 #include "tbb/scalable_allocator.h"
@@ -36,6 +37,59 @@ using namespace std;
 
 static resizable_array_p<Element> elements;
 
+/*
+  Oct 2026. While SD records are parsed on several threads (-i sdfthreads=)
+  any of them may create an element, which writes the hash table and may
+  move the elements array. During that time lookups take a shared lock and
+  element creation an exclusive one. Otherwise nothing is locked.
+  The count only goes between zero and non zero while no parse threads exist.
+*/
+
+static pthread_rwlock_t element_table_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static int element_table_shared = 0;
+
+void
+set_element_table_shared_between_threads (int s)
+{
+  if (s)
+    __sync_add_and_fetch(&element_table_shared, 1);
+  else
+    __sync_sub_and_fetch(&element_table_shared, 1);
+}
+
+class Element_Table_Lock
+{
+  private:
+    int _locked;
+
+  public:
+    Element_Table_Lock (int exclusive);
+    ~Element_Table_Lock ();
+};
+
+Element_Table_Lock::Element_Table_Lock (int exclusive)
+{
+  _locked = element_table_shared;
+
+  if (0 == _locked)
+    ;
+  else if (exclusive)
+    pthread_rwlock_wrlock(&element_table_lock);
+  else
+    pthread_rwlock_rdlock(&element_table_lock);
+
+  return;
+}
+
+Element_Table_Lock::~Element_Table_Lock ()
+{
+  if (_locked)
+    pthread_rwlock_unlock(&element_table_lock);
+
+  return;
+}
+
 #define PLAUSIBLE_ATOMIC_NUMBER(q) ((q) >= 0 && (q) <= HIGHEST_ATOMIC_NUMBER)
 
 #define OUTER_SHELL_ELECTRONS_NOT_KNOWN -18
@@ -94,7 +148,11 @@ set_display_strange_chemistry_messages(int s)
   display_strange_chemistry_messages = s;
 }
 
-const Element *
+/*
+  Callers must hold an Element_Table_Lock
+*/
+
+static const Element *
 get_element_from_long_symbols (const char * asymbol,
                                int nchars)
 {
@@ -1386,7 +1444,10 @@ get_element_from_symbol (const char *name, int nchars, int & isotope)
   if (nchars <= 2)   // good
     ;
   else if (_atomic_symbols_can_have_arbitrary_length)
+  {
+    Element_Table_Lock lock(0);
     return get_element_from_long_symbols (name, nchars);
+  }
   else    // long symbols not enabled
     return NULL;
 
@@ -1407,6 +1468,8 @@ get_element_from_symbol (const char *name, int nchars, int & isotope)
 //cerr << "Hash '" << tmp << "' is " << hash << endl;
 //cerr << "Element there is " << ehash[hash] << endl;
 
+  Element_Table_Lock lock(0);
+
   const Element * rc = ehash[hash];
 
   return rc;
@@ -1419,9 +1482,9 @@ get_element_from_symbol (const char *name, int nchars, int & isotope)
 
 //#define DEBUG_GET_ELEMENT_FROM_SYMBOL
 
-const Element *
-get_element_from_symbol_no_case_conversion (const char * s,
-                                            int nchars)
+static const Element *
+_get_element_from_symbol_no_case_conversion (const char * s,
+                                             int nchars)
 {
   if (0 == nchars)
   {
@@ -1444,6 +1507,15 @@ get_element_from_symbol_no_case_conversion (const char * s,
   return ehash[hash];
 }
 
+const Element *
+get_element_from_symbol_no_case_conversion (const char * s,
+                                            int nchars)
+{
+  Element_Table_Lock lock(0);
+
+  return _get_element_from_symbol_no_case_conversion(s, nchars);
+}
+
 const Element *
 get_element_from_symbol_no_case_conversion (const char * s)
 {
@@ -1549,6 +1621,8 @@ element_from_long_smiles_string (const char * asymbol,
     return rc;
   }
 
+  Element_Table_Lock lock(1);
+
   result = get_element_from_long_symbols (asymbol, close_square_bracket);
   if (NULL != result)
     return close_square_bracket;
@@ -1615,9 +1689,15 @@ element_from_smiles_string (const char * smiles,
   cerr << "ele '" << ele << "' nchars = " << nchars << " hash " << hash << " ehash " << ehash[hash] << endl;
 #endif
 
-  if (ehash[hash])
+  const Element * e;
   {
-    result = ehash[hash];
+    Element_Table_Lock lock(0);
+    e = ehash[hash];
+  }
+
+  if (NULL != e)
+  {
+    result = e;
     return nchars;
   }
 
@@ -1692,6 +1772,8 @@ element_from_smarts_string (const char * smiles, int characters_to_process,
 
 //cerr << "Hash value is " << hash << endl;
 
+  Element_Table_Lock lock(0);
+
   if (NULL == ehash[hash])      // no element of that kind yet
     return 0;
 
@@ -1738,6 +1820,8 @@ Element::ok() const
 const Element *
 get_element_from_atomic_number (atomic_number_t z)
 {
+  Element_Table_Lock lock(0);
+
   if (z >= 0 && z <= HIGHEST_ATOMIC_NUMBER)
     return elements[z];
 
@@ -1807,6 +1891,8 @@ create_element_with_symbol (const char * symbol, int nchars)
     return NULL;
   }
 
+  Element_Table_Lock lock(1);
+
   if (nchars <= 2)
     ;
   else if (! auto_create_new_elements())
@@ -1820,7 +1906,10 @@ create_element_with_symbol (const char * symbol, int nchars)
     return new Element (symbol, nchars);
   }
 
-  const Element * e = get_element_from_symbol_no_case_conversion (symbol, nchars);
+  const Element * e = _get_element_from_symbol_no_case_conversion (symbol, nchars);
+  if (NULL != e && element_table_shared)    // another thread created it first
+    return e;
+
   if (NULL != e)
   {
     cerr << "create_element_with_symbol: cannot create new element with symbol '";
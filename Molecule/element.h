@@ -181,6 +181,13 @@ extern const Element * create_element_with_symbol (const char *);
 extern const Element * create_element_with_symbol (const IWString &);
 extern const Element * create_element_with_symbol (const const_IWSubstring &);
 
+/*
+  Oct 2026. Called with 1 before threads that may create elements are
+  started, and with 0 once they have all finished
+*/
+
+extern void set_element_table_shared_between_threads (int);
+
 extern int element_from_smiles_string (const char * smiles, int nchars, const Element * & result);
 extern int element_from_smarts_string (const char * smiles, int nchars, const Element * & result);
 
@@ -893,18 +893,7 @@ Molecule::reduce_to_largest_fragment()
     }
   }
 
-  Set_of_Atoms atoms_to_be_removed;
-  atoms_to_be_removed.resize (maxat);
-
-  const int * fragment_membership = _fragment_information.fragment_membership();
-
-  for (int i = 0; i < _number_elements; i++)
-  {
-    if (fragment_membership[i] != imax)
-      atoms_to_be_removed.add (i);
-  }
-
-  return remove_atoms (atoms_to_be_removed);
+  return delete_all_fragments_except (imax);
 }
 
 atom_number_t
@@ -1247,6 +1236,23 @@ Fragment_Information::atoms_in_fragment (int matoms,
   return s.number_elements();
 }
 
+/*
+  Root of the union-find tree containing A, with path halving
+*/
+
+static atom_number_t
+union_find_root (int * parent,
+                 atom_number_t a)
+{
+  while (parent[a] != a)
+  {
+    parent[a] = parent[parent[a]];
+    a = parent[a];
+  }
+
+  return a;
+}
+
 int
 Molecule::_compute_fragment_information (Fragment_Information & fragment_information,
                                          int update_ring_info)
@@ -1261,45 +1267,47 @@ Molecule::_compute_fragment_information (Fragment_Information & fragment_informa
 
   int * fragment_membership = fragment_information.fragment_membership();
 
-  Set_of_Atoms mystack;
-  mystack.resize (_number_elements);
+// Union-find over the bond list. The fragment_membership array holds the
+// parent of each atom, and roots are always linked under the lower numbered
+// root, so a parent is never greater than the atom pointing to it
 
-  int nf = 0;
-
-  while (1)
+  for (int i = 0; i < _number_elements; i++)
   {
-    atom_number_t i = locate_item_in_array (FRAGMENT_MEMBERSHIP_NOT_SET, _number_elements, fragment_membership);
-
-//  cerr << "Fragment " << nf << " starts with atom " << i << endl;
+    fragment_membership[i] = i;
+  }
 
-    if (i < 0)
-      break;
+  int nb = _bond_list.number_elements();
 
-    mystack.add (i);
+  for (int i = 0; i < nb; i++)
+  {
+    const Bond * b = _bond_list[i];
 
-    while (mystack.number_elements() > 0)
-    {
-      atom_number_t zatom = mystack.pop();
+    atom_number_t r1 = union_find_root (fragment_membership, b->a1());
+    atom_number_t r2 = union_find_root (fragment_membership, b->a2());
 
-      if (fragment_membership[zatom] >= 0)
-        continue;
+    if (r1 < r2)
+      fragment_membership[r2] = r1;
+    else if (r2 < r1)
+      fragment_membership[r1] = r2;
+  }
 
-      fragment_membership[zatom] = nf;
+// Fragments are numbered in order of their lowest numbered atom, which is
+// also the root. Going through the atoms in order, every parent has already
+// been replaced by its fragment number by the time it is needed
 
-      const Atom * a = _things[zatom];
+  int nf = 0;
 
-      int acon = a->ncon();
-  
-      for (int i = 0; i < acon; i++)
-      {
-        atom_number_t j = a->other (zatom, i);
+  for (int i = 0; i < _number_elements; i++)
+  {
+    int p = fragment_membership[i];
 
-        if (FRAGMENT_MEMBERSHIP_NOT_SET == fragment_membership[j])
-          mystack.add (j);
-      }
+    if (p == i)
+    {
+      fragment_membership[i] = nf;
+      nf++;
     }
-
-    nf++;
+    else
+      fragment_membership[i] = fragment_membership[p];
   }
 
   assert (nf > 0);
@@ -0,0 +1,468 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+#include "hit_matrix.h"
+
+#define IWHM_MAGIC "IWHM"
+#define IWHM_VERSION 1
+
+Hit_Matrix_Writer::Hit_Matrix_Writer ()
+{
+  _kind = 0;
+
+  _columns_written = 0;
+
+  return;
+}
+
+Hit_Matrix_Writer::~Hit_Matrix_Writer ()
+{
+  if (_output.is_open())
+    close();
+
+  return;
+}
+
+int
+Hit_Matrix_Writer::open (const char * fname,
+                         int kind)
+{
+  _output.open(fname, std::ios::out | std::ios::binary);
+
+  if (! _output.good())
+  {
+    cerr << "Hit_Matrix_Writer::open:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+  _fname = fname;
+
+  _kind = kind;
+
+  unsigned int tmp[2];
+  tmp[0] = IWHM_VERSION;
+  tmp[1] = kind;
+
+  _output.write(IWHM_MAGIC, 4);
+  _output.write(reinterpret_cast<const char *>(tmp), sizeof(tmp));
+
+  return _output.good();
+}
+
+int
+Hit_Matrix_Writer::add_column (const IWString & name,
+                               int type,
+                               double weight)
+{
+  _column_name.add(new IWString(name));
+  _column_type.add(type);
+  _column_weight.add(weight);
+
+  return _column_name.number_elements() - 1;
+}
+
+int
+Hit_Matrix_Writer::hard_coded_column (const IWString & name)
+{
+  IW_STL_Hash_Map_int::const_iterator f = _hard_coded_column.find(name);
+  if (f != _hard_coded_column.end())
+    return (*f).second;
+
+  int rc = add_column(name, IWHM_COLUMN_HARD_CODED, 0.0);
+
+  _hard_coded_column[name] = rc;
+
+  return rc;
+}
+
+int
+Hit_Matrix_Writer::_write_block (unsigned int block_type,
+                                 const IWString & payload)
+{
+  unsigned int nbytes = payload.length();
+
+  _output.write(reinterpret_cast<const char *>(&block_type), sizeof(block_type));
+  _output.write(reinterpret_cast<const char *>(&nbytes), sizeof(nbytes));
+  _output.write(payload.rawchars(), nbytes);
+
+  return _output.good();
+}
+
+template <typename T>
+static void
+append_hit_matrix_column (IWString & payload, const T * v, int n)
+{
+  payload.strncat(reinterpret_cast<const char *>(v), n * sizeof(T));
+}
+
+/*
+  Columns must be in the file before the first block that uses them
+*/
+
+int
+Hit_Matrix_Writer::_write_new_columns ()
+{
+  int ncolumns = _column_name.number_elements();
+
+  if (_columns_written == ncolumns)
+    return 1;
+
+  IWString payload;
+
+  for (int i = _columns_written; i < ncolumns; i++)
+  {
+    const IWString & c = *(_column_name[i]);
+
+    unsigned int tmp[2];
+    tmp[0] = i;
+    tmp[1] = _column_type[i];
+
+    append_hit_matrix_column(payload, tmp, 2);
+    append_hit_matrix_column(payload, _column_weight.rawdata() + i, 1);
+
+    tmp[0] = c.length();
+    append_hit_matrix_column(payload, tmp, 1);
+    payload << c;
+  }
+
+  _columns_written = ncolumns;
+
+  return _write_block(IWHM_BLOCK_COLUMNS, payload);
+}
+
+int
+Hit_Matrix_Writer::_write_molecules ()
+{
+  int n = _natoms.number_elements();
+
+  if (0 == n)
+    return 1;
+
+  if (! _write_new_columns())
+    return 0;
+
+  const int nentries = _column.number_elements();
+
+  unsigned int tmp[2];
+  tmp[0] = n;
+  tmp[1] = nentries;
+
+  IWString payload;
+  payload.resize(8 + 20 * n + 12 * nentries + _smiles.length() + _ids.length() + 4);
+
+  append_hit_matrix_column(payload, tmp, 2);
+  append_hit_matrix_column(payload, _natoms.rawdata(), n);
+  append_hit_matrix_column(payload, _flags.rawdata(), n);
+  append_hit_matrix_column(payload, _entry_end.rawdata(), n);
+  append_hit_matrix_column(payload, _column.rawdata(), nentries);
+  append_hit_matrix_column(payload, _hits.rawdata(), nentries);
+  append_hit_matrix_column(payload, _value.rawdata(), nentries);
+  append_hit_matrix_column(payload, _smiles_end.rawdata(), n);
+  append_hit_matrix_column(payload, _id_end.rawdata(), n);
+  payload << _smiles;
+  payload << _ids;
+
+  while (0 != payload.length() % 4)
+  {
+    payload << ' ';
+  }
+
+  _natoms.resize_keep_storage(0);
+  _flags.resize_keep_storage(0);
+  _entry_end.resize_keep_storage(0);
+  _column.resize_keep_storage(0);
+  _hits.resize_keep_storage(0);
+  _value.resize_keep_storage(0);
+  _smiles_end.resize_keep_storage(0);
+  _id_end.resize_keep_storage(0);
+  _smiles.resize_keep_storage(0);
+  _ids.resize_keep_storage(0);
+
+  return _write_block(IWHM_BLOCK_MOLECULES, payload);
+}
+
+int
+Hit_Matrix_Writer::finish_row (const IWString & smiles,
+                               const const_IWSubstring & id,
+                               int natoms,
+                               int flags)
+{
+  _natoms.add(natoms);
+  _flags.add(flags);
+
+  _entry_end.add(_column.number_elements());
+
+  _smiles << smiles;
+  _smiles_end.add(_smiles.length());
+
+  _ids << id;
+  _id_end.add(_ids.length());
+
+  if (_natoms.number_elements() >= IWHM_MOLECULES_PER_BLOCK)
+    return _write_molecules();
+
+  return 1;
+}
+
+int
+Hit_Matrix_Writer::flush ()
+{
+  if (! _write_molecules())
+    return 0;
+
+//  Columns seen after the last molecule are still worth having
+
+  if (! _write_new_columns())
+    return 0;
+
+  _output.flush();
+
+  return _output.good();
+}
+
+int
+Hit_Matrix_Writer::close ()
+{
+  int rc = flush();
+
+  _output.close();
+
+  return rc;
+}
+
+Hit_Matrix_Reader::Hit_Matrix_Reader ()
+{
+  _kind = 0;
+
+  _block = NULL;
+  _block_allocated = 0;
+
+  _n = 0;
+  _nentries = 0;
+
+  return;
+}
+
+Hit_Matrix_Reader::~Hit_Matrix_Reader ()
+{
+  if (NULL != _block)
+    delete [] _block;
+
+  return;
+}
+
+int
+Hit_Matrix_Reader::open (const char * fname)
+{
+  if (! _input.open(fname))
+  {
+    cerr << "Hit_Matrix_Reader::open:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+  char header[12];
+  if (12 != _input.read_bytes(header, 12) || 0 != strncmp(header, IWHM_MAGIC, 4))
+  {
+    cerr << "Hit_Matrix_Reader::open:'" << fname << "' is not a hit matrix file\n";
+    return 0;
+  }
+
+  unsigned int tmp[2];
+  memcpy(tmp, header + 4, sizeof(tmp));
+
+  if (IWHM_VERSION != tmp[0])
+  {
+    cerr << "Hit_Matrix_Reader::open:unsupported version " << tmp[0] << endl;
+    return 0;
+  }
+
+  if (IWHM_KIND_DEMERITS != tmp[1] && IWHM_KIND_ANY_MATCH != tmp[1])
+  {
+    cerr << "Hit_Matrix_Reader::open:unrecognised kind " << tmp[1] << endl;
+    return 0;
+  }
+
+  _kind = tmp[1];
+
+  return 1;
+}
+
+int
+Hit_Matrix_Reader::_read_columns (unsigned int nbytes)
+{
+  unsigned int i = 0;
+
+  while (i + 20 <= nbytes)
+  {
+    unsigned int tmp[2];
+    memcpy(tmp, _block + i, 8);
+    i += 8;
+
+    double weight;
+    memcpy(&weight, _block + i, sizeof(weight));
+    i += sizeof(weight);
+
+    unsigned int length;
+    memcpy(&length, _block + i, sizeof(length));
+    i += sizeof(length);
+
+    if (i + length > nbytes)
+      break;
+
+    while (_column_name.number_elements() <= static_cast<int>(tmp[0]))
+    {
+      _column_name.add(new IWString);
+      _column_type.add(IWHM_COLUMN_QUERY);
+      _column_weight.add(0.0);
+    }
+
+    _column_name[tmp[0]]->set(_block + i, static_cast<int>(length));
+    _column_type[tmp[0]] = tmp[1];
+    _column_weight[tmp[0]] = weight;
+
+    i += length;
+  }
+
+  if (i != nbytes)
+  {
+    cerr << "Hit_Matrix_Reader::_read_columns:corrupt column block\n";
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+Hit_Matrix_Reader::_set_columns (unsigned int nbytes)
+{
+  if (nbytes < 8)
+    return 0;
+
+  const unsigned int * tmp = reinterpret_cast<const unsigned int *>(_block);
+  _n = tmp[0];
+  _nentries = tmp[1];
+
+  if (static_cast<unsigned int>(8 + 20 * _n + 12 * _nentries) > nbytes)
+  {
+    cerr << "Hit_Matrix_Reader::_set_columns:corrupt molecule block\n";
+    return 0;
+  }
+
+  _natoms = reinterpret_cast<const int *>(tmp + 2);
+  _flags = reinterpret_cast<const unsigned int *>(_natoms + _n);
+  _entry_end = _flags + _n;
+  _column = _entry_end + _n;
+  _hits = reinterpret_cast<const int *>(_column + _nentries);
+  _value = _hits + _nentries;
+  _smiles_end = reinterpret_cast<const unsigned int *>(_value + _nentries);
+  _id_end = _smiles_end + _n;
+  _smiles = reinterpret_cast<const char *>(_id_end + _n);
+  _ids = _smiles + (_n > 0 ? _smiles_end[_n - 1] : 0);
+
+  if (_n > 0 && static_cast<unsigned int>(8 + 20 * _n + 12 * _nentries) + _smiles_end[_n - 1] + _id_end[_n - 1] > nbytes)
+  {
+    cerr << "Hit_Matrix_Reader::_set_columns:corrupt molecule block\n";
+    return 0;
+  }
+
+  const unsigned int ncolumns = _column_name.number_elements();
+
+  for (int i = 0; i < _nentries; i++)
+  {
+    if (_column[i] >= ncolumns)
+    {
+      cerr << "Hit_Matrix_Reader::_set_columns:undefined column " << _column[i] << endl;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int
+Hit_Matrix_Reader::next_block ()
+{
+  _n = 0;
+  _nentries = 0;
+
+  while (1)
+  {
+    unsigned int tmp[2];
+    int nread = _input.read_bytes(tmp, 8);
+
+    if (0 == nread)
+      return 0;     // EOF
+
+    if (8 != nread)
+    {
+      cerr << "Hit_Matrix_Reader::next_block:truncated block header\n";
+      return -1;
+    }
+
+    if (tmp[1] > _block_allocated)
+    {
+      if (NULL != _block)
+        delete [] _block;
+
+      _block_allocated = tmp[1];
+      _block = new char[_block_allocated];
+    }
+
+    if (tmp[1] > 0 && static_cast<int>(tmp[1]) != _input.read_bytes(_block, tmp[1]))
+    {
+      cerr << "Hit_Matrix_Reader::next_block:truncated block\n";
+      return -1;
+    }
+
+    if (IWHM_BLOCK_COLUMNS == tmp[0])
+    {
+      if (! _read_columns(tmp[1]))
+        return -1;
+    }
+    else if (IWHM_BLOCK_MOLECULES == tmp[0])
+      return _set_columns(tmp[1]) ? 1 : -1;
+    else
+    {
+      cerr << "Hit_Matrix_Reader::next_block:unrecognised block type " << tmp[0] << endl;
+      return -1;
+    }
+  }
+}
+
+const_IWSubstring
+Hit_Matrix_Reader::smiles (int i) const
+{
+  int istart = (0 == i) ? 0 : _smiles_end[i - 1];
+
+  return const_IWSubstring(_smiles + istart, _smiles_end[i] - istart);
+}
+
+const_IWSubstring
+Hit_Matrix_Reader::id (int i) const
+{
+  int istart = (0 == i) ? 0 : _id_end[i - 1];
+
+  return const_IWSubstring(_ids + istart, _id_end[i] - istart);
+}
@@ -0,0 +1,213 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_HIT_MATRIX_H
+#define IW_HIT_MATRIX_H
+
+/*
+  Oct 2026. A sparse matrix of rule matches, one row per molecule, so
+  that thresholds, atom count cutoffs, demerit weights and the rules
+  applied can be changed without searching again. Written by iwdemerit
+  -H and tsubstructure -M hitmatrix=, read by mc_rescore.
+
+  Same conventions as demerit_columnar.h. The file is "IWHM", a uint32
+  version and a uint32 kind, IWHM_KIND_*, then blocks, each a uint32
+  block type and a uint32 payload size.
+
+  Column blocks define (uint32 id, uint32 type, double weight, uint32
+  length, name) entries, where type is IWHM_COLUMN_*. Columns for
+  queries are in file order. Columns for hard coded rules are added as
+  they are first seen.
+
+  Molecule blocks hold up to IWHM_MOLECULES_PER_BLOCK molecules
+
+    uint32 n, uint32 nentries
+    int32  natoms[n]             atoms in the largest fragment
+    uint32 flags[n]              IWHM_FLAG_*
+    uint32 entry_end[n]          entries for molecule i end at entry_end[i]
+    uint32 column[nentries]
+    int32  hits[nentries]        number of matches
+    int32  value[nentries]       demerit applied, or IWHM_REJECT
+    uint32 smiles_end[n]
+    uint32 id_end[n]
+    char   smiles[smiles_end[n-1]]
+    char   ids[id_end[n-1]]
+
+  padded to a multiple of 4 bytes.
+*/
+
+#include <fstream>
+
+#include "iwstring.h"
+#include "iwaray.h"
+#include "iw_stl_hash_map.h"
+#include "iwstring_data_source.h"
+
+#define IWHM_BLOCK_COLUMNS 1
+#define IWHM_BLOCK_MOLECULES 2
+
+#define IWHM_MOLECULES_PER_BLOCK 4096
+
+//  iwdemerit, rows are scored by demerits. tsubstructure, any match rejects
+
+#define IWHM_KIND_DEMERITS 1
+#define IWHM_KIND_ANY_MATCH 2
+
+#define IWHM_COLUMN_QUERY 0
+#define IWHM_COLUMN_LARGEST_FRAGMENT_QUERY 1
+#define IWHM_COLUMN_HARD_CODED 2
+
+#define IWHM_FLAG_BAD_VALENCE 1
+
+#define IWHM_REJECT -1
+
+class Hit_Matrix_Writer
+{
+  private:
+    std::ofstream _output;
+
+    IWString _fname;
+
+    int _kind;
+
+    resizable_array_p<IWString> _column_name;
+    resizable_array<int> _column_type;
+    resizable_array<double> _column_weight;
+
+    IW_STL_Hash_Map_int _hard_coded_column;
+
+    int _columns_written;
+
+//  Columns for the block being built
+
+    resizable_array<int> _natoms;
+    resizable_array<int> _flags;
+    resizable_array<int> _entry_end;
+    resizable_array<int> _column;
+    resizable_array<int> _hits;
+    resizable_array<int> _value;
+    resizable_array<int> _smiles_end;
+    resizable_array<int> _id_end;
+    IWString _smiles;
+    IWString _ids;
+
+//  private functions
+
+    int _write_block (unsigned int, const IWString &);
+    int _write_new_columns ();
+    int _write_molecules ();
+
+  public:
+    Hit_Matrix_Writer ();
+    ~Hit_Matrix_Writer ();
+
+    int open (const char *, int kind);
+    int is_open () const { return _output.is_open();}
+
+    const IWString & fname () const { return _fname;}
+
+//  Returns the id of the new column
+
+    int add_column (const IWString & name, int type, double weight);
+
+//  Hard coded rules are identified by name
+
+    int hard_coded_column (const IWString & name);
+
+//  Entries for the current row, then the row is finished
+
+    void add_entry (int column, int hits, int value)
+      {
+        _column.add(column);
+        _hits.add(hits);
+        _value.add(value);
+      }
+
+    int finish_row (const IWString & smiles, const const_IWSubstring & id, int natoms, int flags);
+
+    int flush ();
+    int close ();
+};
+
+class Hit_Matrix_Reader
+{
+  private:
+    iwstring_data_source _input;
+
+    int _kind;
+
+    resizable_array_p<IWString> _column_name;
+    resizable_array<int> _column_type;
+    resizable_array<double> _column_weight;
+
+    char * _block;
+    unsigned int _block_allocated;
+
+    int _n;
+    int _nentries;
+
+    const int * _natoms;
+    const unsigned int * _flags;
+    const unsigned int * _entry_end;
+    const unsigned int * _column;
+    const int * _hits;
+    const int * _value;
+    const unsigned int * _smiles_end;
+    const unsigned int * _id_end;
+    const char * _smiles;
+    const char * _ids;
+
+//  private functions
+
+    int _read_columns (unsigned int);
+    int _set_columns (unsigned int);
+
+  public:
+    Hit_Matrix_Reader ();
+    ~Hit_Matrix_Reader ();
+
+    int open (const char *);
+
+    int kind () const { return _kind;}
+
+//  Read the next block of molecules. Returns 0 at EOF, -1 on error
+
+    int next_block ();
+
+    int number_columns () const { return _column_name.number_elements();}
+    const IWString & column_name (int c) const { return *(_column_name[c]);}
+    int column_type (int c) const { return _column_type[c];}
+    double column_weight (int c) const { return _column_weight[c];}
+
+    int number_molecules () const { return _n;}
+
+    int natoms (int i) const { return _natoms[i];}
+    unsigned int flags (int i) const { return _flags[i];}
+
+    int entries_start (int i) const { return 0 == i ? 0 : _entry_end[i - 1];}
+    int entries_end (int i) const { return _entry_end[i];}
+
+    int column (int e) const { return _column[e];}
+    int hits (int e) const { return _hits[e];}
+    int value (int e) const { return _value[e];}
+
+    const_IWSubstring smiles (int i) const;
+    const_IWSubstring id (int i) const;
+};
+
+#endif
@@ -30,6 +30,8 @@ using namespace std;
 #include "iwstring_data_source.h"
 #include "iwcrex.h"
 
+#include "parallel_sdf.h"
+
 template <typename T>
 class data_source_and_type : public iwstring_data_source
 {
@@ -55,6 +57,19 @@ class data_source_and_type : public iwstring_data_source
 //  most recently read molecule started
 
     off_t _offset_for_most_recent_molecule;
+
+//  Oct 2026. Reading stops once a molecule would start at or beyond this
+//  offset. Comes from -i stop= or from -i shard=
+
+    off_t _stop_offset;
+
+//  Oct 2026. With -i sdfthreads= SD records are parsed by background
+//  threads. While that is happening the threads own the underlying
+//  iwstring_data_source, and _parallel_sdf_offset is the end of the most
+//  recent record handed out
+
+    Parallel_SDF_Reader * _parallel_sdf;
+    off_t _parallel_sdf_offset;
   
 //  private functions
 
@@ -69,6 +84,16 @@ class data_source_and_type : public iwstring_data_source
 
     size_t _average_size (off_t offset, IW_Regular_Expression & rx, int n);
 
+    int   _position_for_shard ();
+    off_t _shard_boundary (off_t, off_t);
+
+    int  _start_parallel_sdf ();
+    void _stop_parallel_sdf ();
+    T *  _next_molecule_parallel ();
+
+    static void * _parse_sdf_record (const char *, int, int);
+    static void   _delete_parsed_record (void *);
+
   public:
     data_source_and_type (const IWString &);
     data_source_and_type (int, const char *);
@@ -98,6 +123,11 @@ class data_source_and_type : public iwstring_data_source
     int stopped_because_of_error () const { return _connection_table_errors_encountered > _connection_table_errors_allowed;}
 
     int estimate_molecules_in_file ();
+
+//  These know about records read ahead by parallel SD parsing
+
+    off_t tellg () const;
+    int   seekg (off_t);
 };
 
 #if (IW_IMPLEMENTATIONS_EXPOSED) || defined(ISTREAM_AND_TYPE_IMPLEMENTATION)
@@ -138,6 +168,11 @@ data_source_and_type<T>::_default_values (int input_type)
 
   _offset_for_most_recent_molecule = static_cast<off_t>(0);
 
+  _stop_offset = max_offset_from_command_line();
+
+  _parallel_sdf = NULL;
+  _parallel_sdf_offset = static_cast<off_t>(0);
+
   return 1;
 }
 
@@ -165,7 +200,16 @@ data_source_and_type<T>::_file_opened_ok (const IWString & fname)
   if (input_is_dos_mode())
     iwstring_data_source::set_dos (1);
 
-  if (seek_to_from_command_line() > 0)
+  int shard, nshards;
+  if (input_shard (shard, nshards))
+  {
+    if (! _position_for_shard())
+    {
+      _valid = 0;
+      return 0;
+    }
+  }
+  else if (seek_to_from_command_line() > 0)
   {
     if (! iwstring_data_source::seekg (seek_to_from_command_line()))
     {
@@ -176,6 +220,108 @@ data_source_and_type<T>::_file_opened_ok (const IWString & fname)
   return 1;
 }
 
+/*
+  The first record that starts at or after offset O. Every process computes
+  the same boundaries, so each record is read by exactly one shard.
+  We back up one byte and discard the rest of that line, so a record that
+  starts exactly at O is found.
+*/
+
+template <typename T>
+off_t
+data_source_and_type<T>::_shard_boundary (off_t o, off_t file_size)
+{
+  if (o <= static_cast<off_t>(0))
+    return static_cast<off_t>(0);
+
+  if (o >= file_size)
+    return file_size;
+
+  IW_Regular_Expression rx;
+
+  if (SMI != _input_type && ! _set_rx_for_input_type (rx))
+    return static_cast<off_t>(-1);
+
+  if (! iwstring_data_source::seekg (o - 1))
+    return static_cast<off_t>(-1);
+
+  const_IWSubstring buffer;
+
+  if (! iwstring_data_source::next_record (buffer))    // partial line
+    return file_size;
+
+  if (SMI == _input_type)
+    return tellg();
+
+  while (iwstring_data_source::next_record (buffer))
+  {
+    if (rx.matches (buffer))
+      return tellg();
+  }
+
+  return file_size;
+}
+
+/*
+  With -i shard=k/N we read the records starting between k*size/N and
+  (k+1)*size/N
+*/
+
+template <typename T>
+int
+data_source_and_type<T>::_position_for_shard ()
+{
+  int shard, nshards;
+  (void) input_shard (shard, nshards);
+
+  if (is_pipe())
+  {
+    cerr << "data_source_and_type::_position_for_shard:cannot shard a pipe\n";
+    return 0;
+  }
+
+  if (IWMTYPE_IWB == _input_type)
+  {
+    cerr << "data_source_and_type::_position_for_shard:cannot shard binary input\n";
+    return 0;
+  }
+
+  off_t zsize = file_size();
+  if (zsize <= static_cast<off_t>(0))
+  {
+    cerr << "data_source_and_type::_position_for_shard:cannot determine size of '" << _fname << "'\n";
+    return 0;
+  }
+
+  iwstring_data_source::set_skip_blank_lines (0);    // blank lines are boundaries too
+
+  off_t zstart = _shard_boundary (zsize * shard / nshards, zsize);
+  off_t zstop  = _shard_boundary (zsize * (shard + 1) / nshards, zsize);
+
+  if (SMI == _input_type)
+    iwstring_data_source::set_skip_blank_lines (1);
+
+  if (zstart < static_cast<off_t>(0) || zstop < static_cast<off_t>(0))
+  {
+    cerr << "data_source_and_type::_position_for_shard:cannot find record boundaries in '" << _fname << "'\n";
+    return 0;
+  }
+
+  if (zstop < _stop_offset)
+    _stop_offset = zstop;
+
+  if (! iwstring_data_source::seekg (zstart))
+  {
+    cerr << "data_source_and_type::_position_for_shard:cannot seek to " << zstart << endl;
+    return 0;
+  }
+
+  if (_verbose)
+    cerr << "Shard " << shard << " of " << nshards << " reads bytes " << zstart << " to " << zstop << " of '" << _fname << "'\n";
+
+  return 1;
+}
+
 template <typename T>
 data_source_and_type<T>::data_source_and_type (int input_type,
                                                const char * fname) :
@@ -256,6 +402,8 @@ data_source_and_type<T>::data_source_and_type()
 template <typename T>
 data_source_and_type<T>::~data_source_and_type()
 {
+  if (NULL != _parallel_sdf)
+    delete _parallel_sdf;
 
   if (_verbose)
     cerr << "Read " << _molecules_read << " molecules from '" << _fname << "'\n";
@@ -326,6 +474,9 @@ data_source_and_type<T>::next_molecule()
     return NULL;
   }
 
+  if (NULL != _parallel_sdf || _start_parallel_sdf())
+    return _next_molecule_parallel();
+
   if (! good())
   {
     _valid = 0;
@@ -338,7 +489,7 @@ data_source_and_type<T>::next_molecule()
     {
       _offset_for_most_recent_molecule = tellg();
 
-      if (_offset_for_most_recent_molecule >= max_offset_from_command_line())
+      if (_offset_for_most_recent_molecule >= _stop_offset)
         return NULL;
     }
 
@@ -472,6 +623,8 @@ data_source_and_type<T>::molecules_remaining()
     return 0;
   }
 
+  _stop_parallel_sdf();
+
   if (SMI == _input_type)
     return records_remaining();
 
@@ -503,6 +656,21 @@ data_source_and_type<T>::_do_skip_first()
     return;
   }
 
+  if (IWMTYPE_IWB == _input_type)    // binary, no records to skip, read and discard
+  {
+    for (int i = 0; i < _skip_first; i++)
+    {
+      T m;
+      if (! m.read_molecule_ds (*this, _input_type))
+      {
+        _valid = 0;
+        return;
+      }
+    }
+
+    return;
+  }
+
   IW_Regular_Expression rx;
 
   if (! _set_rx_for_input_type (rx))
@@ -673,6 +841,8 @@ template <typename T>
 int
 data_source_and_type<T>::estimate_molecules_in_file ()
 {
+  _stop_parallel_sdf();
+
   IW_Regular_Expression rx;
 
   if (! _set_rx_for_input_type(rx))
@@ -701,6 +871,184 @@ data_source_and_type<T>::estimate_molecules_in_file ()
   return items_in_file;
 }
 
+template <typename T>
+void *
+data_source_and_type<T>::_parse_sdf_record (const char * record,
+                                            int nbytes,
+                                            int input_type)
+{
+  iwstring_data_source input(true, record, nbytes);
+
+  input.set_record_delimiter(input_file_delimiter());
+
+  if (input_is_dos_mode())
+    input.set_dos(1);
+
+  T * m = new T;
+  if (m->read_molecule_ds(input, input_type))
+    return m;
+
+  delete m;
+
+  return NULL;
+}
+
+template <typename T>
+void
+data_source_and_type<T>::_delete_parsed_record (void * p)
+{
+  delete reinterpret_cast<T *>(p);
+}
+
+/*
+  Hand the rest of the file to a Parallel_SDF_Reader. Not done when
+  the reader keeps per molecule state on the side
+*/
+
+template <typename T>
+int
+data_source_and_type<T>::_start_parallel_sdf ()
+{
+  if (sdf_parse_threads() <= 0)
+    return 0;
+
+  if (SDF != _input_type && MDL != _input_type)
+    return 0;
+
+  if (mdl_accumulate_mdl_chirality_features())
+    return 0;
+
+  if (! good() || at_eof())
+    return 0;
+
+  _parallel_sdf = new Parallel_SDF_Reader(*this, _input_type, _parse_sdf_record, _delete_parsed_record, sdf_parse_threads());
+
+  if (is_pipe())
+    _parallel_sdf_offset = static_cast<off_t>(0);
+  else
+    _parallel_sdf_offset = iwstring_data_source::tellg();
+
+  if (! _parallel_sdf->start(_stop_offset))
+  {
+    delete _parallel_sdf;
+    _parallel_sdf = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+  Stop the background threads and leave the underlying file positioned
+  just after the last record handed out
+*/
+
+template <typename T>
+void
+data_source_and_type<T>::_stop_parallel_sdf ()
+{
+  if (NULL == _parallel_sdf)
+    return;
+
+  delete _parallel_sdf;
+  _parallel_sdf = NULL;
+
+  if (! is_pipe())
+    iwstring_data_source::seekg(_parallel_sdf_offset);
+
+  return;
+}
+
+template <typename T>
+T *
+data_source_and_type<T>::_next_molecule_parallel ()
+{
+  while (_connection_table_errors_encountered <= _connection_table_errors_allowed)
+  {
+    void * result;
+    const char * text;
+    int nbytes;
+    off_t offset;
+
+    int rc = _parallel_sdf->next_record(result, text, nbytes, offset);
+    if (rc < 0)
+    {
+      _valid = 0;
+      return NULL;
+    }
+
+    if (0 == rc)
+      return NULL;
+
+    _offset_for_most_recent_molecule = offset;
+    _parallel_sdf_offset = offset + nbytes;
+
+    if (NULL != result)
+    {
+      T * m = reinterpret_cast<T *>(result);
+
+      _molecules_read++;
+      if (_verbose)
+      {
+        cerr << _molecules_read;
+        if (m->name().length())
+          cerr << " read '" << m->name() << "'\n";
+        else
+          cerr << " no name\n";
+      }
+
+      return m;
+    }
+
+//  A failure on trailing text with no $$$$ is just the end of the file
+
+    if (! sdf_record_is_complete(text, nbytes))
+      return NULL;
+
+    _connection_table_errors_encountered++;
+
+    cerr << "data_source_and_type::next_molecule: Skipping connection table error " << _connection_table_errors_encountered << 
+            " at offset " << offset << endl;
+
+    if (_stream_for_connection_table_errors.is_open())
+    {
+      _stream_for_connection_table_errors.strncat(text, nbytes);
+      _stream_for_connection_table_errors.write_if_buffer_holds_more_than(32768);
+    }
+
+    if (_connection_table_errors_encountered > _connection_table_errors_allowed)
+    {
+      cerr << "data_source_and_type::next_molecule:too many connection table errors " << _connection_table_errors_allowed << endl;
+      return 0;
+    }
+  }
+
+  return NULL;
+}
+
+template <typename T>
+off_t
+data_source_and_type<T>::tellg () const
+{
+  if (NULL != _parallel_sdf)
+    return _parallel_sdf_offset;
+
+  return iwstring_data_source::tellg();
+}
+
+template <typename T>
+int
+data_source_and_type<T>::seekg (off_t o)
+{
+  if (NULL != _parallel_sdf)
+  {
+    delete _parallel_sdf;
+    _parallel_sdf = NULL;
+  }
+
+  return iwstring_data_source::seekg(o);
+}
+
 #endif
 
 #endif
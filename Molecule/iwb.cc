@@ -0,0 +1,651 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+/*
+  Binary connection tables for passing molecules between the stages of a
+  pipeline. Writing and reading these is much cheaper than generating and
+  parsing smiles: atoms and bonds are stored in the order they have in the
+  molecule, and the Kekule form is stored, so no aromaticity or Kekule
+  perception is needed on input.
+
+  Rings and aromaticity are not stored. They are re-perceived on demand
+  by the reader, just as they would be after reading a smiles.
+
+  Each molecule is
+
+    "IWB1" uint32 nbytes <nbytes of payload>
+
+  all numbers are in native byte order - this is for passing data between
+  processes on the same machine, not for archiving.
+*/
+
+#include "misc.h"
+#include "iw_auto_array.h"
+#include "iwstring_data_source.h"
+
+#include "molecule.h"
+#include "chiral_centre.h"
+
+#define IWB_MAGIC "IWB1"
+#define IWB_HEADER_SIZE 8
+
+/*
+  Molecule level flags
+*/
+
+#define IWB_HAS_COORDINATES 1
+#define IWB_HAS_PARTIAL_CHARGES 2
+#define IWB_CONNECTION_ORDER 4
+#define IWB_SHORT_ATOM_NUMBERS 8
+#define IWB_INT_ATOM_NUMBERS 16
+
+/*
+  Atom level flags
+*/
+
+#define IWB_ATOM_SYMBOL 1
+#define IWB_ATOM_FORMAL_CHARGE 2
+#define IWB_ATOM_ISOTOPE 4
+#define IWB_ATOM_HCOUNT_KNOWN 8
+#define IWB_ATOM_PERMANENT_AROMATIC 16
+
+/*
+  Set in the bond type byte when a byte of directional flags follows
+*/
+
+#define IWB_BOND_DIRECTIONAL 128
+
+template <typename T>
+void
+iwb_append (IWString & buffer, T v)
+{
+  buffer.strncat(reinterpret_cast<const char *>(&v), sizeof(T));
+
+  return;
+}
+
+/*
+  Atom numbers are written in as few bytes as the size of the molecule allows
+*/
+
+static void
+iwb_append_atom_number (IWString & buffer, int width, atom_number_t a)
+{
+  if (IWB_INT_ATOM_NUMBERS == width)
+    iwb_append(buffer, static_cast<int>(a));
+  else if (IWB_SHORT_ATOM_NUMBERS == width)
+    iwb_append(buffer, static_cast<unsigned short>(a));
+  else
+    iwb_append(buffer, static_cast<unsigned char>(a));
+
+  return;
+}
+
+/*
+  The chiral centre connections can be special values, they
+  always go out as full ints
+*/
+
+static void
+iwb_append_chiral_centre (IWString & buffer, const Chiral_Centre & c)
+{
+  iwb_append(buffer, static_cast<int>(c.a()));
+  iwb_append(buffer, static_cast<int>(c.top_front()));
+  iwb_append(buffer, static_cast<int>(c.top_back()));
+  iwb_append(buffer, static_cast<int>(c.left_down()));
+  iwb_append(buffer, static_cast<int>(c.right_down()));
+  iwb_append(buffer, static_cast<char>(c.chirality_known()));
+
+  return;
+}
+
+/*
+  Are the bonds attached to each atom in the same order as they appear in
+  _bond_list? That is what we get when the bonds are added one at a time,
+  and then the per atom connection order does not need to be stored.
+*/
+
+static int
+connections_follow_bond_list (const resizable_array_p<Atom> & atoms,
+                              const Bond_list & bond_list)
+{
+  const int matoms = atoms.number_elements();
+
+  int * pos = new_int(matoms); iw_auto_array<int> free_pos(pos);
+
+  const int nb = bond_list.number_elements();
+
+  for (int i = 0; i < nb; i++)
+  {
+    const Bond * b = bond_list[i];
+
+    atom_number_t a1 = b->a1();
+    atom_number_t a2 = b->a2();
+
+    if (atoms[a1]->item(pos[a1]) != b)
+      return 0;
+    if (atoms[a2]->item(pos[a2]) != b)
+      return 0;
+
+    pos[a1]++;
+    pos[a2]++;
+  }
+
+  return 1;
+}
+
+static IWString iwb_buffer;
+
+int
+Molecule::write_molecule_iwb (ostream & os)
+{
+  assert (os.good());
+
+  const int matoms = _number_elements;
+  const int nb = _bond_list.number_elements();
+  const int nc = _chiral_centres.number_elements();
+
+  int flags = 0;
+
+  int width = 0;
+  if (matoms > 0xffff)
+    width = IWB_INT_ATOM_NUMBERS;
+  else if (matoms > 0xff)
+    width = IWB_SHORT_ATOM_NUMBERS;
+
+  flags |= width;
+
+  if (NULL != _charges)
+    flags |= IWB_HAS_PARTIAL_CHARGES;
+
+  for (int i = 0; i < matoms; i++)
+  {
+    const Atom * a = _things[i];
+    if (static_cast<coord_t>(0.0) != a->x() || static_cast<coord_t>(0.0) != a->y() || static_cast<coord_t>(0.0) != a->z())
+    {
+      flags |= IWB_HAS_COORDINATES;
+      break;
+    }
+  }
+
+  if (! connections_follow_bond_list(*this, _bond_list))
+    flags |= IWB_CONNECTION_ORDER;
+
+  iwb_buffer.resize_keep_storage(0);
+
+  iwb_append(iwb_buffer, matoms);
+  iwb_append(iwb_buffer, nb);
+  iwb_append(iwb_buffer, nc);
+  iwb_append(iwb_buffer, static_cast<unsigned char>(flags));
+
+  iwb_append(iwb_buffer, _molecule_name.length());
+  iwb_buffer.strncat(_molecule_name.rawchars(), _molecule_name.length());
+
+  for (int i = 0; i < matoms; i++)
+  {
+    Atom * a = _things[i];
+
+    const Element * e = a->element();
+
+    int aflags = 0;
+    if (! e->is_in_periodic_table() || e != get_element_from_atomic_number(e->atomic_number()))
+      aflags |= IWB_ATOM_SYMBOL;
+    if (a->formal_charge())
+      aflags |= IWB_ATOM_FORMAL_CHARGE;
+    if (a->isotope())
+      aflags |= IWB_ATOM_ISOTOPE;
+    if (a->implicit_hydrogens_known())
+      aflags |= IWB_ATOM_HCOUNT_KNOWN;
+    if (a->permanent_aromatic())
+      aflags |= IWB_ATOM_PERMANENT_AROMATIC;
+
+    iwb_append(iwb_buffer, static_cast<unsigned char>(aflags));
+
+    if (aflags & IWB_ATOM_SYMBOL)
+    {
+      const IWString & s = e->symbol();
+      iwb_append(iwb_buffer, static_cast<unsigned char>(s.length()));
+      iwb_buffer.strncat(s.rawchars(), s.length());
+    }
+    else
+      iwb_append(iwb_buffer, static_cast<unsigned char>(e->atomic_number()));
+
+    if (aflags & IWB_ATOM_FORMAL_CHARGE)
+      iwb_append(iwb_buffer, static_cast<signed char>(a->formal_charge()));
+    if (aflags & IWB_ATOM_ISOTOPE)
+      iwb_append(iwb_buffer, a->isotope());
+    if (aflags & IWB_ATOM_HCOUNT_KNOWN)
+      iwb_append(iwb_buffer, static_cast<unsigned char>(a->implicit_hydrogens()));
+  }
+
+  for (int i = 0; i < nb; i++)
+  {
+    const Bond * b = _bond_list[i];
+
+    iwb_append_atom_number(iwb_buffer, width, b->a1());
+    iwb_append_atom_number(iwb_buffer, width, b->a2());
+
+//  Computed aromaticity is not stored, it will be perceived again
+
+    bond_type_t bt = b->btype() & (SINGLE_BOND | DOUBLE_BOND | TRIPLE_BOND | PERMANENT_AROMATIC_BOND);
+
+    if (b->directional_flags())
+    {
+      iwb_append(iwb_buffer, static_cast<unsigned char>(bt | IWB_BOND_DIRECTIONAL));
+      iwb_append(iwb_buffer, static_cast<unsigned char>(b->directional_flags()));
+    }
+    else
+      iwb_append(iwb_buffer, static_cast<unsigned char>(bt));
+  }
+
+  if (flags & IWB_CONNECTION_ORDER)
+  {
+    for (int i = 0; i < matoms; i++)
+    {
+      const Atom * a = _things[i];
+
+      const int acon = a->ncon();
+      for (int j = 0; j < acon; j++)
+      {
+        iwb_append_atom_number(iwb_buffer, width, a->other(i, j));
+      }
+    }
+  }
+
+  for (int i = 0; i < nc; i++)
+  {
+    iwb_append_chiral_centre(iwb_buffer, *(_chiral_centres[i]));
+  }
+
+  if (flags & IWB_HAS_COORDINATES)
+  {
+    for (int i = 0; i < matoms; i++)
+    {
+      const Atom * a = _things[i];
+      iwb_append(iwb_buffer, a->x());
+      iwb_append(iwb_buffer, a->y());
+      iwb_append(iwb_buffer, a->z());
+    }
+  }
+
+  if (flags & IWB_HAS_PARTIAL_CHARGES)
+  {
+    for (int i = 0; i < matoms; i++)
+    {
+      iwb_append(iwb_buffer, _charges->item(i));
+    }
+  }
+
+  unsigned int nbytes = iwb_buffer.length();
+
+  os.write(IWB_MAGIC, 4);
+  os.write(reinterpret_cast<const char *>(&nbytes), sizeof(nbytes));
+  os.write(iwb_buffer.rawchars(), nbytes);
+
+  if (! os.good())
+  {
+    cerr << "Molecule::write_molecule_iwb:write failed\n";
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+  Pulls items out of a payload, checking that we never read past the end
+*/
+
+class IWB_Cursor
+{
+  private:
+    const unsigned char * _p;
+    const unsigned char * _end;
+
+  public:
+    IWB_Cursor (const unsigned char * s, int n) : _p(s), _end(s + n) {}
+
+    template <typename T> int get (T & v);
+
+    int get_atom_number (int width, atom_number_t & a);
+
+    const char * get_chars (int n);
+};
+
+template <typename T>
+int
+IWB_Cursor::get (T & v)
+{
+  if (_p + sizeof(T) > _end)
+    return 0;
+
+  memcpy(&v, _p, sizeof(T));
+
+  _p += sizeof(T);
+
+  return 1;
+}
+
+int
+IWB_Cursor::get_atom_number (int width, atom_number_t & a)
+{
+  if (IWB_INT_ATOM_NUMBERS == width)
+    return get(a);
+
+  if (IWB_SHORT_ATOM_NUMBERS == width)
+  {
+    unsigned short s;
+    if (! get(s))
+      return 0;
+
+    a = s;
+    return 1;
+  }
+
+  unsigned char c;
+  if (! get(c))
+    return 0;
+
+  a = c;
+
+  return 1;
+}
+
+const char *
+IWB_Cursor::get_chars (int n)
+{
+  if (_p + n > _end)
+    return NULL;
+
+  const char * rc = reinterpret_cast<const char *>(_p);
+
+  _p += n;
+
+  return rc;
+}
+
+static int
+iwb_error (const char * message)
+{
+  cerr << "Molecule::read_molecule_iwb_ds:" << message << endl;
+
+  return 0;
+}
+
+static resizable_array<unsigned char> iwb_payload;
+
+int
+Molecule::read_molecule_iwb_ds (iwstring_data_source & input)
+{
+  assert (input.good());
+
+  if (input.eof())
+    return 0;
+
+  char header[IWB_HEADER_SIZE];
+
+  int nread = input.read_bytes(header, IWB_HEADER_SIZE);
+
+  if (0 == nread)    // normal eof
+    return 0;
+
+  if (IWB_HEADER_SIZE != nread)
+  {
+    cerr << "Molecule::read_molecule_iwb_ds:truncated header\n";
+    return 0;
+  }
+
+  if (0 != strncmp(header, IWB_MAGIC, 4))
+  {
+    cerr << "Molecule::read_molecule_iwb_ds:invalid magic number, not an iwb file\n";
+    return 0;
+  }
+
+  unsigned int nbytes;
+  memcpy(&nbytes, header + 4, sizeof(nbytes));
+
+  if (0 == nbytes)
+  {
+    cerr << "Molecule::read_molecule_iwb_ds:empty record\n";
+    return 0;
+  }
+
+  if (iwb_payload.elements_allocated() < static_cast<int>(nbytes))
+    iwb_payload.resize(nbytes);
+
+  if (static_cast<int>(nbytes) != input.read_bytes(iwb_payload.rawdata(), nbytes))
+  {
+    cerr << "Molecule::read_molecule_iwb_ds:truncated record, expected " << nbytes << " bytes\n";
+    return 0;
+  }
+
+  IWB_Cursor cursor(iwb_payload.rawdata(), nbytes);
+
+  int matoms, nb, nc;
+  unsigned char flags;
+  int name_length;
+  if (! cursor.get(matoms) || ! cursor.get(nb) || ! cursor.get(nc) || ! cursor.get(flags) || ! cursor.get(name_length) || matoms < 0 || nb < 0 || nc < 0 || name_length < 0)
+  {
+    cerr << "Molecule::read_molecule_iwb_ds:invalid header\n";
+    return 0;
+  }
+
+  const char * s = cursor.get_chars(name_length);
+  if (NULL == s)
+  {
+    cerr << "Molecule::read_molecule_iwb_ds:invalid name\n";
+    return 0;
+  }
+
+  _molecule_name.set(s, name_length);
+
+  const int width = (flags & (IWB_SHORT_ATOM_NUMBERS | IWB_INT_ATOM_NUMBERS));
+
+  if (_elements_allocated < matoms)
+    resize(matoms);
+
+  for (int i = 0; i < matoms; i++)
+  {
+    unsigned char aflags;
+    if (! cursor.get(aflags))
+      return iwb_error("truncated atom");
+
+    const Element * e;
+
+    if (aflags & IWB_ATOM_SYMBOL)
+    {
+      unsigned char n;
+      if (! cursor.get(n) || NULL == (s = cursor.get_chars(n)))
+        return iwb_error("invalid element symbol");
+
+      e = get_element_from_symbol_no_case_conversion(s, n);
+      if (NULL == e)
+        e = create_element_with_symbol(s, n);
+    }
+    else
+    {
+      unsigned char z;
+      if (! cursor.get(z))
+        return iwb_error("truncated atom");
+
+      e = get_element_from_atomic_number(z);
+    }
+
+    if (NULL == e)
+      return iwb_error("invalid element");
+
+    Atom * a = new Atom(e);
+
+    add(a, 1);
+
+    if (aflags & IWB_ATOM_FORMAL_CHARGE)
+    {
+      signed char fc;
+      if (! cursor.get(fc))
+        return iwb_error("truncated atom");
+
+      a->set_formal_charge(fc);
+    }
+
+    if (aflags & IWB_ATOM_ISOTOPE)
+    {
+      int iso;
+      if (! cursor.get(iso))
+        return iwb_error("truncated atom");
+
+      a->set_isotope(iso);
+    }
+
+    if (aflags & IWB_ATOM_HCOUNT_KNOWN)
+    {
+      unsigned char h;
+      if (! cursor.get(h))
+        return iwb_error("truncated atom");
+
+      a->set_implicit_hydrogens(h, 1);
+      a->set_implicit_hydrogens_known(1);
+    }
+
+    if (aflags & IWB_ATOM_PERMANENT_AROMATIC)
+      a->set_permanent_aromatic(1);
+  }
+
+  if (_bond_list.elements_allocated() < nb)
+    _bond_list.resize(nb);
+
+  for (int i = 0; i < nb; i++)
+  {
+    atom_number_t a1, a2;
+    unsigned char bt;
+    unsigned char directional = 0;
+
+    if (! cursor.get_atom_number(width, a1) || ! cursor.get_atom_number(width, a2) || ! cursor.get(bt))
+      return iwb_error("truncated bond");
+
+    if (bt & IWB_BOND_DIRECTIONAL)
+    {
+      if (! cursor.get(directional))
+        return iwb_error("truncated bond");
+
+      bt &= ~IWB_BOND_DIRECTIONAL;
+    }
+
+    if (a1 < 0 || a1 >= matoms || a2 < 0 || a2 >= matoms || a1 == a2 || 0 == bt || ! OK_BOND_TYPE(bt))
+      return iwb_error("invalid bond");
+
+    if (! add_bond(a1, a2, bt, 1))
+      return iwb_error("cannot add bond");
+
+    if (directional)
+      _bond_list[i]->set_directional_flags(directional);
+  }
+
+  if (flags & IWB_CONNECTION_ORDER)
+  {
+    for (int i = 0; i < matoms; i++)
+    {
+      Atom * a = _things[i];
+
+      const int acon = a->ncon();
+      for (int j = 0; j < acon; j++)
+      {
+        atom_number_t k;
+        if (! cursor.get_atom_number(width, k))
+          return iwb_error("truncated connection order");
+
+        int found = 0;
+        for (int l = j; l < acon; l++)
+        {
+          if (k != a->item(l)->other(i))
+            continue;
+
+          if (l != j)
+            a->swap_elements(j, l);
+          found = 1;
+          break;
+        }
+
+        if (! found)
+          return iwb_error("invalid connection order");
+      }
+    }
+  }
+
+  for (int i = 0; i < nc; i++)
+  {
+    int a, tf, tb, ld, rd;
+    char known;
+
+    if (! cursor.get(a) || ! cursor.get(tf) || ! cursor.get(tb) || ! cursor.get(ld) || ! cursor.get(rd) || ! cursor.get(known))
+      return iwb_error("truncated chiral centre");
+
+    if (ignore_all_chiral_information_on_input())
+      continue;
+
+    if (a < 0 || a >= matoms)
+      return iwb_error("invalid chiral centre");
+
+    Chiral_Centre * c = new Chiral_Centre(a);
+
+    if ((INVALID_ATOM_NUMBER != tf && ! c->set_top_front(tf)) ||
+        (INVALID_ATOM_NUMBER != tb && ! c->set_top_back(tb)) ||
+        (INVALID_ATOM_NUMBER != ld && ! c->set_left_down(ld)) ||
+        (INVALID_ATOM_NUMBER != rd && ! c->set_right_down(rd)))
+    {
+      delete c;
+      return iwb_error("invalid chiral centre");
+    }
+
+    c->set_chirality_known(known);
+
+    _chiral_centres.add(c);
+  }
+
+  if (flags & IWB_HAS_COORDINATES)
+  {
+    for (int i = 0; i < matoms; i++)
+    {
+      coord_t x, y, z;
+      if (! cursor.get(x) || ! cursor.get(y) || ! cursor.get(z))
+        return iwb_error("truncated coordinates");
+
+      setxyz(i, x, y, z);
+    }
+  }
+
+  if (flags & IWB_HAS_PARTIAL_CHARGES)
+  {
+    allocate_charges();
+
+    for (int i = 0; i < matoms; i++)
+    {
+      charge_t q;
+      if (! cursor.get(q))
+        return iwb_error("truncated partial charges");
+
+      set_charge(i, q);
+    }
+  }
+
+  _set_modified();
+
+  return 1;
+}
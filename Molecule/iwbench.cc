@@ -0,0 +1,1110 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+/*
+  Oct 2026. Benchmarks for the kernels the rules spend their time in.
+
+  Each corpus is a smiles file, plus optionally generated sets of
+  molecules that stress particular code - macrocycles, fused
+  polyaromatics and peptides. For every molecule in a corpus, each
+  kernel is timed separately on a freshly built molecule, so that one
+  kernel does not benefit from what another has already computed.
+
+    smiles_parse     build_from_smiles
+    sssr             ring perception
+    aromaticity      compute_aromaticity, rings already known
+    kekule           find_kekule_form, molecules with aromatic atoms only
+    unique_smiles    canonical ordering and smiles
+    standardise      Chemical_Standardisation, -g
+    charge_assigner  Charge_Assigner, -N
+    query:<name>     each -q query, on a Molecule_to_Match shared by all queries
+    all_queries      every -q query, including building the Molecule_to_Match
+
+  Whole pipeline stages can be timed with -e <name>=<command>, the
+  command reads the corpus on stdin.
+
+  Results are written as JSON, nanoseconds per molecule. For kernels
+  there is one sample per molecule, for stages one per repetition. With
+  -B, medians are compared with a previous run and regressions reported.
+
+  Kernels also report the mean number of heap allocations per molecule,
+  counted by replacing the global operator new.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <new>
+using namespace std;
+
+#include "cmdline.h"
+#include "iwstring_data_source.h"
+#include "iw_stl_hash_map.h"
+
+#include "molecule.h"
+#include "aromatic.h"
+#include "qry_wstats.h"
+#include "rwsubstructure.h"
+#include "target.h"
+#include "charge_assigner.h"
+#include "iwstandard.h"
+
+const char * prog_name = NULL;
+
+static int verbose = 0;
+
+static int repetitions = 3;
+
+static int molecules_per_generated_corpus = 100;
+
+static Chemical_Standardisation chemical_standardisation;
+
+static Charge_Assigner charge_assigner;
+
+static resizable_array_p<Substructure_Hit_Statistics> queries;
+
+/*
+  A stage is a command through which a whole corpus is run
+*/
+
+static resizable_array_p<IWString> stage_name;
+static resizable_array_p<IWString> stage_command;
+
+/*
+  A regression is when the median gets worse by more than this
+*/
+
+static double tolerance = 0.10;
+
+static void
+usage (int rc)
+{
+  cerr << "Benchmarks the chemistry kernels used by the rules, on fixed corpora\n";
+  cerr << "usage: " << prog_name << " <options> corpus.smi ...\n";
+  cerr << "  -q <query>     query whose substructure search is timed, standard -q syntax\n";
+  cerr << "  -N ...         charge assigner specification, as iwdemerit -N\n";
+  cerr << "  -g ...         chemical standardisation options, as mc_first_pass -g\n";
+  cerr << "  -G <n>         molecules in each generated corpus (default " << molecules_per_generated_corpus << "), 0 for none\n";
+  cerr << "  -r <n>         time each kernel <n> times per molecule, take the fastest (default " << repetitions << ")\n";
+  cerr << "  -e <n>=<cmd>   time pipeline stage <n>, <cmd> reads the corpus on stdin\n";
+  cerr << "  -J <fname>     write results to <fname> rather than stdout\n";
+  cerr << "  -B <fname>     compare with the results in <fname>, exit 1 if anything got slower\n";
+  cerr << "  -T <pct>       percent slowdown of the median to report as a regression (default " << (tolerance * 100.0) << ")\n";
+  display_standard_aromaticity_options (cerr);
+  cerr << "  -E ...         element options\n";
+  cerr << "  -v             verbose output\n";
+
+  exit (rc);
+}
+
+class Corpus
+{
+  public:
+    IWString _name;
+
+    IWString _fname;      // for stages
+    int _remove_file;     // generated corpora are written to temporary files
+
+    resizable_array_p<IWString> _smiles;
+
+  public:
+    Corpus () { _remove_file = 0;}
+    ~Corpus () { if (_remove_file) unlink (_fname.null_terminated_chars ());}
+
+    int number_molecules () const { return _smiles.number_elements ();}
+
+    int read (const char * fname);
+    int write_temporary_file ();
+};
+
+int
+Corpus::read (const char * fname)
+{
+  iwstring_data_source input (fname);
+
+  if (! input.good ())
+  {
+    cerr << "Corpus::read:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+  _fname = fname;
+
+  _name = fname;
+  int i = _name.rindex ('/');
+  if (i >= 0)
+    _name.remove_leading_chars (i + 1);
+  if (_name.ends_with (".smi"))
+    _name.chop (4);
+
+  const_IWSubstring buffer;
+  while (input.next_record (buffer))
+  {
+    const_IWSubstring smiles;
+    if (! buffer.word (0, smiles))
+      continue;
+
+    _smiles.add (new IWString (smiles));
+  }
+
+  return _smiles.number_elements ();
+}
+
+int
+Corpus::write_temporary_file ()
+{
+  char tmp[] = "/tmp/iwbenchXXXXXX";
+  int fd = mkstemp (tmp);
+  if (fd < 0)
+  {
+    cerr << "Corpus::write_temporary_file:cannot create temporary file\n";
+    return 0;
+  }
+
+  close (fd);
+
+  _fname = tmp;
+  _remove_file = 1;
+
+  ofstream output (tmp, ios::out);
+
+  for (int i = 0; i < _smiles.number_elements (); i++)
+  {
+    output << *(_smiles[i]) << ' ' << _name << i << '\n';
+  }
+
+  return output.good ();
+}
+
+/*
+  Generated corpora use a fixed generator so every run sees the same molecules
+*/
+
+static unsigned int
+next_random (unsigned int & seed)
+{
+  seed = seed * 1103515245 + 12345;
+
+  return (seed >> 16) & 0x7fff;
+}
+
+static void
+append_ring_closure (IWString & s, int r)
+{
+  if (r < 10)
+    s << r;
+  else
+    s << '%' << r;
+
+  return;
+}
+
+static int
+generate_macrocycles (Corpus & corpus, int n)
+{
+  corpus._name = "macrocycles";
+
+  const char * ring_atom[] = {"C", "C", "C", "N", "O", "C(=O)", "C(C)", "C(O)"};
+
+  unsigned int seed = 1;
+
+  for (int i = 0; i < n; i++)
+  {
+    const int ring_size = 12 + i % 29;
+
+    IWString * s = new IWString;
+    (*s) << "C1";
+    for (int j = 1; j < ring_size; j++)
+    {
+      (*s) << ring_atom[next_random (seed) % 8];
+    }
+    (*s) << '1';
+
+    corpus._smiles.add (s);
+  }
+
+  return 1;
+}
+
+/*
+  Linear acenes, c1ccc2cc3ccccc3cc2c1 for three rings, substituted at
+  random on the terminal ring
+*/
+
+static int
+generate_fused_polyaromatics (Corpus & corpus, int n)
+{
+  corpus._name = "fused_polyaromatics";
+
+  const char * substituent[] = {"", "", "C", "O", "N", "Cl", "C(=O)O"};
+
+  unsigned int seed = 2;
+
+  for (int i = 0; i < n; i++)
+  {
+    const int nrings = 2 + i % 11;
+
+    IWString * s = new IWString;
+
+    const char * x = substituent[next_random (seed) % 7];
+    if (0 != *x)
+      (*s) << x;
+
+    (*s) << "c1ccc";
+    append_ring_closure (*s, 2);
+    for (int r = 3; r <= nrings; r++)
+    {
+      (*s) << "cc";
+      append_ring_closure (*s, r);
+    }
+    (*s) << "ccccc";
+    append_ring_closure (*s, nrings);
+    for (int r = nrings - 1; r >= 2; r--)
+    {
+      (*s) << "cc";
+      append_ring_closure (*s, r);
+    }
+    (*s) << "c1";
+
+    corpus._smiles.add (s);
+  }
+
+  return 1;
+}
+
+static int
+generate_peptides (Corpus & corpus, int n)
+{
+  corpus._name = "peptides";
+
+  const char * residue[] = {"NCC(=O)", "N[C@@H](C)C(=O)", "N[C@@H](CO)C(=O)",
+                            "N[C@@H](Cc1ccccc1)C(=O)", "N[C@@H](CCCCN)C(=O)",
+                            "N[C@@H](CC(=O)O)C(=O)", "N[C@@H](Cc1c[nH]c2ccccc12)C(=O)",
+                            "N[C@@H](CCSC)C(=O)", "N[C@@H](CC(C)C)C(=O)",
+                            "N[C@@H](CCCNC(=N)N)C(=O)"};
+
+  unsigned int seed = 3;
+
+  for (int i = 0; i < n; i++)
+  {
+    const int nresidues = 10 + i % 51;
+
+    IWString * s = new IWString;
+    for (int j = 0; j < nresidues; j++)
+    {
+      (*s) << residue[next_random (seed) % 10];
+    }
+    (*s) << 'O';
+
+    corpus._smiles.add (s);
+  }
+
+  return 1;
+}
+
+/*
+  Every new and new[] in the process comes through here
+*/
+
+static iw_uint64_t heap_allocations = 0;
+
+static void *
+counted_allocation (size_t s)
+{
+  heap_allocations++;
+
+  void * rc = malloc (s > 0 ? s : 1);
+  if (NULL == rc)
+    throw std::bad_alloc ();
+
+  return rc;
+}
+
+void *
+operator new (size_t s)
+{
+  return counted_allocation (s);
+}
+
+void *
+operator new[] (size_t s)
+{
+  return counted_allocation (s);
+}
+
+void
+operator delete (void * p) throw ()
+{
+  free (p);
+}
+
+void
+operator delete[] (void * p) throw ()
+{
+  free (p);
+}
+
+static inline iw_uint64_t
+nanoseconds ()
+{
+  struct timespec t;
+  clock_gettime (CLOCK_MONOTONIC, &t);
+
+  return static_cast<iw_uint64_t> (t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+/*
+  Timings for one kernel over a corpus, nanoseconds per molecule
+*/
+
+class Kernel_Times
+{
+  public:
+    IWString _kernel;
+
+    resizable_array<iw_uint64_t> _ns;
+    resizable_array<iw_uint64_t> _allocations;    // per molecule, kernels only
+
+  public:
+    Kernel_Times (const char * s) : _kernel (s) {}
+    Kernel_Times (const IWString & s) : _kernel (s) {}
+
+    int write_json (const IWString & corpus, int corpus_size, ostream &) const;
+};
+
+static iw_uint64_t
+percentile (const resizable_array<iw_uint64_t> & sorted, int p)
+{
+  int i = sorted.number_elements () * p / 100;
+  if (i >= sorted.number_elements ())
+    i = sorted.number_elements () - 1;
+
+  return sorted[i];
+}
+
+static void
+append_json_string (IWString & s, const IWString & v)
+{
+  s << '"';
+  for (int i = 0; i < v.length (); i++)
+  {
+    if ('"' == v[i] || '\\' == v[i])
+      s << '\\';
+    s << v[i];
+  }
+  s << '"';
+
+  return;
+}
+
+/*
+  One result per line, which is what read_baseline depends on
+*/
+
+int
+Kernel_Times::write_json (const IWString & corpus,
+                          int corpus_size,
+                          ostream & os) const
+{
+  if (0 == _ns.number_elements ())
+    return 1;
+
+  resizable_array<iw_uint64_t> sorted (_ns);
+  std::sort (sorted.rawdata (), sorted.rawdata () + sorted.number_elements ());
+
+  iw_uint64_t total = 0;
+  for (int i = 0; i < sorted.number_elements (); i++)
+  {
+    total += sorted[i];
+  }
+
+  IWString s;
+  s << "  {\"corpus\": ";
+  append_json_string (s, corpus);
+  s << ", \"corpus_size\": " << corpus_size;
+  s << ", \"kernel\": ";
+  append_json_string (s, _kernel);
+  s << ", \"samples\": " << sorted.number_elements ();
+  s << ", \"mean_ns\": " << (total / sorted.number_elements ());
+  s << ", \"p50_ns\": " << percentile (sorted, 50);
+  s << ", \"p90_ns\": " << percentile (sorted, 90);
+  s << ", \"p99_ns\": " << percentile (sorted, 99);
+  s << ", \"max_ns\": " << sorted.last_item ();
+
+  if (_allocations.number_elements ())
+  {
+    iw_uint64_t allocations = 0;
+    for (int i = 0; i < _allocations.number_elements (); i++)
+    {
+      allocations += _allocations[i];
+    }
+
+    s << ", \"allocations\": " << (static_cast<double> (allocations) / static_cast<double> (_allocations.number_elements ()));
+  }
+
+  s << '}';
+
+  os << s;
+
+  return os.good ();
+}
+
+/*
+  The molecule for each timing is built here, untimed
+*/
+
+static int
+build (Molecule & m, const IWString & smiles)
+{
+  m.resize (0);
+
+  return m.build_from_smiles (smiles);
+}
+
+static int
+benchmark_corpus (Corpus & corpus,
+                  resizable_array_p<Kernel_Times> & results)
+{
+  Kernel_Times * parse = new Kernel_Times ("smiles_parse");
+  Kernel_Times * sssr = new Kernel_Times ("sssr");
+  Kernel_Times * aromaticity = new Kernel_Times ("aromaticity");
+  Kernel_Times * kekule = new Kernel_Times ("kekule");
+  Kernel_Times * usmi = new Kernel_Times ("unique_smiles");
+  Kernel_Times * standardise = new Kernel_Times ("standardise");
+  Kernel_Times * charges = new Kernel_Times ("charge_assigner");
+  Kernel_Times * all_queries = new Kernel_Times ("all_queries");
+
+  results.add (parse);
+  results.add (sssr);
+  results.add (aromaticity);
+  results.add (kekule);
+  results.add (usmi);
+  results.add (standardise);
+  results.add (charges);
+  results.add (all_queries);
+
+  const int nq = queries.number_elements ();
+
+  resizable_array<Kernel_Times *> query_times;
+  for (int i = 0; i < nq; i++)
+  {
+    IWString k ("query:");
+    k << queries[i]->comment ();
+
+    Kernel_Times * t = new Kernel_Times (k);
+    results.add (t);
+    query_times.add (t);
+  }
+
+  resizable_array<iw_uint64_t> query_best (nq);
+  for (int i = 0; i < nq; i++)
+  {
+    query_best.add (0);
+  }
+
+  Molecule m;
+
+  for (int i = 0; i < corpus.number_molecules (); i++)
+  {
+    const IWString & smiles = *(corpus._smiles[i]);
+
+    if (! build (m, smiles))
+    {
+      cerr << "Cannot parse smiles '" << smiles << "' in " << corpus._name << ", skipped\n";
+      continue;
+    }
+
+    const int matoms = m.natoms ();
+
+    int * aromatic_atoms = new int[matoms];
+    int nb = m.nedges ();
+    int * aromatic_bonds = new int[nb + 1];
+
+    m.compute_aromaticity_if_needed ();
+
+    int aromatic_atom_count = 0;
+    for (int j = 0; j < matoms; j++)
+    {
+      aromatic_atoms[j] = m.is_aromatic (j);
+      aromatic_atom_count += aromatic_atoms[j];
+    }
+    for (int j = 0; j < nb; j++)
+    {
+      aromatic_bonds[j] = m.bondi (j)->is_aromatic ();
+    }
+
+    iw_uint64_t best[7] = {0, 0, 0, 0, 0, 0, 0};
+    iw_uint64_t best_all_queries = 0;
+
+//  Allocations do not vary much between repetitions, keep the fewest
+
+    iw_uint64_t fewest[7] = {0, 0, 0, 0, 0, 0, 0};
+    iw_uint64_t fewest_all_queries = 0;
+
+    for (int r = 0; r < repetitions; r++)
+    {
+      iw_uint64_t t0, t[7];
+      iw_uint64_t a0, a[7];
+
+      m.resize (0);
+      a0 = heap_allocations;
+      t0 = nanoseconds ();
+      m.build_from_smiles (smiles);
+      t[0] = nanoseconds () - t0;
+      a[0] = heap_allocations - a0;
+
+      build (m, smiles);
+      a0 = heap_allocations;
+      t0 = nanoseconds ();
+      m.nrings ();
+      t[1] = nanoseconds () - t0;
+      a[1] = heap_allocations - a0;
+
+      build (m, smiles);
+      m.nrings ();
+      a0 = heap_allocations;
+      t0 = nanoseconds ();
+      m.compute_aromaticity ();
+      t[2] = nanoseconds () - t0;
+      a[2] = heap_allocations - a0;
+
+      t[3] = a[3] = 0;
+      if (aromatic_atom_count)
+      {
+        build (m, smiles);
+        m.ring_membership ();
+        a0 = heap_allocations;
+        t0 = nanoseconds ();
+        m.find_kekule_form (aromatic_atoms, aromatic_bonds);
+        t[3] = nanoseconds () - t0;
+        a[3] = heap_allocations - a0;
+      }
+
+      build (m, smiles);
+      a0 = heap_allocations;
+      t0 = nanoseconds ();
+      m.unique_smiles ();
+      t[4] = nanoseconds () - t0;
+      a[4] = heap_allocations - a0;
+
+      t[5] = a[5] = 0;
+      if (chemical_standardisation.active ())
+      {
+        build (m, smiles);
+        a0 = heap_allocations;
+        t0 = nanoseconds ();
+        chemical_standardisation.process (m);
+        t[5] = nanoseconds () - t0;
+        a[5] = heap_allocations - a0;
+      }
+
+      t[6] = a[6] = 0;
+      if (charge_assigner.active ())
+      {
+        build (m, smiles);
+        a0 = heap_allocations;
+        t0 = nanoseconds ();
+        charge_assigner.process (m);
+        t[6] = nanoseconds () - t0;
+        a[6] = heap_allocations - a0;
+      }
+
+      for (int k = 0; k < 7; k++)
+      {
+        if (0 == r || t[k] < best[k])
+          best[k] = t[k];
+        if (0 == r || a[k] < fewest[k])
+          fewest[k] = a[k];
+      }
+
+      if (0 == nq)
+        continue;
+
+      build (m, smiles);
+
+      const iw_uint64_t aq = heap_allocations;
+      const iw_uint64_t tq = nanoseconds ();
+
+      Molecule_to_Match target (&m);
+
+      for (int k = 0; k < nq; k++)
+      {
+        t0 = nanoseconds ();
+        queries[k]->substructure_search (target);
+        const iw_uint64_t dt = nanoseconds () - t0;
+
+        if (0 == r || dt < query_best[k])
+          query_best[k] = dt;
+      }
+
+      const iw_uint64_t dt = nanoseconds () - tq;
+      if (0 == r || dt < best_all_queries)
+        best_all_queries = dt;
+
+      const iw_uint64_t da = heap_allocations - aq;
+      if (0 == r || da < fewest_all_queries)
+        fewest_all_queries = da;
+    }
+
+    delete [] aromatic_atoms;
+    delete [] aromatic_bonds;
+
+    Kernel_Times * kernel[7] = {parse, sssr, aromaticity, kekule, usmi, standardise, charges};
+    const int measured[7] = {1, 1, 1, aromatic_atom_count > 0, 1, chemical_standardisation.active (), charge_assigner.active ()};
+
+    for (int k = 0; k < 7; k++)
+    {
+      if (! measured[k])
+        continue;
+
+      kernel[k]->_ns.add (best[k]);
+      kernel[k]->_allocations.add (fewest[k]);
+    }
+
+    if (0 == nq)
+      continue;
+
+    all_queries->_ns.add (best_all_queries);
+    all_queries->_allocations.add (fewest_all_queries);
+    for (int k = 0; k < nq; k++)
+    {
+      query_times[k]->_ns.add (query_best[k]);
+    }
+  }
+
+  return 1;
+}
+
+/*
+  Each repetition of a stage gives one measurement, the elapsed time
+  divided by the number of molecules
+*/
+
+static int
+benchmark_stages (Corpus & corpus,
+                  resizable_array_p<Kernel_Times> & results)
+{
+  if (0 == corpus._fname.length () && ! corpus.write_temporary_file ())
+    return 0;
+
+  for (int i = 0; i < stage_name.number_elements (); i++)
+  {
+    IWString k ("stage:");
+    k << *(stage_name[i]);
+
+    Kernel_Times * t = new Kernel_Times (k);
+    results.add (t);
+
+    IWString cmd;
+    cmd << *(stage_command[i]) << " < " << corpus._fname << " > /dev/null 2>&1";
+
+    for (int r = 0; r < repetitions; r++)
+    {
+      const iw_uint64_t t0 = nanoseconds ();
+
+      const int rc = system (cmd.null_terminated_chars ());
+
+      const iw_uint64_t dt = nanoseconds () - t0;
+
+      if (0 != rc)
+      {
+        cerr << "Stage '" << *(stage_name[i]) << "' failed on " << corpus._name << ", rc " << rc << endl;
+        return 0;
+      }
+
+      t->_ns.add (dt / corpus.number_molecules ());
+    }
+  }
+
+  return 1;
+}
+
+/*
+  Baselines are files we wrote, one result per line. We only need the
+  corpus, its size, the kernel and median from each. Results are only
+  compared if the corpus is the same size, stage times in particular
+  depend on it
+*/
+
+static int
+fetch_json_value (const const_IWSubstring & buffer,
+                  const char * key,
+                  const_IWSubstring & value)
+{
+  IWString k;
+  k << '"' << key << "\": ";
+
+  int i = buffer.find (k);
+  if (i < 0)
+    return 0;
+
+  i += k.length ();
+
+  int j = i;
+  if ('"' == buffer[i])
+  {
+    i++;
+    j = i;
+    while (j < buffer.length () && '"' != buffer[j])
+    {
+      if ('\\' == buffer[j])
+        j++;
+      j++;
+    }
+  }
+  else
+  {
+    while (j < buffer.length () && ',' != buffer[j] && '}' != buffer[j])
+      j++;
+  }
+
+  value = buffer;
+  value.iwtruncate (j);
+  value.remove_leading_chars (i);
+
+  return 1;
+}
+
+static int
+read_baseline (const char * fname,
+               IW_STL_Hash_Map<IWString, iw_uint64_t> & baseline)
+{
+  iwstring_data_source input (fname);
+
+  if (! input.good ())
+  {
+    cerr << "Cannot open baseline '" << fname << "'\n";
+    return 0;
+  }
+
+  const_IWSubstring buffer;
+  while (input.next_record (buffer))
+  {
+    const_IWSubstring corpus, corpus_size, kernel, p50;
+
+    if (! fetch_json_value (buffer, "corpus", corpus) ||
+        ! fetch_json_value (buffer, "corpus_size", corpus_size) ||
+        ! fetch_json_value (buffer, "kernel", kernel) ||
+        ! fetch_json_value (buffer, "p50_ns", p50))
+      continue;
+
+    long long v;
+    if (! p50.numeric_value (v) || v < 0)
+    {
+      cerr << "Invalid median in baseline '" << buffer << "'\n";
+      return 0;
+    }
+
+    IWString key;
+    key << corpus << '\t' << corpus_size << '\t' << kernel;
+
+    baseline[key] = static_cast<iw_uint64_t> (v);
+  }
+
+  return baseline.size ();
+}
+
+static iw_uint64_t
+median (const Kernel_Times & t)
+{
+  resizable_array<iw_uint64_t> sorted (t._ns);
+  std::sort (sorted.rawdata (), sorted.rawdata () + sorted.number_elements ());
+
+  return percentile (sorted, 50);
+}
+
+/*
+  Returns the number of regressions
+*/
+
+static int
+compare_with_baseline (const IW_STL_Hash_Map<IWString, iw_uint64_t> & baseline,
+                       const resizable_array_p<Corpus> & corpora,
+                       const resizable_array_p<resizable_array_p<Kernel_Times> > & results,
+                       ostream & os)
+{
+  int regressions = 0;
+  int compared = 0;
+
+  for (int i = 0; i < corpora.number_elements (); i++)
+  {
+    const resizable_array_p<Kernel_Times> & r = *(results[i]);
+
+    for (int j = 0; j < r.number_elements (); j++)
+    {
+      const Kernel_Times & t = *(r[j]);
+
+      if (0 == t._ns.number_elements ())
+        continue;
+
+      IWString key;
+      key << corpora[i]->_name << '\t' << corpora[i]->number_molecules () << '\t' << t._kernel;
+
+      IW_STL_Hash_Map<IWString, iw_uint64_t>::const_iterator f = baseline.find (key);
+      if (f == baseline.end ())
+        continue;
+
+      compared++;
+
+      const iw_uint64_t was = (*f).second;
+      const iw_uint64_t now = median (t);
+
+      if (0 == was)
+        continue;
+
+      const double change = (static_cast<double> (now) - static_cast<double> (was)) / static_cast<double> (was);
+
+      if (change > tolerance)
+      {
+        os << "REGRESSION " << corpora[i]->_name << ' ' << t._kernel << " median " << was << " -> " << now << " ns, " << static_cast<int> (change * 100.0 + 0.5) << "% slower\n";
+        regressions++;
+      }
+      else if (verbose && change < -tolerance)
+        os << "Improved " << corpora[i]->_name << ' ' << t._kernel << " median " << was << " -> " << now << " ns\n";
+    }
+  }
+
+  os << "Compared " << compared << " results with baseline, " << regressions << " regressions\n";
+
+  return regressions;
+}
+
+static int
+write_results (const resizable_array_p<Corpus> & corpora,
+               const resizable_array_p<resizable_array_p<Kernel_Times> > & results,
+               ostream & output)
+{
+  output << "{\"repetitions\": " << repetitions << ", \"results\": [\n";
+
+  int need_comma = 0;
+  for (int i = 0; i < corpora.number_elements (); i++)
+  {
+    const resizable_array_p<Kernel_Times> & r = *(results[i]);
+
+    for (int j = 0; j < r.number_elements (); j++)
+    {
+      if (0 == r[j]->_ns.number_elements ())
+        continue;
+
+      if (need_comma)
+        output << ",\n";
+
+      r[j]->write_json (corpora[i]->_name, corpora[i]->number_molecules (), output);
+      need_comma = 1;
+    }
+  }
+
+  output << "\n]}\n";
+
+  return output.good ();
+}
+
+static int
+iwbench (int argc, char ** argv)
+{
+  if (argc < 2)
+    usage (1);
+
+  Command_Line cl (argc, argv, "vq:N:g:G:r:e:J:B:T:A:E:");
+
+  if (cl.unrecognised_options_encountered ())
+    usage (1);
+
+  verbose = cl.option_count ('v');
+
+  if (! process_elements (cl))
+    usage (2);
+
+  if (! process_standard_aromaticity_options (cl, verbose))
+    usage (5);
+
+  if (cl.option_present ('g'))
+  {
+    if (! chemical_standardisation.construct_from_command_line (cl, verbose > 1, 'g'))
+      usage (6);
+  }
+
+  if (cl.option_present ('N'))
+  {
+    if (! charge_assigner.construct_from_command_line (cl, verbose > 1, 'N'))
+      usage (6);
+  }
+
+  if (cl.option_present ('q'))
+  {
+    if (! process_queries (cl, queries, verbose, 'q'))
+    {
+      cerr << "Cannot process queries (-q)\n";
+      usage (3);
+    }
+
+    if (verbose)
+      cerr << "Timing " << queries.number_elements () << " queries\n";
+  }
+
+  if (cl.option_present ('G'))
+  {
+    if (! cl.value ('G', molecules_per_generated_corpus) || molecules_per_generated_corpus < 0)
+    {
+      cerr << "The number of generated molecules (-G) must be a whole non negative number\n";
+      usage (3);
+    }
+  }
+
+  if (cl.option_present ('r'))
+  {
+    if (! cl.value ('r', repetitions) || repetitions < 1)
+    {
+      cerr << "The number of repetitions (-r) must be a whole positive number\n";
+      usage (3);
+    }
+  }
+
+  if (cl.option_present ('T'))
+  {
+    double pct;
+    if (! cl.value ('T', pct) || pct < 0.0)
+    {
+      cerr << "The regression tolerance (-T) must be a non negative percentage\n";
+      usage (3);
+    }
+
+    tolerance = pct / 100.0;
+  }
+
+  if (cl.option_present ('e'))
+  {
+    const_IWSubstring e;
+    for (int i = 0; cl.value ('e', e, i); i++)
+    {
+      const_IWSubstring n, c;
+      if (! e.split (n, '=', c) || 0 == n.length () || 0 == c.length ())
+      {
+        cerr << "Stages must be specified as -e <name>=<command>, '" << e << "' invalid\n";
+        usage (3);
+      }
+
+      stage_name.add (new IWString (n));
+      stage_command.add (new IWString (c));
+    }
+  }
+
+  if (0 == cl.number_elements () && 0 == molecules_per_generated_corpus)
+  {
+    cerr << "No corpora\n";
+    usage (1);
+  }
+
+  resizable_array_p<Corpus> corpora;
+
+  for (int i = 0; i < cl.number_elements (); i++)
+  {
+    Corpus * c = new Corpus;
+    corpora.add (c);
+
+    if (! c->read (cl[i]))
+    {
+      cerr << "Cannot read corpus '" << cl[i] << "'\n";
+      return i + 1;
+    }
+  }
+
+  if (molecules_per_generated_corpus > 0)
+  {
+    Corpus * c = new Corpus;
+    generate_macrocycles (*c, molecules_per_generated_corpus);
+    corpora.add (c);
+
+    c = new Corpus;
+    generate_fused_polyaromatics (*c, molecules_per_generated_corpus);
+    corpora.add (c);
+
+    c = new Corpus;
+    generate_peptides (*c, molecules_per_generated_corpus);
+    corpora.add (c);
+  }
+
+  resizable_array_p<resizable_array_p<Kernel_Times> > results;
+
+  for (int i = 0; i < corpora.number_elements (); i++)
+  {
+    Corpus & c = *(corpora[i]);
+
+    if (verbose)
+      cerr << "Corpus " << c._name << ", " << c.number_molecules () << " molecules\n";
+
+    resizable_array_p<Kernel_Times> * r = new resizable_array_p<Kernel_Times>;
+    results.add (r);
+
+    benchmark_corpus (c, *r);
+
+    if (stage_name.number_elements () && ! benchmark_stages (c, *r))
+      return 5;
+  }
+
+  if (cl.option_present ('J'))
+  {
+    const char * fname = cl.option_value ('J');
+
+    ofstream output (fname, ios::out);
+    if (! output.good ())
+    {
+      cerr << "Cannot open results file '" << fname << "'\n";
+      return 4;
+    }
+
+    if (! write_results (corpora, results, output))
+      return 4;
+
+    if (verbose)
+      cerr << "Results written to '" << fname << "'\n";
+  }
+  else
+    write_results (corpora, results, cout);
+
+  if (cl.option_present ('B'))
+  {
+    IW_STL_Hash_Map<IWString, iw_uint64_t> baseline;
+
+    if (! read_baseline (cl.option_value ('B'), baseline))
+    {
+      cerr << "Cannot read baseline '" << cl.option_value ('B') << "'\n";
+      return 6;
+    }
+
+    if (compare_with_baseline (baseline, corpora, results, cerr))
+      return 1;
+  }
+
+  return 0;
+}
+
+int
+main (int argc, char ** argv)
+{
+  prog_name = argv[0];
+
+  int rc = iwbench (argc, argv);
+
+  return rc;
+}
@@ -29,10 +29,15 @@ using namespace std;
 #include <assert.h>
 #include <math.h>
 #include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "iwconfig.h"
 
 #include "cmdline.h"
+#include "iw_auto_array.h"
 
 #include "rwsubstructure.h"
 #include "target.h"
@@ -42,11 +47,16 @@ using namespace std;
 #include "output.h"
 #include "istream_and_type.h"
 #include "charge_assigner.h"
+#include "misc.h"
 #include "misc2.h"
 #include "rmele.h"
 
 #include "substructure_demerits.h"
 #include "demerit.h"
+#include "demerit_columnar.h"
+#include "result_cache.h"
+#include "query_scheduler.h"
+#include "hit_matrix.h"
 
 
 //#define USE_IWMALLOC
@@ -71,6 +81,13 @@ static Elements_to_Remove elements_to_remove;
 static Molecule_Output_Object stream_for_non_rejected_molecules;
 static Molecule_Output_Object stream_for_rejected_molecules;
 
+/*
+  The demerit file used to be flushed after every molecule. Now it follows
+  the same -o flush policy as the molecule streams
+*/
+
+static Output_Flush_Policy tdt_flush_policy;
+
 static IWString stem_for_demerit_file;
 
 static int do_hard_coded_substructure_queries = 1;
@@ -87,16 +104,118 @@ static int molecules_with_abnormal_valences = 0;
 static resizable_array_p<Substructure_Hit_Statistics> queries;
 
 /*
-  For molecules that lie between the hard and low atom count cutoffs, we apply demerits
+  For molecules that lie between the hard and low atom count cutoffs, we apply demerits.
+  Oct 2026. Gathered into a class, since each profile (-P) has its own
 */
 
-static int soft_lower_atom_count_cutoff = 0;
-static int hard_lower_atom_count_cutoff = 0;
-static int lower_atom_count_demerit = 100;
+class Atom_Count_Demerits
+{
+  public:
+    int soft_lower_cutoff;
+    int hard_lower_cutoff;
+    int lower_demerit;
+
+    int soft_upper_cutoff;
+    int hard_upper_cutoff;
+    int upper_demerit;
+
+    Atom_Count_Demerits ();
+
+    int active () const { return soft_lower_cutoff > 0 || soft_upper_cutoff > 0;}
+
+//  smin=, hmin=, smax= and hmax=. Returns 0 if unrecognised
+
+    int parse_directive (const const_IWSubstring &);
+
+    int ok (ostream &) const;
+
+    void apply (Molecule & m, Demerit & demerit) const;
+};
+
+Atom_Count_Demerits::Atom_Count_Demerits ()
+{
+  soft_lower_cutoff = 0;
+  hard_lower_cutoff = 0;
+  lower_demerit = 100;
+
+  soft_upper_cutoff = 0;
+  hard_upper_cutoff = 0;
+  upper_demerit = 100;
+
+  return;
+}
+
+int
+Atom_Count_Demerits::parse_directive (const const_IWSubstring & c)
+{
+  const_IWSubstring directive;
+  int dvalue;
+  if (! c.split_into_directive_and_value (directive, '=', dvalue))
+    return 0;
+
+  if (dvalue < 0)
+  {
+    cerr << "INvalid numeric directive, cannot be negative '" << c << "'\n";
+    return 0;
+  }
+
+  if ("hmin" == directive)
+    hard_lower_cutoff = dvalue;
+  else if ("smin" == directive)
+    soft_lower_cutoff = dvalue;
+  else if ("mindmrt" == directive)
+    ;
+  else if ("smax" == directive)
+    soft_upper_cutoff = dvalue;
+  else if ("hmax" == directive)
+    hard_upper_cutoff = dvalue;
+  else if ("maxdmrt" == directive)
+    ;
+  else
+    return 0;
+
+  return 1;
+}
+
+int
+Atom_Count_Demerits::ok (ostream & os) const
+{
+  if (0 == soft_lower_cutoff && 0 == hard_lower_cutoff)
+    ;
+  else if (hard_lower_cutoff <= soft_lower_cutoff)
+    ;
+  else
+  {
+    os << "Invalid lower atom count cutoff values soft:" << soft_lower_cutoff << " hard:" << hard_lower_cutoff << endl;
+    return 0;
+  }
+
+  if (0 == soft_upper_cutoff && 0 == hard_upper_cutoff)
+    ;
+  else if (soft_upper_cutoff < hard_upper_cutoff)
+    ;
+  else
+  {
+    os << "Invalid upper atom count cutoff values soft:" << soft_upper_cutoff << " hard:" << hard_upper_cutoff << endl;
+    return 0;
+  }
+
+  if (0 == soft_lower_cutoff && 0 == soft_upper_cutoff)
+    ;
+  else if (soft_lower_cutoff < soft_upper_cutoff)
+    ;
+  else
+  {
+    os << "Soft cutoffs invalid, lower:" << soft_lower_cutoff << " upper:" << soft_upper_cutoff << endl;
+    return 0;
+  }
+
+//  Should do more checks here...
+
+  return 1;
+}
 
-static int soft_upper_atom_count_cutoff = 0;
-static int hard_upper_atom_count_cutoff = 0;
-static int upper_atom_count_demerit = 100;
+static Atom_Count_Demerits atom_count_demerits;
 
 /*
   We reject if the atom contains only C, H or S
@@ -107,9 +226,9 @@ static int upper_atom_count_demerit = 100;
 static int atom_types_count = 0;
 static int csxh_count = 0;
 
-static void
-do_atom_count_demerits (Molecule & m,
-                        Demerit & demerit)
+void
+Atom_Count_Demerits::apply (Molecule & m,
+                            Demerit & demerit) const
 {
   int nf = m.number_fragments ();
 
@@ -127,105 +246,1328 @@ do_atom_count_demerits (Molecule & m,
     }
   }
 
-  if (hard_lower_atom_count_cutoff > 0 && matoms <= hard_lower_atom_count_cutoff)
-  {
-    demerit.extra (lower_atom_count_demerit, "too_few_atoms");
+  if (hard_lower_cutoff > 0 && matoms <= hard_lower_cutoff)
+  {
+    demerit.extra (lower_demerit, "too_few_atoms");
+
+    return;
+  }
+
+// Feb 2005. Heuristic for adding demerits beyond the hard atom count cutoff
+
+  if (hard_upper_cutoff > 0 && matoms >= hard_upper_cutoff)
+  {
+    demerit.extra (rejection_threshold() + 6 * (matoms - hard_upper_cutoff), "too_many_atoms");
+
+//  cerr << hard_upper_cutoff << " hard_upper_cutoff, matoms = " << matoms << endl;
+    return;
+  }
+
+  if (matoms > hard_lower_cutoff && matoms < soft_lower_cutoff)
+  {
+    float r = static_cast<float> (soft_lower_cutoff - matoms) / static_cast<float> (soft_lower_cutoff - hard_lower_cutoff);
+    int d = static_cast<int> (lower_demerit * r);
+
+    if (0 == d)
+      d = 1;
+
+    demerit.extra (d, "too_few_atoms");
+
+    return;
+  }
+
+  if (matoms > soft_upper_cutoff && matoms < hard_upper_cutoff)
+  {
+    float r = static_cast<float> (matoms - soft_upper_cutoff) / static_cast<float> (hard_upper_cutoff - soft_upper_cutoff);
+    int d = static_cast<int> (upper_demerit * r);
+//  cerr << "too_many_atoms: " << soft_upper_cutoff << " soft_upper_cutoff, matoms = " << matoms << ", d = " << d << endl;
+//  cerr << "upper_demerit " << upper_demerit << endl;
+//  cerr << "too_many_atoms: soft_upper_cutoff " << soft_upper_cutoff << " hard_upper_cutoff " << hard_upper_cutoff << " matoms " << matoms << " D = " << d << endl;
+    if (0 == d)
+      d = 1;
+
+    demerit.extra (d, "too_many_atoms");
+
+    return;
+  }
+
+  return;
+}
+
+
+/*
+  With -H every rule is evaluated for every molecule, and the matches
+  written as a row of a hit matrix, for mc_rescore. Queries occupy the
+  first columns, in the order they are searched
+*/
+
+static Hit_Matrix_Writer hit_matrix;
+
+/*
+  Oct 2026. With profiles (-P), the number of matches to each query, or
+  -1 if not yet searched, so no query is searched twice for a molecule.
+  The -q queries come first, then those used only by profiles
+*/
+
+static resizable_array<int> query_hits;
+
+/*
+  Returns the integer demerit a query with NHITS matches would assign
+*/
+
+static int
+query_demerit (Substructure_Hit_Statistics * q, int nhits)
+{
+  double d;
+  (void) q->numeric_value (d);
+    
+  d = d * nhits;
+
+  return int (d * 1.0001);
+}
+
+/*
+  Returns 1 if processing of this set of queries should stop
+*/
+
+static int
+apply_query_demerit (Substructure_Hit_Statistics * q,
+                     int nhits,
+                     Demerit & demerit)
+{
+  int intd = query_demerit (q, nhits);
+
+  if (intd >= rejection_threshold ())
+  {
+    demerit.reject (q->comment (), nhits);
+    if (0 == keep_going_after_rejection)
+      return 1;
+  }
+  else
+    demerit.extra(intd, q->comment (), nhits);
+
+  if (demerit.rejected() && 0 == keep_going_after_rejection)
+    return 1;
+
+  return 0;
+}
+
+static void
+run_a_set_of_queries(Molecule_to_Match & target,
+                     Demerit & demerit,
+                     resizable_array_p<Substructure_Hit_Statistics> & queries,
+                     int first_column)
+{
+  int nqueries = queries.number_elements ();
+
+  for (int i = 0; i < nqueries; i++)
+  {
+    Substructure_Hit_Statistics * q = queries[i];
+
+    int nhits = q->substructure_search (target);
+
+    if (query_hits.number_elements ())
+      query_hits[first_column + i] = nhits;
+
+    if (0 == nhits)
+      continue;
+
+    if (verbose > 1)
+      cerr << nhits << " matches to query " << i << ' ' << q->comment () << endl;
+
+    if (hit_matrix.is_open ())
+      hit_matrix.add_entry (first_column + i, nhits, query_demerit (q, nhits));
+
+    if (apply_query_demerit (q, nhits, demerit))
+      return;
+  }
+
+  return;
+}
+
+/*
+  With -Z the queries are tried in the order the schedulers suggest,
+  until a query rejects on its own, or the demerits found so far would
+  reject. Since every demerit is positive, a run in file order would
+  then have rejected no later than the last query searched. Whether or
+  not a molecule is rejected does not depend on the order.
+
+  Applying, in file order, only the queries searched gives the same
+  result as a run in file order for molecules not rejected. For those
+  rejected, the reason may differ. When rejection reasons are written,
+  the queries not yet searched are searched as they are reached in file
+  order, which gives the reason a run without -Z would
+*/
+
+static Query_Scheduler q1_scheduler, q2_scheduler;
+
+static int scheduler_file_order_reason = 0;
+
+static resizable_array<int> scheduled_hits;
+
+static int
+run_scheduled_query (Molecule_to_Match & target,
+                     Substructure_Hit_Statistics * q,
+                     int i,
+                     int first_column,
+                     Query_Scheduler & scheduler)
+{
+  const iw_uint64_t t0 = substructure_search_cycles ();
+
+  const int nhits = q->substructure_search (target);
+
+  const int rejected = nhits > 0 && query_demerit (q, nhits) >= rejection_threshold ();
+
+  scheduler.record (i, rejected, substructure_search_cycles () - t0);
+
+  scheduled_hits[i] = nhits;
+
+  if (query_hits.number_elements ())
+    query_hits[first_column + i] = nhits;
+
+  return nhits;
+}
+
+/*
+  A profile records how often each query matched. Only queries that
+  reject with a single match count as rejections
+*/
+
+static int
+initialise_scheduler (Query_Scheduler & scheduler,
+                      const resizable_array_p<Substructure_Hit_Statistics> & queries)
+{
+  if (! scheduler.active ())
+    return 1;
+
+  int nqueries = queries.number_elements ();
+
+  int * rejects_on_match = new int[nqueries]; iw_auto_array<int> free_rejects_on_match (rejects_on_match);
+
+  for (int i = 0; i < nqueries; i++)
+  {
+    rejects_on_match[i] = query_demerit (queries[i], 1) >= rejection_threshold ();
+  }
+
+  return scheduler.initialise (queries, rejects_on_match);
+}
+
+static void
+run_a_set_of_queries(Molecule_to_Match & target,
+                     Demerit & demerit,
+                     resizable_array_p<Substructure_Hit_Statistics> & queries,
+                     int first_column,
+                     Query_Scheduler & scheduler)
+{
+  int nqueries = queries.number_elements ();
+
+  scheduled_hits.resize_keep_storage (0);
+  scheduled_hits.extend (nqueries, -1);
+
+  const int * order = scheduler.order ();
+
+  int first_rejection = nqueries;
+
+  int score = demerit.score ();
+  int last_searched = -1;
+
+  for (int i = 0; i < nqueries; i++)
+  {
+    const int j = order[i];
+
+    const int nhits = run_scheduled_query (target, queries[j], j, first_column, scheduler);
+
+    if (j > last_searched)
+      last_searched = j;
+
+    if (0 == nhits)
+      continue;
+
+    const int intd = query_demerit (queries[j], nhits);
+
+    if (intd >= rejection_threshold ())
+    {
+      first_rejection = j;
+      break;
+    }
+
+    if (intd > 0)
+      score += intd;
+
+    if (score >= rejection_threshold ())
+    {
+      first_rejection = last_searched;
+      break;
+    }
+  }
+
+  for (int i = 0; i <= first_rejection && i < nqueries; i++)
+  {
+    Substructure_Hit_Statistics * q = queries[i];
+
+    int nhits = scheduled_hits[i];
+    if (nhits < 0 && scheduler_file_order_reason)
+      nhits = run_scheduled_query (target, q, i, first_column, scheduler);
+
+    if (nhits <= 0)     // not searched, or no match
+      continue;
+
+    if (verbose > 1)
+      cerr << nhits << " matches to query " << i << ' ' << q->comment () << endl;
+
+    if (apply_query_demerit (q, nhits, demerit))
+      break;
+  }
+
+  scheduler.molecule_done ();
+
+  return;
+}
+
+static void
+add_hard_coded_rules_to_hit_matrix (const Demerit & demerit,
+                                    int rules_before)
+{
+  int nr = demerit.number_rules_recorded ();
+
+  for (int i = rules_before; i < nr; i++)
+  {
+    int c = hit_matrix.hard_coded_column (demerit_rule_name (demerit.rule (i)));
+
+    if (demerit.rule_is_rejection (i))
+      hit_matrix.add_entry (c, demerit.rule_hits (i), IWHM_REJECT);
+    else
+      hit_matrix.add_entry (c, demerit.rule_hits (i), demerit.rule_demerit (i));
+  }
+
+  return;
+}
+
+static int
+add_hit_matrix_columns (const resizable_array_p<Substructure_Hit_Statistics> & q,
+                        int type)
+{
+  for (int i = 0; i < q.number_elements (); i++)
+  {
+    double d;
+    (void) q[i]->numeric_value (d);
+
+    hit_matrix.add_column (q[i]->comment (), type, d);
+  }
+
+  return 1;
+}
+
+/*
+  Oct 2026. The Molecule_to_Match, and its perception, is shared by the
+  -q queries and any profiles. Discarded by molecule_done
+*/
+
+static Molecule_to_Match * shared_target = NULL;
+
+static Molecule_to_Match &
+molecule_to_match (Molecule & m)
+{
+  if (NULL == shared_target)
+    shared_target = new Molecule_to_Match (&m);
+
+  return *shared_target;
+}
+
+/*
+  With profiles, every hard coded rule is evaluated once, and the
+  results replayed into each Demerit. The replay stops after the same
+  hard coded rule the hard coded queries would have stopped at, given
+  the score so far, so every Demerit is as if the rules were run directly
+*/
+
+static int share_hard_coded_rules = 0;
+
+static Demerit hard_coded_rules;
+static resizable_array<int> hard_coded_rules_done;
+static resizable_array<int> hard_coded_rules_stop;
+static int hard_coded_rules_evaluated = 0;
+
+static void
+apply_hard_coded_rules (Molecule & m,
+                        Demerit & demerit)
+{
+  if (! share_hard_coded_rules)
+  {
+    substructure_demerits::hard_coded_queries (m, demerit);
+    return;
+  }
+
+  if (! hard_coded_rules_evaluated)
+  {
+    hard_coded_rules = Demerit ();
+    hard_coded_rules_done.resize_keep_storage (0);
+    hard_coded_rules_stop.resize_keep_storage (0);
+    substructure_demerits::hard_coded_queries (m, hard_coded_rules, hard_coded_rules_done, hard_coded_rules_stop);
+    hard_coded_rules_evaluated = 1;
+  }
+
+  int i = 0;
+
+  for (int j = 0; j < hard_coded_rules_done.number_elements (); j++)
+  {
+    for ( ; i < hard_coded_rules_done[j]; i++)
+    {
+      const IWString & name = demerit_rule_name (hard_coded_rules.rule (i));
+
+      if (hard_coded_rules.rule_is_rejection (i))
+        demerit.reject (name, hard_coded_rules.rule_hits (i));
+      else
+        demerit.extra (hard_coded_rules.rule_demerit (i), name, hard_coded_rules.rule_hits (i));
+    }
+
+    if (keep_going_after_rejection)
+      continue;
+
+    const int stop = hard_coded_rules_stop[j];
+
+    if (1 == stop || (stop < 0 && demerit.rejected ()))
+      return;
+  }
+
+  return;
+}
+
+static void
+molecule_done ()
+{
+  if (NULL != shared_target)
+  {
+    delete shared_target;
+    shared_target = NULL;
+  }
+
+  hard_coded_rules_evaluated = 0;
+
+  for (int i = 0; i < query_hits.number_elements (); i++)
+  {
+    query_hits[i] = -1;
+  }
+
+  return;
+}
+
+/*
+  Returns the IWDC_STAGE_* at which the molecule was first rejected
+*/
+
+static int
+iwdemerit (Molecule & m,
+           resizable_array_p<Substructure_Hit_Statistics> & q1,
+           resizable_array_p<Substructure_Hit_Statistics> & q2,
+           Demerit & demerit)
+{
+  int stage = IWDC_STAGE_NOT_REJECTED;
+
+  if (atom_count_demerits.active ())
+  {
+    atom_count_demerits.apply (m, demerit);
+    if (demerit.rejected ())
+    {
+      stage = IWDC_STAGE_ATOM_COUNT;
+      if (0 == keep_going_after_rejection)
+        return stage;
+    }
+  }
+
+  if (skip_molecules_with_abnormal_valences && ! m.valence_ok ())
+  {
+    demerit.reject ("valence");
+    molecules_with_abnormal_valences++;
+    if (IWDC_STAGE_NOT_REJECTED == stage)
+      stage = IWDC_STAGE_VALENCE;
+    if (0 == keep_going_after_rejection)
+      return stage;
+  }
+
+  if (do_hard_coded_substructure_queries)
+  {
+    const int rules_before = demerit.number_rules_recorded ();
+
+    apply_hard_coded_rules (m, demerit);
+
+    if (hit_matrix.is_open ())
+      add_hard_coded_rules_to_hit_matrix (demerit, rules_before);
+//  cerr << "After hard coded queries, score is " << demerit.score() << endl;
+
+    if (demerit.rejected () && IWDC_STAGE_NOT_REJECTED == stage)
+      stage = IWDC_STAGE_HARD_CODED;
+
+    if (demerit.rejected () && 0 == keep_going_after_rejection)
+      return stage;
+  }
+
+  Molecule_to_Match & target = molecule_to_match (m);
+
+  if (q1.number_elements())
+  {
+    if (q1_scheduler.active ())
+      run_a_set_of_queries(target, demerit, q1, 0, q1_scheduler);
+    else
+      run_a_set_of_queries(target, demerit, q1, 0);
+
+//  cerr << "After command line queries, score is " << demerit.score() << " rej? " << demerit.rejected() << endl;
+    if (demerit.rejected())
+      return IWDC_STAGE_NOT_REJECTED == stage ? IWDC_STAGE_QUERIES : stage;
+  }
+
+  if (q2.number_elements())
+  {
+    m.reduce_to_largest_fragment_carefully();
+    Molecule_to_Match target(&m);
+
+    if (q2_scheduler.active ())
+      run_a_set_of_queries(target, demerit, q2, q1.number_elements (), q2_scheduler);
+    else
+      run_a_set_of_queries(target, demerit, q2, q1.number_elements ());
+
+    if (demerit.rejected())
+      return IWDC_STAGE_NOT_REJECTED == stage ? IWDC_STAGE_LARGEST_FRAGMENT_QUERIES : stage;
+  }
+
+  return stage;
+}
+
+/*
+  In jul 97, people wanted to know how many molecules received multiple
+  demerits, and how many were rejected as a result of multiple demerits
+*/
+
+static extending_resizable_array<int> demerits_per_molecule;
+static extending_resizable_array<int> demerits_per_rejected_molecule;
+
+/*
+  Later in Jul 97 they wanted a list of molecules for which there were
+  rejected as a result of multiple different types of demerit
+*/
+
+static Molecule_Output_Object stream_for_multiple_demerits;
+
+/*
+  Oct 2026. Optional compact results, see demerit_columnar.h
+*/
+
+static Demerit_Columnar_Writer columnar_output;
+
+/*
+  Oct 2026. Results can be kept from one run to the next, see
+  result_cache.h. The key is the unique smiles, after any elements have
+  been removed. The fingerprint covers the options and the contents of
+  the query and control files, see compute_cache_fingerprint
+*/
+
+static Result_Cache result_cache;
+
+#define CACHE_ABNORMAL_VALENCE 1
+#define CACHE_LARGEST_FRAGMENT 2
+
+/*
+  Oct 2026. Libraries often contain the same structure many times over.
+  With -Q, results are also kept in memory for the run, found either by
+  the smiles exactly as read, or by the unique smiles. The unique smiles
+  is of the whole molecule, since atom counts and the hard coded rules
+  see every fragment, so salt forms are not matched to their parents
+*/
+
+static Result_Memory_Cache memory_cache;
+
+/*
+  Oct 2026. Where the time goes, query by query, with -p
+*/
+
+static IWString profile_file_name;
+
+static int dedup_raw_smiles = 0;
+static int dedup_unique_smiles = 0;
+
+/*
+  Oct 2026. Long runs can write a checkpoint every so many molecules:
+  where we are in the input, how much has been written to each output
+  file, and the accumulated counters. After a crash the run can be
+  resumed, with the same options, from the last checkpoint. Outputs are
+  truncated back to their checkpointed sizes and appended to.
+*/
+
+static IWString checkpoint_file_name;
+static int checkpoint_every = 10000;
+
+static int resume_file_index = -1;     // set when resuming
+static off_t resume_offset = 0;
+
+/*
+  Counters cannot be restored until the queries have been read, so records
+  other than file and output records are kept until then
+*/
+
+static resizable_array_p<IWString> checkpoint_records;
+
+static off_t
+file_size_on_disk (const IWString & fname)
+{
+  IWString tmp (fname);
+
+  struct stat st;
+  if (0 != stat (tmp.null_terminated_chars (), &st))
+    return static_cast<off_t> (-1);
+
+  return st.st_size;
+}
+
+static int
+write_checkpoint_output_sizes (Molecule_Output_Object & mo,
+                               ostream & os)
+{
+  if (! mo.active ())
+    return 1;
+
+  mo.do_flush ();
+
+  for (int i = 0; i < mo.number_elements (); i++)
+  {
+    const IWString & fname = mo[i]->fname ();
+
+    off_t s = file_size_on_disk (fname);
+    if (s < 0)
+    {
+      cerr << "Cannot determine size of '" << fname << "' for checkpoint\n";
+      return 0;
+    }
+
+    os << "output " << s << ' ' << fname << '\n';
+  }
+
+  return 1;
+}
+
+static void
+write_checkpoint_array (const char * label,
+                        const extending_resizable_array<int> & c,
+                        ostream & os)
+{
+  os << label;
+
+  for (int i = 0; i < c.number_elements (); i++)
+  {
+    os << ' ' << c[i];
+  }
+
+  os << '\n';
+
+  return;
+}
+
+/*
+  The checkpoint is written to a temporary file and renamed, so there is
+  always a complete checkpoint on disk
+*/
+
+static int
+write_checkpoint (int file_index, off_t offset,
+                  ofstream_and_type & output,
+                  const resizable_array_p<Substructure_Hit_Statistics> & q1,
+                  const resizable_array_p<Substructure_Hit_Statistics> & q2)
+{
+  IWString tmp_name (checkpoint_file_name);
+  tmp_name << ".tmp";
+
+  ofstream ckpt (tmp_name.null_terminated_chars (), ios::out);
+  if (! ckpt.good ())
+  {
+    cerr << "Cannot open checkpoint file '" << tmp_name << "'\n";
+    return 0;
+  }
+
+  ckpt << "file " << file_index << ' ' << offset << '\n';
+
+  if (! write_checkpoint_output_sizes (stream_for_non_rejected_molecules, ckpt) ||
+      ! write_checkpoint_output_sizes (stream_for_rejected_molecules, ckpt) ||
+      ! write_checkpoint_output_sizes (stream_for_multiple_demerits, ckpt))
+    return 0;
+
+  if (output.is_open ())
+  {
+    output.flush ();
+
+    off_t s = file_size_on_disk (output.fname ());
+    if (s < 0)
+    {
+      cerr << "Cannot determine size of '" << output.fname () << "' for checkpoint\n";
+      return 0;
+    }
+
+    ckpt << "output " << s << ' ' << output.fname () << '\n';
+  }
+
+  if (columnar_output.is_open ())
+  {
+    if (! columnar_output.flush ())
+      return 0;
+
+    off_t s = file_size_on_disk (columnar_output.fname ());
+    if (s < 0)
+    {
+      cerr << "Cannot determine size of '" << columnar_output.fname () << "' for checkpoint\n";
+      return 0;
+    }
+
+    ckpt << "output " << s << ' ' << columnar_output.fname () << '\n';
+  }
+
+  ckpt << "molecules_read " << molecules_read << '\n';
+  ckpt << "molecules_receiving_demerits " << molecules_receiving_demerits << '\n';
+  ckpt << "molecules_rejected " << molecules_rejected << '\n';
+  ckpt << "molecules_with_abnormal_valences " << molecules_with_abnormal_valences << '\n';
+  ckpt << "atom_types_count " << atom_types_count << '\n';
+  ckpt << "csxh_count " << csxh_count << '\n';
+
+  write_checkpoint_array ("demerits_per_molecule", demerits_per_molecule, ckpt);
+  write_checkpoint_array ("demerits_per_rejected_molecule", demerits_per_rejected_molecule, ckpt);
+
+  for (int i = 0; i < q1.number_elements (); i++)
+  {
+    ckpt << "query " << i << ' ';
+    q1[i]->write_hit_counts (ckpt);
+    ckpt << '\n';
+  }
+
+  for (int i = 0; i < q2.number_elements (); i++)
+  {
+    ckpt << "query " << (q1.number_elements () + i) << ' ';
+    q2[i]->write_hit_counts (ckpt);
+    ckpt << '\n';
+  }
+
+  for (int i = 0; i < elements_to_remove.number_elements (); i++)
+  {
+    ckpt << "rmele " << i << ' ';
+    elements_to_remove[i]->write_counters (ckpt);
+    ckpt << '\n';
+  }
+
+  ckpt.close ();
+
+  if (! ckpt.good ())
+  {
+    cerr << "Error writing checkpoint file '" << tmp_name << "'\n";
+    return 0;
+  }
+
+  if (0 != rename (tmp_name.null_terminated_chars (), checkpoint_file_name.null_terminated_chars ()))
+  {
+    cerr << "Cannot rename '" << tmp_name << "' to '" << checkpoint_file_name << "'\n";
+    return 0;
+  }
+
+  if (verbose > 1)
+    cerr << "Checkpoint written after " << molecules_read << " molecules\n";
+
+  return 1;
+}
+
+/*
+  First part of resuming. Must be done before any output file is opened.
+  Each output file is truncated to its checkpointed size, and all files
+  are subsequently opened for append.
+*/
+
+static int
+read_checkpoint ()
+{
+  iwstring_data_source input (checkpoint_file_name.null_terminated_chars ());
+  if (! input.good ())
+  {
+    cerr << "Cannot open checkpoint file '" << checkpoint_file_name << "'\n";
+    return 0;
+  }
+
+  const_IWSubstring buffer;
+  while (input.next_record (buffer))
+  {
+    if (buffer.starts_with ("file "))
+    {
+      const_IWSubstring f, ndx, offset;
+      long tmp;
+      if (3 != buffer.nwords () || ! buffer.word (1, ndx) || ! ndx.numeric_value (resume_file_index) || resume_file_index < 0 ||
+          ! buffer.word (2, offset) || ! offset.numeric_value (tmp) || tmp < 0)
+      {
+        cerr << "Invalid checkpoint file record '" << buffer << "'\n";
+        return 0;
+      }
+
+      resume_offset = static_cast<off_t> (tmp);
+    }
+    else if (buffer.starts_with ("output "))
+    {
+      const_IWSubstring s;
+      long tmp;
+      if (buffer.nwords () < 3 || ! buffer.word (1, s) || ! s.numeric_value (tmp) || tmp < 0)
+      {
+        cerr << "Invalid checkpoint output record '" << buffer << "'\n";
+        return 0;
+      }
+
+      IWString fname (buffer);
+      fname.remove_leading_words (2);
+
+      if (0 != truncate (fname.null_terminated_chars (), static_cast<off_t> (tmp)))
+      {
+        cerr << "Cannot truncate '" << fname << "' to " << tmp << " bytes\n";
+        return 0;
+      }
+    }
+    else
+      checkpoint_records.add (new IWString (buffer));
+  }
+
+  if (resume_file_index < 0)
+  {
+    cerr << "Checkpoint file '" << checkpoint_file_name << "' has no file record\n";
+    return 0;
+  }
+
+  set_ofstream_and_type_open_for_append (1);
+
+  return 1;
+}
+
+static int
+restore_checkpoint_array (const_IWSubstring buffer,
+                          extending_resizable_array<int> & c)
+{
+  buffer.remove_leading_words (1);
+
+  int i = 0;
+  const_IWSubstring token;
+  for (int n = 0; buffer.nextword (token, i); n++)
+  {
+    int v;
+    if (! token.numeric_value (v) || v < 0)
+      return 0;
+
+    c[n] = v;
+  }
+
+  return 1;
+}
+
+/*
+  Second part of resuming, once the queries exist
+*/
+
+static int
+restore_checkpoint_counters (resizable_array_p<Substructure_Hit_Statistics> & q1,
+                             resizable_array_p<Substructure_Hit_Statistics> & q2)
+{
+  for (int i = 0; i < checkpoint_records.number_elements (); i++)
+  {
+    const IWString & buffer = *(checkpoint_records[i]);
+
+    const_IWSubstring label, token;
+    buffer.word (0, label);
+
+    int ndx = -1;
+    if ("query" == label || "rmele" == label)
+    {
+      if (! buffer.word (1, token) || ! token.numeric_value (ndx) || ndx < 0)
+      {
+        cerr << "Invalid checkpoint record '" << buffer << "'\n";
+        return 0;
+      }
+    }
+
+    const_IWSubstring counts (buffer);
+
+    int rc = 0;
+    if ("molecules_read" == label)
+      rc = buffer.word (1, token) && token.numeric_value (molecules_read);
+    else if ("molecules_receiving_demerits" == label)
+      rc = buffer.word (1, token) && token.numeric_value (molecules_receiving_demerits);
+    else if ("molecules_rejected" == label)
+      rc = buffer.word (1, token) && token.numeric_value (molecules_rejected);
+    else if ("molecules_with_abnormal_valences" == label)
+      rc = buffer.word (1, token) && token.numeric_value (molecules_with_abnormal_valences);
+    else if ("atom_types_count" == label)
+      rc = buffer.word (1, token) && token.numeric_value (atom_types_count);
+    else if ("csxh_count" == label)
+      rc = buffer.word (1, token) && token.numeric_value (csxh_count);
+    else if ("demerits_per_molecule" == label)
+      rc = restore_checkpoint_array (buffer, demerits_per_molecule);
+    else if ("demerits_per_rejected_molecule" == label)
+      rc = restore_checkpoint_array (buffer, demerits_per_rejected_molecule);
+    else if ("query" == label)
+    {
+      counts.remove_leading_words (2);
+      if (ndx < q1.number_elements ())
+        rc = q1[ndx]->restore_hit_counts (counts);
+      else if (ndx < q1.number_elements () + q2.number_elements ())
+        rc = q2[ndx - q1.number_elements ()]->restore_hit_counts (counts);
+    }
+    else if ("rmele" == label)
+    {
+      counts.remove_leading_words (2);
+      if (ndx < elements_to_remove.number_elements ())
+        rc = elements_to_remove[ndx]->restore_counters (counts);
+    }
+
+    if (! rc)
+    {
+      cerr << "Cannot restore checkpoint record '" << buffer << "', were the options changed?\n";
+      return 0;
+    }
+  }
+
+  checkpoint_records.resize (0);
+
+  if (verbose)
+    cerr << "Resuming at byte " << resume_offset << " of file " << resume_file_index << ", " << molecules_read << " molecules already processed\n";
+
+  return 1;
+}
+
+static int
+display_checkpoint_options (ostream & os)
+{
+  os << " -Y ckpt=<fname>  write checkpoints to <fname>\n";
+  os << " -Y every=<n>     write a checkpoint every <n> molecules (default " << checkpoint_every << ")\n";
+  os << " -Y resume        resume from the checkpoint in <fname>, use the same options as before\n";
+  os << "                  output files are truncated to their sizes at the checkpoint\n";
+
+  exit (0);
+}
+
+static int
+display_dedup_options (ostream & os)
+{
+  os << " -Q smiles        reuse results for molecules whose smiles, as read, were seen before\n";
+  os << " -Q usmi          reuse results for molecules whose unique smiles were seen before\n";
+  os << "                  the whole molecule is used, a salt form is not the same as its parent\n";
+  os << " -Q mb=<n>        memory to use for held results, least recently used dropped first (default 256)\n";
+  os << "                  with neither smiles nor usmi, both are used\n";
+
+  exit (0);
+}
+
+/*
+  Checkpointing needs files we can seek in and truncate
+*/
+
+static int
+ok_for_checkpointing (const Molecule_Output_Object & mo, const char * opt)
+{
+  if (! mo.active ())
+    return 1;
+
+  if (0 == mo.number_elements () || mo.molecules_per_file () > 0)
+  {
+    cerr << "Checkpointing needs a single set of output files, not stdout, for -" << opt << " output\n";
+    return 0;
+  }
+
+  return 1;
+}
+
+static int
+do_append_demerit_text_to_name (Molecule & m,
+                                const Demerit & demerit)
+{
+  IWString new_name (m.molecule_name ());
+
+  if (write_rejection_reasons_separately && write_rejection_reason_like_tsubstructure)
+    new_name << ' ' << demerit.types ();
+  else if (write_rejection_reason_like_tsubstructure)
+    new_name << " (" << demerit.number_different_demerits_applied () << " matches to 'D" << demerit.score () << ' ' << demerit.types () << "')";
+  else
+    new_name << " : D(" << demerit.score () << ") " << demerit.types ();
+
+  m.set_name (new_name);
+
+  return 1;
+}
+
+/*
+  A stored result is the flags above, the stage, and the binary form of
+  the Demerit. Returns the stage, or -1 if VALUE cannot be used
+*/
+
+static int
+apply_stored_result (Molecule & m,
+                     const IWString & value,
+                     Demerit & demerit)
+{
+  const_IWSubstring s (value);
+
+  if (s.length () < 2 || ! demerit.build_from_binary_form (s.from_to (2, s.length () - 1)))
+  {
+    cerr << "Invalid stored result for '" << m.name () << "', recomputing\n";
+    demerit = Demerit ();
+    return -1;
+  }
+
+  if (value[0] & CACHE_ABNORMAL_VALENCE)
+    molecules_with_abnormal_valences++;
+  if (value[0] & CACHE_LARGEST_FRAGMENT)
+    m.reduce_to_largest_fragment_carefully ();
+
+  return value[1];
+}
+
+/*
+  Look for a result from an earlier copy of this molecule, in memory or
+  in the persistent cache, before doing the work. RAW_KEY is the smiles
+  as read, before any elements were removed, only used with -Q smiles.
+  Returns the stage, as iwdemerit, or -1 on error
+*/
+
+static int
+iwdemerit_reuse (Molecule & m,
+                 const IWString & raw_key,
+                 resizable_array_p<Substructure_Hit_Statistics> & q1,
+                 resizable_array_p<Substructure_Hit_Statistics> & q2,
+                 Demerit & demerit)
+{
+  static IWString key;
+  static IWString value;
+
+  int stage;
+
+  if (dedup_raw_smiles && memory_cache.lookup (raw_key, value))
+  {
+    if ((stage = apply_stored_result (m, value, demerit)) >= 0)
+      return stage;
+  }
+
+  if (dedup_unique_smiles || result_cache.active ())
+  {
+//  unique_smiles overwrites the smiles the molecule was read with, keep those for output
+
+    Molecule tmp (m);
+    key.resize_keep_storage (0);
+    key << 'U' << tmp.unique_smiles ();
+
+    if (dedup_unique_smiles && memory_cache.lookup (key, value))
+    {
+      if ((stage = apply_stored_result (m, value, demerit)) >= 0)
+      {
+        if (dedup_raw_smiles)
+          memory_cache.store (raw_key, value);
+        return stage;
+      }
+    }
+
+    const_IWSubstring usmi (key);
+    usmi.remove_leading_chars (1);
+
+    if (result_cache.active () && result_cache.lookup (usmi, value))
+    {
+      if ((stage = apply_stored_result (m, value, demerit)) >= 0)
+      {
+        if (dedup_unique_smiles)
+          memory_cache.store (key, value);
+        if (dedup_raw_smiles)
+          memory_cache.store (raw_key, value);
+        return stage;
+      }
+    }
+  }
+
+  const int matoms = m.natoms ();
+  const int abnormal_valences = molecules_with_abnormal_valences;
+
+  stage = iwdemerit (m, q1, q2, demerit);
+
+  char flags = 0;
+  if (molecules_with_abnormal_valences != abnormal_valences)
+    flags |= CACHE_ABNORMAL_VALENCE;
+  if (m.natoms () != matoms)
+    flags |= CACHE_LARGEST_FRAGMENT;
+
+  value.resize_keep_storage (0);
+  value << flags << static_cast<char> (stage);
+  demerit.append_binary_form (value);
+
+  if (dedup_unique_smiles)
+    memory_cache.store (key, value);
+  if (dedup_raw_smiles)
+    memory_cache.store (raw_key, value);
+
+  if (result_cache.active ())
+  {
+    const_IWSubstring usmi (key);
+    usmi.remove_leading_chars (1);
+
+    if (! result_cache.store (usmi, value))
+      return -1;
+  }
+
+  return stage;
+}
+
+/*
+  Oct 2026. With -P, further profiles are applied in the same pass. A
+  profile has its own rejection threshold, atom count cutoffs, queries
+  and outputs. Molecules are read and standardised once, and the hard
+  coded rules and each query evaluated at most once per molecule, no
+  matter how many profiles use them.
+
+  A profile is a comma separated list of
+
+    name=<name>       used in reports
+    f=<n>             rejection threshold, as -f
+    smin=<n> ...      atom count cutoffs, as -c
+    noq               do not apply the -q queries
+    q=<query>         further queries, as -q
+    G=<stem>          molecules not rejected
+    R=<stem>          rejected molecules
+
+  Anything not specified is as for the main rules
+*/
+
+static resizable_array_p<Substructure_Hit_Statistics> profile_queries;
+
+/*
+  A query specification used by several profiles is read once. The
+  range of profile_queries it occupies
+*/
+
+static IW_STL_Hash_Map_int profile_query_start, profile_query_end;
+
+static Substructure_Hit_Statistics *
+query_by_index (int i)
+{
+  const int nq = queries.number_elements ();
+
+  if (i < nq)
+    return queries[i];
+
+  return profile_queries[i - nq];
+}
+
+static int
+cached_substructure_search (int i,
+                            Molecule & m)
+{
+  if (query_hits[i] < 0)
+    query_hits[i] = query_by_index (i)->substructure_search (molecule_to_match (m));
+
+  return query_hits[i];
+}
+
+/*
+  Each query must have a positive demerit
+*/
+
+static int
+queries_have_demerits (resizable_array_p<Substructure_Hit_Statistics> & q,
+                       int istart)
+{
+  for (int i = istart; i < q.number_elements (); i++)
+  {
+    q[i]->set_find_unique_embeddings_only (1);
+
+    for (int j = 0; j < q[i]->number_elements (); j++)
+    {
+      const Single_Substructure_Query * sq = q[i]->item (j);
+
+      double d;
+      if (! sq->numeric_value (d))
+      {
+        cerr << "Yipes, query '" << q[i]->comment () << " has no demerit value\n";
+        return 0;
+      }
+  
+      if (d <= 0.0)
+      {
+        cerr << "Hmmm, query '" << q[i]->comment () << "' has a non-positive demerit " << d << endl;
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
 
-    return;
-  }
+class Demerit_Profile
+{
+  private:
+    IWString _name;
 
-// Feb 2005. Heuristic for adding demerits beyond the hard atom count cutoff
+    int _rejection_threshold;
 
-  if (hard_upper_atom_count_cutoff > 0 && matoms >= hard_upper_atom_count_cutoff)
-  {
-    demerit.extra (rejection_threshold() + 6 * (matoms - hard_upper_atom_count_cutoff), "too_many_atoms");
+    Atom_Count_Demerits _atom_count;
 
-//  cerr << hard_upper_atom_count_cutoff << " hard_upper_atom_count_cutoff, matoms = " << matoms << endl;
-    return;
-  }
+//  Indices for query_by_index, in the order applied
 
-  if (matoms > hard_lower_atom_count_cutoff && matoms < soft_lower_atom_count_cutoff)
-  {
-    float r = static_cast<float> (soft_lower_atom_count_cutoff - matoms) / static_cast<float> (soft_lower_atom_count_cutoff - hard_lower_atom_count_cutoff);
-    int d = static_cast<int> (lower_atom_count_demerit * r);
+    resizable_array<int> _query;
 
-    if (0 == d)
-      d = 1;
+    Molecule_Output_Object _good;
+    Molecule_Output_Object _bad;
 
-    demerit.extra (d, "too_few_atoms");
+    int _molecules_rejected;
 
-    return;
-  }
+//  private functions
+
+    int _add_queries (const_IWSubstring &);
+    int _open_stream (const Command_Line &, const const_IWSubstring &, Molecule_Output_Object &);
+    void _evaluate (Molecule &, Demerit &);
+
+  public:
+    Demerit_Profile ();
+
+    int build (const Command_Line &, const const_IWSubstring &);
+
+    const IWString & name () const { return _name;}
+
+    int process (Molecule &);
+
+    int report (ostream &) const;
+};
+
+Demerit_Profile::Demerit_Profile () : _atom_count (atom_count_demerits)
+{
+  _rejection_threshold = rejection_threshold ();
+
+  _molecules_rejected = 0;
+
+  return;
+}
+
+int
+Demerit_Profile::_add_queries (const_IWSubstring & token)
+{
+  IWString key (token);
 
-  if (matoms > soft_upper_atom_count_cutoff && matoms < hard_upper_atom_count_cutoff)
+  if (! profile_query_start.contains (key))
   {
-    float r = static_cast<float> (matoms - soft_upper_atom_count_cutoff) / static_cast<float> (hard_upper_atom_count_cutoff - soft_upper_atom_count_cutoff);
-    int d = static_cast<int> (upper_atom_count_demerit * r);
-//  cerr << "too_many_atoms: " << soft_upper_atom_count_cutoff << " soft_upper_atom_count_cutoff, matoms = " << matoms << ", d = " << d << endl;
-//  cerr << "upper_atom_count_demerit " << upper_atom_count_demerit << endl;
-//  cerr << "too_many_atoms: soft_upper_atom_count_cutoff " << soft_upper_atom_count_cutoff << " hard_upper_atom_count_cutoff " << hard_upper_atom_count_cutoff << " matoms " << matoms << " D = " << d << endl;
-    if (0 == d)
-      d = 1;
+    const int istart = profile_queries.number_elements ();
 
-    demerit.extra (d, "too_many_atoms");
+    if (! process_cmdline_token ('P', token, profile_queries, verbose) ||
+        ! queries_have_demerits (profile_queries, istart))
+      return 0;
 
-    return;
+    profile_query_start[key] = istart;
+    profile_query_end[key] = profile_queries.number_elements ();
   }
 
-  return;
+  const int nq = queries.number_elements ();
+
+  for (int i = profile_query_start[key]; i < profile_query_end[key]; i++)
+  {
+    _query.add (nq + i);
+  }
+
+  return 1;
 }
 
+int
+Demerit_Profile::_open_stream (const Command_Line & cl,
+                               const const_IWSubstring & stem,
+                               Molecule_Output_Object & mo)
+{
+  if (! cl.option_present ('o'))
+    mo.add_output_type (SMI);
+  else if (! mo.determine_output_types (cl))
+    return 0;
 
-static void
-run_a_set_of_queries(Molecule_to_Match & target,
-                     Demerit & demerit,
-                     resizable_array_p<Substructure_Hit_Statistics> & queries)
+  return mo.new_stem (stem);
+}
+
+int
+Demerit_Profile::build (const Command_Line & cl,
+                        const const_IWSubstring & spec)
 {
-  int nqueries = queries.number_elements ();
+  int use_main_queries = 1;
 
-  for (int i = 0; i < nqueries; i++)
+  resizable_array_p<const_IWSubstring> tokens;
+  spec.split (tokens, ',');
+
+  for (int i = 0; i < tokens.number_elements (); i++)
   {
-    Substructure_Hit_Statistics * q = queries[i];
+    const_IWSubstring token = *(tokens[i]);
 
-    int nhits = q->substructure_search (target);
-    if (0 == nhits)
-      continue;
+    if (token.starts_with ("name="))
+    {
+      token.remove_leading_chars (5);
+      _name = token;
+    }
+    else if (token.starts_with ("f="))
+    {
+      token.remove_leading_chars (2);
+      if (! token.numeric_value (_rejection_threshold) || _rejection_threshold < 1)
+      {
+        cerr << "The rejection threshold must be a whole +ve number '" << *(tokens[i]) << "'\n";
+        return 0;
+      }
 
-    if (verbose > 1)
-      cerr << nhits << " matches to query " << i << ' ' << q->comment () << endl;
+      if (! cl.option_present ('x'))
+      {
+        _atom_count.lower_demerit = _rejection_threshold;
+        _atom_count.upper_demerit = _rejection_threshold;
+      }
+    }
+    else if ("noq" == token)
+      use_main_queries = 0;
+    else if (token.starts_with ("q="))
+    {
+      token.remove_leading_chars (2);
+      if (! _add_queries (token))
+      {
+        cerr << "Cannot read profile queries '" << token << "'\n";
+        return 0;
+      }
+    }
+    else if (token.starts_with ("G=") || token.starts_with ("R="))
+    {
+      Molecule_Output_Object & mo = token.starts_with ("G=") ? _good : _bad;
 
-    double d;
-    (void) q->numeric_value (d);
-    
-    d = d * nhits;
+      token.remove_leading_chars (2);
+      if (! _open_stream (cl, token, mo))
+      {
+        cerr << "Cannot open profile output '" << token << "'\n";
+        return 0;
+      }
+    }
+    else if (! _atom_count.parse_directive (token))
+    {
+      cerr << "Unrecognised profile directive '" << token << "'\n";
+      return 0;
+    }
+  }
 
-    int intd = int (d * 1.0001);
+  if (! _atom_count.ok (cerr))
+    return 0;
 
-    if (intd >= rejection_threshold ())
+//  The -q queries first, as if they had been given before any q=
+
+  if (use_main_queries)
+  {
+    for (int i = queries.number_elements () - 1; i >= 0; i--)
     {
-      demerit.reject (q->comment ());
-      if (0 == keep_going_after_rejection)
-        return;
+      _query.insert_at_beginning (i);
     }
-    else
-      demerit.extra(intd, q->comment ());
-
-    if (demerit.rejected() && 0 == keep_going_after_rejection)
-      return;
   }
 
-  return;
+  if (0 == _name.length ())
+    _name = spec;
+
+  return 1;
 }
 
-static void
-iwdemerit (Molecule & m,
-           resizable_array_p<Substructure_Hit_Statistics> & q1,
-           resizable_array_p<Substructure_Hit_Statistics> & q2,
-           Demerit & demerit)
+/*
+  Same sequence of checks as iwdemerit
+*/
+
+void
+Demerit_Profile::_evaluate (Molecule & m,
+                            Demerit & demerit)
 {
-  if (soft_lower_atom_count_cutoff > 0 || soft_upper_atom_count_cutoff > 0)
+  if (_atom_count.active ())
   {
-    do_atom_count_demerits (m, demerit);
+    _atom_count.apply (m, demerit);
     if (demerit.rejected () && 0 == keep_going_after_rejection)
       return;
   }
@@ -233,96 +1575,149 @@ iwdemerit (Molecule & m,
   if (skip_molecules_with_abnormal_valences && ! m.valence_ok ())
   {
     demerit.reject ("valence");
-    molecules_with_abnormal_valences++;
     if (0 == keep_going_after_rejection)
       return;
   }
 
   if (do_hard_coded_substructure_queries)
   {
-    substructure_demerits::hard_coded_queries (m, demerit);
-//  cerr << "After hard coded queries, score is " << demerit.score() << endl;
-
+    apply_hard_coded_rules (m, demerit);
     if (demerit.rejected () && 0 == keep_going_after_rejection)
       return;
   }
 
-  Molecule_to_Match target (&m);
-
-  if (q1.number_elements())
+  for (int i = 0; i < _query.number_elements (); i++)
   {
-    run_a_set_of_queries(target, demerit, q1);
+    const int nhits = cached_substructure_search (_query[i], m);
+    if (0 == nhits)
+      continue;
 
-//  cerr << "After command line queries, score is " << demerit.score() << " rej? " << demerit.rejected() << endl;
-    if (demerit.rejected())
+    if (apply_query_demerit (query_by_index (_query[i]), nhits, demerit))
       return;
   }
 
-  if (q2.number_elements())
-  {
-    m.reduce_to_largest_fragment_carefully();
-    Molecule_to_Match target(&m);
+  return;
+}
 
-    run_a_set_of_queries(target, demerit, q2);
+int
+Demerit_Profile::process (Molecule & m)
+{
+  const int main_rejection_threshold = rejection_threshold ();
 
-    if (demerit.rejected())
-      return;
-  }
+  set_rejection_threshold (_rejection_threshold);
 
-  return;
-}
+  Demerit demerit;
 
-/*
-  In jul 97, people wanted to know how many molecules received multiple
-  demerits, and how many were rejected as a result of multiple demerits
-*/
+  _evaluate (m, demerit);
 
-static extending_resizable_array<int> demerits_per_molecule;
-static extending_resizable_array<int> demerits_per_rejected_molecule;
+  const int rejected = demerit.rejected ();
 
-/*
-  Later in Jul 97 they wanted a list of molecules for which there were
-  rejected as a result of multiple different types of demerit
-*/
+  set_rejection_threshold (main_rejection_threshold);
 
-static Molecule_Output_Object stream_for_multiple_demerits;
+  if (rejected)
+    _molecules_rejected++;
 
-static int
-do_append_demerit_text_to_name (Molecule & m,
-                                const Demerit & demerit)
-{
-  IWString new_name (m.molecule_name ());
+  Molecule_Output_Object & mo = rejected ? _bad : _good;
 
-  if (write_rejection_reasons_separately && write_rejection_reason_like_tsubstructure)
-    new_name << ' ' << demerit.types ();
-  else if (write_rejection_reason_like_tsubstructure)
-    new_name << " (" << demerit.number_different_demerits_applied () << " matches to 'D" << demerit.score () << ' ' << demerit.types () << "')";
-  else
-    new_name << " : D(" << demerit.score () << ") " << demerit.types ();
+  if (! mo.active ())
+    return 1;
 
-  m.set_name (new_name);
+  if (0 == demerit.score () || ! append_demerit_text_to_name)
+    return mo.write (&m);
 
-  return 1;
+  const IWString save_name (m.name ());
+
+  do_append_demerit_text_to_name (m, demerit);
+
+  mo.write (&m);
+
+  m.set_name (save_name);
+
+  return mo.good ();
+}
+
+int
+Demerit_Profile::report (ostream & os) const
+{
+  os << "Profile '" << _name << "' threshold " << _rejection_threshold << ", " << _query.number_elements () << " queries, rejected " << _molecules_rejected << " molecules\n";
+
+  return os.good ();
 }
 
+static resizable_array_p<Demerit_Profile> profiles;
+
 static int
 iwdemerit (Molecule & m,
            resizable_array_p<Substructure_Hit_Statistics> & q1,
            resizable_array_p<Substructure_Hit_Statistics> & q2,
-           ofstream & output)
+           ofstream_and_type & output)
 {
+  static IWString raw_key;
+
+  if (dedup_raw_smiles)
+  {
+    raw_key.resize_keep_storage (0);
+    raw_key << 'R' << m.smiles ();
+  }
+
   elements_to_remove.process (m);
 
+  int hit_matrix_natoms = 0;
+  int hit_matrix_flags = 0;
+
+  if (hit_matrix.is_open ())
+  {
+    hit_matrix_natoms = m.atoms_in_largest_fragment ();
+    if (! m.valence_ok ())
+      hit_matrix_flags |= IWHM_FLAG_BAD_VALENCE;
+  }
+
   Demerit demerit;
 
-  iwdemerit (m, q1, q2, demerit);
+  int stage;
+  if (result_cache.active () || memory_cache.active ())
+  {
+    stage = iwdemerit_reuse (m, raw_key, q1, q2, demerit);
+    if (stage < 0)
+      return 0;
+  }
+  else
+    stage = iwdemerit (m, q1, q2, demerit);
+
+  for (int i = 0; i < profiles.number_elements (); i++)
+  {
+    if (! profiles[i]->process (m))
+      return 0;
+  }
+
+  if (columnar_output.is_open ())
+  {
+    const_IWSubstring id;
+    m.name ().word (0, id);
+
+    if (! columnar_output.add (id, stage, demerit))
+      return 0;
+  }
+
+  if (hit_matrix.is_open () && ! hit_matrix.finish_row (m.smiles (), m.name (), hit_matrix_natoms, hit_matrix_flags))
+    return 0;
 
   if (demerit.rejected ())
     demerits_per_rejected_molecule[demerit.number_different_demerits_applied ()]++;
   if (demerit.score ())
     demerits_per_molecule[demerit.number_different_demerits_applied ()]++;
 
-  if (demerit.score () && append_demerit_text_to_name)
+//  Oct 2026. Only build the new name if the molecule is going to be written
+
+  int written;
+  if (output.is_open ())
+    written = 1;
+  else if (demerit.rejected ())
+    written = stream_for_rejected_molecules.number_elements () || (stream_for_multiple_demerits.number_elements () && ! demerit.rejected_by_single_rule ());
+  else
+    written = stream_for_non_rejected_molecules.active ();
+
+  if (demerit.score () && append_demerit_text_to_name && written)
     do_append_demerit_text_to_name (m, demerit);
 
 //cerr << m.name() << " rejected? " << demerit.rejected () << " stream is " << stream_for_non_rejected_molecules.active () << endl;
@@ -342,7 +1737,7 @@ iwdemerit (Molecule & m,
   if (verbose > 1 && demerit.score ())
     demerit.debug_print (cerr);
 
-  if (! output.rdbuf ()->is_open ())
+  if (! output.is_open ())
     return 1;
 
   output << "$SMI<" << m.smiles () << ">\n";
@@ -357,7 +1752,9 @@ iwdemerit (Molecule & m,
   }
 
   output << "|\n";
-  output.flush ();
+
+  if (tdt_flush_policy.time_to_flush ())
+    output.flush ();
 
   return output.good ();
 }
@@ -372,12 +1769,19 @@ preprocess (Molecule & m)
 
 static int
 iwdemerit (data_source_and_type<Molecule> & input,
+           int file_index,
            resizable_array_p<Substructure_Hit_Statistics> & q1,
            resizable_array_p<Substructure_Hit_Statistics> & q2,
-           ofstream & output)
+           ofstream_and_type & output)
 {
   assert (input.good ());
 
+  if (file_index == resume_file_index && ! input.seekg (resume_offset))
+  {
+    cerr << "Cannot seek to checkpoint offset " << resume_offset << endl;
+    return 0;
+  }
+
   Molecule * m;
   while (NULL != (m = input.next_molecule ()))
   {
@@ -393,6 +1797,12 @@ iwdemerit (data_source_and_type<Molecule> & input,
     if (! iwdemerit (*m, q1, q2, output))
       return 0;
 
+    molecule_done ();
+
+    if (checkpoint_file_name.length () && 0 == molecules_read % checkpoint_every &&
+        ! write_checkpoint (file_index, input.tellg (), output, q1, q2))
+      return 0;
+
 #ifdef USE_IWMALLOC
     terse_malloc_status (stderr);
 #endif
@@ -419,44 +1829,189 @@ iwdemerit (data_source_and_type<Molecule> & input,
     }
   }
 
-  return 1;
+  return 1;
+}
+
+/*
+  Hot list to stderr, every query to the -p file
+*/
+
+static int
+do_report_query_profile (resizable_array_p<Substructure_Hit_Statistics> & q1,
+                         resizable_array_p<Substructure_Hit_Statistics> & q2)
+{
+  resizable_array<Substructure_Hit_Statistics *> q;
+
+  for (int i = 0; i < q1.number_elements (); i++)
+  {
+    q.add (q1[i]);
+  }
+  for (int i = 0; i < q2.number_elements (); i++)
+  {
+    q.add (q2[i]);
+  }
+
+  report_query_profile (q, 20, cerr);
+
+  ofstream output (profile_file_name.null_terminated_chars (), ios::out);
+  if (! output.good ())
+  {
+    cerr << "Cannot open query profile file '" << profile_file_name << "'\n";
+    return 0;
+  }
+
+  return write_query_profile (q, output);
+}
+
+static int
+iwdemerit (const char * fname, int input_type, int file_index,
+           resizable_array_p<Substructure_Hit_Statistics> & q1,
+           resizable_array_p<Substructure_Hit_Statistics> & q2)
+{
+  if (file_index < resume_file_index)     // already done before the checkpoint
+    return 1;
+
+  if (0 == input_type)
+  {
+    input_type = discern_file_type_from_name (fname);
+    assert (0 != input_type);
+  }
+
+  data_source_and_type<Molecule> input (input_type, fname);
+  if (! input.ok ())
+  {
+    cerr << prog_name << ": cannot open '" << fname << "'\n";
+    return 1;
+  }
+
+  ofstream_and_type output;
+  
+  if (stem_for_demerit_file.length ())
+  {
+    IWString output_file_name = stem_for_demerit_file;
+
+    change_suffix (output_file_name, "demerit");
+
+    output.open (output_file_name.null_terminated_chars ());
+    if (! output.good ())
+    {
+      cerr << prog_name << ": cannot open '" << output_file_name << "' for output\n";
+      return 2;
+    }
+  }
+
+  set_ofstream_and_type_open_for_append (0);    // only the resumed file appends
+
+  return iwdemerit (input, file_index, q1, q2, output);
+}
+
+//  The file itself, and for a F: file, each of the files it names
+
+static iw_uint64_t
+hash_file_contents (IWString & fname,
+                    iw_uint64_t h)
+{
+  iwstring_data_source input (fname.null_terminated_chars ());
+
+  if (! input.good ())
+    return h;
+
+  const_IWSubstring buffer;
+
+  while (input.next_record (buffer))
+  {
+    h = result_cache_hash (buffer.rawchars (), buffer.length (), h);
+    h = result_cache_hash ("\n", 1, h);
+  }
+
+  return h;
 }
 
-static int
-iwdemerit (const char * fname, int input_type,
-           resizable_array_p<Substructure_Hit_Statistics> & q1,
-           resizable_array_p<Substructure_Hit_Statistics> & q2)
+static iw_uint64_t
+hash_option_value (const const_IWSubstring & v,
+                   iw_uint64_t h)
 {
-  if (0 == input_type)
+  h = result_cache_hash (v.rawchars (), v.length (), h);
+
+  if (! v.starts_with ("F:"))
   {
-    input_type = discern_file_type_from_name (fname);
-    assert (0 != input_type);
+    IWString fname (v);
+    if (dash_f (fname.null_terminated_chars ()))
+      h = hash_file_contents (fname, h);
+
+    return h;
   }
 
-  data_source_and_type<Molecule> input (input_type, fname);
-  if (! input.ok ())
+  IWString fname (v);
+  fname.remove_leading_chars (2);
+
+  h = hash_file_contents (fname, h);
+
+  IWString directory_path;
+  int i = fname.rindex ('/');
+  if (i >= 0)
   {
-    cerr << prog_name << ": cannot open '" << fname << "'\n";
-    return 1;
+    directory_path = fname;
+    directory_path.iwtruncate (i + 1);
   }
 
-  ofstream output;
-  
-  if (stem_for_demerit_file.length ())
+  iwstring_data_source input (fname.null_terminated_chars ());
+  if (! input.good ())
+    return h;
+
+  input.set_strip_leading_blanks (1);
+
+  const_IWSubstring buffer;
+  while (input.next_record (buffer))
   {
-    IWString output_file_name = stem_for_demerit_file;
+    if (0 == buffer.length () || '#' == buffer[0] || buffer.starts_with ("SMARTS:"))
+      continue;
 
-    change_suffix (output_file_name, "demerit");
+    IWString qfile (directory_path);
+    qfile << buffer;
 
-    output.open (output_file_name.null_terminated_chars ());
-    if (! output.good ())
+    h = hash_file_contents (qfile, h);
+  }
+
+  return h;
+}
+
+/*
+  Everything that can change a result: this build, since the hard coded
+  queries are in the code, and every option except those that only say
+  where input comes from or output goes
+*/
+
+static iw_uint64_t
+compute_cache_fingerprint (const Command_Line & cl,
+                           const char * options)
+{
+  iw_uint64_t h = RESULT_CACHE_HASH_SEED;
+
+  const char * version = "iwdemerit " __DATE__ " " __TIME__;
+
+  h = result_cache_hash (version, strlen (version), h);
+
+  const char * not_significant = "ioRGSMYUWQpvdZHF";
+
+  for (int i = 0; options[i]; i++)
+  {
+    const char o = options[i];
+
+    if (':' == o || NULL != strchr (not_significant, o))
+      continue;
+
+    for (int j = 0; j < cl.option_count (o); j++)
     {
-      cerr << prog_name << ": cannot open '" << output_file_name << "' for output\n";
-      return 2;
+      h = result_cache_hash (&o, 1, h);
+
+      const_IWSubstring v = cl.string_value (o, j);
+
+      h = hash_option_value (v, h);
     }
   }
 
-  return iwdemerit (input, q1, q2, output);
+  return h;
 }
 
 static void
@@ -484,6 +2039,15 @@ usage (int rc)
   cerr << "  -N ...         charge assigner specifications, enter '-N help' for info\n";
   cerr << "  -o <type>      file type for structures written\n";
   cerr << "  -i <type>      specify input file type\n";
+  cerr << "  -Y ...         checkpoint and resume long runs, enter '-Y help' for info\n";
+  cerr << "  -U <fname>     write compact per molecule results, for mc_summarise -U\n";
+  cerr << "  -W <stem>      cache results in <stem>.log and <stem>.idx, across runs\n";
+  cerr << "  -Q ...         reuse results for duplicate structures, enter '-Q help' for info\n";
+  cerr << "  -p <fname>     profile each query, most expensive to stderr, all to <fname>\n";
+  cerr << "  -Z ...         adaptive query order, enter '-Z help' for info\n";
+  cerr << "  -F             screen every query with a path fingerprint\n";
+  cerr << "  -H <fname>     write a hit matrix of every rule for mc_rescore, implies -k\n";
+  cerr << "  -P <spec>      also apply profile <spec>, name=,f=,smax=,hmax=,smin=,hmin=,noq,q=,G=,R=\n";
   display_standard_aromaticity_options (cerr);
 #ifdef USE_IWMALLOC
   cerr << "  -d <block>     die when block <block> is allocated\n";
@@ -519,7 +2083,9 @@ separate_depending_on_fragment_match (resizable_array_p<Substructure_Hit_Statist
 int
 iwdemerit (int argc, char ** argv)
 {
-  Command_Line cl (argc, argv, "M:VX:tA:S:R:G:O:kd:Dq:E:vi:o:c:C:N:uyf:xrl");
+  const char * iwdemerit_options = "M:VX:tA:S:R:G:O:kd:Dq:E:vi:o:c:C:N:uyf:xrlY:U:W:Q:p:Z:H:P:F";
+
+  Command_Line cl (argc, argv, iwdemerit_options);
 
   if (cl.unrecognised_options_encountered ())
     usage (1);
@@ -592,8 +2158,8 @@ iwdemerit (int argc, char ** argv)
 
     if (! cl.option_present('x'))
     {
-      lower_atom_count_demerit = f;
-      upper_atom_count_demerit = f;
+      atom_count_demerits.lower_demerit = f;
+      atom_count_demerits.upper_demerit = f;
     }
   }
 
@@ -611,7 +2177,173 @@ iwdemerit (int argc, char ** argv)
     cerr << prog_name << ": cannot discern input type\n";
     usage (2);
   }
-  
+
+  if (cl.option_present ('Y'))
+  {
+    int resume = 0;
+
+    const_IWSubstring y;
+    for (int i = 0; cl.value ('Y', y, i); i++)
+    {
+      if (y.starts_with ("ckpt="))
+      {
+        y.remove_leading_chars (5);
+        checkpoint_file_name = y;
+      }
+      else if (y.starts_with ("every="))
+      {
+        y.remove_leading_chars (6);
+        if (! y.numeric_value (checkpoint_every) || checkpoint_every < 1)
+        {
+          cerr << "The checkpoint interval must be a whole positive number\n";
+          display_checkpoint_options (cerr);
+        }
+      }
+      else if ("resume" == y)
+        resume = 1;
+      else if ("help" == y)
+        display_checkpoint_options (cerr);
+      else
+      {
+        cerr << "Unrecognised -Y qualifier '" << y << "'\n";
+        display_checkpoint_options (cerr);
+      }
+    }
+
+    if (0 == checkpoint_file_name.length ())
+    {
+      cerr << "Must specify checkpoint file via -Y ckpt=<fname>\n";
+      usage (3);
+    }
+
+    for (int i = 0; i < cl.number_elements (); i++)
+    {
+      if (0 == strcmp (cl[i], "-"))
+      {
+        cerr << "Cannot checkpoint when reading from stdin\n";
+        return 3;
+      }
+    }
+
+    if (resume && ! read_checkpoint ())
+    {
+      cerr << "Cannot resume from checkpoint '" << checkpoint_file_name << "'\n";
+      return 3;
+    }
+
+    if (verbose)
+      cerr << "Checkpoint every " << checkpoint_every << " molecules to '" << checkpoint_file_name << "'\n";
+  }
+
+  if (cl.option_present ('U'))
+  {
+    const char * fname = cl.option_value ('U');
+
+    if (! columnar_output.open (fname, resume_file_index >= 0))
+    {
+      cerr << "Cannot open compact results file '" << fname << "'\n";
+      return 4;
+    }
+
+    if (verbose)
+      cerr << "Compact results written to '" << fname << "'\n";
+  }
+
+  if (cl.option_present ('W'))
+  {
+    const char * stem = cl.option_value ('W');
+
+    if (! result_cache.open (stem, compute_cache_fingerprint (cl, iwdemerit_options)))
+    {
+      cerr << "Cannot open result cache '" << stem << "'\n";
+      return 4;
+    }
+
+    if (verbose)
+      cerr << "Results cached in '" << stem << "'\n";
+  }
+
+  if (cl.option_present ('p'))
+  {
+    cl.value ('p', profile_file_name);
+
+    set_substructure_search_profiling (1);
+
+    if (verbose)
+      cerr << "Query profile written to '" << profile_file_name << "'\n";
+  }
+
+  if (cl.option_present ('F'))
+  {
+    set_use_fingerprints_for_screening_substructure_searches (1);
+
+    if (verbose)
+      cerr << "Queries screened by path fingerprints\n";
+  }
+
+  if (cl.option_present ('Q'))
+  {
+    int mb = 256;
+
+    const_IWSubstring q;
+    for (int i = 0; cl.value ('Q', q, i); i++)
+    {
+      if ("smiles" == q)
+        dedup_raw_smiles = 1;
+      else if ("usmi" == q)
+        dedup_unique_smiles = 1;
+      else if (q.starts_with ("mb="))
+      {
+        q.remove_leading_chars (3);
+        if (! q.numeric_value (mb) || mb < 1)
+        {
+          cerr << "The memory budget for duplicates must be a whole positive number of MB\n";
+          display_dedup_options (cerr);
+        }
+      }
+      else if ("help" == q)
+        display_dedup_options (cerr);
+      else
+      {
+        cerr << "Unrecognised -Q qualifier '" << q << "'\n";
+        display_dedup_options (cerr);
+      }
+    }
+
+    if (0 == dedup_raw_smiles && 0 == dedup_unique_smiles)
+      dedup_raw_smiles = dedup_unique_smiles = 1;
+
+    memory_cache.set_budget (static_cast<size_t> (mb) * 1024 * 1024);
+
+    if (verbose)
+      cerr << "Results of duplicate structures reused, up to " << mb << " MB\n";
+  }
+
+  if (cl.option_present ('H'))
+  {
+    const char * fname = cl.option_value ('H');
+
+    if (cl.option_present ('Y') || result_cache.active () || memory_cache.active ())
+    {
+      cerr << "A hit matrix (-H) cannot be combined with -Y, -W or -Q\n";
+      usage (4);
+    }
+
+    if (! hit_matrix.open (fname, IWHM_KIND_DEMERITS))
+    {
+      cerr << "Cannot open hit matrix '" << fname << "'\n";
+      return 4;
+    }
+
+//  Every rule must be evaluated for every molecule
+
+    keep_going_after_rejection = 1;
+    substructure_demerits::set_keep_going_after_rejection (1);
+
+    if (verbose)
+      cerr << "Hit matrix written to '" << fname << "', all rules checked\n";
+  }
+
   if (cl.option_present ('R'))
   {
     const_IWSubstring fname;
@@ -730,80 +2462,15 @@ iwdemerit (int argc, char ** argv)
     const_IWSubstring c;
     while (cl.value ('c', c, i++))
     {
-      const_IWSubstring directive;
-      int dvalue;
-      if (! c.split_into_directive_and_value (directive, '=', dvalue))
+      if (! atom_count_demerits.parse_directive (c))
       {
         cerr << "Invalid -c directive '" << c << "'\n";
         usage (5);
       }
-
-      if (dvalue < 0)
-      {
-        cerr << "INvalid numeric directive, cannot be negative '" << c << "'\n";
-        usage (6);
-      }
-
-      if ("hmin" == directive)
-      {
-        hard_lower_atom_count_cutoff = dvalue;
-      }
-      else if ("smin" == directive)
-      {
-        soft_lower_atom_count_cutoff = dvalue;
-      }
-      else if ("mindmrt" == directive)
-      {
-      }
-      else if ("smax" == directive)
-      {
-        soft_upper_atom_count_cutoff = dvalue;
-      }
-      else if ("hmax" == directive)
-      {
-        hard_upper_atom_count_cutoff = dvalue;
-      }
-      else if ("maxdmrt" == directive)
-      {
-      }
-      else
-      {
-        cerr << "Unrecognised -c qualifier '" << c << "'\n";
-        usage (5);
-      }
     }
 
-    if (0 == soft_lower_atom_count_cutoff && 0 == hard_lower_atom_count_cutoff)
-      ;
-    else if (hard_lower_atom_count_cutoff <= soft_lower_atom_count_cutoff)
-      ;
-    else
-    {
-      cerr << "Invalid lower atom count cutoff values soft:" << soft_lower_atom_count_cutoff << " hard:" << hard_lower_atom_count_cutoff << endl;
-      return 5;
-    }
-
-    if (0 == soft_upper_atom_count_cutoff && 0 == hard_upper_atom_count_cutoff)
-      ;
-    else if (soft_upper_atom_count_cutoff < hard_upper_atom_count_cutoff)
-      ;
-    else
-    {
-      cerr << "Invalid upper atom count cutoff values soft:" << soft_upper_atom_count_cutoff << " hard:" << hard_upper_atom_count_cutoff << endl;
+    if (! atom_count_demerits.ok (cerr))
       return 5;
-    }
-
-    if (0 == soft_lower_atom_count_cutoff && 0 == soft_upper_atom_count_cutoff)
-      ;
-    else if (soft_lower_atom_count_cutoff < soft_upper_atom_count_cutoff)
-      ;
-    else
-    {
-      cerr << "Soft cutoffs invalid, lower:" << soft_lower_atom_count_cutoff << " upper:" << soft_upper_atom_count_cutoff << endl;
-      return 8;
-    }
-
-//  Should do more checks here...
   }
 
   if (! process_standard_smiles_options (cl, verbose))
@@ -825,6 +2492,48 @@ iwdemerit (int argc, char ** argv)
     substructure_demerits::set_keep_going_after_rejection (1);
   }
 
+  if (cl.option_present ('Z'))
+  {
+    const_IWSubstring z;
+    for (int i = 0; cl.value ('Z', z, i); i++)
+    {
+      if ("help" == z)
+      {
+        display_query_scheduler_options (cerr, 'Z');
+        exit (0);
+      }
+
+      if (! q1_scheduler.parse_directive (z) || ! q2_scheduler.parse_directive (z))
+      {
+        cerr << "Unrecognised -Z qualifier '" << z << "'\n";
+        display_query_scheduler_options (cerr, 'Z');
+        usage (3);
+      }
+    }
+
+    if (keep_going_after_rejection)
+    {
+      cerr << "Every query is run with -k, -Z ignored\n";
+      q1_scheduler.set_active (0);
+      q2_scheduler.set_active (0);
+    }
+    else
+    {
+      if (stem_for_demerit_file.length () || columnar_output.is_open () ||
+          result_cache.active () || memory_cache.active () || verbose > 1 ||
+          stream_for_multiple_demerits.number_elements () ||
+          (append_demerit_text_to_name && stream_for_rejected_molecules.number_elements ()))
+        scheduler_file_order_reason = 1;
+
+      if (verbose)
+      {
+        cerr << "Queries most likely to reject tried first\n";
+        if (scheduler_file_order_reason)
+          cerr << "Rejection reasons written, queries searched as needed to give the reason in file order\n";
+      }
+    }
+  }
+
   if (cl.option_present ('O'))
   {
     IWString tmp;
@@ -871,34 +2580,53 @@ iwdemerit (int argc, char ** argv)
       return 8;
     }
 
-    for (int i = 0; i < queries.number_elements (); i++)
-    {
-      Substructure_Hit_Statistics * q = queries[i];
+    if (! queries_have_demerits (queries, 0))
+      return 13;
+  }
 
-      q->set_find_unique_embeddings_only (1);
+  if (cl.option_present ('P'))
+  {
+    if (cl.option_present ('l') || checkpoint_file_name.length ())
+    {
+      cerr << "Profiles (-P) cannot be used with -l or -Y\n";
+      usage (3);
+    }
 
-      for (int j = 0; j < q->number_elements (); j++)
+    const_IWSubstring p;
+    for (int i = 0; cl.value ('P', p, i); i++)
+    {
+      Demerit_Profile * t = new Demerit_Profile;
+      if (! t->build (cl, p))
       {
-        const Single_Substructure_Query * sq = q->item (j);
-
-        double d;
-        if (! sq->numeric_value (d))
-        {
-          cerr << "Yipes, query '" << q->comment () << " has no demerit value\n";
-          return 13;
-        }
-  
-        if (d <= 0.0)
-        {
-          cerr << "Hmmm, query '" << q->comment () << "' has a non-positive demerit " << d << endl;
-          return 14;
-        }
+        cerr << "Invalid profile specification '" << p << "'\n";
+        delete t;
+        return 3;
       }
+
+      profiles.add (t);
+
+      if (verbose)
+        cerr << "Profile '" << t->name () << "' applied\n";
     }
+
+    query_hits.extend (queries.number_elements () + profile_queries.number_elements (), -1);
+
+//  Hard coded rules are evaluated once, and replayed for each profile
+
+    if (do_hard_coded_substructure_queries)
+      share_hard_coded_rules = 1;
   }
 
   set_remove_hits_not_in_largest_fragment_behaviour(1);    // to get reproducible behaviour with multiple instances of largest fragment
 
+  if (checkpoint_file_name.length ())
+  {
+    if (! ok_for_checkpointing (stream_for_rejected_molecules, "R") ||
+        ! ok_for_checkpointing (stream_for_non_rejected_molecules, "G") ||
+        ! ok_for_checkpointing (stream_for_multiple_demerits, "M"))
+      return 3;
+  }
+
   int rc = 0;
 
   if (cl.option_present('l'))
@@ -906,6 +2634,18 @@ iwdemerit (int argc, char ** argv)
     resizable_array_p<Substructure_Hit_Statistics> q1, q2;
     separate_depending_on_fragment_match(queries, q1, q2);
 
+    if (checkpoint_records.number_elements () && ! restore_checkpoint_counters (q1, q2))
+      return 3;
+
+    if (! initialise_scheduler (q1_scheduler, q1) || ! initialise_scheduler (q2_scheduler, q2))
+      return 3;
+
+    if (hit_matrix.is_open ())
+    {
+      add_hit_matrix_columns (q1, IWHM_COLUMN_QUERY);
+      add_hit_matrix_columns (q2, IWHM_COLUMN_LARGEST_FRAGMENT_QUERY);
+    }
+
     for (int i = 0; i < cl.number_elements(); i++)
     {
       const char *fname = cl[i];
@@ -913,17 +2653,34 @@ iwdemerit (int argc, char ** argv)
       if (verbose)
         cerr << prog_name << " processing '" << fname << "'\n";
 
-      if (! iwdemerit (fname, input_type, q1, q2))
+      if (! iwdemerit (fname, input_type, i, q1, q2))
       {
         rc = i + 1;
         break;
       }
     }
+
+    if (profile_file_name.length () && ! do_report_query_profile (q1, q2))
+      rc = cl.number_elements () + 1;
+
+    if (verbose && q1_scheduler.initialised ())
+      q1_scheduler.report (q1, cerr);
+    if (verbose && q2_scheduler.initialised ())
+      q2_scheduler.report (q2, cerr);
   }
   else
   {
     resizable_array_p<Substructure_Hit_Statistics> notused;
 
+    if (checkpoint_records.number_elements () && ! restore_checkpoint_counters (queries, notused))
+      return 3;
+
+    if (! initialise_scheduler (q1_scheduler, queries))
+      return 3;
+
+    if (hit_matrix.is_open ())
+      add_hit_matrix_columns (queries, IWHM_COLUMN_QUERY);
+
     for (int i = 0; i < cl.number_elements (); i++)     // each argument is a file
     {
       const char *fname = cl[i];
@@ -931,14 +2688,58 @@ iwdemerit (int argc, char ** argv)
       if (verbose)
         cerr << prog_name << " processing '" << fname << "'\n";
 
-      if (! iwdemerit (fname, input_type, queries, notused))
+      if (! iwdemerit (fname, input_type, i, queries, notused))
       {
         rc = i + 1;
         break;
       }
     }
+
+    if (profile_file_name.length () && ! do_report_query_profile (queries, notused))
+      rc = cl.number_elements () + 1;
+
+    if (verbose && q1_scheduler.initialised ())
+      q1_scheduler.report (queries, cerr);
+  }
+
+  if (verbose)
+  {
+    for (int i = 0; i < profiles.number_elements (); i++)
+    {
+      profiles[i]->report (cerr);
+    }
+  }
+
+  if (verbose && memory_cache.active ())
+    memory_cache.report (cerr);
+
+  if (result_cache.active ())
+  {
+    if (verbose)
+      result_cache.report (cerr);
+
+    if (! result_cache.close ())
+    {
+      cerr << "Error closing result cache\n";
+      rc = cl.number_elements () + 1;
+    }
+  }
+
+  if (hit_matrix.is_open () && ! hit_matrix.close ())
+  {
+    cerr << "Error writing hit matrix\n";
+    rc = cl.number_elements () + 1;
   }
 
+  if (columnar_output.is_open () && ! columnar_output.close ())
+  {
+    cerr << "Error writing compact results file\n";
+    rc = cl.number_elements () + 1;
+  }
+
+  if (0 == rc && checkpoint_file_name.length ())
+    unlink (checkpoint_file_name.null_terminated_chars ());
+
   if (verbose)
   {
     if (cl.number_elements () > 1)
@@ -286,6 +286,13 @@ typedef unsigned int atom_invariant_type_t;
 
 #define IWMTYPE_TDT_NAUSMI 26
 
+/*
+  Oct 2026. Binary connection tables for passing molecules between
+  programs in a pipeline, see iwb.cc
+*/
+
+#define IWMTYPE_IWB 27
+
 /*enum 
 {
   FILE_TYPE_INVALID,
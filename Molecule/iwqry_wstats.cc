@@ -26,10 +26,26 @@
 #endif
 
 #include <iostream>
+#include <time.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "qry_wstats.h"
 #include "target.h"
 
+iw_uint64_t
+substructure_search_cycles ()
+{
+#if defined (__x86_64__) || defined (__i386__)
+  return __rdtsc ();
+#else
+  struct timespec t;
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return static_cast<iw_uint64_t> (t.tv_sec) * 1000000000 + t.tv_nsec;
+#endif
+}
+
 void
 
 Substructure_Hit_Statistics::_default_values ()
@@ -44,6 +60,13 @@ Substructure_Hit_Statistics::_default_values ()
 
    _use_vertical_bars_for_query_details = 0;
 
+  _searches = 0;
+  _cycles = 0;
+  _max_cycles = 0;
+  _embeddings_found = 0;
+  _backtrack_steps = 0;
+  _environment_cycles = 0;
+
   return;
 }
 
@@ -122,12 +145,66 @@ Substructure_Hit_Statistics::report (ostream & os, int verbose) const
   if (_molecules_which_do_not_match && _stream_for_non_matches.valid ())
     os << " Non matches written to '" << _stream_for_non_matches.fname () << "'\n";
 
+  if (_searches)
+  {
+    os << ' ';
+    report_profile (os, substructure_search_cycles_per_second ());
+    os << '\n';
+  }
+
   if (verbose)
     print_environment_matches (os);
 
   return os.good ();
 }
 
+/*
+  Matches, non matches, then the number of molecules matching 0, 1, 2 ... times
+*/
+
+int
+Substructure_Hit_Statistics::write_hit_counts (ostream & os) const
+{
+  os << _molecules_which_match << ' ' << _molecules_which_do_not_match;
+
+  for (int i = 0; i < _molecules_which_match_n_times.number_elements (); i++)
+  {
+    os << ' ' << _molecules_which_match_n_times[i];
+  }
+
+  return os.good ();
+}
+
+int
+Substructure_Hit_Statistics::restore_hit_counts (const const_IWSubstring & buffer)
+{
+  int i = 0;
+  const_IWSubstring token;
+
+  if (! buffer.nextword (token, i) || ! token.numeric_value (_molecules_which_match) ||
+      ! buffer.nextword (token, i) || ! token.numeric_value (_molecules_which_do_not_match))
+  {
+    cerr << "Substructure_Hit_Statistics::restore_hit_counts:invalid counts '" << buffer << "'\n";
+    return 0;
+  }
+
+  _molecules_which_match_n_times.resize_keep_storage (0);
+
+  for (int n = 0; buffer.nextword (token, i); n++)
+  {
+    int c;
+    if (! token.numeric_value (c) || c < 0)
+    {
+      cerr << "Substructure_Hit_Statistics::restore_hit_counts:invalid count '" << token << "'\n";
+      return 0;
+    }
+
+    _molecules_which_match_n_times[n] = c;
+  }
+
+  return 1;
+}
+
 int
 Substructure_Hit_Statistics::_set_stream (int output_type, const char * fname,
                                           ofstream_and_type & stream_for)
@@ -227,12 +304,42 @@ Substructure_Hit_Statistics::_update_name_if_needed (int nmatches, Molecule * m)
   return 1;
 }
 
+int
+Substructure_Hit_Statistics::_profiled_search (Molecule_to_Match & target,
+                                               Substructure_Results & results)
+{
+  const Substructure_Search_Counters c0 = substructure_search_counters;
+
+  const iw_uint64_t t0 = substructure_search_cycles ();
+
+  const int nmatches = Substructure_Query::substructure_search (target, results);
+
+  const iw_uint64_t t = substructure_search_cycles () - t0;
+
+  _searches++;
+  _cycles += t;
+  if (t > _max_cycles)
+    _max_cycles = t;
+  _embeddings_found += nmatches;
+  _backtrack_steps += substructure_search_counters._backtrack_steps - c0._backtrack_steps;
+  _environment_cycles += substructure_search_counters._environment_cycles - c0._environment_cycles;
+
+  return nmatches;
+}
+
 int
 Substructure_Hit_Statistics::substructure_search (Molecule * m)
 {
   Substructure_Results sresults;
 
-  int nmatches = Substructure_Query::substructure_search (m, sresults);
+  int nmatches;
+  if (substructure_search_profiling ())
+  {
+    Molecule_to_Match target (m);
+    nmatches = _profiled_search (target, sresults);
+  }
+  else
+    nmatches = Substructure_Query::substructure_search (m, sresults);
 
   _update_matches (nmatches, m, sresults);
 
@@ -269,7 +376,11 @@ int
 Substructure_Hit_Statistics::substructure_search (Molecule_to_Match & m,
                                                   Substructure_Results & results)
 {
-  int nmatches = Substructure_Query::substructure_search (m, results);
+  int nmatches;
+  if (substructure_search_profiling ())
+    nmatches = _profiled_search (m, results);
+  else
+    nmatches = Substructure_Query::substructure_search (m, results);
 
   _update_matches (nmatches, m.molecule (), results);
 
@@ -278,6 +389,19 @@ Substructure_Hit_Statistics::substructure_search (Molecule_to_Match & m,
   return nmatches;
 }
 
+int
+Substructure_Hit_Statistics::no_match (Molecule_to_Match & m,
+                                       Substructure_Results & results)
+{
+  results.initialise (m.natoms ());
+
+  _update_matches (0, m.molecule (), results);
+
+  _update_name_if_needed (0, m.molecule ());
+
+  return 0;
+}
+
 /*
   By one of our substructure_search interfaces, we have NMATCHES hits for
   molecule M
@@ -333,3 +457,97 @@ Substructure_Hit_Statistics::_update_matches (int nmatches,
 }
 
 
+
+int
+Substructure_Hit_Statistics::report_profile (ostream & os,
+                                             double cycles_per_second) const
+{
+  os << _searches << " searches, " << (static_cast<double> (_cycles) / cycles_per_second) << " sec, max " <<
+        (static_cast<double> (_max_cycles) / cycles_per_second * 1.0e+06) << " usec, " <<
+        _embeddings_found << " embeddings, " << _backtrack_steps << " backtracks, " <<
+        (static_cast<double> (_environment_cycles) / cycles_per_second) << " sec in environments";
+
+  return os.good ();
+}
+
+int
+Substructure_Hit_Statistics::write_profile (ostream & os,
+                                            double cycles_per_second) const
+{
+  os << _searches << '\t' << _cycles << '\t' << (static_cast<double> (_cycles) / cycles_per_second) << '\t' <<
+        _max_cycles << '\t' << _molecules_which_match << '\t' << _embeddings_found << '\t' <<
+        _backtrack_steps << '\t' << _environment_cycles << '\t' << comment ();
+
+  return os.good ();
+}
+
+static int
+compare_profile_cycles (Substructure_Hit_Statistics * const * pq1,
+                        Substructure_Hit_Statistics * const * pq2)
+{
+  const iw_uint64_t c1 = (*pq1)->profile_cycles ();
+  const iw_uint64_t c2 = (*pq2)->profile_cycles ();
+
+  if (c1 > c2)
+    return -1;
+  if (c1 < c2)
+    return 1;
+
+  return 0;
+}
+
+int
+report_query_profile (resizable_array<Substructure_Hit_Statistics *> & queries,
+                      int nshow,
+                      ostream & os)
+{
+  const double cps = substructure_search_cycles_per_second ();
+
+  resizable_array<Substructure_Hit_Statistics *> sorted;
+  sorted.copy (queries);
+  sorted.sort (compare_profile_cycles);
+
+  iw_uint64_t total = 0;
+  for (int i = 0; i < sorted.number_elements (); i++)
+  {
+    total += sorted[i]->profile_cycles ();
+  }
+
+  os << "Query search time " << (static_cast<double> (total) / cps) << " sec, most expensive queries\n";
+
+  if (nshow > sorted.number_elements ())
+    nshow = sorted.number_elements ();
+
+  for (int i = 0; i < nshow; i++)
+  {
+    const Substructure_Hit_Statistics * q = sorted[i];
+
+    float fraction = 0.0f;
+    if (total > 0)
+      fraction = static_cast<float> (q->profile_cycles ()) / static_cast<float> (total);
+
+    os << ' ' << fraction << " '" << q->comment () << "' ";
+    q->report_profile (os, cps);
+    os << '\n';
+  }
+
+  return os.good ();
+}
+
+int
+write_query_profile (resizable_array<Substructure_Hit_Statistics *> & queries,
+                     ostream & os)
+{
+  const double cps = substructure_search_cycles_per_second ();
+
+  os << "# " << cps << " cycles per second\n";
+  os << "searches\tcycles\tseconds\tmax_cycles\tmolecules_matched\tembeddings\tbacktracks\tenvironment_cycles\tquery\n";
+
+  for (int i = 0; i < queries.number_elements (); i++)
+  {
+    queries[i]->write_profile (os, cps);
+    os << '\n';
+  }
+
+  return os.good ();
+}
@@ -225,6 +225,12 @@ set_smiles_ring_number_offset (int s)
   return;
 }
 
+int
+smiles_ring_number_offset ()
+{
+  return ring_number_offset;
+}
+
 static char single_digit[10] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
 
 //#define DEBUG_APPEND_RING_CLOSURE_DIGITS
@@ -18,6 +18,7 @@
 **************************************************************************/
 #include <stdlib.h>
 #include <assert.h>
+#include <time.h>
 #include <iomanip>
 #include <memory>
 using namespace std;
@@ -52,6 +53,50 @@ set_use_fingerprints_for_screening_substructure_searches (int s)
   _use_fingerprints_for_screening_substructure_searches = s;
 }
 
+thread_local Substructure_Search_Counters substructure_search_counters = {0, 0};
+
+static int _substructure_search_profiling = 0;
+
+static iw_uint64_t profiling_start_cycles = 0;
+static struct timespec profiling_start_time;
+
+int
+substructure_search_profiling ()
+{
+  return _substructure_search_profiling;
+}
+
+void
+set_substructure_search_profiling (int s)
+{
+  _substructure_search_profiling = s;
+
+  if (s)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &profiling_start_time);
+    profiling_start_cycles = substructure_search_cycles ();
+  }
+
+  return;
+}
+
+double
+substructure_search_cycles_per_second ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+
+  const iw_uint64_t cycles = substructure_search_cycles () - profiling_start_cycles;
+
+  const double seconds = static_cast<double> (now.tv_sec - profiling_start_time.tv_sec) +
+                         static_cast<double> (now.tv_nsec - profiling_start_time.tv_nsec) * 1.0e-09;
+
+  if (seconds <= 0.0 || 0 == cycles)
+    return 1.0e+09;
+
+  return static_cast<double> (cycles) / seconds;
+}
+
 static int running_in_valhalla = 0;
 
 void
@@ -1324,7 +1369,18 @@ Single_Substructure_Query::_got_embedding (Query_Atoms_Matched & matched_atoms,
 
   _matches_before_checking_environment++;
 
-  if (! _query_environment_also_matched (matched_atoms, target_molecule.natoms ()))
+  if (_substructure_search_profiling)
+  {
+    const iw_uint64_t t0 = substructure_search_cycles ();
+
+    const int env = _query_environment_also_matched (matched_atoms, target_molecule.natoms ());
+
+    substructure_search_counters._environment_cycles += substructure_search_cycles () - t0;
+
+    if (! env)
+      return 0;
+  }
+  else if (! _query_environment_also_matched (matched_atoms, target_molecule.natoms ()))
     return 0;
 
 #ifdef DEBUG_GOT_EMBEDDING
@@ -1506,6 +1562,9 @@ Single_Substructure_Query::_find_embedding (Molecule_to_Match & target_molecule,
       cerr << "Move to next failed for atom " << a->unique_id () << endl;
 #endif
 
+      if (_substructure_search_profiling)
+        substructure_search_counters._backtrack_steps++;
+
       a->remove_your_children (matched_atoms, already_matched);
       if (a->or_id () && atom_to_process < matched_atoms.number_elements () - 1 &&
           a->or_id () == matched_atoms[atom_to_process + 1]->or_id ())
@@ -1694,6 +1753,156 @@ Single_Substructure_Query::_substructure_search (Molecule_to_Match & target_mole
   return rc;
 }
 
+/*
+  The query atoms any match must use, with the index of their parent
+*/
+
+static void
+add_mandatory_atoms (const Substructure_Atom * a, int parent,
+                     resizable_array<const Substructure_Atom *> & atoms,
+                     resizable_array<int> & parent_of)
+{
+  int me = atoms.number_elements ();
+
+  atoms.add (a);
+  parent_of.add (parent);
+
+  for (int i = 0; i < a->number_children (); i++)
+  {
+    const Substructure_Atom * c = a->child (i);
+    if (0 == c->or_id ())
+      add_mandatory_atoms (c, me, atoms, parent_of);
+  }
+
+  return;
+}
+
+/*
+  Extend the path ending at query atom A by every neighbour whose element
+  is known
+*/
+
+static void
+add_query_paths (const resizable_array<int> & parent_of,
+                 const atomic_number_t * zatom,
+                 atomic_number_t * z,
+                 int * on_path,
+                 int n,
+                 int a,
+                 IW_Bits_Base & fp)
+{
+  z[n] = zatom[a];
+  n++;
+
+  fp.set (path_fingerprint_bit (z, n));
+
+  if (PATH_FINGERPRINT_MAX_ATOMS == n)
+    return;
+
+  on_path[a] = 1;
+
+  int na = parent_of.number_elements ();
+  for (int i = 0; i < na; i++)
+  {
+    if (on_path[i] || zatom[i] < 0)
+      continue;
+
+    if (parent_of[a] == i || parent_of[i] == a)
+      add_query_paths (parent_of, zatom, z, on_path, n, i, fp);
+  }
+
+  on_path[a] = 0;
+
+  return;
+}
+
+/*
+  Oct 2026. Set bits for the paths through mandatory atoms whose element
+  is known. As with required_elements, nothing is built for queries that
+  can match without matching atoms, nor with link atoms, which stand in
+  for bonds
+*/
+
+int
+Single_Substructure_Query::_build_path_fingerprint ()
+{
+  if (NULL != _fingerprint)
+    return 1;
+
+  if (_rejection || _link_atom.number_elements ())
+    return 0;
+
+  if (_hits_needed.is_set () && _hits_needed.matches (0))
+    return 0;
+
+  resizable_array<const Substructure_Atom *> atoms;
+  resizable_array<int> parent_of;
+
+  for (int i = 0; i < _root_atoms.number_elements (); i++)
+  {
+    add_mandatory_atoms (_root_atoms[i], -1, atoms, parent_of);
+  }
+
+  int na = atoms.number_elements ();
+  if (0 == na)
+    return 0;
+
+  atomic_number_t * zatom = new atomic_number_t[na]; iw_auto_array<atomic_number_t> free_zatom (zatom);
+  int * on_path = new_int (na); iw_auto_array<int> free_on_path (on_path);
+
+  IW_Bits_Base * fp = new IW_Bits_Base (PATH_FINGERPRINT_NBITS);
+
+  for (int i = 0; i < na; i++)
+  {
+    if (! atoms[i]->required_atomic_number (zatom[i]))
+      zatom[i] = -1;
+  }
+
+  atomic_number_t z[PATH_FINGERPRINT_MAX_ATOMS];
+
+  for (int i = 0; i < na; i++)
+  {
+    if (zatom[i] >= 0)
+      add_query_paths (parent_of, zatom, z, on_path, 0, i, *fp);
+  }
+
+  if (0 == fp->nset ())
+  {
+    delete fp;
+    return 0;
+  }
+
+  _fingerprint = fp;
+
+  return 1;
+}
+
+/*
+  Nothing can be required of a rejection, or of a query that is satisfied
+  by zero hits
+*/
+
+int
+Single_Substructure_Query::required_elements (int * count) const
+{
+  if (_rejection)
+    return 0;
+
+  if (_hits_needed.is_set () && _hits_needed.matches (0))
+    return 0;
+
+  int nr = _root_atoms.number_elements ();
+  if (0 == nr)
+    return 0;
+
+  for (int i = 0; i < nr; i++)
+  {
+    _root_atoms[i]->required_elements (count);
+  }
+
+  return 1;
+}
+
 int
 Single_Substructure_Query::_match_elements_needed (Molecule_to_Match & target_molecule) const
 {
@@ -2050,13 +2259,11 @@ Single_Substructure_Query::substructure_search (Molecule_to_Match & target_molec
 
   results.initialise (matoms);     // no returns before this.
 
-  if (NULL == _fingerprint)
-    ;
-  else if (! target_molecule.is_superset (*_fingerprint))
-    return 0;
-
   if (_need_to_compute_aromaticity < 0)    // first time this query has been invoked
   {
+    if (_use_fingerprints_for_screening_substructure_searches)
+      _build_path_fingerprint ();
+
     if (running_in_valhalla)
     {
       _need_to_compute_aromaticity = 0;
@@ -2090,6 +2297,11 @@ Single_Substructure_Query::substructure_search (Molecule_to_Match & target_molec
   if (matoms < _min_atoms_in_query)
     return 0;     
 
+  if (NULL == _fingerprint)
+    ;
+  else if (! target_molecule.is_superset (*_fingerprint))
+    return 0;
+
 // If 2 == aromatic_bonds_lose_kekule_identity(), we need a temporary array
 // of bond types. Even if the query doesn't specify aromatic bonds, we
 // need to convert aromatic rings so they match single bonds
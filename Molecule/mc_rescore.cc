@@ -0,0 +1,623 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+/*
+  Oct 2026. Re-apply the rules to a hit matrix written by iwdemerit -H
+  or tsubstructure -M hitmatrix=, with different thresholds, atom count
+  cutoffs, weights or rules, without doing any substructure searches
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#define RESIZABLE_ARRAY_IMPLEMENTATION
+
+#include "cmdline.h"
+#include "iwcrex.h"
+#include "iw_stl_hash_map.h"
+
+#include "hit_matrix.h"
+#include "demerit.h"
+#include "demerit_columnar.h"
+
+const char * prog_name = NULL;
+
+static int verbose = 0;
+
+static int molecules_read = 0;
+static int molecules_rejected = 0;
+
+static int soft_lower_atom_count_cutoff = 0;
+static int hard_lower_atom_count_cutoff = 0;
+static int lower_atom_count_demerit = 100;
+
+static int soft_upper_atom_count_cutoff = 0;
+static int hard_upper_atom_count_cutoff = 0;
+static int upper_atom_count_demerit = 100;
+
+static int skip_molecules_with_abnormal_valences = 0;
+static int molecules_with_abnormal_valences = 0;
+
+/*
+  With -r only the hard coded rules are applied. Those iwdemerit -r
+  suppresses are in the matrix unless it was also written with -r
+*/
+
+static int hard_coded_rules_only = 0;
+
+static int append_demerit_text_to_name = 0;
+
+/*
+  Rules removed with -O, by name or by regular expression
+*/
+
+static IW_STL_Hash_Map_int omit_rule;
+static resizable_array_p<IW_Regular_Expression> omit_rule_rx;
+
+/*
+  Weights changed with -w, by query name
+*/
+
+static IW_STL_Hash_Map<IWString, double> new_weight;
+
+/*
+  Per column, whether it is used, and its weight
+*/
+
+static int * column_active = NULL;
+static double * column_weight = NULL;
+static int columns_set = 0;
+
+static IWString_and_File_Descriptor good_output, bad_output;
+
+static Demerit_Columnar_Writer columnar;
+
+static void
+usage (int rc)
+{
+  cerr << __FILE__ << " compiled " << __DATE__ << " " << __TIME__ << endl;
+  cerr << "Rescores a hit matrix from 'iwdemerit -H' or 'tsubstructure -M hitmatrix='\n";
+  cerr << prog_name << " <options> <hit matrix>\n";
+  cerr << " -f <n>         rejection threshold (default 100)\n";
+  cerr << " -x             atom count demerits are 100 regardless of -f\n";
+  cerr << " -c smin=<n>    soft lower atom count cutoff\n";
+  cerr << " -c hmin=<n>    hard lower atom count cutoff\n";
+  cerr << " -c smax=<n>    soft upper atom count cutoff\n";
+  cerr << " -c hmax=<n>    hard upper atom count cutoff\n";
+  cerr << " -V             reject molecules with abnormal valences\n";
+  cerr << " -r             only apply the hard coded rules, no queries\n";
+  cerr << " -O <name>      omit rule <name>, or all rules matching -O RX=<regex>\n";
+  cerr << " -w name=<d>    change the demerit of query <name> to <d>\n";
+  cerr << " -G <stem>      write molecules that pass to <stem>.smi, '-' for stdout\n";
+  cerr << " -R <stem>      write rejected molecules to <stem>.smi\n";
+  cerr << " -t             append demerit text to names\n";
+  cerr << " -U <fname>     write compact results, see demerit_columnar.h\n";
+  cerr << " -v             verbose output\n";
+
+  exit (rc);
+}
+
+static int
+rule_omitted (const IWString & name)
+{
+  if (omit_rule.contains (name))
+    return 1;
+
+  for (int i = 0; i < omit_rule_rx.number_elements (); i++)
+  {
+    if (omit_rule_rx[i]->matches (name))
+      return 1;
+  }
+
+  return 0;
+}
+
+/*
+  Columns can be added by any block, so the per column arrays are
+  extended as new ones appear
+*/
+
+static int
+set_columns (const Hit_Matrix_Reader & hm)
+{
+  const int ncol = hm.number_columns ();
+
+  if (ncol <= columns_set)
+    return 1;
+
+  int * a = new int[ncol];
+  double * w = new double[ncol];
+
+  for (int i = 0; i < columns_set; i++)
+  {
+    a[i] = column_active[i];
+    w[i] = column_weight[i];
+  }
+
+  for (int i = columns_set; i < ncol; i++)
+  {
+    const IWString & name = hm.column_name (i);
+
+    a[i] = ! rule_omitted (name);
+    if (hard_coded_rules_only && IWHM_COLUMN_HARD_CODED != hm.column_type (i))
+      a[i] = 0;
+
+    IW_STL_Hash_Map<IWString, double>::const_iterator f = new_weight.find (name);
+    if (f == new_weight.end ())
+      w[i] = hm.column_weight (i);
+    else
+      w[i] = (*f).second;
+
+    if (verbose > 1)
+      cerr << "Column " << i << " '" << name << "' weight " << w[i] << " active " << a[i] << endl;
+  }
+
+  if (NULL != column_active)
+  {
+    delete [] column_active;
+    delete [] column_weight;
+  }
+
+  column_active = a;
+  column_weight = w;
+  columns_set = ncol;
+
+  return 1;
+}
+
+/*
+  Same as do_atom_count_demerits in iwdemerit
+*/
+
+static void
+do_atom_count_demerits (int matoms,
+                        Demerit & demerit)
+{
+  if (hard_lower_atom_count_cutoff > 0 && matoms <= hard_lower_atom_count_cutoff)
+  {
+    demerit.extra (lower_atom_count_demerit, "too_few_atoms");
+    return;
+  }
+
+  if (hard_upper_atom_count_cutoff > 0 && matoms >= hard_upper_atom_count_cutoff)
+  {
+    demerit.extra (rejection_threshold () + 6 * (matoms - hard_upper_atom_count_cutoff), "too_many_atoms");
+    return;
+  }
+
+  if (matoms > hard_lower_atom_count_cutoff && matoms < soft_lower_atom_count_cutoff)
+  {
+    float r = static_cast<float> (soft_lower_atom_count_cutoff - matoms) / static_cast<float> (soft_lower_atom_count_cutoff - hard_lower_atom_count_cutoff);
+    int d = static_cast<int> (lower_atom_count_demerit * r);
+
+    if (0 == d)
+      d = 1;
+
+    demerit.extra (d, "too_few_atoms");
+    return;
+  }
+
+  if (matoms > soft_upper_atom_count_cutoff && matoms < hard_upper_atom_count_cutoff)
+  {
+    float r = static_cast<float> (matoms - soft_upper_atom_count_cutoff) / static_cast<float> (hard_upper_atom_count_cutoff - soft_upper_atom_count_cutoff);
+    int d = static_cast<int> (upper_atom_count_demerit * r);
+
+    if (0 == d)
+      d = 1;
+
+    demerit.extra (d, "too_many_atoms");
+    return;
+  }
+
+  return;
+}
+
+/*
+  Entries are in the order the rules were applied by iwdemerit, hard
+  coded rules first, then queries. Returns the IWDC_STAGE_* at which
+  the molecule was rejected
+*/
+
+static int
+rescore_demerits (const Hit_Matrix_Reader & hm,
+                  int i,
+                  Demerit & demerit)
+{
+  if (soft_lower_atom_count_cutoff > 0 || soft_upper_atom_count_cutoff > 0)
+  {
+    do_atom_count_demerits (hm.natoms (i), demerit);
+    if (demerit.rejected ())
+      return IWDC_STAGE_ATOM_COUNT;
+  }
+
+  if (skip_molecules_with_abnormal_valences && (hm.flags (i) & IWHM_FLAG_BAD_VALENCE))
+  {
+    demerit.reject ("valence");
+    molecules_with_abnormal_valences++;
+    return IWDC_STAGE_VALENCE;
+  }
+
+  const int estop = hm.entries_end (i);
+
+  for (int e = hm.entries_start (i); e < estop; e++)
+  {
+    const int c = hm.column (e);
+
+    if (! column_active[c])
+      continue;
+
+    const IWString & name = hm.column_name (c);
+    const int nhits = hm.hits (e);
+    const int type = hm.column_type (c);
+
+    if (IWHM_COLUMN_HARD_CODED == type)
+    {
+      if (IWHM_REJECT == hm.value (e))
+        demerit.reject (name, nhits);
+      else
+        demerit.extra (hm.value (e), name, nhits);
+
+      if (demerit.rejected ())
+        return IWDC_STAGE_HARD_CODED;
+
+      continue;
+    }
+
+    const int intd = int (column_weight[c] * nhits * 1.0001);
+
+    if (intd >= rejection_threshold ())
+      demerit.reject (name, nhits);
+    else if (intd > 0)
+      demerit.extra (intd, name, nhits);
+
+    if (demerit.rejected ())
+      return IWHM_COLUMN_QUERY == type ? IWDC_STAGE_QUERIES : IWDC_STAGE_LARGEST_FRAGMENT_QUERIES;
+  }
+
+  return IWDC_STAGE_NOT_REJECTED;
+}
+
+/*
+  tsubstructure matrices, any match to a rule still in use rejects
+*/
+
+static int
+rescore_any_match (const Hit_Matrix_Reader & hm,
+                   int i,
+                   Demerit & demerit)
+{
+  const int estop = hm.entries_end (i);
+
+  for (int e = hm.entries_start (i); e < estop; e++)
+  {
+    const int c = hm.column (e);
+
+    if (! column_active[c])
+      continue;
+
+    demerit.reject (hm.column_name (c), hm.hits (e));
+
+    return IWDC_STAGE_QUERIES;
+  }
+
+  return IWDC_STAGE_NOT_REJECTED;
+}
+
+static int
+write_molecule (const Hit_Matrix_Reader & hm,
+                int i,
+                const Demerit & demerit,
+                IWString_and_File_Descriptor & output)
+{
+  output << hm.smiles (i) << ' ' << hm.id (i);
+
+  if (append_demerit_text_to_name && demerit.score () > 0)
+    output << " : D(" << demerit.score () << ") " << demerit.types ();
+
+  output << '\n';
+
+  output.write_if_buffer_holds_more_than (32768);
+
+  return 1;
+}
+
+static int
+mc_rescore (Hit_Matrix_Reader & hm)
+{
+  int rc;
+
+  while ((rc = hm.next_block ()) > 0)
+  {
+    set_columns (hm);
+
+    const int n = hm.number_molecules ();
+
+    for (int i = 0; i < n; i++)
+    {
+      molecules_read++;
+
+      Demerit demerit;
+
+      int stage;
+      if (IWHM_KIND_ANY_MATCH == hm.kind ())
+        stage = rescore_any_match (hm, i, demerit);
+      else
+        stage = rescore_demerits (hm, i, demerit);
+
+      if (demerit.rejected ())
+      {
+        molecules_rejected++;
+        if (bad_output.is_open ())
+          write_molecule (hm, i, demerit, bad_output);
+      }
+      else if (good_output.is_open ())
+        write_molecule (hm, i, demerit, good_output);
+
+      if (columnar.is_open ())
+        columnar.add (hm.id (i), stage, demerit);
+    }
+  }
+
+  return 0 == rc;
+}
+
+/*
+  As with iwdemerit, -G and -R are stems, the molecules are smiles
+*/
+
+static int
+open_output (const char * stem,
+             IWString_and_File_Descriptor & output)
+{
+  if (0 == strcmp (stem, "-"))
+    return output.open ("/dev/stdout");
+
+  IWString fname (stem);
+  fname << ".smi";
+
+  return output.open (fname.null_terminated_chars ());
+}
+
+static int
+mc_rescore (int argc, char ** argv)
+{
+  Command_Line cl (argc, argv, "vf:xc:VrO:w:G:R:tU:");
+
+  if (cl.unrecognised_options_encountered ())
+  {
+    cerr << "Unrecognised options encountered\n";
+    usage (1);
+  }
+
+  verbose = cl.option_count ('v');
+
+  if (cl.option_present ('f'))
+  {
+    int f;
+    if (! cl.value ('f', f) || f < 1)
+    {
+      cerr << "The rejection threshold (-f) must be a whole +ve number\n";
+      usage (4);
+    }
+
+    set_rejection_threshold (f);
+
+    if (verbose)
+      cerr << "Rejection threshold set to " << f << endl;
+
+    if (! cl.option_present ('x'))
+    {
+      lower_atom_count_demerit = f;
+      upper_atom_count_demerit = f;
+    }
+  }
+
+  if (cl.option_present ('c'))
+  {
+    int i = 0;
+    const_IWSubstring c;
+    while (cl.value ('c', c, i++))
+    {
+      const_IWSubstring directive;
+      int dvalue;
+      if (! c.split_into_directive_and_value (directive, '=', dvalue) || dvalue < 0)
+      {
+        cerr << "Invalid -c directive '" << c << "'\n";
+        usage (5);
+      }
+
+      if ("hmin" == directive)
+        hard_lower_atom_count_cutoff = dvalue;
+      else if ("smin" == directive)
+        soft_lower_atom_count_cutoff = dvalue;
+      else if ("smax" == directive)
+        soft_upper_atom_count_cutoff = dvalue;
+      else if ("hmax" == directive)
+        hard_upper_atom_count_cutoff = dvalue;
+      else
+      {
+        cerr << "Unrecognised -c qualifier '" << c << "'\n";
+        usage (5);
+      }
+    }
+
+    if (hard_lower_atom_count_cutoff > soft_lower_atom_count_cutoff)
+    {
+      cerr << "Invalid lower atom count cutoff values soft:" << soft_lower_atom_count_cutoff << " hard:" << hard_lower_atom_count_cutoff << endl;
+      return 5;
+    }
+
+    if ((soft_upper_atom_count_cutoff > 0 || hard_upper_atom_count_cutoff > 0) && soft_upper_atom_count_cutoff >= hard_upper_atom_count_cutoff)
+    {
+      cerr << "Invalid upper atom count cutoff values soft:" << soft_upper_atom_count_cutoff << " hard:" << hard_upper_atom_count_cutoff << endl;
+      return 5;
+    }
+
+    if (soft_lower_atom_count_cutoff > 0 && soft_upper_atom_count_cutoff > 0 && soft_lower_atom_count_cutoff >= soft_upper_atom_count_cutoff)
+    {
+      cerr << "Soft cutoffs invalid, lower:" << soft_lower_atom_count_cutoff << " upper:" << soft_upper_atom_count_cutoff << endl;
+      return 8;
+    }
+  }
+
+  if (cl.option_present ('V'))
+  {
+    skip_molecules_with_abnormal_valences = 1;
+
+    if (verbose)
+      cerr << "Molecules with abnormal valences will be rejected\n";
+  }
+
+  if (cl.option_present ('r'))
+  {
+    hard_coded_rules_only = 1;
+
+    if (verbose)
+      cerr << "Only hard coded rules will be applied\n";
+  }
+
+  if (cl.option_present ('O'))
+  {
+    int i = 0;
+    const_IWSubstring o;
+    while (cl.value ('O', o, i++))
+    {
+      if (o.starts_with ("RX="))
+      {
+        o.remove_leading_chars (3);
+        IW_Regular_Expression * rx = new IW_Regular_Expression;
+        if (! rx->set_pattern (o))
+        {
+          cerr << "Invalid regular expression '" << o << "'\n";
+          delete rx;
+          return 3;
+        }
+        omit_rule_rx.add (rx);
+      }
+      else
+        omit_rule[o] = 1;
+    }
+
+    if (verbose)
+      cerr << "Omitting " << omit_rule.size () << " rules and " << omit_rule_rx.number_elements () << " rule patterns\n";
+  }
+
+  if (cl.option_present ('w'))
+  {
+    int i = 0;
+    const_IWSubstring w;
+    while (cl.value ('w', w, i++))
+    {
+      const_IWSubstring name, s;
+      double d;
+      if (! w.split (name, '=', s) || 0 == name.length () || ! s.numeric_value (d) || d < 0.0)
+      {
+        cerr << "Invalid -w specification '" << w << "'\n";
+        usage (3);
+      }
+
+      new_weight[name] = d;
+    }
+  }
+
+  if (cl.option_present ('t'))
+    append_demerit_text_to_name = 1;
+
+  if (cl.option_present ('G') && ! open_output (cl.option_value ('G'), good_output))
+  {
+    cerr << "Cannot open -G stem '" << cl.option_value ('G') << "'\n";
+    return 4;
+  }
+
+  if (cl.option_present ('R') && ! open_output (cl.option_value ('R'), bad_output))
+  {
+    cerr << "Cannot open -R stem '" << cl.option_value ('R') << "'\n";
+    return 4;
+  }
+
+  if (cl.option_present ('U'))
+  {
+    const char * fname = cl.option_value ('U');
+
+    if (! columnar.open (fname))
+    {
+      cerr << "Cannot open columnar results file '" << fname << "'\n";
+      return 4;
+    }
+
+    if (verbose)
+      cerr << "Compact results written to '" << fname << "'\n";
+  }
+
+  if (1 != cl.number_elements ())
+  {
+    cerr << "Must specify a single hit matrix\n";
+    usage (2);
+  }
+
+  Hit_Matrix_Reader hm;
+
+  if (! hm.open (cl[0]))
+  {
+    cerr << "Cannot open hit matrix '" << cl[0] << "'\n";
+    return 3;
+  }
+
+  int rc = 0;
+
+  if (! mc_rescore (hm))
+  {
+    cerr << "Error reading hit matrix '" << cl[0] << "'\n";
+    rc = 3;
+  }
+
+  good_output.flush ();
+  bad_output.flush ();
+
+  if (columnar.is_open () && ! columnar.close ())
+  {
+    cerr << "Error writing columnar results\n";
+    rc = 4;
+  }
+
+  if (verbose)
+  {
+    cerr << "Read " << molecules_read << " molecules, rejected " << molecules_rejected << endl;
+    if (skip_molecules_with_abnormal_valences)
+      cerr << molecules_with_abnormal_valences << " molecules with abnormal valences\n";
+  }
+
+  if (NULL != column_active)
+  {
+    delete [] column_active;
+    delete [] column_weight;
+  }
+
+  return rc;
+}
+
+int
+main (int argc, char ** argv)
+{
+  prog_name = argv[0];
+
+  int rc = mc_rescore (argc, argv);
+
+  return rc;
+}
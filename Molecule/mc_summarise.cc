@@ -21,6 +21,9 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #define RESIZABLE_ARRAY_IMPLEMENTATION
 #define RESIZABLE_ARRAY_IWQSORT_IMPLEMENTATION
@@ -31,6 +34,8 @@
 #include "iwstring_data_source.h"
 #include "iw_stl_hash_map.h"
 
+#include "demerit_columnar.h"
+
 const char * prog_name = NULL;
 
 static int verbose = 0;
@@ -39,12 +44,6 @@ static IWString bad_file_stem ("bad");
 
 static IWString bad_file_stem_array ("BQTP");
 
-static int molecules_written = 0;
-
-static int rejected_molecules = 0;
-
-static int demerited_molecules = 0;
-
 static int include_reason = 0;
 
 static int include_zero_demerit_molecules = 0;
@@ -55,12 +54,8 @@ static IWString prepend_string;
 
 static int prepend_d = 1;
 
-static IW_STL_Hash_Map_int reason;
-
 static int accumulate_reasons = 0;
 
-static extending_resizable_array<int> demerits_per_molecule;
-
 static char separator = ' ';
 
 static int latex_table = 0;
@@ -89,22 +84,108 @@ usage (int rc)
   cerr << " -X             produce table in LaTex format\n";
   cerr << " -c             produce a demerit based scale factor file\n";
   cerr << " -f <n>         numeric demerit value for rejections (default 100)\n";
+  cerr << " -U <fname>     iwdemerit results from 'iwdemerit -U' rather than " << bad_file_stem << "3.smi and okfile\n";
+  cerr << "                repeat for each run when summarising multiple runs, no okfile needed\n";
+  cerr << " -n <n>         number of threads, input files are read concurrently (default one per cpu)\n";
   cerr << " -v             verbose output\n";
 
   exit (rc);
 }
 
-static int
-write_demerit_value (const const_IWSubstring & id,
-                     int demerit,
-                     IWString_and_File_Descriptor & output)
+/*
+  Oct 2026. Input files are summarised concurrently, each thread
+  accumulating its own counts, which are merged at the end
+*/
+
+static int nthreads = 0;
+
+class Summary_Accumulator
 {
-  molecules_written++;
+  private:
+    int _molecules_written;
+    int _rejected_molecules;
+    int _demerited_molecules;
+
+    IW_STL_Hash_Map_int _reason;
+
+    extending_resizable_array<int> _demerits_per_molecule;
+
+  public:
+    Summary_Accumulator ();
+
+//  Scratch space for building reasons
+
+    IWString myreason;
+
+    int write_demerit_value (const const_IWSubstring & id, int demerit, IWString & output);
+
+    void reason_found (const IWString & r) { _reason[r]++;}
+
+    void demerits_this_molecule (int d) { _demerits_per_molecule[d]++;}
+
+    void merge (const Summary_Accumulator &);
+
+    const IW_STL_Hash_Map_int & reason () const { return _reason;}
+
+    int report (ostream &) const;
+};
+
+Summary_Accumulator::Summary_Accumulator ()
+{
+  _molecules_written = 0;
+  _rejected_molecules = 0;
+  _demerited_molecules = 0;
+
+  return;
+}
+
+void
+Summary_Accumulator::merge (const Summary_Accumulator & rhs)
+{
+  _molecules_written += rhs._molecules_written;
+  _rejected_molecules += rhs._rejected_molecules;
+  _demerited_molecules += rhs._demerited_molecules;
+
+  for (IW_STL_Hash_Map_int::const_iterator i = rhs._reason.begin (); i != rhs._reason.end (); ++i)
+  {
+    _reason[(*i).first] += (*i).second;
+  }
+
+  for (int i = 0; i < rhs._demerits_per_molecule.number_elements (); i++)
+  {
+    if (rhs._demerits_per_molecule[i])
+      _demerits_per_molecule[i] += rhs._demerits_per_molecule[i];
+  }
+
+  return;
+}
+
+int
+Summary_Accumulator::report (ostream & os) const
+{
+  os << "Wrote " << _molecules_written << " molecules, ";
+  os << _rejected_molecules << " rejected, " << _demerited_molecules << " demerited\n";
+
+  for (int i = 0; i < _demerits_per_molecule.number_elements (); i++)
+  {
+    if (_demerits_per_molecule[i])
+      os << _demerits_per_molecule[i] << " molecules had " << i << " demerits\n";
+  }
+
+  return os.good ();
+}
+
+int
+Summary_Accumulator::write_demerit_value (const const_IWSubstring & id,
+                                          int demerit,
+                                          IWString & output)
+{
+  _molecules_written++;
 
   if (demerit >= 100)
-    rejected_molecules++;
+    _rejected_molecules++;
   else if (demerit > 0)
-    demerited_molecules++;
+    _demerited_molecules++;
 
   output << id << separator;
 
@@ -124,37 +205,153 @@ write_demerit_value (const const_IWSubstring & id,
   else
     output << demerit;
 
-  output.write_if_buffer_holds_more_than(32768);
+  return 1;
+}
 
-  return output.good ();
+/*
+  Where the summary of one input file goes. When summarising serially
+  it is written straight through, otherwise full buffers are handed to
+  the pool, which writes them in file order
+*/
+
+class Summary_Pool;
+
+class Summary_Output : public IWString
+{
+  private:
+    IWString_and_File_Descriptor * _direct;
+
+    Summary_Pool * _pool;
+    int _item;
+
+  public:
+    Summary_Output (IWString_and_File_Descriptor & output);
+    Summary_Output (Summary_Pool * pool, int item);
+
+    int write_if_buffer_holds_more_than (int);
+
+    int flush ();
+};
+
+/*
+  Oct 2026. Records are parsed by hand rather than with nextword and
+  regular expressions. Tokens are separated by runs of spaces, just as
+  with nextword, but word ends are found with memchr, since the first
+  word, the smiles, is usually the longest
+*/
+
+class Record_Scanner
+{
+  private:
+    const char * _s;
+    const int _n;
+    int _i;
+
+  public:
+    Record_Scanner (const const_IWSubstring & buffer) : _s(buffer.rawchars ()), _n(buffer.length ()), _i(0) {}
+
+//  Same result as nextword (token, i, separator)
+
+    int next_token (const_IWSubstring & token, char separator = ' ');
+};
+
+int
+Record_Scanner::next_token (const_IWSubstring & token,
+                            char separator)
+{
+  while (_i < _n && separator == _s[_i])
+  {
+    _i++;
+  }
+
+  if (_i >= _n)
+    return 0;
+
+  const char * e = reinterpret_cast<const char *>(memchr (_s + _i, separator, _n - _i));
+
+  const int iend = (NULL == e) ? _n : static_cast<int>(e - _s);
+
+  token.set (_s + _i, iend - _i);
+
+  _i = iend;
+
+  return 1;
+}
+
+//  A token of the form D(123), gives the number
+
+static int
+is_d_parentheses (const const_IWSubstring & token,
+                  int & d)
+{
+  const int n = token.length ();
+
+  if (n < 4 || 'D' != token[0] || '(' != token[1] || ')' != token[n - 1])
+    return 0;
+
+  int tmp = 0;
+
+  for (int i = 2; i < n - 1; i++)
+  {
+    const char c = token[i];
+    if (c < '0' || c > '9')
+      return 0;
+
+    tmp = 10 * tmp + (c - '0');
+  }
+
+  d = tmp;
+
+  return 1;
+}
+
+//  A token of the form (123
+
+static int
+is_open_paren_number (const const_IWSubstring & token)
+{
+  const int n = token.length ();
+
+  if (n < 2 || '(' != token[0])
+    return 0;
+
+  for (int i = 1; i < n; i++)
+  {
+    const char c = token[i];
+    if (c < '0' || c > '9')
+      return 0;
+  }
+
+  return 1;
 }
 
-static IW_Regular_Expression d_parentheses ("^D\\([0-9]+\\)$");
+//  Smiles id ... : D(123) reason1:reason2:...
 
 static int
 process_from_iwdemerit (const const_IWSubstring & buffer,
                         int must_have_demerit,
-                        IWString_and_File_Descriptor & output)
+                        Summary_Accumulator & acc,
+                        Summary_Output & output)
 {
-  int i = 0;
+  Record_Scanner scanner (buffer);
 
   const_IWSubstring token;
 
-  buffer.nextword (token, i);
+  scanner.next_token (token);
 
   const_IWSubstring id;
 
-  buffer.nextword (id, i);
+  scanner.next_token (id);
 
 //cerr << "Processing '" << id << "'\n";
 
   int previous_was_colon = 0;
 
-  const_IWSubstring dmrt;
+  int d = -1;
 
-  while (buffer.nextword (token, i))
+  while (scanner.next_token (token))
   {
-    if (':' == token)
+    if (1 == token.length () && ':' == token[0])
     {
       previous_was_colon = 1;
       continue;
@@ -163,21 +360,15 @@ process_from_iwdemerit (const const_IWSubstring & buffer,
     if (! previous_was_colon)
       continue;
 
-    if (! d_parentheses.matches (token))
-    {
-      previous_was_colon = 0;
-      continue;
-    }
+    if (is_d_parentheses (token, d))
+      break;
 
-    dmrt = token;
-    dmrt.remove_leading_chars (2);
-    dmrt.chop ();
-    break;
+    previous_was_colon = 0;
   }
 
-//cerr << " Demerit for '" << id << " is '" << dmrt << "'\n";
+//cerr << " Demerit for '" << id << " is '" << d << "'\n";
 
-  if (dmrt.length ())
+  if (d >= 0)
     ;
   else if (must_have_demerit)
   {
@@ -188,59 +379,58 @@ process_from_iwdemerit (const const_IWSubstring & buffer,
   {
     if (include_zero_demerit_molecules)
     {
-      write_demerit_value (id, 0, output);
+      acc.write_demerit_value (id, 0, output);
       output << '\n';
     }
 
-    return output.good ();
+    return 1;
   }
 
-  int d;
-  (void) dmrt.numeric_value (d);
-
   if (d > 100)
     d = 100;
 
-  write_demerit_value (id, d, output);
+  acc.write_demerit_value (id, d, output);
 
   if (include_reason)
   {
     int demerit_reasons_this_molecule = 0;
 
-    static IWString myreason;
-
-    while (buffer.nextword (myreason, i, ':'))
+    while (scanner.next_token (token, ':'))
     {
-      myreason.strip_leading_blanks();
+      token.strip_leading_blanks ();
 
-      output << separator << myreason;
+      output << separator << token;
 
       if (accumulate_reasons)
-        reason[myreason]++;
+      {
+        acc.myreason = token;
+        acc.reason_found (acc.myreason);
+      }
 
       demerit_reasons_this_molecule++;
     }
 
-    demerits_per_molecule[demerit_reasons_this_molecule]++;
+    acc.demerits_this_molecule (demerit_reasons_this_molecule);
   }
 
   output << '\n';
 
   output.write_if_buffer_holds_more_than(32768);
 
-  return output.good ();
+  return 1;
 }
 
 static int
 process_from_iwdemerit (iwstring_data_source & input,
                         int must_have_demerit,
-                        IWString_and_File_Descriptor & output)
+                        Summary_Accumulator & acc,
+                        Summary_Output & output)
 {
   const_IWSubstring buffer;
 
   while (input.next_record (buffer))
   {
-    if (! process_from_iwdemerit (buffer, must_have_demerit, output))
+    if (! process_from_iwdemerit (buffer, must_have_demerit, acc, output))
     {
       cerr << "Invalid from iwdemerit record, line " << input.lines_read () << endl;
       cerr << buffer << endl;
@@ -248,28 +438,30 @@ process_from_iwdemerit (iwstring_data_source & input,
     }
   }
 
-  return output.good ();
+  return 1;
 }
 
-static IW_Regular_Expression open_paren ("^\\([0-9]+$");
+//  Smiles id ... (2 matches to 'reason')
 
 static int
 process_bad12 (const const_IWSubstring & buffer,
-               IWString_and_File_Descriptor & output)
+               Summary_Accumulator & acc,
+               Summary_Output & output)
 {
-  int i = 0;
+  Record_Scanner scanner (buffer);
+
   const_IWSubstring token;
 
-  buffer.nextword (token, i);
+  scanner.next_token (token);
 
   const_IWSubstring id;
-  buffer.nextword (id, i);
+  scanner.next_token (id);
 
   int got_open_paren = 0;
 
-  while (buffer.nextword (token, i))
+  while (scanner.next_token (token))
   {
-    if (! open_paren.matches (token))
+    if (! is_open_paren_number (token))
       continue;
 
     got_open_paren = 1;
@@ -282,7 +474,7 @@ process_bad12 (const const_IWSubstring & buffer,
     return 0;
   }
 
-  buffer.nextword (token, i);
+  scanner.next_token (token);
 
   if ("matches" != token)
   {
@@ -290,7 +482,7 @@ process_bad12 (const const_IWSubstring & buffer,
     return 0;
   }
 
-  buffer.nextword (token, i);
+  scanner.next_token (token);
 
   if ("to" != token)
   {
@@ -298,15 +490,15 @@ process_bad12 (const const_IWSubstring & buffer,
     return 0;
   }
 
-  write_demerit_value (id, bad12_demerit, output);
+  acc.write_demerit_value (id, bad12_demerit, output);
 
   if (include_reason)
   {
-    static IWString myreason;
+    IWString & myreason = acc.myreason;
 
     myreason.resize_keep_storage (0);
 
-    while (buffer.nextword (token, i))
+    while (scanner.next_token (token))
     {
       if (token.starts_with ('\''))
         token.remove_leading_chars (1);
@@ -320,200 +512,578 @@ process_bad12 (const const_IWSubstring & buffer,
     output << separator << myreason;
 
     if (accumulate_reasons)
-      reason[myreason]++;
+      acc.reason_found (myreason);
   }
 
   output << '\n';
 
   output.write_if_buffer_holds_more_than(32768);
 
-  return output.good ();
+  return 1;
 }
 
 static int
 process_bad12 (iwstring_data_source & input,
-               IWString_and_File_Descriptor & output)
+               Summary_Accumulator & acc,
+               Summary_Output & output)
 {
   const_IWSubstring buffer;
   while (input.next_record (buffer))
   {
-    if (! process_bad12 (buffer, output))
+    if (! process_bad12 (buffer, acc, output))
     {
       cerr << "Invalid bad12 record '" << buffer << "'\n";
       return 0;
     }
   }
 
-  return output.good ();
+  return 1;
 }
 
+//  Smiles id ... TP1 reason
+
 static int
-process_bad12 (const IWString & fname,
-               IWString_and_File_Descriptor & output)
+process_bad0 (const const_IWSubstring & buffer,
+              Summary_Accumulator & acc,
+              Summary_Output & output)
 {
-  iwstring_data_source input (fname);
+  Record_Scanner scanner (buffer);
 
-  if (! input.good ())
+  const_IWSubstring token;
+
+  scanner.next_token (token);
+
+  const_IWSubstring id;
+  scanner.next_token (id);
+
+  int got_tp1 = 0;
+
+  while (scanner.next_token (token))
+  {
+    if ("TP1" != token)
+      continue;
+
+    got_tp1 = 1;
+    break;
+  }
+
+  if (! got_tp1)
   {
-    cerr << "Cannot open '" << fname << "'\n";
+    cerr << "No 'TP1' token\n";
     return 0;
   }
 
-  return process_bad12 (input, output);
+  acc.write_demerit_value (id, bad0_demerit, output);
+
+  if (include_reason)
+  {
+    IWString & myreason = acc.myreason;
+
+    myreason.resize_keep_storage (0);
+
+    while (scanner.next_token (token))
+    {
+      myreason.append_with_spacer (token);
+    }
+
+    if (gsub_spaces_in_reason_to_underscore)
+      myreason.gsub (' ', '_');
+
+    output << separator << myreason;
+
+    if (accumulate_reasons)
+      acc.reason_found (myreason);
+  }
+
+  output << '\n';
+
+  output.write_if_buffer_holds_more_than(32768);
+
+  return 1;
 }
 
 static int
-process_bad1 (const IWString & bad_stem,
-              IWString_and_File_Descriptor & output)
+process_bad0 (iwstring_data_source & input,
+              Summary_Accumulator & acc,
+              Summary_Output & output)
 {
-  IWString fname;
-
-  fname = bad_stem;
-  fname << "1.smi";
+  const_IWSubstring buffer;
+  while (input.next_record (buffer))
+  {
+    if (! process_bad0 (buffer, acc, output))
+    {
+      cerr << "Invalid bad0 record '" << buffer << "'\n";
+      return 0;
+    }
+  }
 
-  return process_bad12 (fname, output);
+  return 1;
 }
 
+/*
+  Oct 2026. The same information as the iwdemerit text outputs, read
+  from the columnar file written by iwdemerit -U
+*/
+
 static int
-process_bad2 (const IWString & bad_stem,
-              IWString_and_File_Descriptor & output)
+process_columnar_molecule (const Demerit_Columnar_Reader & input,
+                           int ndx,
+                           Summary_Accumulator & acc,
+                           Summary_Output & output)
 {
-  IWString fname;
+  const const_IWSubstring id = input.id (ndx);
 
-  fname = bad_stem;
-  fname << "2.smi";
+  int d = input.score (ndx);
 
-  return process_bad12 (fname, output);
+  if (0 == d)
+  {
+    if (include_zero_demerit_molecules)
+    {
+      acc.write_demerit_value (id, 0, output);
+      output << '\n';
+    }
+
+    return 1;
+  }
+
+  if (d > 100)
+    d = 100;
+
+  acc.write_demerit_value (id, d, output);
+
+  if (include_reason)
+  {
+    const int hstart = input.hits_start (ndx);
+    const int hend = input.hits_end (ndx);
+
+    for (int h = hstart; h < hend; h++)
+    {
+      const IWString & myreason = input.rule_name (input.rule (h));
+
+      output << separator << myreason;
+
+      if (accumulate_reasons)
+        acc.reason_found (myreason);
+    }
+
+    acc.demerits_this_molecule (hend - hstart);
+  }
+
+  output << '\n';
+
+  output.write_if_buffer_holds_more_than(32768);
+
+  return 1;
 }
 
+/*
+  Rejected molecules come first, as they would from the bad file
+*/
+
 static int
-process_from_iwdemerit (const char * fname,
-                        int must_have_demerit,
-                        IWString_and_File_Descriptor & output)
+process_columnar (const char * fname,
+                  int want_rejected,
+                  Summary_Accumulator & acc,
+                  Summary_Output & output)
 {
-  iwstring_data_source input (fname);
+  Demerit_Columnar_Reader input;
+
+  if (! input.open (fname))
+  {
+    cerr << "Cannot open columnar results file '" << fname << "'\n";
+    return 0;
+  }
+
+  int rc;
+  while ((rc = input.next_block ()) > 0)
+  {
+    const int n = input.number_molecules ();
+
+    for (int i = 0; i < n; i++)
+    {
+      const int rejected = (IWDC_STAGE_NOT_REJECTED != input.stage (i));
+
+      if (rejected != want_rejected)
+        continue;
+
+      if (! process_columnar_molecule (input, i, acc, output))
+        return 0;
+    }
+  }
+
+  if (rc < 0)
+  {
+    cerr << "Corrupt columnar results file '" << fname << "'\n";
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+  Each input file is a separate piece of work. Output must appear in the
+  order of the items
+*/
+
+#define SUMMARY_BAD0 0
+#define SUMMARY_BAD12 1
+#define SUMMARY_IWDEMERIT_REJECTED 2
+#define SUMMARY_IWDEMERIT 3
+#define SUMMARY_COLUMNAR 4
+
+class Summary_Work_Item
+{
+  private:
+    const int _type;
+    IWString _fname;
+
+  public:
+    Summary_Work_Item (int t, const IWString & f) : _type(t), _fname(f) {}
+
+    int process (Summary_Accumulator &, Summary_Output &);
+};
+
+int
+Summary_Work_Item::process (Summary_Accumulator & acc,
+                            Summary_Output & output)
+{
+  if (SUMMARY_COLUMNAR == _type)
+  {
+    return process_columnar (_fname.null_terminated_chars (), 1, acc, output) &&
+           process_columnar (_fname.null_terminated_chars (), 0, acc, output);
+  }
+
+  iwstring_data_source input (_fname.null_terminated_chars ());
+
   if (! input.good ())
   {
-    cerr << "Cannot open '" << fname << "'\n";
+    cerr << "Cannot open '" << _fname << "'\n";
     return 0;
   }
 
-  return process_from_iwdemerit (input, must_have_demerit, output);
+  if (SUMMARY_BAD0 == _type)
+    return process_bad0 (input, acc, output);
+
+  if (SUMMARY_BAD12 == _type)
+    return process_bad12 (input, acc, output);
+
+  return process_from_iwdemerit (input, SUMMARY_IWDEMERIT_REJECTED == _type, acc, output);
 }
 
 static int
-process_from_iwdemerit (const IWString & bad_stem,
-                        IWString_and_File_Descriptor & output,
-                        int must_have_demerit)
+add_single_run (const char * okfile,
+                const IWString & bad_stem,
+                const char * columnar,
+                resizable_array_p<Summary_Work_Item> & items)
 {
   IWString fname;
 
+  fname << bad_stem << "0.smi";
+  items.add (new Summary_Work_Item (SUMMARY_BAD0, fname));
+
+  for (int i = 1; i <= 2; i++)
+  {
+    fname = bad_stem;
+    fname << i << ".smi";
+    items.add (new Summary_Work_Item (SUMMARY_BAD12, fname));
+  }
+
+  if (NULL != columnar)
+  {
+    items.add (new Summary_Work_Item (SUMMARY_COLUMNAR, columnar));
+    return 1;
+  }
+
   fname = bad_stem;
   fname << "3.smi";
+  items.add (new Summary_Work_Item (SUMMARY_IWDEMERIT_REJECTED, fname));
+
+  items.add (new Summary_Work_Item (SUMMARY_IWDEMERIT, okfile));
 
-  return process_from_iwdemerit (fname.null_terminated_chars (), must_have_demerit, output);
+  return 1;
 }
 
-static int
-process_bad0 (const const_IWSubstring & buffer,
-              IWString_and_File_Descriptor & output)
+/*
+  Worker threads claim items in order. Each item has a bounded queue of
+  completed buffers, which the main thread drains, one item at a time.
+  Since items are claimed in order, the item being written is always
+  being worked on, or finished
+*/
+
+#define SUMMARY_BUFFER_SIZE 262144
+#define SUMMARY_BUFFERS_PER_ITEM 8
+
+class Summary_Pool
 {
-  int i = 0;
-  const_IWSubstring token;
+  private:
+    const resizable_array_p<Summary_Work_Item> & _item;
 
-  buffer.nextword (token, i);
+    int _next_item;
 
-  const_IWSubstring id;
-  buffer.nextword (id, i);
+    resizable_array_p<IWString> * _queue;
+    int * _finished;
 
-  int got_tp1 = 0;
+    resizable_array_p<Summary_Accumulator> _acc;
 
-  while (buffer.nextword (token, i))
-  {
-    if ("TP1" != token)
-      continue;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _changed;
 
-    got_tp1 = 1;
-    break;
+//  private functions
+
+    void _write_item (int, IWString_and_File_Descriptor &);
+
+  public:
+    Summary_Pool (const resizable_array_p<Summary_Work_Item> &);
+    ~Summary_Pool ();
+
+    int run (int nthreads, IWString_and_File_Descriptor & output, Summary_Accumulator & totals);
+
+    int add_buffer (int item, IWString & buffer);
+
+    void worker (Summary_Accumulator &);
+};
+
+Summary_Pool::Summary_Pool (const resizable_array_p<Summary_Work_Item> & item) : _item(item)
+{
+  _next_item = 0;
+
+  _queue = new resizable_array_p<IWString>[_item.number_elements ()];
+  _finished = new_int (_item.number_elements ());
+
+  pthread_mutex_init (&_mutex, NULL);
+  pthread_cond_init (&_changed, NULL);
+
+  return;
+}
+
+Summary_Pool::~Summary_Pool ()
+{
+  delete [] _queue;
+  delete [] _finished;
+
+  pthread_mutex_destroy (&_mutex);
+  pthread_cond_destroy (&_changed);
+
+  return;
+}
+
+int
+Summary_Pool::add_buffer (int item,
+                          IWString & buffer)
+{
+  IWString * b = new IWString;
+  b->resize (SUMMARY_BUFFER_SIZE + 4096);
+  b->strncat (buffer.rawchars (), buffer.length ());
+
+  buffer.resize_keep_storage (0);
+
+  pthread_mutex_lock (&_mutex);
+
+  while (_queue[item].number_elements () >= SUMMARY_BUFFERS_PER_ITEM)
+  {
+    pthread_cond_wait (&_changed, &_mutex);
   }
 
-  if (! got_tp1)
+  _queue[item].add (b);
+
+  pthread_cond_broadcast (&_changed);
+  pthread_mutex_unlock (&_mutex);
+
+  return 1;
+}
+
+void
+Summary_Pool::worker (Summary_Accumulator & acc)
+{
+  while (1)
   {
-    cerr << "No 'TP1' token\n";
-    return 0;
+    pthread_mutex_lock (&_mutex);
+    const int i = _next_item;
+    _next_item++;
+    pthread_mutex_unlock (&_mutex);
+
+    if (i >= _item.number_elements ())
+      return;
+
+    Summary_Output output (this, i);
+
+    _item[i]->process (acc, output);
+
+    output.flush ();
+
+    pthread_mutex_lock (&_mutex);
+    _finished[i] = 1;
+    pthread_cond_broadcast (&_changed);
+    pthread_mutex_unlock (&_mutex);
   }
+}
 
-  write_demerit_value (id, bad0_demerit, output);
+struct Summary_Worker_Arg
+{
+  Summary_Pool * pool;
+  Summary_Accumulator * acc;
+};
 
-  if (include_reason)
+static void *
+summary_worker (void * p)
+{
+  Summary_Worker_Arg * arg = reinterpret_cast<Summary_Worker_Arg *>(p);
+
+  arg->pool->worker (*(arg->acc));
+
+  return NULL;
+}
+
+int
+Summary_Pool::run (int nthreads,
+                   IWString_and_File_Descriptor & output,
+                   Summary_Accumulator & totals)
+{
+  const int nitems = _item.number_elements ();
+
+  if (nthreads > nitems)
+    nthreads = nitems;
+
+  pthread_t * thread = new pthread_t[nthreads];
+  Summary_Worker_Arg * arg = new Summary_Worker_Arg[nthreads];
+
+  int nstarted = 0;
+
+  for (int i = 0; i < nthreads && nthreads > 1; i++)
   {
-    static IWString myreason;
+    Summary_Accumulator * acc = new Summary_Accumulator;
+    _acc.add (acc);
 
-    myreason.resize_keep_storage (0);
+    arg[i].pool = this;
+    arg[i].acc = acc;
 
-    while (buffer.nextword (token, i))
+    if (0 != pthread_create (thread + i, NULL, summary_worker, arg + i))
     {
-      myreason.append_with_spacer (token);
+      cerr << "Summary_Pool::run:cannot create thread\n";
+      break;
     }
 
-    if (gsub_spaces_in_reason_to_underscore)
-      myreason.gsub (' ', '_');
+    nstarted++;
+  }
 
-    output << separator << myreason;
+  if (0 == nstarted)     // do it all here
+  {
+    Summary_Accumulator * acc = new Summary_Accumulator;
+    _acc.add (acc);
 
-    if (accumulate_reasons)
-      reason[myreason]++;
+    for (int i = 0; i < nitems; i++)
+    {
+      Summary_Output direct (output);
+      _item[i]->process (*acc, direct);
+      direct.flush ();
+    }
   }
+  else
+  {
+    for (int i = 0; i < nitems; i++)
+    {
+      _write_item (i, output);
+    }
 
-  output << '\n';
+    for (int i = 0; i < nstarted; i++)
+    {
+      pthread_join (thread[i], NULL);
+    }
+  }
 
-  output.write_if_buffer_holds_more_than(32768);
+  for (int i = 0; i < _acc.number_elements (); i++)
+  {
+    totals.merge (*(_acc[i]));
+  }
+
+  delete [] thread;
+  delete [] arg;
 
   return output.good ();
 }
 
-static int
-process_bad0 (iwstring_data_source & input, 
-              IWString_and_File_Descriptor & output)
+//  Write everything for ITEM as it becomes available
+
+void
+Summary_Pool::_write_item (int item,
+                           IWString_and_File_Descriptor & output)
 {
-  const_IWSubstring buffer;
-  while (input.next_record (buffer))
+  while (1)
   {
-    if (! process_bad0 (buffer, output))
+    pthread_mutex_lock (&_mutex);
+
+    while (0 == _queue[item].number_elements () && ! _finished[item])
     {
-      cerr << "Invalid bad0 record '" << buffer << "'\n";
-      return 0;
+      pthread_cond_wait (&_changed, &_mutex);
+    }
+
+    IWString * b = NULL;
+    if (_queue[item].number_elements ())
+    {
+      b = _queue[item].remove_no_delete (0);
+      pthread_cond_broadcast (&_changed);
     }
+
+    pthread_mutex_unlock (&_mutex);
+
+    if (NULL == b)     // item finished and drained
+      return;
+
+    output << *b;
+    output.write_if_buffer_holds_more_than (32768);
+
+    delete b;
   }
+}
 
-  return output.good ();
+Summary_Output::Summary_Output (IWString_and_File_Descriptor & output) : _direct(&output)
+{
+  _pool = NULL;
+  _item = -1;
+
+  return;
 }
 
-static int
-process_bad01 (const IWString & fname,
-               IWString_and_File_Descriptor & output)
+Summary_Output::Summary_Output (Summary_Pool * pool, int item) : _pool(pool), _item(item)
 {
-  iwstring_data_source input (fname);
+  _direct = NULL;
 
-  if (! input.good ())
+  resize (SUMMARY_BUFFER_SIZE + 4096);
+
+  return;
+}
+
+int
+Summary_Output::write_if_buffer_holds_more_than (int s)
+{
+  if (NULL != _direct)
   {
-    cerr << "Cannot open '" << fname << "'\n";
-    return 0;
+    if (_number_elements > s)
+      return flush ();
+
+    return 1;
   }
 
-  return process_bad0 (input, output);
+  if (_number_elements > SUMMARY_BUFFER_SIZE)
+    return flush ();
+
+  return 1;
 }
 
-static int
-process_bad0 (const IWString & bad_stem,
-              IWString_and_File_Descriptor & output)
+int
+Summary_Output::flush ()
 {
-  IWString fname;
+  if (0 == _number_elements)
+    return 1;
 
-  fname = bad_stem;
-  fname << "0.smi";
+  if (NULL != _direct)
+  {
+    _direct->strncat (rawchars (), _number_elements);
+    resize_keep_storage (0);
+    return _direct->write_if_buffer_holds_more_than (32768);
+  }
 
-  return process_bad01 (fname, output);
+  return _pool->add_buffer (_item, *this);
 }
 
 static int
@@ -539,21 +1109,6 @@ all_files_present (const char * okfile,
   return dash_f (okfile);
 }
 
-static int
-process_single_run (const char * okfile,
-                    const IWString & bad_stem,
-                    int ndx,
-                    IWString_and_File_Descriptor & output)
-{
-  process_bad0 (bad_stem, output);
-  process_bad1 (bad_stem, output);
-  process_bad2 (bad_stem, output);
-  process_from_iwdemerit (bad_stem, output, 1);
-  process_from_iwdemerit (okfile, 0, output);
-
-  return output.good ();
-}
-
 class Reason_and_Count
 {
   private:
@@ -614,7 +1169,9 @@ Reason_and_Count_Comparator::operator () (const Reason_and_Count * rc1,
   if (rc1->count() > rc2->count())
     return -1;
 
-  return 0;
+// Oct 2026. The hash order depends on how the per thread counts were merged
+
+  return rc1->reason().strcmp(rc2->reason());
 }
 
 template <typename T>
@@ -671,7 +1228,7 @@ write_reasons (const IW_STL_Hash_Map_int & reason,
 static int
 tp1_summarise (int argc, char ** argv)
 {
-  Command_Line cl (argc, argv, "vB:S:rhzDs:tT:uj:f:XP:c");
+  Command_Line cl (argc, argv, "vB:S:rhzDs:tT:uj:f:XP:cU:n:");
 
   if (cl.unrecognised_options_encountered ())
   {
@@ -809,12 +1366,39 @@ tp1_summarise (int argc, char ** argv)
     separator = s[0];
   }
 
-  if (0 == cl.number_elements ())
+  if (cl.option_present ('n'))
+  {
+    if (! cl.value ('n', nthreads) || nthreads < 1)
+    {
+      cerr << "The number of threads (-n) must be a whole +ve number\n";
+      usage (4);
+    }
+
+    if (verbose)
+      cerr << "Will use " << nthreads << " threads\n";
+  }
+  else
+    nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+
+// With -U the okfile is not read, so it may be omitted
+
+  int nruns = cl.number_elements ();
+
+  if (0 == nruns && cl.option_present ('U'))
+    nruns = cl.option_count ('U');
+
+  if (0 == nruns)
   {
     cerr << "Insufficient arguments\n";
     usage (2);
   }
 
+  if (cl.option_present ('U') && cl.option_count ('U') != nruns)
+  {
+    cerr << "Must specify one columnar results file (-U) for each run\n";
+    usage (2);
+  }
+
   IWString_and_File_Descriptor output(1);
 
   if (include_header_record)
@@ -822,34 +1406,51 @@ tp1_summarise (int argc, char ** argv)
 
   int rc = 0;
 
-  cerr << "Processing " << cl.number_elements() << " files\n";
+  cerr << "Processing " << nruns << " files\n";
 
-  if (1 == cl.number_elements ())
-    process_single_run (cl[0], bad_file_stem, -1, output);
+  resizable_array_p<Summary_Work_Item> items;
+
+  if (1 == nruns)
+  {
+    const char * okfile = cl.number_elements () ? cl[0] : NULL;
+    add_single_run (okfile, bad_file_stem, cl.option_value ('U'), items);
+  }
   else
   {
-    for (int i = 0; i < cl.number_elements (); i++)
+    for (int i = 0; i < nruns; i++)
     {
       IWString bstem = bad_file_stem_array;
       bstem << (i + 1) << '_';
 
-      if (! all_files_present (cl[i], bstem))
+      const char * okfile = (i < cl.number_elements ()) ? cl[i] : NULL;
+      const char * columnar = cl.option_value ('U', i);
+
+      if (NULL == columnar && ! all_files_present (okfile, bstem))
         break;
 
-      if (verbose)
-        cerr << "Processing okfile '" << cl[i] << "', bad stem '" << bstem << "'\n";
+      if (verbose && NULL != columnar)
+        cerr << "Processing columnar file '" << columnar << "', bad stem '" << bstem << "'\n";
+      else if (verbose)
+        cerr << "Processing okfile '" << okfile << "', bad stem '" << bstem << "'\n";
 
-      if (! process_single_run (cl[i], bstem, i, output))
-      {
-        cerr << "Fatal error processing files with stem '" << bstem << "'\n";
-        rc = i + 1;
-        break;
-      }
+      add_single_run (okfile, bstem, columnar, items);
     }
   }
 
+  Summary_Accumulator totals;
+
+  Summary_Pool pool (items);
+
+  if (! pool.run (nthreads, output, totals))
+  {
+    cerr << "Error writing summary\n";
+    rc = 1;
+  }
+
   output.flush();
 
+  const IW_STL_Hash_Map_int & reason = totals.reason ();
+
   if (cl.option_present('X'))
   {
     latex_table = 1;
@@ -883,16 +1484,7 @@ tp1_summarise (int argc, char ** argv)
   }
 
   if (verbose)
-  {
-    cerr << "Wrote " << molecules_written << " molecules, ";
-    cerr << rejected_molecules << " rejected, " << demerited_molecules << " demerited\n";
-
-    for (int i = 0; i < demerits_per_molecule.number_elements (); i++)
-    {
-      if (demerits_per_molecule[i])
-        cerr << demerits_per_molecule[i] << " molecules had " << i << " demerits\n";
-    }
-  }
+    totals.report (cerr);
 
   return rc;
 }
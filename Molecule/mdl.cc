@@ -22,6 +22,7 @@
 #include <fstream>
 #include <iomanip>
 #include <memory>
+#include <pthread.h>
 using namespace std;
 
 // Be sure to define this symbol so all the private functions get defined
@@ -234,6 +235,25 @@ set_sdf_identifier (const const_IWSubstring & sdfid)
   return 1;
 }
 
+/*
+  The regular expression matcher keeps state, so it cannot be shared
+  between threads parsing SD records in parallel
+*/
+
+static pthread_mutex_t sdf_identifier_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+sdf_identifier_matches (const const_IWSubstring & buffer)
+{
+  pthread_mutex_lock(&sdf_identifier_mutex);
+
+  int rc = sdf_identifier.matches(buffer);
+
+  pthread_mutex_unlock(&sdf_identifier_mutex);
+
+  return rc;
+}
+
 static int extract_isis_extregno = 0;
 
 void 
@@ -392,6 +412,12 @@ set_mdl_accumulate_mdl_chirality_features (int s)
   accumulate_mdl_chirality_features = s;
 }
 
+int
+mdl_accumulate_mdl_chirality_features()
+{
+  return accumulate_mdl_chirality_features;
+}
+
 const Set_of_Atoms &
 mdl_unspecified_chiral_atoms()
 {
@@ -1408,7 +1434,7 @@ create_mdl_atom (const const_IWSubstring & ss,
       cerr << "create_mdl_atom: unrecognised element '" << zsymbol << "'\n";
       return NULL;
     }
-    else
+    else     // if another parse thread got there first, we get its element
       e = create_element_with_symbol(zsymbol);
 
     if (NULL == e)
@@ -1978,10 +2004,13 @@ $$$$
   Note that we also flag records starting with a G
 */
 
-static int a_records_found = 0;
-static int g_records_found = 0;
+//  Oct 2026. SD records may be parsed by several threads at once, see
+//  parallel_sdf.h. These describe the molecule being read by this thread
+
+static thread_local int a_records_found = 0;
+static thread_local int g_records_found = 0;
 
-static resizable_array_p<Atom_Alias> aliases;
+static thread_local resizable_array_p<Atom_Alias> aliases;
 
 static int _set_elements_based_on_atom_aliases = 0;
 
@@ -2411,7 +2440,7 @@ Molecule::_read_molecule_mdl_trailing_records (iwstring_data_source & input,
 
 //  Now all the various other identifiers possible in the file
 
-    if (sdf_identifier.active() && sdf_identifier.matches(buffer))
+    if (sdf_identifier.active() && sdf_identifier_matches(buffer))
     {
       IWString id;
       extract_sdf_identifier(buffer, id);
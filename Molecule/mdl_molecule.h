@@ -46,7 +46,7 @@ class MDL_Molecule : public Molecule, public MDL_File_Data
 
 //  private functions
 
-    int _parse_link_record (const IWString & buffer, resizable_array_p<ISIS_Link_Atom> & ltmp);
+    int _parse_link_record (const IWString & buffer, ::resizable_array_p<ISIS_Link_Atom> & ltmp);
 
     int _parse_M_record (iwstring_data_source & input,
                          const const_IWSubstring & buffer,
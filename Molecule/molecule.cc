@@ -3180,7 +3180,7 @@ Molecule::translate_atoms (coord_t x, coord_t y, coord_t z)
 
   for (int i = 0; i < _number_elements; i++)
   {
-    Coordinates * t = _things[i];
+    Atom_Position * t = _things[i];
     t->add (x, y, z);
   }
 
@@ -3199,7 +3199,7 @@ Molecule::translate_atoms (coord_t x, coord_t y, coord_t z,
     atom_number_t atom_to_move = atoms_to_move[i];
     assert (ok_index (atom_to_move));
 
-    Coordinates * t = _things[atom_to_move];
+    Atom_Position * t = _things[atom_to_move];
 
     t->add (x, y, z);
   }
@@ -3220,7 +3220,7 @@ Molecule::translate_atoms (const Coordinates & whereto,
     atom_number_t atom_to_move = atoms_to_move[i];
     assert (ok_index (atom_to_move));
 
-    Coordinates * t = _things[atom_to_move];
+    Atom_Position * t = _things[atom_to_move];
     *t += whereto;
   }
 
@@ -3438,7 +3438,7 @@ Molecule::setx (atom_number_t a, coord_t newx)
 {
   assert (ok_atom_number (a));
 
-  _things[a]->x() = newx;
+  _things[a]->setxyz (newx, _things[a]->y(), _things[a]->z());
 
   return;
 }
@@ -3448,7 +3448,7 @@ Molecule::sety (atom_number_t a, coord_t newy)
 {
   assert (ok_atom_number (a));
 
-  _things[a]->y() =  newy;
+  _things[a]->setxyz (_things[a]->x(), newy, _things[a]->z());
 
   return;
 }
@@ -3458,7 +3458,7 @@ Molecule::setz (atom_number_t a, coord_t newz)
 {
   assert (ok_atom_number (a));
 
-  _things[a]->z() = newz;
+  _things[a]->setxyz (_things[a]->x(), _things[a]->y(), newz);
 
   return;
 }
@@ -3872,6 +3872,13 @@ Molecule::delete_fragments (const int * fragments_to_be_deleted)
   return remove_atoms(atoms_to_be_deleted);
 }
 
+/*
+  Removing atoms one at a time means renumbering every bond and chiral
+  centre, and shifting the atom array, for each atom removed. When whole
+  fragments are discarded nothing that remains is bonded to anything
+  removed, so everything can be compacted in a single pass.
+*/
+
 int
 Molecule::delete_all_fragments_except (int frag)
 {
@@ -3880,20 +3887,76 @@ Molecule::delete_all_fragments_except (int frag)
   int nf = number_fragments();
   assert (frag >= 0 && frag < nf);
 
+  if (1 == nf)
+    return 0;
+
   const int * fragment_membership = _fragment_information.fragment_membership();
 
-  Set_of_Atoms atoms_to_be_removed;
-  atoms_to_be_removed.resize (_number_elements);
+  int * xref = new int[_number_elements + _number_elements]; iw_auto_array<int> free_xref(xref);
+  int * to_remove = xref + _number_elements;
+
+  int nremove = 0;
+  int ndx = 0;
 
   for (int i = 0; i < _number_elements; i++)
   {
-    if (frag != fragment_membership[i])
-      atoms_to_be_removed.add (i);
+    if (frag == fragment_membership[i])
+    {
+      xref[i] = ndx;
+      ndx++;
+    }
+    else
+    {
+      xref[i] = -1;
+      to_remove[nremove] = i;
+      nremove++;
+    }
   }
 
-  assert (atoms_to_be_removed.number_elements());
+  assert (nremove > 0);
 
-  return remove_atoms (atoms_to_be_removed);
+  for (int i = _chiral_centres.number_elements() - 1; i >= 0; i--)
+  {
+    Chiral_Centre * c = _chiral_centres[i];
+
+    if (xref[c->a()] < 0)
+      _chiral_centres.remove_item (i);
+    else
+      c->new_atom_numbers (xref);
+  }
+
+  int nb = _bond_list.number_elements();
+
+  int * bonds_to_remove = new int[nb]; iw_auto_array<int> free_bonds_to_remove(bonds_to_remove);
+  int nbremove = 0;
+
+  for (int i = 0; i < nb; i++)
+  {
+    Bond * b = _bond_list[i];
+
+    if (xref[b->a1()] < 0)
+    {
+      bonds_to_remove[nbremove] = i;
+      nbremove++;
+    }
+    else
+      b->set_a1a2 (xref[b->a1()], xref[b->a2()]);
+  }
+
+  if (nbremove)
+    _bond_list.remove_items (bonds_to_remove, nbremove);
+
+  if (_charges)
+    _charges->remove_items (to_remove, nremove);
+
+  if (_atom_type)
+    _atom_type->remove_items (to_remove, nremove);
+
+  remove_items (to_remove, nremove);
+
+  _set_modified();
+
+  return nremove;
 }
 
 distance_t
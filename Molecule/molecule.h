@@ -171,7 +171,7 @@ class PDB_Stored_Atom_Information
 
 class IW_Bits_Base;
 class Path;
-class List_of_Ring_Sizes : public resizable_array<int>
+class List_of_Ring_Sizes : public small_resizable_array<int, 4>
 {
 };
 
@@ -506,6 +506,7 @@ class Molecule : private resizable_array_p <Atom>
     int  _identify_possible_aromatic_rings (resizable_array<Bond *> & , int *);
 
     int _do_unconnect_covalently_bonded_non_organics ();
+    void _store_smiles_as_read (const const_IWSubstring &);
 
 //  Called by mdl and tripos reading functions. Sometimes carboxyllic acids
 //  come in with aromatic bonds
@@ -956,6 +957,8 @@ class Molecule : private resizable_array_p <Atom>
     int write_molecule_mrv (ostream &);
     int write_molecule_inchi (ostream &);
 
+    int write_molecule_iwb (ostream &);
+
     int write_connection_table_mdl (ostream &) const;
     int write_connection_table_pdb (ostream &);
 
@@ -980,6 +983,7 @@ class Molecule : private resizable_array_p <Atom>
     int read_molecule_mrk_ds   (iwstring_data_source &);
     int read_molecule_mrv_ds   (iwstring_data_source &);
     int read_molecule_inchi_ds (iwstring_data_source &);
+    int read_molecule_iwb_ds   (iwstring_data_source &);
 
     int build_from_smiles     (const char *);
     int build_from_smiles     (const char *, int);
@@ -1539,6 +1543,7 @@ extern void set_put_formal_charges_on_neutral_ND3v4 (int);
 extern int  put_formal_charges_on_neutral_ND3v4 ();
 
 extern void set_mdl_accumulate_mdl_chirality_features (int);
+extern int  mdl_accumulate_mdl_chirality_features ();
 extern void set_mdl_truncate_long_elements (int s);
 extern void set_mdl_change_long_symbols_to (const const_IWSubstring & s);
 extern void set_mdl_discern_chirality_from_wedge_bonds (int);
@@ -1580,6 +1585,12 @@ extern void  set_seek_to (off_t);
 extern off_t max_offset_from_command_line ();
 extern void  set_max_offset_from_command_line (off_t);
 
+extern int  input_shard (int & k, int & n);
+extern int  set_input_shard (int k, int n);
+
+extern int  sdf_parse_threads ();
+extern void set_sdf_parse_threads (int);
+
 extern void set_mol2_assign_default_formal_charges (int);
 extern void set_mol2_write_assigned_atom_types (int s);
 
@@ -1717,6 +1728,9 @@ int is_actually_chiral (Molecule & m, atom_number_t zatom);
 extern int unconnect_covalently_bonded_non_organics_on_read ();
 extern void set_unconnect_covalently_bonded_non_organics_on_read (int);
 
+extern int  write_smiles_as_read_if_unmodified ();
+extern void set_write_smiles_as_read_if_unmodified (int);
+
 /*
   When asking for smarts from a molecule, we need to decide what kind of
   smarts do we want. Do we want a smarts that as completely describies the
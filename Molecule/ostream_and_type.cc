@@ -16,10 +16,35 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 **************************************************************************/
+#include "iw_async_streambuf.h"
+
 #include "ostream_and_type.h"
 
 #include "molecule.h"
 
+#define OFSTREAM_AND_TYPE_BUFFER_SIZE (1024 * 1024)
+
+static int use_writer_thread = 0;
+
+void
+set_ofstream_and_type_use_writer_thread (int s)
+{
+  use_writer_thread = s;
+}
+
+/*
+  When resuming from a checkpoint, existing files are extended rather
+  than overwritten, as if every name had a '>>' prefix
+*/
+
+static int open_for_append = 0;
+
+void
+set_ofstream_and_type_open_for_append (int s)
+{
+  open_for_append = s;
+}
+
 int
 ofstream_and_type::_default_values ()
 {
@@ -30,6 +55,9 @@ ofstream_and_type::_default_values ()
 
   _output_type = -1;
 
+  _stream_buffer = NULL;
+  _async = NULL;
+
   return 1;
 }
 
@@ -80,6 +108,14 @@ ofstream_and_type::~ofstream_and_type ()
 //if (_valid && good () && BFILE == _output_type)
 //  (*this) << "-1\n";
 
+  close ();
+
+  if (NULL != _async)
+    delete _async;
+
+  if (NULL != _stream_buffer)
+    delete [] _stream_buffer;
+
   return;
 }
 
@@ -105,16 +141,55 @@ ofstream_and_type::set_type (int t)
   return 1;
 }
 
+/*
+  Either give the filebuf a larger buffer, or replace it with an
+  IW_Async_Streambuf. Both must be done before anything is opened.
+*/
+
+int
+ofstream_and_type::_open (const char * fname, ios::openmode mode)
+{
+  if (use_writer_thread)
+  {
+    if (NULL == _async)
+      _async = new IW_Async_Streambuf;
+
+    _async->set_use_writer_thread (1);
+
+    if (! _async->open (fname, ios::app == mode))
+    {
+      setstate (ios::failbit);
+      return 0;
+    }
+
+    std::ios::rdbuf (_async);
+
+    return good ();
+  }
+
+  if (NULL == _stream_buffer)
+  {
+    _stream_buffer = new char[OFSTREAM_AND_TYPE_BUFFER_SIZE];
+    ofstream::rdbuf ()->pubsetbuf (_stream_buffer, OFSTREAM_AND_TYPE_BUFFER_SIZE);
+  }
+
+  ofstream::open (fname, mode);
+
+  return good ();
+}
+
 int
 ofstream_and_type::open (const char * fname)
 {
   if ('>' == *fname && strlen (fname) > 1 && '>' == fname[1])
   {
     fname += 2;
-    ofstream::open (fname, ios::app);
+    _open (fname, ios::app);
   }
+  else if (open_for_append)
+    _open (fname, ios::app);
   else
-    ofstream::open (fname, ios::out);
+    _open (fname, ios::out);
 
   if (good ())
     _fname = fname;
@@ -130,10 +205,12 @@ ofstream_and_type::open (IWString & fname)
   if (fname.starts_with (">>"))
   {
     fname.remove_leading_chars (2);
-    ofstream::open (fname.chars (), ios::app);
+    _open (fname.null_terminated_chars (), ios::app);
   }
+  else if (open_for_append)
+    _open (fname.null_terminated_chars (), ios::app);
   else
-    ofstream::open (fname.chars (), ios::out);
+    _open (fname.null_terminated_chars (), ios::out);
 
   if (good ())
     _fname = fname;
@@ -141,6 +218,29 @@ ofstream_and_type::open (IWString & fname)
   return good ();
 }
 
+int
+ofstream_and_type::is_open () const
+{
+  if (NULL != _async)
+    return _async->is_open ();
+
+  return ofstream::is_open ();
+}
+
+void
+ofstream_and_type::close ()
+{
+  if (NULL != _async)
+  {
+    flush ();
+    _async->close ();
+  }
+  else if (ofstream::is_open ())
+    ofstream::close ();
+
+  return;
+}
+
 int
 ofstream_and_type::write_molecule (Molecule * m)
 {
@@ -27,9 +27,16 @@ class Molecule;
 
 #include "iwaray.h"
 
+class IW_Async_Streambuf;
+
 /*
   This class consists of an ofstream which knows which kind of
   structure file to write.
+
+  Oct 2026. Output goes through a large buffer rather than the default
+  filebuf one. If requested, files are written by a separate writer
+  thread, in which case the stream's buffer is an IW_Async_Streambuf
+  rather than the ofstream's own filebuf.
 */
 
 class ofstream_and_type : public ofstream
@@ -41,9 +48,13 @@ class ofstream_and_type : public ofstream
     int _molecules_written;
     int _verbose;
 
+    char * _stream_buffer;
+    IW_Async_Streambuf * _async;
+
 //  private functions
 
     int _default_values ();
+    int _open (const char *, ios::openmode);
 
   public:
     ofstream_and_type ();
@@ -60,6 +71,9 @@ class ofstream_and_type : public ofstream
     int open (const char *);
     int open (IWString &);
 
+    int is_open () const;
+    void close ();
+
     int  set_type (int);
     void set_verbose (int verbose) {_verbose = verbose;}
 
@@ -71,4 +85,7 @@ class ofstream_and_type : public ofstream
     int write_molecules (const resizable_array_p<Molecule> &);
 };
 
+extern void set_ofstream_and_type_use_writer_thread (int);
+extern void set_ofstream_and_type_open_for_append (int);
+
 #endif
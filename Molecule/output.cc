@@ -17,6 +17,9 @@
 
 **************************************************************************/
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 #if defined (IWSGI) || (__GNUC_MINOR__ == 95)
 #include <strstream>
@@ -31,6 +34,100 @@
 #include "molecule.h"
 #include "smiles.h"
 
+static int flush_files_every_n_molecules = 0;
+static int flush_files_interval_ms = 0;
+
+void
+set_flush_files_every_n_molecules (int s)
+{
+  flush_files_every_n_molecules = s;
+}
+
+void
+set_flush_files_interval_ms (int s)
+{
+  flush_files_interval_ms = s;
+}
+
+static long long
+milliseconds_now ()
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+
+  return static_cast<long long>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+Output_Flush_Policy::Output_Flush_Policy ()
+{
+  _since_last_flush = 0;
+  _last_flush_ms = 0;
+
+  return;
+}
+
+int
+Output_Flush_Policy::time_to_flush ()
+{
+  if (flush_files_after_writing_each_molecule())     // -o flush
+    return 1;
+
+  if (0 == flush_files_every_n_molecules && 0 == flush_files_interval_ms)
+    return 0;
+
+  _since_last_flush++;
+
+  if (flush_files_every_n_molecules > 0 && _since_last_flush >= flush_files_every_n_molecules)
+  {
+    _since_last_flush = 0;
+    if (flush_files_interval_ms > 0)
+      _last_flush_ms = milliseconds_now ();
+    return 1;
+  }
+
+  if (flush_files_interval_ms > 0)
+  {
+    long long now = milliseconds_now ();
+
+    if (0 == _last_flush_ms)
+      _last_flush_ms = now;
+    else if (now - _last_flush_ms >= flush_files_interval_ms)
+    {
+      _since_last_flush = 0;
+      _last_flush_ms = now;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+  stdout is shared with anything else using stdio, so rather than
+  replacing its buffer, just make the stdio buffer large. Terminals
+  are left alone
+*/
+
+#define STDOUT_BUFFER_SIZE (1024 * 1024)
+
+static void
+enlarge_stdout_buffer ()
+{
+  static int done = 0;
+
+  if (done)
+    return;
+
+  done = 1;
+
+  if (isatty (1))
+    return;
+
+  setvbuf (stdout, NULL, _IOFBF, STDOUT_BUFFER_SIZE);
+
+  return;
+}
+
 void
 Molecule_Output_Object::_default_values()
 {
@@ -166,6 +263,9 @@ Molecule_Output_Object::do_close()
 int
 Molecule_Output_Object::do_flush()
 {
+  if (_use_stdout)
+    cout.flush();
+
   for (int i = 0; i < _number_elements; i++)
   {
     _things[i]->flush();
@@ -238,6 +338,8 @@ Molecule_Output_Object::new_stem (const const_IWSubstring & nstem,
 
     _use_stdout = 1;
 
+    enlarge_stdout_buffer();
+
     return 1;
   }
 
@@ -268,7 +370,11 @@ Molecule_Output_Object::write (Molecule & m)
       return 0;
 
     if (0 == _number_elements)    // just stdout
+    {
+      if (_flush_policy.time_to_flush())
+        cout.flush();
       return 1;
+    }
   }
 
   if (0 == _number_elements && 0 == _molecules_per_file && _name_token_for_fname < 0)
@@ -319,6 +425,9 @@ Molecule_Output_Object::write (Molecule & m)
 
   _molecules_written++;
 
+  if (_flush_policy.time_to_flush())
+    do_flush();
+
   return rc;
 }
 
@@ -485,7 +594,11 @@ display_output_help_screen (ostream & os, char opt)
 
   os << " -" << opt << " nochiral    exclude chirality info from smiles and mdl outputs\n";
   os << " -" << opt << " nochiralflag don't write the chiral flag info to mdl files\n";
+  os << " -" << opt << " asread      write smiles exactly as read, unless the structure was changed\n";
   os << " -" << opt << " flush       flush files after writing each molecule\n";
+  os << " -" << opt << " flush=<n>   flush files after every <n> molecules\n";
+  os << " -" << opt << " flushms=<t> flush files when <t> milliseconds have passed since the last flush\n";
+  os << " -" << opt << " wthread     files written by a separate writer thread\n";
   os << " -" << opt << " info        write any associated text info (if possible)\n";
   os << " -" << opt << " MULT        create multiple output files, one per molecule\n";
   os << " -" << opt << " MULT=nn     create multiple output files, <nn> molecules per file\n";
@@ -527,6 +640,40 @@ Molecule_Output_Object::determine_output_types (const Command_Line & cl,
       continue;
     }
 
+    if (c.starts_with ("flush="))
+    {
+      c.remove_leading_chars (6);
+      int n;
+      if (! c.numeric_value (n) || n < 1)
+      {
+        cerr << "The flush= qualifier must be followed by a whole positive number\n";
+        return 0;
+      }
+
+      set_flush_files_every_n_molecules (n);
+      continue;
+    }
+
+    if (c.starts_with ("flushms="))
+    {
+      c.remove_leading_chars (8);
+      int t;
+      if (! c.numeric_value (t) || t < 1)
+      {
+        cerr << "The flushms= qualifier must be followed by a whole positive number of milliseconds\n";
+        return 0;
+      }
+
+      set_flush_files_interval_ms (t);
+      continue;
+    }
+
+    if ("wthread" == c)
+    {
+      set_ofstream_and_type_use_writer_thread (1);
+      continue;
+    }
+
     if ("info" == c)
     {
       set_write_extra_text_info (1);
@@ -636,6 +783,12 @@ Molecule_Output_Object::determine_output_types (const Command_Line & cl,
       continue;
     }
 
+    if ("asread" == c)
+    {
+      set_write_smiles_as_read_if_unmodified (1);
+      continue;
+    }
+
     if ("DOS" == c)
     {
       set_write_DOS_records (1);
@@ -39,6 +39,30 @@
 class Command_Line;
 class Molecule;
 
+/*
+  Oct 2026. Output streams are heavily buffered, and by default only
+  flushed when closed. -o flush=<n> flushes every <n> molecules, and
+  -o flushms=<t> once <t> milliseconds have passed since the last flush.
+  -o flush continues to flush after every molecule.
+*/
+
+class Output_Flush_Policy
+{
+  private:
+    int _since_last_flush;
+    long long _last_flush_ms;
+
+  public:
+    Output_Flush_Policy ();
+
+//  Call after each record is written
+
+    int time_to_flush ();
+};
+
+extern void set_flush_files_every_n_molecules (int);
+extern void set_flush_files_interval_ms (int);
+
 
 class Molecule_Output_Object : public resizable_array_p<ofstream_and_type>
 {
@@ -68,6 +92,8 @@ class Molecule_Output_Object : public resizable_array_p<ofstream_and_type>
 
     int _use_stdout;
 
+    Output_Flush_Policy _flush_policy;
+
 //  private functions
 
     void _default_values ();
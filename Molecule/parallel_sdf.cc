@@ -0,0 +1,635 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+#include "iwaray.h"
+#include "iwstring_data_source.h"
+
+#include "element.h"
+#include "parallel_sdf.h"
+
+/*
+  The scanner reads this many bytes at a time. Consecutive records are
+  copied to a slot together, until the slot holds this many bytes or
+  records, so threads hand over work in reasonable sized pieces.
+*/
+
+#define PARALLEL_SDF_READ_SIZE (1024 * 1024)
+
+#define PARALLEL_SDF_BATCH_BYTES (64 * 1024)
+#define PARALLEL_SDF_BATCH_RECORDS 256
+
+#define SLOT_EMPTY 0
+#define SLOT_SCANNED 1
+#define SLOT_PARSING 2
+#define SLOT_READY 3
+
+struct Parallel_SDF_Slot
+{
+  int state;
+
+  char * text;
+  int nbytes;
+  int allocated;
+
+  off_t offset;       // of text[0] in the input
+
+  int nrecords;
+  int * record_end;   // record I is text[record_end[i-1] .. record_end[i])
+  void ** result;
+  int records_allocated;
+};
+
+static void *
+parallel_sdf_scanner_thread (void * p)
+{
+  reinterpret_cast<Parallel_SDF_Reader *>(p)->scanner();
+
+  return NULL;
+}
+
+static void *
+parallel_sdf_worker_thread (void * p)
+{
+  reinterpret_cast<Parallel_SDF_Reader *>(p)->worker();
+
+  return NULL;
+}
+
+Parallel_SDF_Reader::Parallel_SDF_Reader (iwstring_data_source & input,
+                                          int input_type,
+                                          sdf_record_parser parser,
+                                          sdf_record_deleter deleter,
+                                          int nworkers) : _input(input)
+{
+  _input_type = input_type;
+  _parser = parser;
+  _deleter = deleter;
+
+  if (nworkers < 1)
+    nworkers = 1;
+
+  _nworkers = nworkers;
+
+  _nslots = 2 * _nworkers + 2;
+
+  _slot = new Parallel_SDF_Slot[_nslots];
+
+  for (int i = 0; i < _nslots; i++)
+  {
+    Parallel_SDF_Slot & s = _slot[i];
+
+    s.state = SLOT_EMPTY;
+    s.text = NULL;
+    s.nbytes = 0;
+    s.allocated = 0;
+    s.offset = 0;
+    s.nrecords = 0;
+    s.record_end = NULL;
+    s.result = NULL;
+    s.records_allocated = 0;
+  }
+
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_changed, NULL);
+
+  _worker = new pthread_t[_nworkers];
+  _threads_running = 0;
+
+  _produced = _consumed = _next_to_parse = 0;
+  _have_current = 0;
+  _next_in_current = 0;
+  _producer_done = 0;
+  _error = 0;
+  _stop = 0;
+
+  _start_offset = 0;
+  _stop_offset = 0;
+
+  _pending = NULL;
+  _npending = 0;
+  _pending_allocated = 0;
+
+  return;
+}
+
+Parallel_SDF_Reader::~Parallel_SDF_Reader ()
+{
+  stop();
+
+// Results not yet handed to the consumer. Those before _next_in_current
+// in the current slot already were
+
+  for (off_t i = _consumed; i < _produced; i++)
+  {
+    Parallel_SDF_Slot & s = _slot[i % _nslots];
+
+    if (SLOT_READY != s.state)
+      continue;
+
+    int j = (i == _consumed && _have_current) ? _next_in_current : 0;
+
+    for ( ; j < s.nrecords; j++)
+    {
+      if (NULL != s.result[j])
+        _deleter(s.result[j]);
+    }
+  }
+
+  for (int i = 0; i < _nslots; i++)
+  {
+    Parallel_SDF_Slot & s = _slot[i];
+
+    if (NULL != s.text)
+      delete [] s.text;
+
+    if (NULL != s.record_end)
+    {
+      delete [] s.record_end;
+      delete [] s.result;
+    }
+  }
+
+  delete [] _slot;
+  delete [] _worker;
+
+  if (NULL != _pending)
+    delete [] _pending;
+
+  pthread_cond_destroy(&_changed);
+  pthread_mutex_destroy(&_mutex);
+
+  return;
+}
+
+/*
+  Reading starts wherever _input is now. No record starting at or beyond
+  STOP_OFFSET is returned
+*/
+
+int
+Parallel_SDF_Reader::start (off_t stop_offset)
+{
+  assert (0 == _threads_running);
+
+  if (_input.is_pipe())
+    _start_offset = 0;
+  else
+    _start_offset = _input.tellg();
+
+  _stop_offset = stop_offset;
+
+  if (0 != pthread_create(&_scanner, NULL, parallel_sdf_scanner_thread, this))
+  {
+    cerr << "Parallel_SDF_Reader::start:cannot create scanner thread\n";
+    return 0;
+  }
+
+  _threads_running = 1;
+
+  set_element_table_shared_between_threads(1);    // parsers may create elements
+
+  for (int i = 0; i < _nworkers; i++)
+  {
+    if (0 != pthread_create(_worker + i, NULL, parallel_sdf_worker_thread, this))
+    {
+      cerr << "Parallel_SDF_Reader::start:cannot create parse thread\n";
+      stop();
+      return 0;
+    }
+
+    _threads_running++;
+  }
+
+  return 1;
+}
+
+void
+Parallel_SDF_Reader::stop ()
+{
+  if (0 == _threads_running)
+    return;
+
+  pthread_mutex_lock(&_mutex);
+  _stop = 1;
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  pthread_join(_scanner, NULL);
+  for (int i = 0; i < _threads_running - 1; i++)
+  {
+    pthread_join(_worker[i], NULL);
+  }
+
+  _threads_running = 0;
+
+  set_element_table_shared_between_threads(0);
+
+  return;
+}
+
+/*
+  Move everything from START down to the front of _pending and append
+  more data. Returns the number of bytes read, 0 at EOF
+*/
+
+int
+Parallel_SDF_Reader::_fill_pending (int & start)
+{
+  if (start > 0)
+  {
+    _npending -= start;
+    if (_npending > 0)
+      memmove(_pending, _pending + start, _npending);
+    start = 0;
+  }
+
+  if (_pending_allocated - _npending < PARALLEL_SDF_READ_SIZE)
+  {
+    int new_size = _npending + PARALLEL_SDF_READ_SIZE;
+    if (new_size < 2 * _pending_allocated)
+      new_size = 2 * _pending_allocated;
+
+    char * tmp = new char[new_size];
+    if (_npending > 0)
+      memcpy(tmp, _pending, _npending);
+
+    if (NULL != _pending)
+      delete [] _pending;
+
+    _pending = tmp;
+    _pending_allocated = new_size;
+  }
+
+  int nread = _input.read_bytes(_pending + _npending, PARALLEL_SDF_READ_SIZE);
+
+  if (nread > 0)
+    _npending += nread;
+
+  return nread;
+}
+
+/*
+  Look for a '$$$$' line in the record beginning at START, scanning from
+  FROM. END is set to just beyond the newline that ends it. Returns 0 if
+  the record is not yet complete
+*/
+
+int
+Parallel_SDF_Reader::_find_end_of_record (int start,
+                                          int from,
+                                          int & end) const
+{
+  int i = from;
+
+  while (i < _npending)
+  {
+    const char * p = reinterpret_cast<const char *>(memchr(_pending + i, '$', _npending - i));
+    if (NULL == p)
+      return 0;
+
+    int j = p - _pending;
+
+    if (j + 4 > _npending)
+      return 0;
+
+    if ((j == start || '\n' == _pending[j - 1]) && 0 == strncmp(p, "$$$$", 4))
+    {
+      const char * nl = reinterpret_cast<const char *>(memchr(p + 4, '\n', _npending - j - 4));
+      if (NULL == nl)
+        return 0;
+
+      end = nl - _pending + 1;
+      return 1;
+    }
+
+    i = j + 1;
+  }
+
+  return 0;
+}
+
+int
+Parallel_SDF_Reader::_wait_for_empty_slot ()
+{
+  pthread_mutex_lock(&_mutex);
+
+  while (! _stop && _produced - _consumed >= _nslots)
+  {
+    pthread_cond_wait(&_changed, &_mutex);
+  }
+
+  int rc = ! _stop;
+
+  pthread_mutex_unlock(&_mutex);
+
+  return rc;
+}
+
+/*
+  Copy NRECORDS consecutive records, NBYTES in all, to the next slot.
+  RECORD_END holds the end of each record relative to S.
+  Only the scanner writes to a slot that is empty, so the copy can be
+  done without the lock
+*/
+
+void
+Parallel_SDF_Reader::_publish (const char * s,
+                               int nbytes,
+                               off_t offset,
+                               const int * record_end,
+                               int nrecords)
+{
+  Parallel_SDF_Slot & slot = _slot[_produced % _nslots];
+
+  if (slot.allocated < nbytes + 1)
+  {
+    if (NULL != slot.text)
+      delete [] slot.text;
+
+    slot.allocated = nbytes + 1 + nbytes / 2;
+    slot.text = new char[slot.allocated];
+  }
+
+  if (slot.records_allocated < nrecords)
+  {
+    if (NULL != slot.record_end)
+    {
+      delete [] slot.record_end;
+      delete [] slot.result;
+    }
+
+    slot.records_allocated = nrecords;
+    slot.record_end = new int[nrecords];
+    slot.result = new void *[nrecords];
+  }
+
+  memcpy(slot.text, s, nbytes);
+  slot.text[nbytes] = '\0';
+  slot.nbytes = nbytes;
+  slot.offset = offset;
+
+  for (int i = 0; i < nrecords; i++)
+  {
+    slot.record_end[i] = record_end[i];
+    slot.result[i] = NULL;
+  }
+
+  slot.nrecords = nrecords;
+
+  pthread_mutex_lock(&_mutex);
+
+  slot.state = SLOT_SCANNED;
+  _produced++;
+
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  return;
+}
+
+static int
+all_white_space (const char * s, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (! isspace(s[i]))
+      return 0;
+  }
+
+  return 1;
+}
+
+int
+sdf_record_is_complete (const char * record, int nbytes)
+{
+  while (nbytes > 0 && isspace(record[nbytes - 1]))
+  {
+    nbytes--;
+  }
+
+  if (nbytes < 4 || 0 != strncmp(record + nbytes - 4, "$$$$", 4))
+    return 0;
+
+  return 4 == nbytes || '\n' == record[nbytes - 5];
+}
+
+/*
+  _pending[start] is the start of the current batch. Records found so far
+  in the batch end at the offsets, relative to START, in RECORD_END
+*/
+
+void
+Parallel_SDF_Reader::scanner ()
+{
+  off_t offset = _start_offset;     // of _pending[start]
+
+  int start = 0;
+  int rstart = 0;      // start of the record being looked for
+
+  resizable_array<int> record_end;
+
+  int past_stop = 0;
+
+  while (1)
+  {
+    int end;
+    if (! past_stop && _find_end_of_record(rstart, rstart, end))
+    {
+      if (offset + (rstart - start) >= _stop_offset)
+        past_stop = 1;
+      else
+      {
+        record_end.add(end - start);
+        rstart = end;
+      }
+
+      if (! past_stop && rstart - start < PARALLEL_SDF_BATCH_BYTES && record_end.number_elements() < PARALLEL_SDF_BATCH_RECORDS)
+        continue;
+    }
+    else if (! past_stop)
+    {
+      int nread = _fill_pending(start);
+
+      rstart = start + (record_end.number_elements() ? record_end.last_item() : 0);
+
+      if (nread > 0)
+        continue;
+
+      if (nread < 0)
+      {
+        cerr << "Parallel_SDF_Reader::scanner:read error at " << offset << endl;
+        pthread_mutex_lock(&_mutex);
+        _error = 1;
+        pthread_mutex_unlock(&_mutex);
+        break;
+      }
+
+//    EOF. Anything left does not end with '$$$$', let the parser decide
+
+      if (rstart < _npending && offset + (rstart - start) < _stop_offset && ! all_white_space(_pending + rstart, _npending - rstart))
+      {
+        record_end.add(_npending - start);
+        rstart = _npending;
+      }
+
+      past_stop = 1;
+    }
+
+    if (record_end.number_elements())
+    {
+      if (! _wait_for_empty_slot())
+        break;
+
+      int n = record_end.number_elements();
+
+      _publish(_pending + start, record_end[n - 1], offset, record_end.rawdata(), n);
+
+      offset += record_end[n - 1];
+      start = rstart;
+      record_end.resize_keep_storage(0);
+    }
+
+    if (past_stop)
+      break;
+  }
+
+  pthread_mutex_lock(&_mutex);
+  _producer_done = 1;
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  return;
+}
+
+void
+Parallel_SDF_Reader::worker ()
+{
+  pthread_mutex_lock(&_mutex);
+
+  while (1)
+  {
+    while (! _stop && ! _error && _next_to_parse >= _produced && ! _producer_done)
+    {
+      pthread_cond_wait(&_changed, &_mutex);
+    }
+
+    if (_stop || _error || _next_to_parse >= _produced)
+      break;
+
+    Parallel_SDF_Slot & s = _slot[_next_to_parse % _nslots];
+    _next_to_parse++;
+
+    s.state = SLOT_PARSING;
+
+    pthread_mutex_unlock(&_mutex);
+
+    int rstart = 0;
+    for (int i = 0; i < s.nrecords; i++)
+    {
+      s.result[i] = _parser(s.text + rstart, s.record_end[i] - rstart, _input_type);
+      rstart = s.record_end[i];
+    }
+
+    pthread_mutex_lock(&_mutex);
+
+    s.state = SLOT_READY;
+
+    pthread_cond_broadcast(&_changed);
+  }
+
+  pthread_mutex_unlock(&_mutex);
+
+  return;
+}
+
+int
+Parallel_SDF_Reader::next_record (void * & result,
+                                  const char * & text,
+                                  int & nbytes,
+                                  off_t & offset)
+{
+  if (_have_current)     // no lock needed, the slot is ours
+  {
+    Parallel_SDF_Slot & s = _slot[_consumed % _nslots];
+
+    if (_next_in_current < s.nrecords)
+    {
+      int rstart = s.record_end[_next_in_current - 1];
+      result = s.result[_next_in_current];
+      s.result[_next_in_current] = NULL;
+      text = s.text + rstart;
+      nbytes = s.record_end[_next_in_current] - rstart;
+      offset = s.offset + rstart;
+      _next_in_current++;
+      return 1;
+    }
+  }
+
+  pthread_mutex_lock(&_mutex);
+
+  if (_have_current)
+  {
+    _slot[_consumed % _nslots].state = SLOT_EMPTY;
+    _consumed++;
+    _have_current = 0;
+    pthread_cond_broadcast(&_changed);
+  }
+
+  while (! _error)
+  {
+    if (_consumed < _produced && SLOT_READY == _slot[_consumed % _nslots].state)
+      break;
+
+    if (_producer_done && _consumed == _produced)
+      break;
+
+    pthread_cond_wait(&_changed, &_mutex);
+  }
+
+  int rc;
+
+  if (_error)
+    rc = -1;
+  else if (_consumed == _produced)
+    rc = 0;
+  else
+  {
+    Parallel_SDF_Slot & s = _slot[_consumed % _nslots];
+    result = s.result[0];
+    s.result[0] = NULL;
+    text = s.text;
+    nbytes = s.record_end[0];
+    offset = s.offset;
+    _have_current = 1;
+    _next_in_current = 1;
+    rc = 1;
+  }
+
+  pthread_mutex_unlock(&_mutex);
+
+  return rc;
+}
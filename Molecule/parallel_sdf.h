@@ -0,0 +1,127 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_PARALLEL_SDF_H
+#define IW_PARALLEL_SDF_H
+
+/*
+  Oct 2026. Parallel parsing of SD files.
+
+  A scanner thread pulls raw bytes from the input and cuts them into
+  whole records at each '$$$$' line. Batches of consecutive records go
+  into a bounded ring of slots, and a pool of worker threads turns each
+  record into a molecule. The consumer takes parsed records strictly in
+  file order, so the molecules come out in exactly the order a serial
+  reader would return them.
+
+  The reader knows nothing about molecules. Records are parsed by a
+  caller supplied function, which returns NULL on failure, so the
+  consumer can handle connection table errors.
+*/
+
+#include <pthread.h>
+#include <sys/types.h>
+
+class iwstring_data_source;
+
+//  Parse NBYTES of record text as INPUT_TYPE, return a new object or NULL.
+//  The deleter frees results that were never handed to the consumer
+
+typedef void * (*sdf_record_parser) (const char * record, int nbytes, int input_type);
+typedef void (*sdf_record_deleter) (void *);
+
+//  True if the record ends with a '$$$$' line
+
+extern int sdf_record_is_complete (const char * record, int nbytes);
+
+struct Parallel_SDF_Slot;
+
+class Parallel_SDF_Reader
+{
+  private:
+    iwstring_data_source & _input;
+
+    int _input_type;
+
+    sdf_record_parser _parser;
+    sdf_record_deleter _deleter;
+
+    int _nworkers;
+
+    int _nslots;
+    Parallel_SDF_Slot * _slot;
+
+    pthread_mutex_t _mutex;
+    pthread_cond_t _changed;
+
+//  Sequence numbers. Slot for sequence number S is S % _nslots
+
+    off_t _produced;
+    off_t _consumed;
+    off_t _next_to_parse;
+
+    int _have_current;
+    int _next_in_current;     // next record to return from the current slot
+
+    int _producer_done;
+    int _error;
+    int _stop;
+
+    pthread_t _scanner;
+    pthread_t * _worker;
+    int _threads_running;
+
+//  Offset of the first byte the scanner reads, and the offset beyond which
+//  no record may start
+
+    off_t _start_offset;
+    off_t _stop_offset;
+
+//  Bytes read from _input, but not yet cut into records
+
+    char * _pending;
+    int _npending;
+    int _pending_allocated;
+
+//  private functions
+
+    int  _fill_pending (int & start);
+    int  _find_end_of_record (int start, int from, int & end) const;
+    int  _wait_for_empty_slot ();
+    void _publish (const char * s, int nbytes, off_t offset, const int * record_end, int nrecords);
+
+  public:
+    Parallel_SDF_Reader (iwstring_data_source &, int input_type,
+                         sdf_record_parser, sdf_record_deleter, int nworkers);
+    ~Parallel_SDF_Reader ();
+
+    int start (off_t stop_offset);
+    void stop ();
+
+//  Hands over the next parsed record. RESULT is whatever the parser
+//  returned and now belongs to the caller. TEXT, NBYTES and OFFSET
+//  describe the raw record and are valid until the next call.
+//  Returns 1 with a record, 0 at end of data, -1 on error
+
+    int next_record (void * & result, const char * & text, int & nbytes, off_t & offset);
+
+    void scanner ();
+    void worker ();
+};
+
+#endif
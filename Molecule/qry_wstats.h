@@ -45,6 +45,15 @@ class Substructure_Hit_Statistics : public Substructure_Query
     int _molecules_which_do_not_match;
     extending_resizable_array<int> _molecules_which_match_n_times;
 
+//  Oct 2026. Only accumulated while substructure_search_profiling () is on
+
+    iw_uint64_t _searches;
+    iw_uint64_t _cycles;
+    iw_uint64_t _max_cycles;
+    iw_uint64_t _embeddings_found;
+    iw_uint64_t _backtrack_steps;
+    iw_uint64_t _environment_cycles;
+
 //  private functions
 
   private:
@@ -53,6 +62,7 @@ class Substructure_Hit_Statistics : public Substructure_Query
     int  _set_stream (int, const char *, ofstream_and_type &);
     int  _update_matches (int, Molecule *, const Substructure_Results &);
     int  _update_name_if_needed (int, Molecule *);
+    int  _profiled_search (Molecule_to_Match &, Substructure_Results &);
 
   public:
     Substructure_Hit_Statistics ();
@@ -71,6 +81,11 @@ class Substructure_Hit_Statistics : public Substructure_Query
     int substructure_search (Molecule_to_Match &);
     int substructure_search (Molecule_to_Match &, Substructure_Results &);
 
+//  Oct 2026. The caller knows the query cannot match, the statistics are
+//  updated as if a search had found nothing
+
+    int no_match (Molecule_to_Match &, Substructure_Results &);
+
     int set_stream_for_matches     (int, const char *);
     int set_stream_for_non_matches (int, const char *);
 
@@ -84,9 +99,27 @@ class Substructure_Hit_Statistics : public Substructure_Query
       {_append_non_match_details_to_molecule_name = ii;}
 
     int report (ostream & os, int verbose) const;
+
+//  Oct 2026. For checkpointing a long run, the counters as a single line of text
+
+    int write_hit_counts (ostream &) const;
+    int restore_hit_counts (const const_IWSubstring &);
+
+    iw_uint64_t profile_cycles () const { return _cycles;}
+
+    int report_profile (ostream &, double cycles_per_second) const;
+    int write_profile (ostream &, double cycles_per_second) const;
 };
 
 extern ostream & operator << (ostream &, const Substructure_Hit_Statistics &);
 
+/*
+  Oct 2026. With substructure_search_profiling on, the most expensive
+  NSHOW queries, and a tab separated file with every query
+*/
+
+extern int report_query_profile (resizable_array<Substructure_Hit_Statistics *> &, int nshow, ostream &);
+extern int write_query_profile (resizable_array<Substructure_Hit_Statistics *> &, ostream &);
+
 
 #endif
@@ -0,0 +1,229 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+#include "misc.h"
+#include "iw_stl_hash_map.h"
+
+#include "qry_wstats.h"
+#include "target.h"
+#include "query_index.h"
+
+Query_Index::Query_Index ()
+{
+  _active = 0;
+
+  _nq = 0;
+
+  _record = NULL;
+  _record_ok = NULL;
+
+  _molecules = 0;
+  _skipped = 0;
+
+  return;
+}
+
+Query_Index::~Query_Index ()
+{
+  if (NULL != _record)
+    delete [] _record;
+
+  if (NULL != _record_ok)
+    delete [] _record_ok;
+
+  return;
+}
+
+/*
+  Carbon is in nearly everything, Nitrogen and Oxygen in most things,
+  anything else is rare. Among equals prefer the heavier element
+*/
+
+static int
+rarity (int z)
+{
+  if (6 == z)
+    return 0;
+
+  if (7 == z || 8 == z)
+    return 1;
+
+  return 2;
+}
+
+int
+Query_Index::_rarest (int rstart, int rstop) const
+{
+  int rc = rstart;
+
+  for (int i = rstart + 1; i < rstop; i++)
+  {
+    int ri = rarity (_z[i]);
+    int rr = rarity (_z[rc]);
+
+    if (ri > rr || (ri == rr && _z[i] > _z[rc]))
+      rc = i;
+  }
+
+  return _z[rc];
+}
+
+int
+Query_Index::build (const resizable_array_p<Substructure_Hit_Statistics> & queries)
+{
+  _nq = queries.number_elements ();
+
+  _record = new int[_nq];
+
+  _record_start.add (0);
+
+  IW_STL_Hash_Map_int signature_to_record;
+
+  int * count = new int[HIGHEST_ATOMIC_NUMBER + 1];
+
+  for (int i = 0; i < _nq; i++)
+  {
+    _record[i] = -1;
+
+    set_vector (count, HIGHEST_ATOMIC_NUMBER + 1, 0);
+
+    if (! queries[i]->required_elements (count))
+      continue;
+
+    IWString signature;
+    for (int z = 0; z <= HIGHEST_ATOMIC_NUMBER; z++)
+    {
+      if (count[z])
+        signature << ' ' << z << ':' << count[z];
+    }
+
+    if (0 == signature.length ())     // nothing specific required
+      continue;
+
+    IW_STL_Hash_Map_int::const_iterator f = signature_to_record.find (signature);
+    if (f != signature_to_record.end ())
+    {
+      _record[i] = (*f).second;
+      continue;
+    }
+
+    int r = _record_start.number_elements () - 1;
+
+    for (int z = 0; z <= HIGHEST_ATOMIC_NUMBER; z++)
+    {
+      if (0 == count[z])
+        continue;
+
+      _z.add (z);
+      _count.add (count[z]);
+    }
+
+    _record_start.add (_z.number_elements ());
+
+    _by_element[_rarest (_record_start[r], _record_start[r + 1])].add (r);
+
+    signature_to_record[signature] = r;
+    _record[i] = r;
+  }
+
+  delete [] count;
+
+  _record_ok = new_int (number_records () + 1);
+
+  return 1;
+}
+
+int
+Query_Index::queries_indexed () const
+{
+  int rc = 0;
+
+  for (int i = 0; i < _nq; i++)
+  {
+    if (_record[i] >= 0)
+      rc++;
+  }
+
+  return rc;
+}
+
+int
+Query_Index::_record_matches (int r) const
+{
+  for (int i = _record_start[r]; i < _record_start[r + 1]; i++)
+  {
+    if (_element_count[_z[i]] < _count[i])
+      return 0;
+  }
+
+  return 1;
+}
+
+int
+Query_Index::prepare (Molecule_to_Match & target)
+{
+  _molecules++;
+
+  set_vector (_element_count, HIGHEST_ATOMIC_NUMBER + 1, 0);
+  set_vector (_record_ok, number_records (), 0);
+
+  const Molecule * m = target.molecule ();
+
+  int matoms = m->natoms ();
+
+  for (int i = 0; i < matoms; i++)
+  {
+    atomic_number_t z = m->atomic_number (i);
+
+    if (REASONABLE_ATOMIC_NUMBER (z))
+      _element_count[z]++;
+  }
+
+  for (int z = 0; z <= HIGHEST_ATOMIC_NUMBER; z++)
+  {
+    if (0 == _element_count[z])
+      continue;
+
+    const resizable_array<int> & b = _by_element[z];
+
+    for (int i = 0; i < b.number_elements (); i++)
+    {
+      int r = b[i];
+      _record_ok[r] = _record_matches (r);
+    }
+  }
+
+  return 1;
+}
+
+int
+Query_Index::report (std::ostream & os) const
+{
+  os << "Query index: " << queries_indexed () << " of " << _nq << " queries indexed, " << number_records () << " distinct requirements\n";
+
+  if (_molecules > 0)
+    os << _skipped << " searches avoided over " << _molecules << " molecules, " << static_cast<float> (_skipped) / static_cast<float> (_molecules) << " per molecule\n";
+
+  return os.good ();
+}
@@ -0,0 +1,105 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_QUERY_INDEX_H
+#define IW_QUERY_INDEX_H
+
+/*
+  Oct 2026. With thousands of queries, most of them cannot match a given
+  molecule simply because it lacks an element they need.
+
+  A Query_Index collects, for each query, the elements any match must
+  contain - see Substructure_Query::required_elements. Queries with the
+  same requirements share one record, which is filed under its rarest
+  element. For each molecule only the records filed under elements the
+  molecule contains are examined, and only queries whose requirements
+  are met are candidates. Queries about which nothing can be said are
+  always candidates.
+
+  A query that is not a candidate would have found no match, so callers
+  record a non match instead of searching.
+*/
+
+#include <iostream>
+
+#include "iwaray.h"
+#include "iwmtypes.h"
+#include "element.h"
+
+class Substructure_Hit_Statistics;
+class Molecule_to_Match;
+
+class Query_Index
+{
+  private:
+    int _active;
+
+    int _nq;
+
+//  For each query, the requirement record it uses, or -1 if it must always be searched
+
+    int * _record;
+
+//  Requirements are stored as pairs of atomic number and count, those for
+//  record R are from _record_start[R] to _record_start[R+1]
+
+    resizable_array<int> _record_start;
+    resizable_array<int> _z;
+    resizable_array<int> _count;
+
+//  Records filed under their rarest element
+
+    resizable_array<int> _by_element[HIGHEST_ATOMIC_NUMBER + 1];
+
+//  For the current molecule
+
+    int _element_count[HIGHEST_ATOMIC_NUMBER + 1];
+    int * _record_ok;
+
+    iw_uint64_t _molecules;
+    iw_uint64_t _skipped;
+
+//  private functions
+
+    int _rarest (int rstart, int rstop) const;
+    int _record_matches (int r) const;
+
+  public:
+    Query_Index ();
+    ~Query_Index ();
+
+    void set_active (int s) { _active = s;}
+    int active () const { return _active;}
+
+    int build (const resizable_array_p<Substructure_Hit_Statistics> &);
+
+    int queries_indexed () const;
+    int number_records () const { return _record_start.number_elements () - 1;}
+
+//  Must be called before candidate () for each molecule
+
+    int prepare (Molecule_to_Match &);
+
+    int candidate (int q) const { return _record[q] < 0 || _record_ok[_record[q]];}
+
+    void skipped () { _skipped++;}
+
+    int report (std::ostream &) const;
+};
+
+#endif
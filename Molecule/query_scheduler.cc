@@ -0,0 +1,307 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+
+using std::cerr;
+using std::endl;
+
+#include "iwstring_data_source.h"
+#include "iw_stl_hash_map.h"
+
+#include "qry_wstats.h"
+#include "query_scheduler.h"
+
+/*
+  Profile values are scaled to at most this many runs, so what is
+  learned in this run can still change the order
+*/
+
+#define QUERY_SCHEDULER_PROFILE_WEIGHT 1000
+
+Query_Scheduler::Query_Scheduler ()
+{
+  _active = 0;
+
+  _nq = 0;
+
+  _order = NULL;
+  _runs = NULL;
+  _rejections = NULL;
+  _cycles = NULL;
+
+  _reorder_every = 1000;
+  _molecules_since_reorder = 0;
+  _reorders = 0;
+
+  return;
+}
+
+Query_Scheduler::~Query_Scheduler ()
+{
+  _free_arrays ();
+
+  return;
+}
+
+void
+Query_Scheduler::_free_arrays ()
+{
+  if (NULL != _order)
+  {
+    delete [] _order;
+    delete [] _runs;
+    delete [] _rejections;
+    delete [] _cycles;
+  }
+
+  _order = NULL;
+  _runs = NULL;
+  _rejections = NULL;
+  _cycles = NULL;
+
+  return;
+}
+
+void
+display_query_scheduler_options (std::ostream & os, char flag)
+{
+  os << " -" << flag << " adapt        try the queries most likely to reject, per unit time, first\n";
+  os << " -" << flag << " every=<n>    reconsider the order every <n> molecules\n";
+  os << " -" << flag << " prof=<fname> start from a query profile written by an earlier run\n";
+  os << "              which molecules are rejected, or match, does not change\n";
+
+  return;
+}
+
+int
+Query_Scheduler::parse_directive (const const_IWSubstring & d)
+{
+  const_IWSubstring s (d);
+
+  if ("adapt" == s)
+    ;
+  else if (s.starts_with ("every="))
+  {
+    s.remove_leading_chars (6);
+    if (! s.numeric_value (_reorder_every) || _reorder_every < 1)
+    {
+      cerr << "Query_Scheduler::parse_directive:invalid reorder interval '" << d << "'\n";
+      return 0;
+    }
+  }
+  else if (s.starts_with ("prof="))
+  {
+    s.remove_leading_chars (5);
+    _profile = s;
+  }
+  else
+    return 0;
+
+  _active = 1;
+
+  return 1;
+}
+
+int
+Query_Scheduler::initialise (const resizable_array_p<Substructure_Hit_Statistics> & queries,
+                             const int * rejects_on_match)
+{
+  _free_arrays ();
+
+  _nq = queries.number_elements ();
+
+  _order = new int[_nq];
+  _runs = new iw_uint64_t[_nq];
+  _rejections = new iw_uint64_t[_nq];
+  _cycles = new iw_uint64_t[_nq];
+
+  for (int i = 0; i < _nq; i++)
+  {
+    _order[i] = i;
+    _runs[i] = 0;
+    _rejections[i] = 0;
+    _cycles[i] = 0;
+  }
+
+  if (_profile.length () && ! _read_profile (queries, rejects_on_match))
+    return 0;
+
+  _reorder ();
+
+  return 1;
+}
+
+/*
+  The tab separated file from write_query_profile. We use searches,
+  cycles and molecules matched, and the query name
+*/
+
+int
+Query_Scheduler::_read_profile (const resizable_array_p<Substructure_Hit_Statistics> & queries,
+                                const int * rejects_on_match)
+{
+  iwstring_data_source input (_profile.null_terminated_chars ());
+
+  if (! input.good ())
+  {
+    cerr << "Query_Scheduler::_read_profile:cannot open '" << _profile << "'\n";
+    return 0;
+  }
+
+  IW_STL_Hash_Map_int name_to_query;
+  for (int i = 0; i < _nq; i++)
+  {
+    name_to_query[queries[i]->comment ()] = i;
+  }
+
+  int found = 0;
+
+  const_IWSubstring buffer;
+  while (input.next_record (buffer))
+  {
+    if (buffer.starts_with ('#') || buffer.starts_with ("searches"))
+      continue;
+
+    const_IWSubstring token;
+    int i = 0;
+
+    long long searches, cycles, matched;
+    int ok = 1;
+
+    ok = ok && buffer.nextword (token, i, '\t') && token.numeric_value (searches);
+    ok = ok && buffer.nextword (token, i, '\t') && token.numeric_value (cycles);
+    ok = ok && buffer.nextword (token, i, '\t');     // seconds
+    ok = ok && buffer.nextword (token, i, '\t');     // max cycles
+    ok = ok && buffer.nextword (token, i, '\t') && token.numeric_value (matched);
+
+    if (! ok || searches < 0 || cycles < 0 || matched < 0)
+    {
+      cerr << "Query_Scheduler::_read_profile:invalid profile record '" << buffer << "'\n";
+      return 0;
+    }
+
+    ok = buffer.nextword (token, i, '\t') && buffer.nextword (token, i, '\t') &&
+         buffer.nextword (token, i, '\t');    // embeddings, backtracks, environment cycles
+
+    if (! ok || i >= buffer.length ())
+    {
+      cerr << "Query_Scheduler::_read_profile:no query name '" << buffer << "'\n";
+      return 0;
+    }
+
+    IWString qname (buffer);
+    qname.remove_leading_chars (i);
+    qname.strip_leading_blanks ();
+
+    IW_STL_Hash_Map_int::const_iterator f = name_to_query.find (qname);
+    if (f == name_to_query.end () || 0 == searches)
+      continue;
+
+    const int q = (*f).second;
+
+    double scale = 1.0;
+    if (searches > QUERY_SCHEDULER_PROFILE_WEIGHT)
+      scale = static_cast<double> (QUERY_SCHEDULER_PROFILE_WEIGHT) / static_cast<double> (searches);
+
+    _runs[q] = static_cast<iw_uint64_t> (searches * scale + 0.5);
+    _cycles[q] = static_cast<iw_uint64_t> (cycles * scale + 0.5);
+    if (NULL == rejects_on_match || rejects_on_match[q])
+      _rejections[q] = static_cast<iw_uint64_t> (matched * scale + 0.5);
+
+    found++;
+  }
+
+  if (0 == found)
+  {
+    cerr << "Query_Scheduler::_read_profile:no queries from '" << _profile << "' match\n";
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+  Queries never run sort first, so they get measured. Otherwise by
+  (rejections + 1) / (runs + 2) / mean cycles, ties in the original order
+*/
+
+class Query_Payoff_Comparator
+{
+  private:
+    const double * _payoff;
+
+  public:
+    Query_Payoff_Comparator (const double * p) : _payoff (p) {}
+
+    bool operator () (int q1, int q2) const
+      {
+        if (_payoff[q1] != _payoff[q2])
+          return _payoff[q1] > _payoff[q2];
+
+        return q1 < q2;
+      }
+};
+
+void
+Query_Scheduler::_reorder ()
+{
+  _molecules_since_reorder = 0;
+  _reorders++;
+
+  double * payoff = new double[_nq];
+
+  for (int i = 0; i < _nq; i++)
+  {
+    if (0 == _runs[i])
+    {
+      payoff[i] = 1.0e+30;
+      continue;
+    }
+
+    const double p = static_cast<double> (_rejections[i] + 1) / static_cast<double> (_runs[i] + 2);
+    const double cost = static_cast<double> (_cycles[i] + 1) / static_cast<double> (_runs[i]);
+
+    payoff[i] = p / cost;
+  }
+
+  std::sort (_order, _order + _nq, Query_Payoff_Comparator (payoff));
+
+  delete [] payoff;
+
+  return;
+}
+
+int
+Query_Scheduler::report (const resizable_array_p<Substructure_Hit_Statistics> & queries,
+                         std::ostream & os) const
+{
+  os << "Query order recomputed " << _reorders << " times, current order";
+
+  for (int i = 0; i < _nq && i < 10; i++)
+  {
+    const int q = _order[i];
+    os << "\n " << q << " '" << queries[q]->comment () << "' " << _rejections[q] << " rejections in " << _runs[q] << " runs";
+  }
+
+  os << '\n';
+
+  return os.good ();
+}
@@ -0,0 +1,117 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_QUERY_SCHEDULER_H
+#define IW_QUERY_SCHEDULER_H
+
+/*
+  Oct 2026. When a molecule is finished at its first rejection, queries
+  that often reject and are cheap to run are best tried first.
+
+  A Query_Scheduler keeps, for each query, how often it has been run,
+  how often it rejected, and the time it took, and orders queries by
+  expected payoff - probability of rejection divided by mean cost. The
+  order is recomputed every so many molecules. Initial values can come
+  from a profile written by iwdemerit -p or tsubstructure -M profile=.
+
+  Whether a molecule is rejected does not depend on the order, but the
+  query reported as the reason can. Callers only use a scheduler when
+  the reason is not written anywhere.
+*/
+
+#include <iostream>
+
+#include "iwstring.h"
+#include "iwaray.h"
+#include "iwmtypes.h"
+
+class Substructure_Hit_Statistics;
+
+class Query_Scheduler
+{
+  private:
+    int _active;
+
+    int _nq;
+
+//  The order in which queries are to be tried
+
+    int * _order;
+
+    iw_uint64_t * _runs;
+    iw_uint64_t * _rejections;
+    iw_uint64_t * _cycles;
+
+    int _reorder_every;
+    int _molecules_since_reorder;
+    int _reorders;
+
+    IWString _profile;
+
+//  private functions
+
+    void _free_arrays ();
+    int _read_profile (const resizable_array_p<Substructure_Hit_Statistics> &,
+                       const int * rejects_on_match);
+    void _reorder ();
+
+  public:
+    Query_Scheduler ();
+    ~Query_Scheduler ();
+
+    void set_active (int s) { _active = s;}
+    int active () const { return _active;}
+
+    void set_reorder_every (int s) { _reorder_every = s;}
+    void set_profile (const const_IWSubstring & s) { _profile = s;}
+
+//  Recognises every=<n> and prof=<fname>, returns 0 for anything else
+
+    int parse_directive (const const_IWSubstring &);
+
+//  Called once the queries exist. REJECTS_ON_MATCH says which queries
+//  reject a molecule with a single match, used for the profile only,
+//  NULL means they all do
+
+    int initialise (const resizable_array_p<Substructure_Hit_Statistics> &,
+                    const int * rejects_on_match);
+
+    int initialised () const { return NULL != _order;}
+
+    const int * order () const { return _order;}
+
+    void record (int q, int rejected, iw_uint64_t cycles)
+      {
+        _runs[q]++;
+        _rejections[q] += rejected;
+        _cycles[q] += cycles;
+      }
+
+    void molecule_done ()
+      {
+        _molecules_since_reorder++;
+        if (_molecules_since_reorder >= _reorder_every)
+          _reorder ();
+      }
+
+    int report (const resizable_array_p<Substructure_Hit_Statistics> &, std::ostream &) const;
+};
+
+extern void display_query_scheduler_options (std::ostream &, char);
+
+#endif
@@ -0,0 +1,746 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+#include "result_cache.h"
+
+#define RESULT_CACHE_LOG_MAGIC "IWRL"
+#define RESULT_CACHE_IDX_MAGIC "IWRI"
+#define RESULT_CACHE_VERSION 1
+
+#define RESULT_CACHE_LOG_HEADER_SIZE 8
+
+//  Each record starts with uint32 length, uint64 fingerprint, uint32 key length
+
+#define RESULT_CACHE_RECORD_HEADER_SIZE 16
+
+#define RESULT_CACHE_INITIAL_SLOTS 65536
+
+struct Result_Cache_Header
+{
+  char magic[4];
+  unsigned int version;
+  unsigned int clean;       // set when the index covers exactly log_size bytes of the log
+  unsigned int unused;
+  iw_uint64_t nslots;       // always a power of 2
+  iw_uint64_t nused;
+  iw_uint64_t log_size;
+};
+
+struct Result_Cache_Slot
+{
+  iw_uint64_t hash;
+  iw_uint64_t offset;       // offset in the log + 1, 0 means empty
+};
+
+iw_uint64_t
+result_cache_hash (const void * p, int n, iw_uint64_t h)
+{
+  const unsigned char * s = reinterpret_cast<const unsigned char *> (p);
+
+  for (int i = 0; i < n; i++)
+  {
+    h ^= s[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+//  FNV-1a does not mix the low bits well enough to use them directly as a slot
+
+static iw_uint64_t
+record_hash (iw_uint64_t fingerprint, const char * key, int keylen)
+{
+  iw_uint64_t h = result_cache_hash (&fingerprint, sizeof(fingerprint));
+  h = result_cache_hash (key, keylen, h);
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+Result_Cache::Result_Cache ()
+{
+  _fingerprint = 0;
+
+  _log_fd = -1;
+  _log_size = 0;
+
+  _idx_fd = -1;
+  _idx = NULL;
+  _idx_size = 0;
+
+  _header = NULL;
+  _slot = NULL;
+
+  _lookups = 0;
+  _hits = 0;
+  _stored = 0;
+
+  return;
+}
+
+Result_Cache::~Result_Cache ()
+{
+  if (_log_fd >= 0)
+    close ();
+
+  return;
+}
+
+int
+Result_Cache::_open_log ()
+{
+  IWString fname;
+  fname << _stem << ".log";
+
+  _log_fd = ::open (fname.null_terminated_chars (), O_RDWR | O_CREAT, 0666);
+  if (_log_fd < 0)
+  {
+    cerr << "Result_Cache::_open_log:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+  if (0 != flock (_log_fd, LOCK_EX | LOCK_NB))
+  {
+    cerr << "Result_Cache::_open_log:'" << fname << "' is in use by another process\n";
+    ::close (_log_fd);
+    _log_fd = -1;
+    return 0;
+  }
+
+  struct stat st;
+  if (0 != fstat (_log_fd, &st))
+  {
+    cerr << "Result_Cache::_open_log:cannot stat '" << fname << "'\n";
+    return 0;
+  }
+
+  if (0 == st.st_size)
+  {
+    char tmp[RESULT_CACHE_LOG_HEADER_SIZE];
+    unsigned int version = RESULT_CACHE_VERSION;
+    memcpy (tmp, RESULT_CACHE_LOG_MAGIC, 4);
+    memcpy (tmp + 4, &version, 4);
+
+    if (RESULT_CACHE_LOG_HEADER_SIZE != pwrite (_log_fd, tmp, RESULT_CACHE_LOG_HEADER_SIZE, 0))
+    {
+      cerr << "Result_Cache::_open_log:cannot write '" << fname << "'\n";
+      return 0;
+    }
+
+    _log_size = RESULT_CACHE_LOG_HEADER_SIZE;
+
+    return 1;
+  }
+
+  char tmp[RESULT_CACHE_LOG_HEADER_SIZE];
+  unsigned int version;
+
+  if (st.st_size < RESULT_CACHE_LOG_HEADER_SIZE ||
+      RESULT_CACHE_LOG_HEADER_SIZE != pread (_log_fd, tmp, RESULT_CACHE_LOG_HEADER_SIZE, 0) ||
+      0 != memcmp (tmp, RESULT_CACHE_LOG_MAGIC, 4))
+  {
+    cerr << "Result_Cache::_open_log:'" << fname << "' is not a result cache\n";
+    return 0;
+  }
+
+  memcpy (&version, tmp + 4, 4);
+  if (RESULT_CACHE_VERSION != version)
+  {
+    cerr << "Result_Cache::_open_log:unsupported version " << version << " in '" << fname << "'\n";
+    return 0;
+  }
+
+  _log_size = st.st_size;
+
+  return 1;
+}
+
+int
+Result_Cache::_map_index (iw_uint64_t nslots,
+                          int initialise)
+{
+  _idx_size = sizeof(Result_Cache_Header) + nslots * sizeof(Result_Cache_Slot);
+
+  if (initialise)
+  {
+    if (0 != ftruncate (_idx_fd, 0) || 0 != ftruncate (_idx_fd, _idx_size))
+    {
+      cerr << "Result_Cache::_map_index:cannot size index to " << _idx_size << " bytes\n";
+      return 0;
+    }
+  }
+
+  void * p = mmap (NULL, _idx_size, PROT_READ | PROT_WRITE, MAP_SHARED, _idx_fd, 0);
+  if (MAP_FAILED == p)
+  {
+    cerr << "Result_Cache::_map_index:cannot map " << _idx_size << " bytes\n";
+    _idx = NULL;
+    return 0;
+  }
+
+  _idx = reinterpret_cast<char *> (p);
+  _header = reinterpret_cast<Result_Cache_Header *> (_idx);
+  _slot = reinterpret_cast<Result_Cache_Slot *> (_idx + sizeof(Result_Cache_Header));
+
+  if (initialise)
+  {
+    memcpy (_header->magic, RESULT_CACHE_IDX_MAGIC, 4);
+    _header->version = RESULT_CACHE_VERSION;
+    _header->clean = 0;
+    _header->nslots = nslots;
+    _header->nused = 0;
+    _header->log_size = RESULT_CACHE_LOG_HEADER_SIZE;
+  }
+
+  return 1;
+}
+
+int
+Result_Cache::_unmap_index ()
+{
+  if (NULL == _idx)
+    return 1;
+
+  munmap (_idx, _idx_size);
+
+  _idx = NULL;
+  _header = NULL;
+  _slot = NULL;
+
+  return 1;
+}
+
+int
+Result_Cache::_rebuild_index (iw_uint64_t nslots)
+{
+  _unmap_index ();
+
+  if (! _map_index (nslots, 1))
+    return 0;
+
+  return _index_log_from (RESULT_CACHE_LOG_HEADER_SIZE);
+}
+
+/*
+  Add every record from OFFSET to the end of the log to the index. A
+  partial record at the end, left by a crash, is removed
+*/
+
+int
+Result_Cache::_index_log_from (off_t offset)
+{
+  int bufsize = 1 << 20;
+  char * buf = new char[bufsize];
+
+  off_t pos = offset;
+
+  while (pos < _log_size)
+  {
+    int want = bufsize;
+    if (pos + want > _log_size)
+      want = _log_size - pos;
+
+    if (want != pread (_log_fd, buf, want, pos))
+    {
+      cerr << "Result_Cache::_index_log_from:cannot read log at " << pos << endl;
+      delete [] buf;
+      return 0;
+    }
+
+    int i = 0;
+
+    while (i + RESULT_CACHE_RECORD_HEADER_SIZE <= want)
+    {
+      unsigned int len;
+      iw_uint64_t fingerprint;
+      unsigned int keylen;
+      memcpy (&len, buf + i, 4);
+      memcpy (&fingerprint, buf + i + 4, 8);
+      memcpy (&keylen, buf + i + 12, 4);
+
+      if (len < 12 || keylen > len - 12)
+        break;
+
+      if (i + 4 + static_cast<int> (len) > want)
+        break;
+
+      if (! _insert (record_hash (fingerprint, buf + i + RESULT_CACHE_RECORD_HEADER_SIZE, keylen), pos + i))
+      {
+        delete [] buf;
+        return 0;
+      }
+
+      i += 4 + len;
+    }
+
+    if (i > 0)
+    {
+      pos += i;
+      continue;
+    }
+
+//  Nothing complete in the buffer. Either a record larger than the buffer, or
+//  a corrupt or partial record at the end
+
+    unsigned int len = 0;
+    if (want >= 4)
+      memcpy (&len, buf, 4);
+
+    if (want >= RESULT_CACHE_RECORD_HEADER_SIZE && len >= 12 &&
+        pos + 4 + static_cast<off_t> (len) <= _log_size && static_cast<int> (len) + 4 > bufsize)
+    {
+      delete [] buf;
+      bufsize = len + 4;
+      buf = new char[bufsize];
+      continue;
+    }
+
+    cerr << "Result_Cache::_index_log_from:discarding incomplete record at " << pos << endl;
+    if (0 != ftruncate (_log_fd, pos))
+    {
+      cerr << "Result_Cache::_index_log_from:cannot truncate log\n";
+      delete [] buf;
+      return 0;
+    }
+
+    _log_size = pos;
+  }
+
+  delete [] buf;
+
+  return 1;
+}
+
+int
+Result_Cache::_grow_index ()
+{
+  const iw_uint64_t nslots = _header->nslots;
+  const iw_uint64_t nused = _header->nused;
+
+  Result_Cache_Slot * tmp = new Result_Cache_Slot[nused];
+
+  iw_uint64_t n = 0;
+  for (iw_uint64_t i = 0; i < nslots; i++)
+  {
+    if (_slot[i].offset)
+      tmp[n++] = _slot[i];
+  }
+
+  _unmap_index ();
+
+  if (! _map_index (2 * nslots, 1))
+  {
+    delete [] tmp;
+    return 0;
+  }
+
+  for (iw_uint64_t i = 0; i < n; i++)
+  {
+    _insert (tmp[i].hash, tmp[i].offset - 1);
+  }
+
+  delete [] tmp;
+
+  return 1;
+}
+
+int
+Result_Cache::_insert (iw_uint64_t hash,
+                       off_t offset)
+{
+  if (2 * (_header->nused + 1) > _header->nslots && ! _grow_index ())
+    return 0;
+
+  const iw_uint64_t mask = _header->nslots - 1;
+
+  iw_uint64_t i = hash & mask;
+
+  while (_slot[i].offset)
+  {
+    i = (i + 1) & mask;
+  }
+
+  _slot[i].hash = hash;
+  _slot[i].offset = offset + 1;
+
+  _header->nused++;
+
+  return 1;
+}
+
+int
+Result_Cache::open (const char * stem,
+                    iw_uint64_t fingerprint)
+{
+  if (_log_fd >= 0)
+    close ();
+
+  _stem = stem;
+  _fingerprint = fingerprint;
+
+  if (! _open_log ())
+    return 0;
+
+  IWString fname;
+  fname << _stem << ".idx";
+
+  _idx_fd = ::open (fname.null_terminated_chars (), O_RDWR | O_CREAT, 0666);
+  if (_idx_fd < 0)
+  {
+    cerr << "Result_Cache::open:cannot open '" << fname << "'\n";
+    return 0;
+  }
+
+// Use the existing index if it was closed cleanly and matches the log
+
+  Result_Cache_Header h;
+  struct stat st;
+
+  int usable = (0 == fstat (_idx_fd, &st) &&
+                sizeof(h) == pread (_idx_fd, &h, sizeof(h), 0) &&
+                0 == memcmp (h.magic, RESULT_CACHE_IDX_MAGIC, 4) &&
+                RESULT_CACHE_VERSION == h.version && h.clean &&
+                h.nslots > 0 && 0 == (h.nslots & (h.nslots - 1)) &&
+                static_cast<off_t> (h.log_size) <= _log_size &&
+                static_cast<size_t> (st.st_size) == sizeof(h) + h.nslots * sizeof(Result_Cache_Slot));
+
+  if (usable)
+  {
+    if (! _map_index (h.nslots, 0) || ! _index_log_from (h.log_size))
+      return 0;
+  }
+  else if (! _rebuild_index (RESULT_CACHE_INITIAL_SLOTS))
+    return 0;
+
+// Until close, the index does not necessarily match the log
+
+  _header->clean = 0;
+  msync (_idx, sizeof(Result_Cache_Header), MS_SYNC);
+
+  return 1;
+}
+
+int
+Result_Cache::close ()
+{
+  if (_log_fd < 0)
+    return 1;
+
+  int rc = 1;
+
+  if (NULL != _header)
+  {
+    if (0 != fsync (_log_fd))
+      rc = 0;
+
+    _header->log_size = _log_size;
+    _header->clean = rc;
+
+    if (0 != msync (_idx, _idx_size, MS_SYNC))
+      rc = 0;
+  }
+
+  _unmap_index ();
+
+  if (_idx_fd >= 0)
+    ::close (_idx_fd);
+  _idx_fd = -1;
+
+  ::close (_log_fd);      // releases the lock
+  _log_fd = -1;
+
+  return rc;
+}
+
+iw_uint64_t
+Result_Cache::_hash (const const_IWSubstring & key) const
+{
+  return record_hash (_fingerprint, key.rawchars (), key.length ());
+}
+
+int
+Result_Cache::_read_record (off_t offset,
+                            const const_IWSubstring & key,
+                            IWString & value)
+{
+  char tmp[RESULT_CACHE_RECORD_HEADER_SIZE];
+
+  if (RESULT_CACHE_RECORD_HEADER_SIZE != pread (_log_fd, tmp, RESULT_CACHE_RECORD_HEADER_SIZE, offset))
+    return 0;
+
+  unsigned int len;
+  iw_uint64_t fingerprint;
+  unsigned int keylen;
+  memcpy (&len, tmp, 4);
+  memcpy (&fingerprint, tmp + 4, 8);
+  memcpy (&keylen, tmp + 12, 4);
+
+  if (fingerprint != _fingerprint || keylen != static_cast<unsigned int> (key.length ()))
+    return 0;
+
+  const int nbytes = len - 12;
+
+  _record.resize_keep_storage (0);
+  _record.resize (nbytes);
+
+  if (nbytes != pread (_log_fd, const_cast<char *> (_record.rawchars ()), nbytes, offset + RESULT_CACHE_RECORD_HEADER_SIZE))
+    return 0;
+
+  if (0 != memcmp (_record.rawchars (), key.rawchars (), keylen))
+    return 0;
+
+  value.set (_record.rawchars () + keylen, nbytes - static_cast<int> (keylen));
+
+  return 1;
+}
+
+int
+Result_Cache::lookup (const const_IWSubstring & key,
+                      IWString & value)
+{
+  _lookups++;
+
+  const iw_uint64_t h = _hash (key);
+
+  const iw_uint64_t mask = _header->nslots - 1;
+
+  for (iw_uint64_t i = h & mask; _slot[i].offset; i = (i + 1) & mask)
+  {
+    if (_slot[i].hash != h)
+      continue;
+
+    if (_read_record (_slot[i].offset - 1, key, value))
+    {
+      _hits++;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int
+Result_Cache::store (const const_IWSubstring & key,
+                     const const_IWSubstring & value)
+{
+  const unsigned int keylen = key.length ();
+  const unsigned int len = 12 + keylen + value.length ();
+
+  _record.resize_keep_storage (0);
+  _record.strncat (reinterpret_cast<const char *> (&len), 4);
+  _record.strncat (reinterpret_cast<const char *> (&_fingerprint), 8);
+  _record.strncat (reinterpret_cast<const char *> (&keylen), 4);
+  _record << key << value;
+
+  if (_record.length () != pwrite (_log_fd, _record.rawchars (), _record.length (), _log_size))
+  {
+    cerr << "Result_Cache::store:cannot write to '" << _stem << ".log'\n";
+    return 0;
+  }
+
+  if (! _insert (_hash (key), _log_size))
+    return 0;
+
+  _log_size += _record.length ();
+
+  _stored++;
+
+  return 1;
+}
+
+int
+Result_Cache::report (std::ostream & os) const
+{
+  os << "Result cache '" << _stem << "', " << _lookups << " lookups, " << _hits << " hits, " << _stored << " new results stored\n";
+
+  return os.good ();
+}
+
+/*
+  Approximate per entry overhead - the entry, the hash map node and two
+  string allocations
+*/
+
+#define RESULT_MEMORY_CACHE_OVERHEAD 128
+
+Result_Memory_Cache::Result_Memory_Cache ()
+{
+  _budget = 0;
+  _used = 0;
+
+  _most_recent = -1;
+  _least_recent = -1;
+
+  _lookups = 0;
+  _hits = 0;
+  _evicted = 0;
+
+  return;
+}
+
+void
+Result_Memory_Cache::_unlink (int i)
+{
+  Result_Memory_Cache_Entry * e = _entry[i];
+
+  if (e->_prev >= 0)
+    _entry[e->_prev]->_next = e->_next;
+  else
+    _most_recent = e->_next;
+
+  if (e->_next >= 0)
+    _entry[e->_next]->_prev = e->_prev;
+  else
+    _least_recent = e->_prev;
+
+  e->_prev = -1;
+  e->_next = -1;
+
+  return;
+}
+
+void
+Result_Memory_Cache::_make_most_recent (int i)
+{
+  Result_Memory_Cache_Entry * e = _entry[i];
+
+  e->_prev = -1;
+  e->_next = _most_recent;
+
+  if (_most_recent >= 0)
+    _entry[_most_recent]->_prev = i;
+  else
+    _least_recent = i;
+
+  _most_recent = i;
+
+  return;
+}
+
+void
+Result_Memory_Cache::_evict_least_recent ()
+{
+  const int i = _least_recent;
+
+  _unlink (i);
+
+  Result_Memory_Cache_Entry * e = _entry[i];
+
+  _used -= e->_key.length () + e->_value.length () + RESULT_MEMORY_CACHE_OVERHEAD;
+
+  _index.erase (e->_key);
+
+  e->_key.resize (0);
+  e->_value.resize (0);
+
+  _free.add (i);
+
+  _evicted++;
+
+  return;
+}
+
+int
+Result_Memory_Cache::lookup (const IWString & key,
+                             IWString & value)
+{
+  _lookups++;
+
+  IW_STL_Hash_Map_int::const_iterator f = _index.find (key);
+
+  if (f == _index.end ())
+    return 0;
+
+  const int i = (*f).second;
+
+  if (i != _most_recent)
+  {
+    _unlink (i);
+    _make_most_recent (i);
+  }
+
+  value = _entry[i]->_value;
+
+  _hits++;
+
+  return 1;
+}
+
+int
+Result_Memory_Cache::store (const IWString & key,
+                            const IWString & value)
+{
+  if (_index.contains (key))
+    return 1;
+
+  const size_t s = key.length () + value.length () + RESULT_MEMORY_CACHE_OVERHEAD;
+
+  if (s > _budget)
+    return 1;
+
+  while (_used + s > _budget)
+  {
+    _evict_least_recent ();
+  }
+
+  int i;
+  if (_free.number_elements ())
+    i = _free.pop ();
+  else
+  {
+    i = _entry.number_elements ();
+    _entry.add (new Result_Memory_Cache_Entry);
+  }
+
+  Result_Memory_Cache_Entry * e = _entry[i];
+
+  e->_key = key;
+  e->_value = value;
+
+  _make_most_recent (i);
+
+  _index[key] = i;
+
+  _used += s;
+
+  return 1;
+}
+
+int
+Result_Memory_Cache::report (std::ostream & os) const
+{
+  os << "In memory results, " << _lookups << " lookups, " << _hits << " hits, " << _index.size () << " held, " << _evicted << " evicted, about " << (_used / 1024) << " KB\n";
+
+  return os.good ();
+}
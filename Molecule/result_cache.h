@@ -0,0 +1,170 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_RESULT_CACHE_H
+#define IW_RESULT_CACHE_H
+
+/*
+  Oct 2026. A persistent cache of per molecule results, so that a
+  program run repeatedly over mostly the same molecules only has to do
+  the work for the new ones.
+
+  Keys are strings, normally a unique smiles. Every record also carries
+  a fingerprint of whatever determines the result - rules, thresholds,
+  options - so results from different settings can share a cache but
+  never match each other.
+
+  Two files are used
+
+    <stem>.log   append only records (uint32 length, uint64 fingerprint,
+                 uint32 key length, key, value)
+    <stem>.idx   open addressing hash table, memory mapped, of
+                 (uint64 hash, uint64 offset + 1) pairs
+
+  The log is the truth. The index is rebuilt from the log if it is
+  missing, or if the previous writer did not close it cleanly. Only one
+  process may have a cache open at a time, enforced with flock.
+  Numbers are native byte order.
+*/
+
+#include <sys/types.h>
+
+#include "iwstring.h"
+#include "iwmtypes.h"
+#include "iwaray.h"
+#include "iw_stl_hash_map.h"
+
+#define RESULT_CACHE_HASH_SEED 14695981039346656037ULL
+
+//  FNV-1a, H is the running value
+
+extern iw_uint64_t result_cache_hash (const void *, int, iw_uint64_t h = RESULT_CACHE_HASH_SEED);
+
+struct Result_Cache_Header;
+struct Result_Cache_Slot;
+
+class Result_Cache
+{
+  private:
+    IWString _stem;
+
+    iw_uint64_t _fingerprint;
+
+    int _log_fd;
+    off_t _log_size;
+
+    int _idx_fd;
+    char * _idx;
+    size_t _idx_size;
+
+    Result_Cache_Header * _header;
+    Result_Cache_Slot * _slot;
+
+    IWString _record;      // scratch
+
+    int _lookups;
+    int _hits;
+    int _stored;
+
+//  private functions
+
+    int _open_log ();
+    int _map_index (iw_uint64_t nslots, int initialise);
+    int _unmap_index ();
+    int _rebuild_index (iw_uint64_t nslots);
+    int _index_log_from (off_t);
+    int _insert (iw_uint64_t hash, off_t offset);
+    int _grow_index ();
+    iw_uint64_t _hash (const const_IWSubstring & key) const;
+    int _read_record (off_t offset, const const_IWSubstring & key, IWString & value);
+
+  public:
+    Result_Cache ();
+    ~Result_Cache ();
+
+    int active () const { return _log_fd >= 0;}
+
+    int open (const char * stem, iw_uint64_t fingerprint);
+    int close ();
+
+//  Returns 1 and fills VALUE if KEY was stored with our fingerprint
+
+    int lookup (const const_IWSubstring & key, IWString & value);
+
+    int store (const const_IWSubstring & key, const const_IWSubstring & value);
+
+    int report (std::ostream &) const;
+};
+
+/*
+  Oct 2026. Results within a single run. Entries are kept on a least
+  recently used list, and the oldest are dropped once the approximate
+  memory used passes a budget
+*/
+
+class Result_Memory_Cache_Entry
+{
+  public:
+    IWString _key;
+    IWString _value;
+
+    int _prev;       // towards most recently used
+    int _next;       // towards least recently used
+};
+
+class Result_Memory_Cache
+{
+  private:
+    size_t _budget;
+    size_t _used;
+
+    IW_STL_Hash_Map_int _index;
+
+    resizable_array_p<Result_Memory_Cache_Entry> _entry;
+    resizable_array<int> _free;      // entries evicted, available for reuse
+
+    int _most_recent;
+    int _least_recent;
+
+    int _lookups;
+    int _hits;
+    int _evicted;
+
+//  private functions
+
+    void _unlink (int);
+    void _make_most_recent (int);
+    void _evict_least_recent ();
+
+  public:
+    Result_Memory_Cache ();
+
+    void set_budget (size_t s) { _budget = s;}
+
+    int active () const { return _budget > 0;}
+
+//  Returns 1 and fills VALUE if KEY is present
+
+    int lookup (const IWString & key, IWString & value);
+
+    int store (const IWString & key, const IWString & value);
+
+    int report (std::ostream &) const;
+};
+
+#endif
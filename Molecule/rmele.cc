@@ -114,6 +114,41 @@ Element_to_Remove::report (ostream & os) const
   return debug_print (os);
 }
 
+int
+Element_to_Remove::write_counters (ostream & os) const
+{
+  os << _molecules_examined << ' ' << _molecules_changed << ' ' << _atoms_removed;
+
+  return os.good ();
+}
+
+int
+Element_to_Remove::restore_counters (const const_IWSubstring & buffer)
+{
+  if (3 != buffer.nwords ())
+  {
+    cerr << "Element_to_Remove::restore_counters:must have 3 tokens '" << buffer << "'\n";
+    return 0;
+  }
+
+  int i = 0;
+  const_IWSubstring token;
+
+  buffer.nextword (token, i);
+  if (! token.numeric_value (_molecules_examined))
+    return 0;
+
+  buffer.nextword (token, i);
+  if (! token.numeric_value (_molecules_changed))
+    return 0;
+
+  buffer.nextword (token, i);
+  if (! token.numeric_value (_atoms_removed))
+    return 0;
+
+  return 1;
+}
+
 int
 Element_to_Remove::reset_counters ()
 {
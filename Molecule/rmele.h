@@ -73,6 +73,11 @@ class Element_to_Remove : public Element_Matcher
 
     int reset_counters ();
 
+//  Oct 2026. For checkpointing a long run
+
+    int write_counters (ostream &) const;
+    int restore_counters (const const_IWSubstring &);
+
     int process (Molecule &);
     int process (Molecule &, const int *, int);
 };
@@ -249,6 +249,57 @@ set_max_offset_from_command_line (off_t s)
   _max_offset_from_command_line = s;
 }
 
+/*
+  Oct 2026. -i shard=k/N. Process K of N reads the records that start in
+  the K'th slice of each input file. K runs from 0 to N-1
+*/
+
+static int _input_shard = 0;
+static int _number_input_shards = 0;
+
+int
+input_shard (int & k, int & n)
+{
+  k = _input_shard;
+  n = _number_input_shards;
+
+  return _number_input_shards > 0;
+}
+
+int
+set_input_shard (int k, int n)
+{
+  if (n <= 0 || k < 0 || k >= n)
+  {
+    cerr << "set_input_shard:invalid shard " << k << " of " << n << endl;
+    return 0;
+  }
+
+  _input_shard = k;
+  _number_input_shards = n;
+
+  return 1;
+}
+
+/*
+  Oct 2026. -i sdfthreads=<n>. SD records are cut out by a scanner thread
+  and parsed by this many threads, see parallel_sdf.h
+*/
+
+static int _sdf_parse_threads = 0;
+
+int
+sdf_parse_threads ()
+{
+  return _sdf_parse_threads;
+}
+
+void
+set_sdf_parse_threads (int s)
+{
+  _sdf_parse_threads = s;
+}
+
 static int _number_connection_table_errors_to_skip = 0;
 
 int
@@ -285,6 +336,28 @@ set_unconnect_covalently_bonded_non_organics_on_read (int s)
   _unconnect_covalently_bonded_non_organics_on_read = s;
 }
 
+/*
+  Oct 2026. Pipelines often read a smiles, perceive nothing more than a
+  few substructure matches, and write the molecule back out with a new
+  name. Regenerating the smiles is then wasted effort. When this is set,
+  the smiles text from the input record is stored as the molecule's smiles,
+  and any structural change discards it, like any other cached smiles.
+*/
+
+static int _write_smiles_as_read_if_unmodified = 0;
+
+int
+write_smiles_as_read_if_unmodified ()
+{
+  return _write_smiles_as_read_if_unmodified;
+}
+
+void
+set_write_smiles_as_read_if_unmodified (int s)
+{
+  _write_smiles_as_read_if_unmodified = s;
+}
+
 static int _put_formal_charges_on_neutral_ND3v4 = 0;
 
 void
@@ -442,6 +515,10 @@ suffix_for_file_type (int file_type)
       return "tdt";
       break;
 
+    case IWMTYPE_IWB:
+      return "iwb";
+      break;
+
     default:
       return NULL;
       break;
@@ -613,6 +690,8 @@ discern_file_type_from_name (const IWString & file_name)
     return IWMTYPE_MRV;
   if (file_name.ends_with(".inchi"))
     return IWMTYPE_INCHI;
+  if (file_name.ends_with(".iwb"))
+    return IWMTYPE_IWB;
 
   return 0;
 }
@@ -676,6 +755,8 @@ _string_to_file_type (const const_IWSubstring & file_type)
     return IWMTYPE_MRV;
   if ("inchi" == file_type)
     return IWMTYPE_INCHI;
+  if ("iwb" == file_type)
+    return IWMTYPE_IWB;
   
   return 0;
 }
@@ -836,6 +917,10 @@ valid_file_type (int ftype)
       return 1;
       break;
 
+    case IWMTYPE_IWB:
+      return 1;
+      break;
+
     default:
       return 0;
       break;
@@ -909,6 +994,9 @@ Molecule::read_molecule_ds (iwstring_data_source & input, int input_type)
   else if (TDT == input_type)
     rc = read_molecule_tdt_ds(input);
 
+  else if (IWMTYPE_IWB == input_type)
+    rc = read_molecule_iwb_ds(input);
+
   else
   {
     cerr << "read_molecule_ds: Unknown type " << input_type << "\n";
@@ -960,6 +1048,8 @@ Molecule::write_molecule (ostream & os, int output_type,
     rc = write_molecule_nausmi(os, name());
   else if (IWMTYPE_SMT == output_type)
     rc = write_molecule_smarts(os);
+  else if (IWMTYPE_IWB == output_type)
+    rc = write_molecule_iwb(os);
   else
     cerr << "Molecule::write_molecule: unrecognised type " << output_type << "\n";
     
@@ -1016,6 +1106,7 @@ display_input_help (ostream & os)
   os << " -i smi                  smiles input\n";
   os << " -i tdt                  TDT input\n";
   os << " -i mdl                  MDL format (generally, use 'sdf' instead)\n";
+  os << " -i iwb                  binary connection tables, as written by '-o iwb'\n";
   os << " -i info                 collect extra text records in input (SDF and TDT only)\n";
   os << " -i ignore_bad_m         ignore unrecognised 'M' records in SDF files\n";
   os << " -i ignore_fatal_m       ignore otherwise fatal errors in M records\n";
@@ -1070,6 +1161,10 @@ display_input_help (ostream & os)
   os << " -i do=nn                only process NN molecules\n";
   os << " -i seek=offset          seek to byte offset OFFSET before starting reading\n";
   os << " -i stop=offset          stop reading once file is at byte offset OFFSET\n";
+  os << " -i shard=k/N            read only the K'th of N slices of each file, 0 <= K < N\n";
+  os << " -i mmap                 memory map regular input files rather than reading them\n";
+  os << " -i gzthreads=<n>        inflate gzip'd input in the background, BGZF files with <n> threads\n";
+  os << " -i sdfthreads=<n>       parse SD files with <n> threads, molecules are returned in file order\n";
   os << " -i maxq=<charge>        set maximum plausible atomic partial charge\n";
   os << " -i minq=<charge>        set minimum plausible atomic partial charge\n";
   os << " -i mq=<charge>          set min (-charge) and max (+charge) plausible atomic partial charge\n";
@@ -1079,6 +1174,22 @@ display_input_help (ostream & os)
   exit(0);
 }
 
+/*
+  Oct 2026. A NO_COORDINATES build discards coordinates on input, so
+  options that perceive something from them cannot work
+*/
+
+static int
+coordinates_available (const const_IWSubstring & optval)
+{
+#ifdef IW_NO_COORDINATES
+  cerr << "The '-i " << optval << "' option needs coordinates, not available in a NO_COORDINATES build\n";
+  return 0;
+#else
+  return 1;
+#endif
+}
+
 int
 process_input_type (const Command_Line & cl, int & input_type)
 {
@@ -1287,14 +1398,23 @@ process_input_type (const Command_Line & cl, int & input_type)
     }
     else if ("dctb" == optval)
     {
+      if (! coordinates_available(optval))
+        return 0;
+
       set_discern_cis_trans_bonds(1);
     }
     else if ("d@3d" == optval || "d3d" == optval)
     {
+      if (! coordinates_available(optval))
+        return 0;
+
       set_discern_chirality_from_3d_coordinates(1);
     }
     else if (optval.starts_with("d@3d=") || optval.starts_with("d3d="))
     {
+      if (! coordinates_available(optval))
+        return 0;
+
       optval.remove_up_to_first('=');
       int d;
       if (! optval.numeric_value(d) || d < 3)
@@ -1307,6 +1427,9 @@ process_input_type (const Command_Line & cl, int & input_type)
     }
     else if ("dwedge" == optval)
     {
+      if (! coordinates_available(optval))
+        return 0;
+
       set_mdl_discern_chirality_from_wedge_bonds(1);
     }
     else if ("ibctb" == optval)
@@ -1331,6 +1454,34 @@ process_input_type (const Command_Line & cl, int & input_type)
     {
       dos_mode = 1;
     }
+    else if ("mmap" == optval)
+    {
+      set_iwstring_data_source_use_mmap(1);
+    }
+    else if (optval.starts_with("gzthreads="))
+    {
+      optval.remove_leading_chars(10);
+      int n;
+      if (! optval.numeric_value(n) || n < 1)
+      {
+        cerr << "The gzip inflate threads directive 'gzthreads=nn' must be followed by a whole positive number\n";
+        return 0;
+      }
+
+      set_iwzlib_inflate_threads(n);
+    }
+    else if (optval.starts_with("sdfthreads="))
+    {
+      optval.remove_leading_chars(11);
+      int n;
+      if (! optval.numeric_value(n) || n < 1)
+      {
+        cerr << "The SD parse threads directive 'sdfthreads=nn' must be followed by a whole positive number\n";
+        return 0;
+      }
+
+      set_sdf_parse_threads(n);
+    }
     else if (optval.starts_with("skip="))
     {
       optval.remove_leading_chars(5);
@@ -1375,6 +1526,18 @@ process_input_type (const Command_Line & cl, int & input_type)
 
       _max_offset_from_command_line = static_cast<off_t>(tmp);
     }
+    else if (optval.starts_with("shard="))
+    {
+      optval.remove_leading_chars(6);
+
+      const_IWSubstring k, n;
+      int ik, in;
+      if (! optval.split(k, '/', n) || ! k.numeric_value(ik) || ! n.numeric_value(in) || ! set_input_shard(ik, in))
+      {
+        cerr << "Invalid shard specifier 'shard=" << optval << "', must be 'shard=k/N', 0 <= k < N\n";
+        return 0;
+      }
+    }
     else if (optval.starts_with("maxq="))
     {
       optval.remove_leading_chars(5);
@@ -1498,8 +1661,12 @@ reset_rwmolecule_file_scope_variables ()
     _do_only_n_molecules = 0;
     _seek_to_from_command_line = 0;
     _max_offset_from_command_line = numeric_limits<off_t>::max();
+    _input_shard = 0;
+    _number_input_shards = 0;
+    _sdf_parse_threads = 0;
     _number_connection_table_errors_to_skip = 0;
     _unconnect_covalently_bonded_non_organics_on_read = 0;
+    _write_smiles_as_read_if_unmodified = 0;
     _put_formal_charges_on_neutral_ND3v4 = 0;
     file_scope_newline_string = '\n';
     _write_DOS_records = 0;
@@ -27,8 +27,9 @@ Set_of_Atoms::Set_of_Atoms ()
 //cerr << "Set_of_Atoms::Set_of_Atoms called\n";
 }
 
-Set_of_Atoms::Set_of_Atoms (int initial_size) : resizable_array<atom_number_t> (initial_size)
+Set_of_Atoms::Set_of_Atoms (int initial_size)
 {
+  resize (initial_size);
 }
 
 Set_of_Atoms::Set_of_Atoms (const Set_of_Atoms & rhs)
@@ -22,7 +22,7 @@
 #include "iwmtypes.h"
 #include "iwaray.h"
 
-class Set_of_Atoms : public resizable_array<atom_number_t>
+class Set_of_Atoms : public small_resizable_array<atom_number_t, 8>
 {
   private:
   public:
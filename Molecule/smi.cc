@@ -991,26 +991,64 @@ Molecule::read_molecule_smi_ds (iwstring_data_source & input)
   if (input.eof())
     return 0;
 
-  IWString buffer;
+  const_IWSubstring buffer;     // may be a view into a memory mapped file, not null terminated
 
   EXTRA_STRING_RECORD (input, buffer, "read mol smi");
 
   if (buffer.length() < 1)
     return 0;
 
-  if (! build_from_smiles (buffer.chars()))
+  if (! build_from_smiles (buffer))
   {
     cerr << "Molecule::read_molecule_smi_ds: Cannot interpret smiles\n";
     cerr << buffer << endl;
     return 0;
   }
 
+  if (write_smiles_as_read_if_unmodified())
+    _store_smiles_as_read(buffer);
+
   if (unconnect_covalently_bonded_non_organics_on_read())
     _do_unconnect_covalently_bonded_non_organics();
 
   return 1;
 }
 
+/*
+  Seed the smiles cache with the text just parsed. Anything that changes
+  the structure goes through _set_modified, which invalidates the cache,
+  so smiles() only returns this text while the molecule is as read.
+  Unique smiles checks the order type, so it is always computed.
+
+  If the output settings would drop something that is in the input, or
+  write the smiles differently, the text cannot be used.
+*/
+
+void
+Molecule::_store_smiles_as_read (const const_IWSubstring & buffer)
+{
+  if (! smiles_written_with_default_options())
+    return;
+
+  if (! include_chiral_info_in_smiles() || ignore_all_chiral_information_on_input())
+    return;
+
+  if (! include_cis_trans_in_smiles() || ignore_bad_cis_trans_input())
+    return;
+
+  int n = 0;
+  while (n < buffer.length() && ' ' != buffer[n] && '\t' != buffer[n])
+  {
+    n++;
+  }
+
+  IWString & s = _smiles_information.smiles();
+
+  s.set(buffer.rawchars(), n);
+
+  return;
+}
+
 static int ignore_tdts_with_no_smiles = 0;
 
 void
@@ -96,6 +96,7 @@ extern void set_include_directional_bonding_information_in_unique_smiles (int s)
 extern void set_include_implicit_hydrogens_on_aromatic_n_and_p (int);
 
 extern void set_smiles_ring_number_offset (int s);
+extern int  smiles_ring_number_offset ();
 
 extern void set_display_smiles_interpretation_error_messages(int s);
 
@@ -214,6 +215,14 @@ extern  void set_display_unusual_hcount_warning_messages(int);
 extern  int  display_unusual_hcount_warning_messages ();
 
 extern  void set_include_directionality_in_ring_closure_bonds (int);
+extern  int  include_directionality_in_ring_closure_bonds ();
+
+/*
+  Oct 2026. True if no option that changes how smiles are written has
+  been changed. Only then can the smiles read be written as is
+*/
+
+extern int smiles_written_with_default_options ();
 
 extern void reset_smi_file_scope_variables ();
 extern void reset_smiles_support_file_scope_variables ();
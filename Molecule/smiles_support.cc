@@ -191,6 +191,30 @@ set_include_hcount_in_smiles(int s)
   include_hcount_in_smiles = s;
 }
 
+int
+smiles_written_with_default_options ()
+{
+  if (include_aromaticity_in_smiles || write_smiles_aromatic_bonds_as_colons ())
+    return 0;
+
+  if (_write_smiles_with_smarts_atoms || append_coordinates_after_each_atom)
+    return 0;
+
+  if (! reuse_ring_closure_numbers || 0 != smiles_ring_number_offset ())
+    return 0;
+
+  if (_write_single_bonds_in_smiles || ! include_hcount_in_smiles)
+    return 0;
+
+  if (_add_implicit_hydrogens_to_isotopic_atoms_needing_hydrogens)
+    return 0;
+
+  if (include_directionality_in_ring_closure_bonds ())
+    return 0;
+
+  return 1;
+}
+
 static int file_scope_display_unusual_hcount_warning_messages = 1;
 
 void
@@ -511,7 +511,7 @@ class Atomic_Smarts_Component;
   atoms which comprise the match
 */
 
-class Query_Atoms_Matched : public resizable_array<Substructure_Atom *>
+class Query_Atoms_Matched : public small_resizable_array<Substructure_Atom *, 8>
 {
   private:
     int _preference_value;
@@ -596,7 +596,7 @@ class Substructure_Atom : public Substructure_Atom_Specifier
 
     int _initial_atom_number;
 
-    resizable_array_p<Substructure_Atom> _children;
+    small_resizable_array_p<Substructure_Atom, 4> _children;
 
 //  For alternate matches, we use the or id
 
@@ -843,6 +843,16 @@ class Substructure_Atom : public Substructure_Atom_Specifier
 
     int atomic_number (atomic_number_t &) const;
 
+//  Oct 2026. Returns 1 if any target atom matched must have atomic number Z
+
+    int required_atomic_number (atomic_number_t & z) const;
+
+//  Oct 2026. Increment COUNT[z] for every atom in the tree rooted here that
+//  can only match atomic number z. OR'd children are skipped. COUNT must
+//  be dimensioned HIGHEST_ATOMIC_NUMBER + 1
+
+    int required_elements (int * count) const;
+
 //  During a substructure search, we gain efficiencies by only searching
 //  those parts of the molecule where a match is possible. Given a
 //  Molecule_to_Match object, we can examine our _atomic_number values
@@ -2114,6 +2124,8 @@ class Single_Substructure_Query
 
     int  _has_implicit_rings (Query_Atoms_Matched & matched_query_atoms, const int * already_matched) const;
     int  _no_matched_atoms_between_satisfied (Query_Atoms_Matched & matched_atoms) const;
+    int  _build_path_fingerprint ();
+
     int  _link_atoms_satisfied (Query_Atoms_Matched & matched_atoms) const;
     int  _link_atom_satisfied (const Link_Atom & l,
                                Query_Atoms_Matched & matched_atoms) const;
@@ -2244,6 +2256,11 @@ class Single_Substructure_Query
 
     int   root_atoms () const { return _root_atoms.number_elements ();}
     const Substructure_Atom * root_atom (int i) const { return _root_atoms[i];}
+
+//  Oct 2026. Elements any matching target must contain, see Substructure_Atom.
+//  Returns 0 if the query can match a molecule without matching its atoms
+
+    int required_elements (int * count) const;
     int   add_root_atom (Substructure_Atom * r) { return _root_atoms.add(r);}
 
 //  Does a particular atom match the query?
@@ -2387,6 +2404,11 @@ class Substructure_Query : public resizable_array_p<Single_Substructure_Query>
 
     int substructure_search_do_each_component (Molecule_to_Match & target, Substructure_Results & sresults);
 
+//  Oct 2026. Only single component queries say what they require, returns
+//  0 if nothing can be said
+
+    int required_elements (int * count) const;
+
     int set_find_one_embedding_per_atom (int);
     int set_find_unique_embeddings_only (int);
     int set_min_matches_to_find (int);
@@ -2439,6 +2461,33 @@ extern void set_h_means_exactly_one_hydrogen (int s);
 
 extern void set_atom_environment_only_matches_unmatched_atoms (int);
 
+/*
+  Oct 2026. Per query profiling. While on, the matcher accumulates time
+  spent checking environments, and backtracking steps, into per thread
+  counters. Substructure_Hit_Statistics takes differences around each search
+*/
+
+class Substructure_Search_Counters
+{
+  public:
+    iw_uint64_t _backtrack_steps;
+    iw_uint64_t _environment_cycles;
+};
+
+extern thread_local Substructure_Search_Counters substructure_search_counters;
+
+extern int substructure_search_profiling ();
+extern void set_substructure_search_profiling (int);
+
+//  Converts differences in substructure_search_cycles to seconds, from
+//  the time since profiling was turned on
+
+extern double substructure_search_cycles_per_second ();
+
+//  Cycle counter used for timing searches, defined in iwqry_wstats.cc
+
+extern iw_uint64_t substructure_search_cycles ();
+
 // This is an internal thing used during matches. Not for external use
 
 extern int remove_atoms_with_same_or (Query_Atoms_Matched & matched_atoms,
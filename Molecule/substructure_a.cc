@@ -859,6 +859,73 @@ Substructure_Atom::atomic_number (atomic_number_t & z) const
   return 0;
 }
 
+/*
+  An element is required if it is the only one in our own list, or the
+  only one in a component that must match - all operators are AND
+  and the component is not negated.
+  A rejection atom can match anything its specification does not.
+*/
+
+int
+Substructure_Atom::required_atomic_number (atomic_number_t & z) const
+{
+  if (1 != _match_as_match_or_rejection)
+    return 0;
+
+  const Element * e = NULL;
+
+  if (1 == _element.number_elements ())
+    e = _element[0];
+  else if (_components.number_elements ())
+  {
+    int nc = _components.number_elements ();
+
+    int all_and = (nc - 1 == _operator.number_operators () && nc == _operator.number_results ());
+    for (int i = 0; all_and && i < nc - 1; i++)
+    {
+      int op = _operator.op (i);
+      if (IW_LOGEXP_AND != op && IW_LOGEXP_LOW_PRIORITY_AND != op)
+        all_and = 0;
+    }
+
+    for (int i = 0; all_and && i < nc && NULL == e; i++)
+    {
+      const resizable_array<const Element *> & ce = _components[i]->element ();
+
+      if (1 == ce.number_elements () && 0 != _operator.unary_operator (i))
+        e = ce[0];
+    }
+  }
+
+  if (NULL == e || ! e->is_in_periodic_table ())
+    return 0;
+
+  z = e->atomic_number ();
+
+  return REASONABLE_ATOMIC_NUMBER (z);
+}
+
+/*
+  A rejection atom still needs some target atom, so its children count
+*/
+
+int
+Substructure_Atom::required_elements (int * count) const
+{
+  atomic_number_t z;
+  if (required_atomic_number (z))
+    count[z]++;
+
+  for (int i = 0; i < _children.number_elements (); i++)
+  {
+    const Substructure_Atom * c = _children[i];
+    if (0 == c->or_id ())
+      c->required_elements (count);
+  }
+
+  return 1;
+}
+
 /*
   Substructure_Atom::min_ncon is only used by ::create_molecule. It returns an
   estimate of the minimum connectivity associated with an atom.
@@ -65,6 +65,170 @@ charge_assigner ()
   return _charge_assigner;
 }
 
+/*
+  Oct 2026. The rules used to gather their own per atom information,
+  several allocating arrays for each molecule. Now one pass over the
+  atoms collects everything, into storage kept from one molecule to
+  the next, and the rules read from it. Element counts let rules
+  return at once when the elements they look for are absent.
+*/
+
+#define ATOM_FEATURES_SCRATCH 2
+
+class Atom_Features
+{
+  private:
+    int _allocated;
+    int _matoms;
+
+    atomic_number_t * _z;
+    int * _ncon;
+    int * _nbonds;
+    formal_charge_t * _formal_charge;
+    int * _nrings;
+
+    int * _scratch[ATOM_FEATURES_SCRATCH];
+
+    int _element_count[HIGHEST_ATOMIC_NUMBER + 1];
+
+//  Carbons that can be in a chain - non ring, uncharged, at most 2 connections
+
+    int _chain_carbons;
+
+//  private functions
+
+    void _free_arrays ();
+
+  public:
+    Atom_Features ();
+    ~Atom_Features ();
+
+    int build (Molecule &);
+
+    const atomic_number_t * z () const { return _z;}
+    const int * ncon () const { return _ncon;}
+    const int * nbonds () const { return _nbonds;}
+    const formal_charge_t * formal_charge () const { return _formal_charge;}
+    const int * nrings () const { return _nrings;}
+
+    int count (atomic_number_t z) const { return _element_count[z];}
+    int halogens () const { return _element_count[17] + _element_count[35] + _element_count[53];}
+    int chain_carbons () const { return _chain_carbons;}
+
+//  Array WHICH, zero'd for the current molecule
+
+    int * scratch (int which);
+};
+
+Atom_Features::Atom_Features ()
+{
+  _allocated = 0;
+  _matoms = 0;
+
+  _z = NULL;
+  _ncon = NULL;
+  _nbonds = NULL;
+  _formal_charge = NULL;
+  _nrings = NULL;
+
+  for (int i = 0; i < ATOM_FEATURES_SCRATCH; i++)
+  {
+    _scratch[i] = NULL;
+  }
+
+  _chain_carbons = 0;
+
+  return;
+}
+
+Atom_Features::~Atom_Features ()
+{
+  _free_arrays ();
+
+  return;
+}
+
+void
+Atom_Features::_free_arrays ()
+{
+  if (0 == _allocated)
+    return;
+
+  delete [] _z;
+  delete [] _ncon;
+  delete [] _nbonds;
+  delete [] _formal_charge;
+  delete [] _nrings;
+
+  for (int i = 0; i < ATOM_FEATURES_SCRATCH; i++)
+  {
+    delete [] _scratch[i];
+  }
+
+  _allocated = 0;
+
+  return;
+}
+
+int
+Atom_Features::build (Molecule & m)
+{
+  _matoms = m.natoms ();
+
+  if (_matoms > _allocated)
+  {
+    _free_arrays ();
+
+    _allocated = _matoms + 20;
+
+    _z = new atomic_number_t[_allocated];
+    _ncon = new int[_allocated];
+    _nbonds = new int[_allocated];
+    _formal_charge = new formal_charge_t[_allocated];
+    _nrings = new int[_allocated];
+
+    for (int i = 0; i < ATOM_FEATURES_SCRATCH; i++)
+    {
+      _scratch[i] = new int[_allocated];
+    }
+  }
+
+  set_vector (_element_count, HIGHEST_ATOMIC_NUMBER + 1, 0);
+  _chain_carbons = 0;
+
+  m.ring_membership (_nrings);
+
+  for (int i = 0; i < _matoms; i++)
+  {
+    const Atom * a = m.atomi (i);
+
+    atomic_number_t z = a->atomic_number ();
+
+    _z[i] = z;
+    _ncon[i] = a->ncon ();
+    _nbonds[i] = a->nbonds ();
+    _formal_charge[i] = a->formal_charge ();
+
+    if (REASONABLE_ATOMIC_NUMBER (z))
+      _element_count[z]++;
+
+    if (6 == z && _ncon[i] <= 2 && 0 == _nrings[i] && 0 == _formal_charge[i])
+      _chain_carbons++;
+  }
+
+  return _matoms;
+}
+
+int *
+Atom_Features::scratch (int which)
+{
+  set_vector (_scratch[which], _matoms, 0);
+
+  return _scratch[which];
+}
+
+static Atom_Features atom_features;
+
 static int
 identify_largest_fragment (int matoms,
                            int nf,
@@ -91,23 +255,21 @@ static int apply_positive_charge_demerit = 1;
 static int apply_negative_charge_demerit = 1;
 
 static int
-too_many_charges (Molecule & m, Demerit & demerit)
+too_many_charges (Molecule & m, Demerit & demerit, Atom_Features & features)
 {
   if (0 == apply_positive_charge_demerit && 0 == apply_negative_charge_demerit)
     return 0;
 
   int matoms = m.natoms ();
 
-  formal_charge_t * f = new formal_charge_t[matoms]; iw_auto_array<formal_charge_t> free_f (f);
-
-  set_vector(f, matoms, static_cast<formal_charge_t>(0));
+  formal_charge_t * f = features.scratch (0);
 
   _charge_assigner.set_apply_charges_to_molecule(0);
 
   if (0 == _charge_assigner.process (m, f))
     return 0;
 
-  int * fragment_membership = new int[matoms]; iw_auto_array<int> free_fragment_membership(fragment_membership);
+  int * fragment_membership = features.scratch (1);
 
   int nf = m.fragment_membership (fragment_membership);
 
@@ -245,6 +407,7 @@ static int
 identify_largest_saturated_carbon_section (Molecule & m,
                                            const atomic_number_t * z,
                                            const int * ncon,
+                                           const int * nbonds,
                                            const int * attached_heteroatom_count,
                                            atom_number_t zatom,
                                            int flag,
@@ -269,10 +432,10 @@ identify_largest_saturated_carbon_section (Molecule & m,
     if (6 != z[j])
       continue;
 
-    if (ncon[j] < m.nbonds (j))
+    if (ncon[j] < nbonds[j])
       continue;
 
-    rc += identify_largest_saturated_carbon_section (m, z, ncon, attached_heteroatom_count, j, flag, already_done);
+    rc += identify_largest_saturated_carbon_section (m, z, ncon, nbonds, attached_heteroatom_count, j, flag, already_done);
   }
 
   return rc;
@@ -284,13 +447,16 @@ static int apply_satcg = 0;   // turn off until we get this debugged
 static int
 large_saturated_carbon_sections_including_rings (Molecule & m,
                              Demerit & demerit,
-                             const atomic_number_t * z,
-                             const int * ncon,
-                             const int * ring_membership)
+                             Atom_Features & features)
 {
   int matoms = m.natoms ();
 
-  int * attached_heteroatom_count = new_int (matoms); iw_auto_array<int> free_attached_heteroatom_count (attached_heteroatom_count);
+  const atomic_number_t * z = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+  const int * ring_membership = features.nrings ();
+
+  int * attached_heteroatom_count = features.scratch (0);
 
   for (int i = 0; i < matoms; i++)
   {
@@ -312,7 +478,7 @@ large_saturated_carbon_sections_including_rings (Molecule & m,
     }
   }
 
-  int * tmp = new_int (matoms); iw_auto_array<int> free_tmp (tmp);
+  int * tmp = features.scratch (1);
 
   for (int i = 0; i < matoms; i++)
   {
@@ -325,12 +491,12 @@ large_saturated_carbon_sections_including_rings (Molecule & m,
     if (6 != z[i])
       continue;
 
-    if (ncon[i] < m.nbonds (i))
+    if (ncon[i] < nbonds[i])
       continue;
 
     int flag = i + 1;    // a unique identifier for this grouping
 
-    int carbon_atoms_in_group = identify_largest_saturated_carbon_section (m, z, ncon, attached_heteroatom_count, i, flag, tmp);
+    int carbon_atoms_in_group = identify_largest_saturated_carbon_section (m, z, ncon, nbonds, attached_heteroatom_count, i, flag, tmp);
 
     if (carbon_atoms_in_group < 7)
       continue;
@@ -417,9 +583,13 @@ bonded_to_heteroatom_outside_ring (Molecule & m,
 static int
 is_rejectable_c7_ring (Molecule & m,
                        const Ring & ri,
-                       const atomic_number_t * z,
-                       const int * ncon)
+                       const Atom_Features & features)
 {
+  const atomic_number_t * z = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+  const int * nrings = features.nrings ();
+
   int heteroatoms_encountered = 0;
   int fused_ring_atoms_encountered = 0;
   int heteroatom_outside_ring = 0;
@@ -434,15 +604,13 @@ is_rejectable_c7_ring (Molecule & m,
 //    heteroatoms_encountered++;    relaxed form, not used
       return 0;
 
-    const Atom * aj = m.atomi (j);
-
-    if (aj->unsaturated ())    // what about -C(=*)- too rare to worry about
+    if (nbonds[j] < ncon[j])    // same test as Atom::unsaturated. What about -C(=*)- too rare to worry about
       return 0;
 
     if (2 == ncon[j])
       continue;
 
-    if (m.nrings (j) > 1)
+    if (nrings[j] > 1)
       fused_ring_atoms_encountered++;
 
     if (bonded_to_heteroatom_outside_ring (m, ri, i, z))
@@ -470,12 +638,14 @@ static int apply_c7ring = 1;
 static int
 determine_c7_ring (Molecule & m,
                    Demerit & demerit,
-                   const atomic_number_t * z,
-                   const int * ncon)
+                   const Atom_Features & features)
 {
   if (! apply_c7ring)
     return 0;
 
+  if (features.count (6) < 7)
+    return 0;
+
   int nr = m.nrings ();
 
   for (int i = 0; i < nr; i++)
@@ -487,7 +657,7 @@ determine_c7_ring (Molecule & m,
     if (ring_size < 7)
       continue;
 
-    if (! is_rejectable_c7_ring (m, *ri, z, ncon))
+    if (! is_rejectable_c7_ring (m, *ri, features))
       continue;
 
     demerit.reject ("C7ring");
@@ -508,9 +678,14 @@ determine_c7_ring (Molecule & m,
 static int
 grow_chain (Molecule & m,
             atom_number_t zatom,
-            const atomic_number_t * mz, const int * ncon,
+            const Atom_Features & features,
             int * already_done)
 {
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nrings = features.nrings ();
+  const formal_charge_t * fc = features.formal_charge ();
+
   int rc = 0;
   while (1)
   {
@@ -528,7 +703,7 @@ grow_chain (Molecule & m,
 
     assert (0 == already_done[tmp]);
 
-    if (6 != mz[tmp] || ncon[tmp] > 2 || m.is_ring_atom (tmp) || m.formal_charge (tmp))
+    if (6 != mz[tmp] || ncon[tmp] > 2 || nrings[tmp] || fc[tmp])
       return rc;
 
     zatom = tmp;
@@ -538,11 +713,16 @@ grow_chain (Molecule & m,
 static int
 determine_chain (Molecule & m,
                  atom_number_t zatom,
-                 const atomic_number_t * mz, const int * ncon,
+                 const Atom_Features & features,
                  int * already_done)
 {
   int matoms = m.natoms ();
 
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nrings = features.nrings ();
+  const formal_charge_t * fc = features.formal_charge ();
+
   already_done[zatom] = 1;
   int rc = 1;
 
@@ -555,9 +735,9 @@ determine_chain (Molecule & m,
     atom_number_t a1 = a->other (zatom, i);
     assert (a1 >= 0 && a1 < matoms && 0 == already_done[a1]);
 
-    if (6 == mz[a1] && ncon[a1] <= 2 && m.is_non_ring_atom (a1) && 0 == m.formal_charge (a1))
+    if (6 == mz[a1] && ncon[a1] <= 2 && 0 == nrings[a1] && 0 == fc[a1])
     {
-      rc += grow_chain (m, a1, mz, ncon, already_done);
+      rc += grow_chain (m, a1, features, already_done);
     }
   }
 
@@ -575,13 +755,19 @@ static int apply_c4 = 1;
 
 static int
 long_carbon_chains (Molecule & m, Demerit & demerit,
-                    const atomic_number_t * mz, const int * ncon,
+                    const Atom_Features & features,
                     int * already_done)
 {
   extending_resizable_array<int> long_chain;
 
   int matoms = m.natoms ();
 
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+  const int * nrings = features.nrings ();
+  const formal_charge_t * fc = features.formal_charge ();
+
   for (int i = 0; i < matoms; i++)
   {
     if (6 != mz[i])
@@ -593,14 +779,12 @@ long_carbon_chains (Molecule & m, Demerit & demerit,
     if (already_done[i])
       continue;
 
-    if (m.is_ring_atom (i))
+    if (nrings[i])
       continue;
 
-    const Atom * a = m.atomi (i);
-
-    if (2 == a->nbonds () && 0 == a->formal_charge ())
+    if (2 == nbonds[i] && 0 == fc[i])
     {
-      int path_length = determine_chain (m, i, mz, ncon, already_done);
+      int path_length = determine_chain (m, i, features, already_done);
 
       long_chain[path_length]++;
     }
@@ -687,14 +871,19 @@ long_carbon_chains (Molecule & m, Demerit & demerit,
   return 0;
 }
 
+/*
+  Every atom in a chain is one of the chain carbons, and nothing
+  shorter than 4 attracts a demerit
+*/
+
 static int
 long_carbon_chains (Molecule & m, Demerit & demerit,
-                    const atomic_number_t * mz, const int * ncon)
+                    Atom_Features & features)
 {
-  int matoms = m.natoms ();
-  int * tmp = new_int (matoms); iw_auto_array<int> free_tmp (tmp);
+  if (features.chain_carbons () < 4)
+    return 0;
 
-  return long_carbon_chains (m, demerit, mz, ncon, tmp);
+  return long_carbon_chains (m, demerit, features, features.scratch (0));
 }
 
 /*
@@ -713,11 +902,18 @@ static int apply_alkyl_halides = 1;
 
 static int
 alkyl_halides (Molecule & m, Demerit & demerit,
-               const atomic_number_t * mz, const int * ncon)
+               const Atom_Features & features)
 {
   if (! apply_alkyl_halides)
     return 0;
 
+  if (0 == features.halogens ())
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+
   resizable_array<atom_number_t> ccl3;    // carbons which are CCl3 centres
 
   int matoms = m.natoms ();
@@ -746,7 +942,7 @@ alkyl_halides (Molecule & m, Demerit & demerit,
     if (ccl3.contains (c))
       continue;
 
-    if (ncon[c] < m.nbonds (c))
+    if (ncon[c] < nbonds[c])
       continue;
 
 //  We have a halogen attached to a saturated carbon.
@@ -903,8 +1099,14 @@ static int apply_more_than_two_phosporus = 1;
 
 static int
 phosphorus (Molecule & m, Demerit & demerit,
-            const atomic_number_t * mz, const int * ncon)
+            const Atom_Features & features)
 {
+  if (0 == features.count (15))
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+
   int phosphoric_acids = 0;
 
   int matoms = m.natoms ();
@@ -974,11 +1176,18 @@ static int apply_two_halogens_at_different_attach_points = 1;
 
 static int
 two_halogens_at_different_attach_points (Molecule & m, Demerit & demerit,
-               const atomic_number_t * mz, const int * ncon)
+               const Atom_Features & features)
 {
   if (! apply_two_halogens_at_different_attach_points)
     return 0;
 
+  if (features.halogens () < 2)
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+
   int first_carbon_centre = INVALID_ATOM_NUMBER;
 
   int matoms = m.natoms ();
@@ -989,7 +1198,7 @@ two_halogens_at_different_attach_points (Molecule & m, Demerit & demerit,
     {
       atom_number_t c = m.other (i, 0);
       atomic_number_t cz = mz[c];
-      if (6 == cz && ncon[c] == m.nbonds (c))    // SP3 carbon only
+      if (6 == cz && ncon[c] == nbonds[c])    // SP3 carbon only
       {
         if (INVALID_ATOM_NUMBER == first_carbon_centre)
           first_carbon_centre = c;
@@ -1019,17 +1228,24 @@ static int apply_more_than_three_sulphur = 1;
 
 static int
 more_than_three_sulphur (Molecule & m, Demerit & demerit,
-               const atomic_number_t * mz, const int * ncon)
+               const Atom_Features & features)
 {
   if (! apply_more_than_three_sulphur)
     return 0;
 
+  if (features.count (16) < 3)
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nrings = features.nrings ();
+
   int nsulphur = 0;
   int matoms = m.natoms ();
   for (int i = 0; i < matoms; i++)
   {
     atomic_number_t z = mz[i];
-    if (16 == z && 2 == ncon[i] && 0 == m.nrings (i))
+    if (16 == z && 2 == ncon[i] && 0 == nrings[i])
     {
       nsulphur++;
       if (nsulphur >= 3)
@@ -1059,15 +1275,24 @@ static int apply_sulphur_nitrogen = 1;
 
 static int
 sulphur_nitrogen (Molecule & m, Demerit & demerit,
-               const atomic_number_t * mz, const int * ncon)
+               const Atom_Features & features)
 {
   if (! apply_sulphur_nitrogen)
     return 0;
 
+  if (0 == features.count (16) || 0 == features.count (7))
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+  const int * nrings = features.nrings ();
+  const formal_charge_t * fc = features.formal_charge ();
+
   int matoms = m.natoms ();
   for (int i = 0; i < matoms; i++)
   {
-    if (16 != mz[i] || ncon[i] < 2 || ncon[i] > 4 || m.formal_charge (i))
+    if (16 != mz[i] || ncon[i] < 2 || ncon[i] > 4 || fc[i])
       continue;
 
     if (m.is_aromatic (i))
@@ -1085,7 +1310,7 @@ sulphur_nitrogen (Molecule & m, Demerit & demerit,
       if (7 != mz[k])
         continue;
 
-      if (m.is_ring_atom (k))
+      if (nrings[k])
         continue;
 
       if (2 == ncon[i] && b->is_single_bond ())
@@ -1094,7 +1319,7 @@ sulphur_nitrogen (Molecule & m, Demerit & demerit,
         demerit.reject ("[SD2]=N");
 //    else if (3 == ncon[i] && b->is_double_bond ())    // removed 25 sept 2010
 //      demerit.reject ("[SD3]=N");
-      else if (4 == ncon[i] && 6 == as->nbonds ())    // sulphone type OK
+      else if (4 == ncon[i] && 6 == nbonds[i])    // sulphone type OK
         continue;
       else
         demerit.reject ("sulfinamide");
@@ -1124,15 +1349,23 @@ static int apply_two_nitrogens_with_double_bonds = 1;
 
 static int
 nitrogen_nitrogen (Molecule & m, Demerit & demerit,
-               const atomic_number_t * mz, const int * ncon)
+               const Atom_Features & features)
 {
+  if (features.count (7) < 2)
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+  const int * nbonds = features.nbonds ();
+  const int * nrings = features.nrings ();
+
   int matoms = m.natoms ();
   for (int i = 0; i < matoms; i++)
   {
     if (7 != mz[i])
       continue;
 
-    if (m.nrings (i))
+    if (nrings[i])
       continue;
 
     const Atom * a = m.atomi (i);
@@ -1143,7 +1376,7 @@ nitrogen_nitrogen (Molecule & m, Demerit & demerit,
       const Bond * b = a->item (j);
       atom_number_t k = b->other (i);
 
-      if (7 == mz[k] && 0 == m.nrings (k) && apply_nitrogen_nitrogen_triple_bond)     // two N's in a chain.
+      if (7 == mz[k] && 0 == nrings[k] && apply_nitrogen_nitrogen_triple_bond)     // two N's in a chain.
       {
         if (b->is_triple_bond ())
         {
@@ -1159,7 +1392,7 @@ nitrogen_nitrogen (Molecule & m, Demerit & demerit,
         }
         if (b->is_single_bond ())
         {
-          if (a->nbonds () > ncon[i] && m.nbonds (k) > ncon[k])
+          if (nbonds[i] > ncon[i] && nbonds[k] > ncon[k])
           {
             demerit.reject ("=N-N=");
             two_nitrogens_with_double_bonds_count++;
@@ -1179,12 +1412,17 @@ static int apply_nitrogen_single_bond_nitrogen = 1;
 static int
 nitrogen_single_bond_nitrogen (Molecule & m,
                         Demerit & demerit,
-                        const atomic_number_t * mz,
-                        const int * ncon)
+                        const Atom_Features & features)
 {
   if (! apply_nitrogen_single_bond_nitrogen)
     return 0;
 
+  if (features.count (7) < 2)
+    return 0;
+
+  const atomic_number_t * mz = features.z ();
+  const int * ncon = features.ncon ();
+
   int matoms = m.natoms ();
   int NNcount = 0;
   for (int i = 0; i < matoms; i++)
@@ -1237,54 +1475,76 @@ too_many_rings (Molecule & m,
 
 
 
+/*
+  Oct 2026. With RULES_DONE, every rule is applied regardless of
+  rejection. After each, the number of rules recorded goes to
+  RULES_DONE, and to STOP whether we would have stopped there: 1 or 0,
+  or -1 for the rules which stop only if the Demerit is rejected
+*/
+
+static int
+rule_done (int rc,
+           const Demerit & demerit,
+           resizable_array<int> * rules_done,
+           resizable_array<int> * stop,
+           int rc_is_rejected = 0)
+{
+  if (NULL != rules_done)
+  {
+    rules_done->add (demerit.number_rules_recorded ());
+    stop->add (rc_is_rejected ? -1 : rc);
+    return 0;
+  }
+
+  return rc && 0 == keep_going_after_rejection;
+}
+
 static int
 hard_coded_queries (Molecule & m,
                     Demerit & demerit,
-                    const atomic_number_t * z,
-                    const int * ncon)
+                    Atom_Features & features,
+                    resizable_array<int> * rules_done,
+                    resizable_array<int> * stop)
 {
-  int * ring_membership = new int[m.natoms ()]; iw_auto_array<int> free_ring_membership (ring_membership);
-  m.ring_membership (ring_membership);
-
-  if (alkyl_halides (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (alkyl_halides (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
 //if (fluorine (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
 //  return 1;
 
-  if (phosphorus (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (phosphorus (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (two_halogens_at_different_attach_points (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (two_halogens_at_different_attach_points (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (nitrogen_nitrogen (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (nitrogen_nitrogen (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (nitrogen_single_bond_nitrogen (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (nitrogen_single_bond_nitrogen (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (too_many_rings (m, demerit) && 0 == keep_going_after_rejection)
+  if (rule_done (too_many_rings (m, demerit), demerit, rules_done, stop, 1))
     return 1;
 
-  if (more_than_three_sulphur (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (more_than_three_sulphur (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (sulphur_nitrogen (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (sulphur_nitrogen (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (too_many_charges (m, demerit) && 0 == keep_going_after_rejection)
+  if (rule_done (too_many_charges (m, demerit, features), demerit, rules_done, stop, 1))
     return 1;
 
-  if (long_carbon_chains (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (long_carbon_chains (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
-  if (determine_c7_ring (m, demerit, z, ncon) && 0 == keep_going_after_rejection)
+  if (rule_done (determine_c7_ring (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
   if (! apply_satcg)
     ;
-  else if (large_saturated_carbon_sections_including_rings (m, demerit, z, ncon, ring_membership) && 0 == keep_going_after_rejection)
+  else if (rule_done (large_saturated_carbon_sections_including_rings (m, demerit, features), demerit, rules_done, stop))
     return 1;
 
 //if (complex_fused_rings(m, demerit))
@@ -1296,15 +1556,20 @@ hard_coded_queries (Molecule & m,
 int
 hard_coded_queries (Molecule & m, Demerit & demerit)
 {
-  int matoms = m.natoms ();
+  atom_features.build (m);
 
-  int * ncon = new int[matoms]; iw_auto_array<int> free_ncon (ncon);
-  (void) m.ncon (ncon);
+  return hard_coded_queries (m, demerit, atom_features, NULL, NULL);
+}
 
-  atomic_number_t * z = new atomic_number_t[matoms]; iw_auto_array<atomic_number_t> free_z (z);
-  (void) m.atomic_numbers (z);
+int
+hard_coded_queries (Molecule & m,
+                    Demerit & demerit,
+                    resizable_array<int> & rules_done,
+                    resizable_array<int> & stop)
+{
+  atom_features.build (m);
 
-  return hard_coded_queries (m, demerit, z, ncon);
+  return hard_coded_queries (m, demerit, atom_features, &rules_done, &stop);
 }
 
 int
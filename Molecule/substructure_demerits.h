@@ -19,6 +19,8 @@
 #ifndef SUBSTRUCTURE_DEMERIT_H
 #define SUBSTRUCTURE_DEMERIT_H
 
+#include "iwaray.h"
+
 class Molecule;
 class Demerit;
 class Charge_Assigner;
@@ -40,6 +42,16 @@ extern int initialise_hard_coded_queries_to_do (IWString &);
 
 extern int hard_coded_queries (Molecule &, Demerit &);
 
+/*
+  Oct 2026. Every rule is applied, regardless of rejection. After each
+  rule, the first array gets the number of rules recorded so far, and
+  the second whether to stop there: 1 or 0, or -1 to stop only if the
+  Demerit is rejected. The results can then be replayed into a Demerit
+  with any prior score
+*/
+
+extern int hard_coded_queries (Molecule &, Demerit &, resizable_array<int> &, resizable_array<int> &);
+
 /*
   We need a means of passing the charge assigner in substructure_demerits.cc back
   to the calling programme so it can be initialised from the command line. Awful!
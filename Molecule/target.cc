@@ -1659,12 +1659,99 @@ Molecule_to_Match::_identify_between_rings (atom_number_t aprev,
   return 0;
 }
 
+/*
+  A path is the same whichever end it is read from, so the bit comes
+  from the lexically smaller direction
+*/
+
+int
+path_fingerprint_bit (const atomic_number_t * z, int n)
+{
+  int forward = 1;
+  for (int i = 0; i < n / 2; i++)
+  {
+    if (z[i] == z[n - 1 - i])
+      continue;
+
+    forward = z[i] < z[n - 1 - i];
+    break;
+  }
+
+  unsigned int h = n;
+  for (int i = 0; i < n; i++)
+  {
+    atomic_number_t zi;
+    if (forward)
+      zi = z[i];
+    else
+      zi = z[n - 1 - i];
+
+    h = h * 131 + zi + 1;
+  }
+
+  return h % PATH_FINGERPRINT_NBITS;
+}
+
+/*
+  Z holds the atomic numbers of the N atoms on the path so far, ending at A
+*/
+
+void
+Molecule_to_Match::_add_paths (atomic_number_t * z, int * on_path, int n,
+                               const Target_Atom & a)
+{
+  z[n] = a.atomic_number ();
+  n++;
+
+  _fingerprint->set (path_fingerprint_bit (z, n));
+
+  if (PATH_FINGERPRINT_MAX_ATOMS == n)
+    return;
+
+  atom_number_t zatom = a.atom_number ();
+
+  on_path[zatom] = 1;
+
+  Target_Atom & t = _target_atom[zatom];
+
+  int acon = t.ncon ();
+  for (int i = 0; i < acon; i++)
+  {
+    const Target_Atom * o = t.other (i).other ();
+
+    if (! on_path[o->atom_number ()])
+      _add_paths (z, on_path, n, *o);
+  }
+
+  on_path[zatom] = 0;
+
+  return;
+}
+
+int
+Molecule_to_Match::_compute_path_fingerprint ()
+{
+  _fingerprint = new IW_Bits_Base (PATH_FINGERPRINT_NBITS);
+
+  int * on_path = new_int (_natoms); iw_auto_array<int> free_on_path (on_path);
+
+  atomic_number_t z[PATH_FINGERPRINT_MAX_ATOMS];
+
+  for (int i = 0; i < _natoms; i++)
+  {
+    _add_paths (z, on_path, 0, _target_atom[i]);
+  }
+
+  return 1;
+}
+
 int
-Molecule_to_Match::is_superset (const IW_Bits_Base & fp) const
+Molecule_to_Match::is_superset (const IW_Bits_Base & fp)
 {
-  assert (NULL != _fingerprint);
+  if (NULL == _fingerprint)
+    _compute_path_fingerprint ();
 
-  return fp.is_subset (*_fingerprint);
+  return _fingerprint->is_subset (fp);
 }
 
 void
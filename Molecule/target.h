@@ -226,6 +226,18 @@ class Target_Atom
 #define TARGET_SPTMP -3
 #define TARGET_UNSET -4
 
+/*
+  Oct 2026. Path fingerprints screen substructure searches. A bit is set
+  for every sequence of up to PATH_FINGERPRINT_MAX_ATOMS bonded atoms,
+  identified only by atomic number. A query sets bits only for paths any
+  match must contain, so a target lacking one of them cannot match.
+*/
+
+#define PATH_FINGERPRINT_NBITS 2048
+#define PATH_FINGERPRINT_MAX_ATOMS 4
+
+extern int path_fingerprint_bit (const atomic_number_t * z, int n);
+
 class Molecule_to_Match
 {
   private:
@@ -300,6 +312,9 @@ class Molecule_to_Match
 
     void _initialise_molecule (Molecule * m);
 
+    void _add_paths (atomic_number_t * z, int * on_path, int n, const Target_Atom & a);
+    int _compute_path_fingerprint ();
+
   public:
     Molecule_to_Match ();
     Molecule_to_Match (Molecule *);
@@ -323,7 +338,9 @@ class Molecule_to_Match
 
     int atoms_with_atomic_number (atomic_number_t) const;
 
-    int is_superset (const IW_Bits_Base &) const;
+//  The first call computes our path fingerprint
+
+    int is_superset (const IW_Bits_Base &);
 
     atom_number_t start_matching_at () const { return _start_matching_at;}
     void set_start_matching_at (atom_number_t s) { _start_matching_at = s;}
@@ -30,6 +30,9 @@
 #include "molecule.h"
 #include "path.h"
 #include "qry_wstats.h"
+#include "query_scheduler.h"
+#include "query_index.h"
+#include "hit_matrix.h"
 #include "molecule_to_query.h"
 #include "target.h"
 #include "misc.h"
@@ -131,6 +134,7 @@ usage (int rc)
   cerr << "  -R <fname>     create report file, how many times each query matches <fname>\n";
   cerr << "  -b             for each molecule, break after finding a query which matches\n";
   cerr << "  -B             for each molecule, break after finding a query which DOESN't match\n";
+  cerr << "  -Z ...         with -b, adaptive query order, enter '-Z help' for info\n";
   cerr << "  -G <fname>     file for lists of matched atoms\n";
   cerr << "  -i <type>      specify input type, enter '-i help' for info\n";
   cerr << "  -o <type>      output type for all molecules written\n";
@@ -166,6 +170,10 @@ display_dash_M_options()
   cerr << "  -M nhtag=<tag> output TDT, insert number of hits in the <tag> dataitem\n";
   cerr << "  -M htag=<tag>  output TDT, insert id of each query that matches\n";
   cerr << "  -M time        report timing\n";
+  cerr << "  -M profile     report the most expensive queries\n";
+  cerr << "  -M profile=<fname> also write a profile of every query to <fname>\n";
+  cerr << "  -M hitmatrix=<fname> write matches to every query, for mc_rescore\n";
+  cerr << "  -M qindex      index queries by the elements they need, only search possible matches\n";
   cerr << "  -M report=nn   report progress every <nn> molecules processed\n";
   cerr << "  -M meach       match each query of a multi-component query - ignores operators\n";
   cerr << "  -M ncon=xxx    number of connections to matched atoms\n";
@@ -179,7 +187,7 @@ display_dash_M_options()
   cerr << "  -M edno        embedings do not overlap\n";
   cerr << "  -M nosm        do not record self matches - ID's the same\n";
   cerr << "  -M xrianum     turn off the respect initial atom numbering flag (obscure)\n";
-  cerr << "  -M usefp       use fingerprints for queries created from molecules\n";
+  cerr << "  -M usefp       screen every query with a path fingerprint\n";
   cerr << "  -M ucez        interpret uppercase smarts letters as element specifiers only\n";
   cerr << "  -M ecount      initialise element counts in targets - may help '-q M:...'\n";
   cerr << "  -M mmaq        must match all queries in order for a match to be perceived\n";
@@ -275,6 +283,13 @@ static int write_non_matches_to_matched_stream = 0;
 
 static int NONM_append_non_match_query_details = 0;
 
+/*
+  Oct 2026. With SEPA every query writes its own matches (or non
+  matches) as it is searched
+*/
+
+static int separate_file_for_each_query_used = 0;
+
 static int write_matched_atoms_as_mdl_v30_atom_lists = 0;
 static int write_matched_atoms_as_mdl_v30_bond_lists = 0;
 
@@ -321,6 +336,22 @@ static Molecule_Output_Object stream_for_individually_labelled_matches;
 
 static int report_timing = 0;
 
+/*
+  Oct 2026. Per query profile, -M profile. The most expensive queries are
+  reported, and if a file name is given, all queries written there
+*/
+
+static int profile_queries = 0;
+static IWString profile_file_name;
+
+/*
+  Oct 2026. With -M hitmatrix=<fname> the number of matches to every
+  query is written for every molecule, for mc_rescore. With -b the
+  remaining queries are searched once the first match is processed
+*/
+
+static Hit_Matrix_Writer hit_matrix;
+
 /*
   The matched atoms can be labelled as isotopes, or transformed into
   a new atom type
@@ -864,14 +895,25 @@ transform_atoms_hit (const Substructure_Results & sresults,
   return 1;
 }
 
+/*
+  Oct 2026. With -M qindex, queries needing elements the molecule does
+  not have are recorded as non matches without being searched
+*/
+
+static Query_Index query_index;
+
 static int
-do_single_query (Molecule_to_Match & target,
+search_single_query (Molecule_to_Match & target,
                  int query_number,
                  Substructure_Hit_Statistics * query,
-                 Substructure_Results & sresults,
-                 const Element ** element_labels,
-                 int * atom_isotopic_label)
+                 Substructure_Results & sresults)
 {
+  if (query_index.active() && ! query_index.candidate(query_number))
+  {
+    query_index.skipped();
+    return query->no_match(target, sresults);
+  }
+
 #ifdef USE_IWMALLOC
   iwmalloc_check_all_malloced(stderr);
 #endif
@@ -888,6 +930,22 @@ do_single_query (Molecule_to_Match & target,
   if (discard_hits_in_non_organic_fragments)
     nmatches = do_discard_hits_in_non_organic_fragments(target, sresults);
 
+  return nmatches;
+}
+
+/*
+  Everything done once a query has matched
+*/
+
+static int
+process_single_query_match (Molecule_to_Match & target,
+                 int query_number,
+                 Substructure_Hit_Statistics * query,
+                 Substructure_Results & sresults,
+                 int nmatches,
+                 const Element ** element_labels,
+                 int * atom_isotopic_label)
+{
   if ((verbose > 1 || report_matches) ||
       (0 == multiple_matches_each_query_counts_one && report_multiple_matches > 0 && nmatches > report_multiple_matches))
     cerr << molecules_read << ": '" << target.molecule()->molecule_name() << "' " << nmatches <<
@@ -912,20 +970,161 @@ do_single_query (Molecule_to_Match & target,
   return nmatches;
 }
 
+static int
+do_single_query (Molecule_to_Match & target,
+                 int query_number,
+                 Substructure_Hit_Statistics * query,
+                 Substructure_Results & sresults,
+                 const Element ** element_labels,
+                 int * atom_isotopic_label)
+{
+  int nmatches = search_single_query(target, query_number, query, sresults);
+
+  if (0 == nmatches)
+    return 0;
+
+  return process_single_query_match(target, query_number, query, sresults, nmatches, element_labels, atom_isotopic_label);
+}
+
 /*
+  With -b and -Z the queries are searched in the order the scheduler
+  suggests, until one matches. Which molecules match does not depend
+  on the order, which query matched does. When anything about the
+  matching query is written, the first match in file order is found by
+  searching the earlier queries not yet tried
+*/
+
+static Query_Scheduler query_scheduler;
+
+static int scheduler_recompute_first_match = 0;
+
+static int
+do_first_matching_query (Molecule_to_Match & target,
+                         const IWString & mname,
+                         resizable_array_p<Substructure_Hit_Statistics> & queries,
+                         Substructure_Results * sresults,
+                         int * hits,
+                         const Element ** element_labels,
+                         int * atom_isotopic_label)
+{
+  int nq = queries.number_elements();
+
+  const int * order = query_scheduler.order();
+
+  Molecule * m = target.molecule();
+
+  int * searched = NULL;
+  IWString name_before_search;
+
+  if (scheduler_recompute_first_match)
+  {
+    searched = new_int(nq);
+    name_before_search = m->name();
+  }
+
+  iw_auto_array<int> free_searched(searched);
+
+  int matched = -1;
+  int nmatches = 0;
+
+  for (int i = 0; i < nq; i++)
+  {
+    const int j = order[i];
+
+    if (mname.length() && mname == queries[j]->comment())
+      continue;
+
+    const iw_uint64_t t0 = substructure_search_cycles();
+
+    nmatches = search_single_query(target, j, queries[j], sresults[j]);
+
+    query_scheduler.record(j, nmatches > 0, substructure_search_cycles() - t0);
+
+    if (NULL != searched)
+      searched[j] = 1;
+
+    if (nmatches > 0)
+    {
+      matched = j;
+      break;
+    }
+  }
+
+// An earlier query in file order that matches is the one reported without -Z.
+// Only a match appends to the name, so each search starts from the original name
+
+  if (matched > 0 && NULL != searched)
+  {
+    const IWString name_after_search = m->name();
+
+    int earlier_match = 0;
+
+    for (int i = 0; i < matched; i++)
+    {
+      if (searched[i])
+        continue;
+
+      if (mname.length() && mname == queries[i]->comment())
+        continue;
+
+      m->set_name(name_before_search);
+
+      const iw_uint64_t t0 = substructure_search_cycles();
+
+      const int n = search_single_query(target, i, queries[i], sresults[i]);
+
+      query_scheduler.record(i, n > 0, substructure_search_cycles() - t0);
+
+      if (n > 0)
+      {
+        matched = i;
+        nmatches = n;
+        earlier_match = 1;
+        break;
+      }
+    }
+
+    if (! earlier_match)
+      m->set_name(name_after_search);
+  }
+
+  query_scheduler.molecule_done();
+
+  if (matched < 0)
+    return 0;
+
+  hits[matched] = process_single_query_match(target, matched, queries[matched], sresults[matched], nmatches, element_labels, atom_isotopic_label);
+
+  return 1;
+}
+
+/*
+  Queries after the first match (-b), or the first non match (-B), are
+  searched only for the hit matrix
+*/
+
 static void
-update_atom_coverage (const Substructure_Results & sresults,
-                      int * atom_hit)
+add_remaining_queries_to_hit_matrix (Molecule_to_Match & target,
+                                     const IWString & mname,
+                                     resizable_array_p<Substructure_Hit_Statistics> & queries,
+                                     Substructure_Results * sresults,
+                                     int istart)
 {
-  int nhits = sresults.number_embeddings();
+  int nq = queries.number_elements();
 
-  for (int i = 0; i < nhits; i++)
+  for (int i = istart; i < nq; i++)
   {
-    sresults.embedding(i)->set_vector(atom_hit, 1);
+    if (mname.length() && mname == queries[i]->comment())
+      continue;
+
+    int nhits = search_single_query(target, i, queries[i], sresults[i]);
+
+    if (nhits)
+      hit_matrix.add_entry(i, nhits, 0);
   }
 
   return;
-}*/
+}
 
 static int
 do_all_queries (Molecule & m,
@@ -946,34 +1145,66 @@ do_all_queries (Molecule & m,
   if (element_transformations.active())
     element_transformations.process(target);
 
+  if (query_index.active())
+    query_index.prepare(target);
+
   int total_hits_across_all_queries = 0;
 
   int nq = queries.number_elements();
-  for (int i = 0; i < nq; i++)
+
+  if (query_scheduler.active())
   {
-    if (perform_search_even_if_names_the_same)
-      ;
-    else if (0 == mname.length())
+    if (0 == mname.length() && ! perform_search_even_if_names_the_same)
       cerr << "Molecule with no name detected, cannot determine self match, searching...\n";
-    else if (mname == queries[i]->comment())
-      continue;
 
-    int nhits;
-    if ((nhits = do_single_query(target, i, queries[i], sresults[i], element_labels, atom_isotopic_label)))
+    rc = do_first_matching_query(target, mname, queries, sresults, hits, element_labels, atom_isotopic_label);
+    for (int i = 0; i < nq; i++)
+    {
+      total_hits_across_all_queries += hits[i];
+    }
+  }
+  else
+  {
+    int queries_searched = nq;
+
+    for (int i = 0; i < nq; i++)
     {
-      rc++;
-      hits[i] = nhits;
+      if (perform_search_even_if_names_the_same)
+        ;
+      else if (0 == mname.length())
+        cerr << "Molecule with no name detected, cannot determine self match, searching...\n";
+      else if (mname == queries[i]->comment())
+        continue;
+
+      int nhits;
+      if ((nhits = do_single_query(target, i, queries[i], sresults[i], element_labels, atom_isotopic_label)))
+      {
+        rc++;
+        hits[i] = nhits;
 
-      if (print_embeddings)
-        sresults[i].print_embeddings(cerr, verbose > 1);
+        if (print_embeddings)
+          sresults[i].print_embeddings(cerr, verbose > 1);
 
-      total_hits_across_all_queries += nhits;
+        total_hits_across_all_queries += nhits;
 
-      if (break_at_first_match)
+        if (hit_matrix.is_open())
+          hit_matrix.add_entry(i, nhits, 0);
+
+        if (break_at_first_match)
+        {
+          queries_searched = i + 1;
+          break;
+        }
+      }
+      else if (break_at_first_non_match)
+      {
+        queries_searched = i + 1;
         break;
+      }
     }
-    else if (break_at_first_non_match)
-      break;
+
+    if (hit_matrix.is_open())
+      add_remaining_queries_to_hit_matrix(target, mname, queries, sresults, queries_searched);
   }
 
   if (bob_coner_stream.rdbuf()->is_open())
@@ -1069,8 +1300,18 @@ tsubstructure (Molecule & m,
     }
   }
 
+  IWString hit_matrix_smiles, hit_matrix_name;
+  if (hit_matrix.is_open())
+  {
+    hit_matrix_smiles = m.smiles();
+    hit_matrix_name = m.name();
+  }
+
   int nmatched = do_all_queries(m, queries, sresults, tmp, new_elements, atom_isotopic_label);
 
+  if (hit_matrix.is_open())
+    hit_matrix.finish_row(hit_matrix_smiles, hit_matrix_name, m.atoms_in_largest_fragment(), 0);
+
   if (NULL != atom_isotopic_label)
     delete [] atom_isotopic_label;
 
@@ -1502,6 +1743,7 @@ parse_set_of_options (Command_Line & cl,
     else if (tmp.starts_with("SEPA"))
     {
       separate_file_for_each_query = 1;
+      separate_file_for_each_query_used = 1;
       need_to_open_file = 1;
       if (verbose)
         cerr << match_or_non_match << " written to separate file for each query\n";
@@ -1602,7 +1844,7 @@ assign_name_if_needed (Substructure_Hit_Statistics & q,
 static int
 tsubstructure (int argc, char ** argv)
 {
-  Command_Line cl (argc, argv, "w:W:y:R:X:hj:J:E:rcls:S:t:A:K:bBd:fm:n:uvo:i:q:Q:ag:pkG:Y:N:H:M:x:T:");
+  Command_Line cl (argc, argv, "w:W:y:R:X:hj:J:E:rcls:S:t:A:K:bBd:fm:n:uvo:i:q:Q:ag:pkG:Y:N:H:M:x:T:Z:");
 
   if (cl.unrecognised_options_encountered())
   {
@@ -1871,6 +2113,46 @@ tsubstructure (int argc, char ** argv)
 
         tzero = time(NULL);
       }
+      else if ("profile" == m)
+      {
+        profile_queries = 1;
+        set_substructure_search_profiling(1);
+
+        if (verbose)
+          cerr << "Will profile each query\n";
+      }
+      else if (m.starts_with("profile="))
+      {
+        m.remove_leading_chars(8);
+        profile_file_name = m;
+
+        profile_queries = 1;
+        set_substructure_search_profiling(1);
+
+        if (verbose)
+          cerr << "Query profile written to '" << profile_file_name << "'\n";
+      }
+      else if (m.starts_with("hitmatrix="))
+      {
+        m.remove_leading_chars(10);
+        IWString fname(m);
+
+        if (! hit_matrix.open(fname.null_terminated_chars(), IWHM_KIND_ANY_MATCH))
+        {
+          cerr << "Cannot open hit matrix '" << fname << "'\n";
+          return 3;
+        }
+
+        if (verbose)
+          cerr << "Hit matrix written to '" << fname << "'\n";
+      }
+      else if ("qindex" == m)
+      {
+        query_index.set_active(1);
+
+        if (verbose)
+          cerr << "Only queries whose required elements are present will be searched\n";
+      }
       else if ("organic" == m)
       {
         discard_hits_in_non_organic_fragments = 1;
@@ -2560,6 +2842,71 @@ tsubstructure (int argc, char ** argv)
       cerr << "Matched atom lists written to '" << g << "'\n";
   }
 
+  if (hit_matrix.is_open())
+  {
+    for (int i = 0; i < queries.number_elements(); i++)
+    {
+      hit_matrix.add_column(queries[i]->comment(), IWHM_COLUMN_QUERY, 0.0);
+    }
+  }
+
+  if (cl.option_present('Z'))
+  {
+    const_IWSubstring z;
+    for (int i = 0; cl.value('Z', z, i); i++)
+    {
+      if ("help" == z)
+      {
+        display_query_scheduler_options(cerr, 'Z');
+        exit(0);
+      }
+
+      if (! query_scheduler.parse_directive(z))
+      {
+        cerr << "Unrecognised -Z qualifier '" << z << "'\n";
+        display_query_scheduler_options(cerr, 'Z');
+        usage(3);
+      }
+    }
+
+    if (! break_at_first_match || break_at_first_non_match)
+    {
+      cerr << "The -Z option only applies with -b\n";
+      usage(3);
+    }
+    else if (verbose > 1 || separate_file_for_each_query_used || NONM_append_non_match_query_details ||
+             append_non_match_details_to_molecule_name ||
+             bob_coner_stream.rdbuf()->is_open() || stream_for_directcolorfile.is_open() ||
+             hit_matrix.is_open())
+    {
+      cerr << "Output depends on every query searched, -Z ignored\n";
+      query_scheduler.set_active(0);
+    }
+    else if (! query_scheduler.initialise(queries, NULL))
+    {
+      cerr << "Cannot initialise the query order\n";
+      return 3;
+    }
+    else
+    {
+      if (report_matches || report_multiple_matches > 0 || print_embeddings ||
+          stream_for_multiple_matches.active() || stream_for_individually_labelled_matches.active() ||
+          label_matched_atoms || label_by_query_atom_number || label_by_query_number || matched_atoms_element ||
+          tag_for_nhits.length() || tag_for_hits.length() || min_hits_needed > 0 ||
+          max_hits_needed < numeric_limits<int>::max() || append_match_details_to_molecule_name ||
+          cl.option_present('a') || cl.option_present('Y') || cl.option_present('J') ||
+          write_matched_atoms_as_mdl_v30_atom_lists || write_matched_atoms_as_mdl_v30_bond_lists)
+        scheduler_recompute_first_match = 1;
+
+      if (verbose)
+      {
+        cerr << "Queries most likely to match tried first\n";
+        if (scheduler_recompute_first_match)
+          cerr << "Earlier queries searched to find the first match in file order\n";
+      }
+    }
+  }
+
 // Now that all queries are in, make any global changes to them.
 
   for (int i = 0; i < queries.number_elements(); i++)
@@ -2622,6 +2969,21 @@ tsubstructure (int argc, char ** argv)
     assert (qi->ok());
   }
 
+// Element transformations change the target after the index has looked at it
+
+  if (query_index.active() && element_transformations.active())
+  {
+    cerr << "Element transformations (-T) change what queries can match, -M qindex ignored\n";
+    query_index.set_active(0);
+  }
+  else if (query_index.active())
+  {
+    query_index.build(queries);
+
+    if (verbose)
+      cerr << query_index.queries_indexed() << " of " << queries.number_elements() << " queries indexed, " << query_index.number_records() << " distinct element requirements\n";
+  }
+
 #ifdef OLD_DASH_T_OPTION
   if (cl.option_present('T'))
   {
@@ -2830,6 +3192,41 @@ tsubstructure (int argc, char ** argv)
     }
   }
 
+  if (hit_matrix.is_open() && ! hit_matrix.close())
+  {
+    cerr << "Error writing hit matrix '" << hit_matrix.fname() << "'\n";
+    rc = 4;
+  }
+
+  if (verbose && query_scheduler.initialised())
+    query_scheduler.report(queries, cerr);
+
+  if (verbose && query_index.active())
+    query_index.report(cerr);
+
+  if (profile_queries)
+  {
+    resizable_array<Substructure_Hit_Statistics *> q;
+    for (int i = 0; i < nqueries; i++)
+    {
+      q.add(queries[i]);
+    }
+
+    report_query_profile(q, 20, cerr);
+
+    if (profile_file_name.length())
+    {
+      ofstream output(profile_file_name.null_terminated_chars(), ios::out);
+      if (! output.good())
+      {
+        cerr << "Cannot open query profile file '" << profile_file_name << "'\n";
+        rc = 1;
+      }
+      else
+        write_query_profile(q, output);
+    }
+  }
+
 #ifdef USE_IWMALLOC
   iwmalloc_check_all_malloced(stderr);
 #endif
@@ -0,0 +1,87 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#ifndef IW_ASYNC_STREAMBUF_H
+#define IW_ASYNC_STREAMBUF_H
+
+#include <streambuf>
+#include <pthread.h>
+
+/*
+  A streambuf which writes to a file descriptor through a ring of large
+  buffers. If a writer thread is requested, filled buffers are handed
+  to that thread which drains as many as are waiting with a single
+  writev, so the thread formatting the output seldom waits on write(2).
+  Without the thread, each buffer is written when full.
+
+  Data is written when a buffer fills, on sync (flush) and on close.
+*/
+
+class IW_Async_Streambuf : public std::streambuf
+{
+  private:
+    int _fd;
+
+    int _buffer_size;
+    int _nbuffers;
+    char ** _buffer;
+    int * _nchars;
+
+//  The buffer being filled. The _nqueued buffers before it in the ring are
+//  waiting to be written
+
+    int _current;
+    int _nqueued;
+
+    int _use_writer_thread;
+    int _thread_running;
+
+    pthread_t _writer;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _changed;
+
+    int _stop;
+    int _error;
+
+//  private functions
+
+    int _hand_off_current ();
+    int _write_all (struct iovec *, int);
+
+  protected:
+    int overflow (int);
+    int sync ();
+
+  public:
+    IW_Async_Streambuf ();
+    ~IW_Async_Streambuf ();
+
+//  Must be called before open
+
+    void set_buffer_size (int s) { _buffer_size = s;}
+    void set_use_writer_thread (int s) { _use_writer_thread = s;}
+
+    int open (const char * fname, int append);
+    int close ();
+
+    int is_open () const { return _fd >= 0;}
+
+    void writer ();
+};
+
+#endif
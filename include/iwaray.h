@@ -63,7 +63,23 @@ class resizable_array_base
     int _elements_allocated;
     int _magic;
     int _number_elements;
+
+//  Oct 2026. Derived types may provide a small buffer inside the object,
+//  used instead of the heap while the array fits. These live in what
+//  would otherwise be padding, and are zero for ordinary arrays
+
+    unsigned short _inline_capacity;
+    unsigned short _inline_offset;     // bytes from this to the buffer
+
     T * _things;
+
+    T * _inline_storage () const { return reinterpret_cast<T *> (reinterpret_cast<char *> (const_cast<resizable_array_base<T> *> (this)) + _inline_offset);}
+    int _things_are_inline () const { return _inline_capacity > 0 && _things == _inline_storage ();}
+    void _use_inline_storage (T *, int);
+
+    T *  _new_storage (int);
+    void _release_storage ();
+
   public:
     resizable_array_base        ();
     ~resizable_array_base       ();
@@ -144,6 +160,11 @@ class resizable_array_p : public resizable_array_base<T *>
     resizable_array_p            (int);
     resizable_array_p            (T *);
     ~resizable_array_p           ();
+
+//  Oct 2026. We own the pointers, a copy would delete them twice
+
+    resizable_array_p            (const resizable_array_p<T> &) = delete;
+    resizable_array_p<T> & operator = (const resizable_array_p<T> &) = delete;
  
     int  resize                   (int);
     int  resize_no_delete         (int);
@@ -249,6 +270,42 @@ class extending_resizable_array : public resizable_array<T>
     const T & operator [] (int i) const { return _things[i];}
 };
 
+/*
+  Oct 2026. Arrays that are nearly always short - bonds to an atom, ring
+  sizes, embeddings - spend more time in new and delete than using their
+  contents. These keep the first N items inside the object and only go
+  to the heap beyond that. Same interface as the parent. The objects
+  must not be moved by memcpy, rawdata () may point into the object.
+*/
+
+template <typename T, int N>
+class small_resizable_array : public resizable_array<T>
+{
+  private:
+    T _buffer[N];
+
+  public:
+    small_resizable_array ();
+    small_resizable_array (const small_resizable_array<T, N> &);
+    small_resizable_array (const resizable_array<T> &);
+
+    small_resizable_array<T, N> & operator = (const small_resizable_array<T, N> &);
+    small_resizable_array<T, N> & operator = (const resizable_array<T> &);
+};
+
+template <typename T, int N>
+class small_resizable_array_p : public resizable_array_p<T>
+{
+  private:
+    T * _buffer[N];
+
+  public:
+    small_resizable_array_p ();
+
+    small_resizable_array_p (const small_resizable_array_p<T, N> &) = delete;
+    small_resizable_array_p<T, N> & operator = (const small_resizable_array_p<T, N> &) = delete;
+};
+
 /*
   This derived type supports next () and previous () operators, and
   has a notion of the current item.
@@ -311,6 +368,8 @@ resizable_array_base<T>::resizable_array_base ()
 {
   _elements_allocated = _number_elements = 0;
   _magic = IWARAY_MAGIC_NUMBER;
+  _inline_capacity = 0;
+  _inline_offset = 0;
   _things = NULL;
 }
 
@@ -328,6 +387,50 @@ resizable_array<T>::resizable_array ()
 
 #include <assert.h>
 
+/*
+  Called from the constructor of a derived type that holds BUFFER. Must
+  happen before anything is stored
+*/
+
+template <typename T>
+void
+resizable_array_base<T>::_use_inline_storage (T * buffer, int n)
+{
+  assert (0 == _elements_allocated && NULL == _things);
+
+  _inline_offset = static_cast<unsigned short> (reinterpret_cast<char *> (buffer) - reinterpret_cast<char *> (this));
+  _inline_capacity = static_cast<unsigned short> (n);
+
+  return;
+}
+
+template <typename T>
+T *
+resizable_array_base<T>::_new_storage (int n)
+{
+  if (n <= _inline_capacity)
+    return _inline_storage ();
+
+  return new T[n];
+}
+
+/*
+  Frees storage if it came from the heap, leaves the array with nothing allocated
+*/
+
+template <typename T>
+void
+resizable_array_base<T>::_release_storage ()
+{
+  if (NULL != _things && ! _things_are_inline ())
+    delete [] _things;
+
+  _things = NULL;
+  _elements_allocated = 0;
+
+  return;
+}
+
 template <typename T>
 resizable_array_p<T>::resizable_array_p (int n)
 {
@@ -392,15 +495,11 @@ resizable_array_base<T>::~resizable_array_base ()
 {
   assert (ok());
    
+  _release_storage ();
+
   _number_elements = _elements_allocated = -1;   //paranoia !!
   _magic = -1;
 
-  if (_things)
-  {
-    delete [] _things;
-    _things = NULL;
-  }
-
   return;
 }
 
@@ -490,7 +589,9 @@ resizable_array_base<T>::add (T extra)
 
   if (_number_elements == _elements_allocated)
   {
-    if (0 == _number_elements)
+    if (_number_elements < _inline_capacity)    // fill any inline buffer before going to the heap
+      resize (_inline_capacity);
+    else if (0 == _number_elements)
       resize (INITIAL_NON_EMPTY_SIZE);
     else
       resize (_number_elements + _number_elements);
@@ -589,12 +690,7 @@ resizable_array_base<T>::remove_item (int item_to_remove)
   _number_elements--;
 
   if (0 == _number_elements)
-  {
-    if (NULL != _things)      // free anything already there
-      delete [] _things;
-    _elements_allocated = 0;
-    _things = NULL;
-  }
+    _release_storage ();
 
   return _number_elements;
 }
@@ -713,12 +809,7 @@ resizable_array_base<T>::remove_all (const T item_to_remove)
   _number_elements = j;
 
   if (0 == _number_elements)
-  {
-    if (NULL != _things)      // free anything already there
-      delete [] _things;
-    _elements_allocated = 0;
-    _things = NULL;
-  }
+    _release_storage ();
 
   return items_removed;
 }
@@ -770,11 +861,8 @@ resizable_array_base<T>::resize (int new_size)
 
   if (0 == new_size)
   {
-    if (NULL != _things)      // free anything already there
-      delete [] _things;
-    _elements_allocated = 0;
+    _release_storage ();
     _number_elements = 0;
-    _things = NULL;
     return 1;
   }
 
@@ -784,7 +872,7 @@ resizable_array_base<T>::resize (int new_size)
   if (0 == _elements_allocated)
   {
     assert (NULL == _things);
-    _things = new T[new_size];
+    _things = _new_storage (new_size);
     if (NULL == _things)
     {
       cerr << "resizable_array_base<T>::resize: malloc failure, size " << new_size << endl;
@@ -797,7 +885,7 @@ resizable_array_base<T>::resize (int new_size)
 
 // Create a new array, and copy existing data.
 
-  T * new_things = new T[new_size];
+  T * new_things = _new_storage (new_size);
 
   if (NULL == new_things)
   {
@@ -805,17 +893,21 @@ resizable_array_base<T>::resize (int new_size)
     return 1;
   }
 
-  int ncopy = _number_elements;
-  if (ncopy > new_size)
-    ncopy = new_size;
-
-  for (int i = 0; i < ncopy; i++)
+  if (new_things != _things)     // staying within the inline buffer needs no copy
   {
-    new_things[i] = _things[i];
-  }
+    int ncopy = _number_elements;
+    if (ncopy > new_size)
+      ncopy = new_size;
 
-  delete [] _things;
-  _things = new_things;
+    for (int i = 0; i < ncopy; i++)
+    {
+      new_things[i] = _things[i];
+    }
+
+    if (! _things_are_inline ())
+      delete [] _things;
+    _things = new_things;
+  }
 
   _elements_allocated = new_size;
 
@@ -1012,7 +1104,9 @@ resizable_array_base<T>::insert_before (int where_to_insert,
 
   if (_number_elements == _elements_allocated)
   {
-    if (0 == _number_elements)
+    if (_number_elements < _inline_capacity)
+      resize (_inline_capacity);
+    else if (0 == _number_elements)
       resize (INITIAL_NON_EMPTY_SIZE);
     else
       resize (_number_elements + _number_elements);
@@ -1043,7 +1137,9 @@ resizable_array_base<T>::insert_after (int where_to_insert,
 
   if (_number_elements == _elements_allocated)
   {
-    if (0 == _number_elements)
+    if (_number_elements < _inline_capacity)
+      resize (_inline_capacity);
+    else if (0 == _number_elements)
       resize (INITIAL_NON_EMPTY_SIZE);
     else
       resize (_number_elements + _number_elements);
@@ -1739,6 +1835,64 @@ extending_resizable_array<T>::extend (int new_size)
   return resizable_array<T>::extend (new_size, _initialiser);
 }
 
+template <typename T, int N>
+small_resizable_array<T, N>::small_resizable_array ()
+{
+  this->_use_inline_storage (_buffer, N);
+
+  return;
+}
+
+template <typename T, int N>
+small_resizable_array<T, N>::small_resizable_array (const small_resizable_array<T, N> & rhs)
+{
+  this->_use_inline_storage (_buffer, N);
+
+  resizable_array<T>::operator = (rhs);
+
+  return;
+}
+
+template <typename T, int N>
+small_resizable_array<T, N>::small_resizable_array (const resizable_array<T> & rhs)
+{
+  this->_use_inline_storage (_buffer, N);
+
+  resizable_array<T>::operator = (rhs);
+
+  return;
+}
+
+/*
+  The default assignment would also copy _buffer, clobbering what was just copied
+*/
+
+template <typename T, int N>
+small_resizable_array<T, N> &
+small_resizable_array<T, N>::operator = (const small_resizable_array<T, N> & rhs)
+{
+  resizable_array<T>::operator = (rhs);
+
+  return *this;
+}
+
+template <typename T, int N>
+small_resizable_array<T, N> &
+small_resizable_array<T, N>::operator = (const resizable_array<T> & rhs)
+{
+  resizable_array<T>::operator = (rhs);
+
+  return *this;
+}
+
+template <typename T, int N>
+small_resizable_array_p<T, N>::small_resizable_array_p ()
+{
+  this->_use_inline_storage (_buffer, N);
+
+  return;
+}
+
 #endif
 
 #if (IW_IMPLEMENTATIONS_EXPOSED) || defined(IWARAY_IMPLEMENTATION)
@@ -300,8 +300,10 @@ extern int print_bits (ostream & os, const void * bits, int nbits,
 
 #ifdef _WIN32
 extern int bits_in_common (const unsigned int *, const unsigned int *, int);
+extern int words_are_subset (const unsigned int *, const unsigned int *, int);
 #else
 extern "C" int bits_in_common (const unsigned int *, const unsigned int *, int);
+extern "C" int words_are_subset (const unsigned int *, const unsigned int *, int);
 #endif
 extern "C" int count_bits_set (const unsigned char *, int);
 
@@ -94,6 +94,22 @@ class iwstring_data_source
 
     IW_ZLib_Wrapper _gzfile;
 
+//  Oct 2026. Regular files can optionally be memory mapped. When that is
+//  done, _read_buffer points into the mapping rather than at our own
+//  storage, and records can be handed out as views into the mapping
+//  without being copied into _buffer.
+
+    char *   _mmap_data;
+    off_t    _mmap_size;
+    char *   _allocated_read_buffer;
+
+//  If the most recent record was returned as a view into the mapping, where
+//  it started in _read_buffer, or -1. Needed by push_record. _view is the
+//  record as it was returned, for most_recent_record
+
+    int      _view_start;
+    const_IWSubstring _view;
+
 // private functions
 
     void  _default_values (int);
@@ -111,6 +127,12 @@ class iwstring_data_source
     int   _save_state (IWSDS_State &);
     int   _restore_state (IWSDS_State &);
 
+    int   _setup_mmap ();
+    void  _release_mmap ();
+    int   _read_more_data_from_mapping ();
+    int   _can_return_view () const;
+    int   _next_record_from_mapping (const_IWSubstring &);
+
 protected:
 	
 	// for stringbuffer.
@@ -146,6 +168,8 @@ protected:
 
     int is_pipe () const { return 0 == _fd;}
 
+    int is_memory_mapped () const { return NULL != _mmap_data;}
+
     void set_dos (int d) { _dos = d;}
     void set_record_delimiter (char d);
 
@@ -212,6 +236,13 @@ protected:
     int read_bytes (void *, int);
 };
 
+/*
+  Regular files opened after this is set are memory mapped rather than read
+*/
+
+extern void set_iwstring_data_source_use_mmap (int);
+extern int  iwstring_data_source_use_mmap ();
+
 #endif
 
 /* arch-tag: 4df1f9cb-b50a-4beb-a150-9bee1e280d41 */
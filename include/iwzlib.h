@@ -66,6 +66,8 @@ class IW_ZLib_Wrapper
 #else
 #include "zlib.h"
 
+class IWZLib_Inflate_Pipeline;
+
 class IW_ZLib_Wrapper
 {
   private:
@@ -73,11 +75,25 @@ class IW_ZLib_Wrapper
 
     char * _buffer;
 
+//  Oct 2026. If inflation is being done by background threads, records
+//  come from buffers owned by _pipeline rather than _buffer. _data points
+//  to whichever is current, and _data_offset is the uncompressed offset
+//  of _data[0]
+
+    IWZLib_Inflate_Pipeline * _pipeline;
+
+    const char * _data;
+    z_off_t _data_offset;
+
     int _start_of_next_record;
     int _chars_in_buffer;
 
     char _record_delimiter;
 
+//  private functions
+
+    int _fill_buffer ();
+
   public:
     IW_ZLib_Wrapper ();
     ~IW_ZLib_Wrapper ();
@@ -85,7 +101,7 @@ class IW_ZLib_Wrapper
     int open_file (const char *);
     int close_file ();
 
-    int active () const { return NULL != _gzfile;}
+    int active () const { return NULL != _gzfile || NULL != _pipeline;}
 
     int eof () const;
 
@@ -99,6 +115,14 @@ class IW_ZLib_Wrapper
     z_off_t tellg () const;
 };
 
+/*
+  By default gzip'd files are inflated by the thread doing the reading.
+  If this is set non zero, files opened afterwards are inflated by a
+  background thread, and BGZF files by this many threads in parallel
+*/
+
+extern void set_iwzlib_inflate_threads (int);
+
 #endif
 
 #endif
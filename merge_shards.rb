@@ -0,0 +1,104 @@
+#!/usr/bin/env ruby
+
+#**************************************************************************
+
+#   Copyright (C) 2026  Eli Lilly and Company
+
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#*************************************************************************/
+
+
+# Concatenate the outputs of runs done with -shard k/N back into the
+# files a single run would have produced. Shards hold consecutive slices
+# of the input, so concatenating in shard order restores the input order.
+
+ianhome=File.dirname($0)
+
+require "#{ianhome}/ruby/iwcmdline.rb"
+
+def usage (rc)
+  $stderr.print "Merges the outputs of sharded runs\n"
+  $stderr.print "For each file 'stem.suffix' on the command line, concatenates\n"
+  $stderr.print "stem_shard0ofN.suffix .. stem_shard<N-1>ofN.suffix into stem.suffix\n"
+  $stderr.print "  merge_shards.rb -n 8 okmedchem.smi bad0.smi bad1.smi bad2.smi bad3.smi\n"
+  $stderr.print " -n <N>         number of shards\n"
+  $stderr.print " -rm            remove the shard files once merged\n"
+  $stderr.print " -v             verbose output\n"
+  exit(rc)
+end
+
+cl = IWCmdline.new("-v-n=ipos-rm")
+
+if cl.unrecognised_options_encountered()
+  $stderr.print "Unrecognised options encountered\n"
+  usage(1)
+end
+
+verbose = cl.option_present('v')
+
+unless (cl.option_present('n'))
+  $stderr.print "Must specify number of shards via the -n option\n"
+  usage(2)
+end
+
+nshards = cl.value('n')
+
+if (0 == ARGV.size)
+  $stderr.print "Insufficient arguments\n"
+  usage(2)
+end
+
+def shard_file_name (fname, k, nshards)
+  ext = File.extname(fname)
+  stem = fname[0, fname.length - ext.length]
+
+  return "#{stem}_shard#{k}of#{nshards}#{ext}"
+end
+
+# Make sure everything is there before writing anything
+
+rc = 0
+
+ARGV.each do |fname|
+  (0...nshards).each do |k|
+    s = shard_file_name(fname, k, nshards)
+    unless (File.exist?(s))
+      $stderr.print "Missing shard file '#{s}'\n"
+      rc = 1
+    end
+  end
+end
+
+exit(rc) if (rc > 0)
+
+ARGV.each do |fname|
+  bytes = 0
+  File.open(fname, mode='wb') do |output|
+    (0...nshards).each do |k|
+      s = shard_file_name(fname, k, nshards)
+      File.open(s, mode='rb') do |input|
+        bytes += IO.copy_stream(input, output)
+      end
+    end
+  end
+
+  $stderr.print "Wrote #{bytes} bytes to '#{fname}' from #{nshards} shards\n" if (verbose)
+
+  if (cl.option_present('rm'))
+    (0...nshards).each do |k|
+      File.unlink(shard_file_name(fname, k, nshards))
+    end
+  end
+end
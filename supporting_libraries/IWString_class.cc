@@ -3425,11 +3425,6 @@ IWString::strncat (const char * s, int nchars)
 
   ::memcpy (_things + _number_elements, s, nchars);
 
-  for (int i = 0; i < nchars; i++)
-  {
-    _things[_number_elements + i] = s[i];
-  }
-
   _number_elements += nchars;
 
   return _number_elements;
@@ -0,0 +1,353 @@
+/**************************************************************************
+
+    Copyright (C) 2026  Eli Lilly and Company
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <iostream>
+using namespace std;
+
+#include "iw_async_streambuf.h"
+
+#define IW_ASYNC_DEFAULT_BUFFER_SIZE (1024 * 1024)
+#define IW_ASYNC_NBUFFERS 4
+
+static void *
+iw_async_writer_thread (void * p)
+{
+  reinterpret_cast<IW_Async_Streambuf *>(p)->writer();
+
+  return NULL;
+}
+
+IW_Async_Streambuf::IW_Async_Streambuf ()
+{
+  _fd = -1;
+
+  _buffer_size = IW_ASYNC_DEFAULT_BUFFER_SIZE;
+  _nbuffers = 0;
+  _buffer = NULL;
+  _nchars = NULL;
+
+  _current = 0;
+  _nqueued = 0;
+
+  _use_writer_thread = 0;
+  _thread_running = 0;
+
+  _stop = 0;
+  _error = 0;
+
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_changed, NULL);
+
+  return;
+}
+
+IW_Async_Streambuf::~IW_Async_Streambuf ()
+{
+  if (_fd >= 0)
+    close();
+
+  pthread_cond_destroy(&_changed);
+  pthread_mutex_destroy(&_mutex);
+
+  return;
+}
+
+int
+IW_Async_Streambuf::open (const char * fname, int append)
+{
+  if (_fd >= 0)
+    close();
+
+  int flags = O_WRONLY | O_CREAT;
+  if (append)
+    flags |= O_APPEND;
+  else
+    flags |= O_TRUNC;
+
+  _fd = ::open(fname, flags, 0666);
+
+  if (_fd < 0)
+  {
+    cerr << "IW_Async_Streambuf::open:cannot open '" << fname << "' " << strerror(errno) << endl;
+    return 0;
+  }
+
+  if (_use_writer_thread)
+    _nbuffers = IW_ASYNC_NBUFFERS;
+  else
+    _nbuffers = 1;
+
+  _buffer = new char *[_nbuffers];
+  _nchars = new int[_nbuffers];
+  for (int i = 0; i < _nbuffers; i++)
+  {
+    _buffer[i] = new char[_buffer_size];
+    _nchars[i] = 0;
+  }
+
+  _current = 0;
+  _nqueued = 0;
+  _stop = 0;
+  _error = 0;
+
+  setp(_buffer[0], _buffer[0] + _buffer_size);
+
+  if (_use_writer_thread)
+  {
+    if (0 == pthread_create(&_writer, NULL, iw_async_writer_thread, this))
+      _thread_running = 1;
+    else
+    {
+      cerr << "IW_Async_Streambuf::open:cannot create writer thread, writing synchronously\n";
+      _nbuffers = 1;
+    }
+  }
+
+  return 1;
+}
+
+int
+IW_Async_Streambuf::close ()
+{
+  if (_fd < 0)
+    return 0;
+
+  int rc = (0 == sync());
+
+  if (_thread_running)
+  {
+    pthread_mutex_lock(&_mutex);
+    _stop = 1;
+    pthread_cond_broadcast(&_changed);
+    pthread_mutex_unlock(&_mutex);
+
+    pthread_join(_writer, NULL);
+    _thread_running = 0;
+  }
+
+  if (0 != ::close(_fd))
+    rc = 0;
+
+  _fd = -1;
+
+  for (int i = 0; i < _nbuffers; i++)
+  {
+    delete [] _buffer[i];
+  }
+  delete [] _buffer;
+  delete [] _nchars;
+
+  _buffer = NULL;
+  _nchars = NULL;
+  _nbuffers = 0;
+
+  setp(NULL, NULL);
+
+  return rc;
+}
+
+/*
+  Write everything described by IOV, coping with partial writes
+*/
+
+int
+IW_Async_Streambuf::_write_all (struct iovec * iov, int n)
+{
+  while (n > 0)
+  {
+    ssize_t w = ::writev(_fd, iov, n);
+
+    if (w < 0)
+    {
+      if (EINTR == errno)
+        continue;
+
+      cerr << "IW_Async_Streambuf::_write_all:write failed " << strerror(errno) << endl;
+      return 0;
+    }
+
+    while (n > 0 && static_cast<size_t>(w) >= iov[0].iov_len)
+    {
+      w -= iov[0].iov_len;
+      iov++;
+      n--;
+    }
+
+    if (n > 0)
+    {
+      iov[0].iov_base = reinterpret_cast<char *>(iov[0].iov_base) + w;
+      iov[0].iov_len -= w;
+    }
+  }
+
+  return 1;
+}
+
+/*
+  The buffer being filled is either written, or queued for the writer
+  thread, and we move on to the next buffer in the ring
+*/
+
+int
+IW_Async_Streambuf::_hand_off_current ()
+{
+  int n = pptr() - pbase();
+
+  if (0 == n)
+    return 1;
+
+  if (! _thread_running)
+  {
+    struct iovec iov;
+    iov.iov_base = pbase();
+    iov.iov_len = n;
+
+    setp(pbase(), epptr());
+
+    if (_write_all(&iov, 1))
+      return 1;
+
+    _error = 1;
+    return 0;
+  }
+
+  pthread_mutex_lock(&_mutex);
+
+  _nchars[_current] = n;
+
+  while (_nqueued >= _nbuffers - 1 && ! _error)
+  {
+    pthread_cond_wait(&_changed, &_mutex);
+  }
+
+  if (_error)
+  {
+    pthread_mutex_unlock(&_mutex);
+    return 0;
+  }
+
+  _nqueued++;
+  _current = (_current + 1) % _nbuffers;
+
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  setp(_buffer[_current], _buffer[_current] + _buffer_size);
+
+  return 1;
+}
+
+int
+IW_Async_Streambuf::overflow (int c)
+{
+  if (_fd < 0 || _error)
+    return traits_type::eof();
+
+  if (! _hand_off_current())
+    return traits_type::eof();
+
+  if (traits_type::eof() != c)
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+
+  return traits_type::not_eof(c);
+}
+
+int
+IW_Async_Streambuf::sync ()
+{
+  if (_fd < 0)
+    return 0;
+
+  if (! _hand_off_current())
+    return -1;
+
+  if (! _thread_running)
+    return 0;
+
+  pthread_mutex_lock(&_mutex);
+
+  while (_nqueued > 0 && ! _error)
+  {
+    pthread_cond_wait(&_changed, &_mutex);
+  }
+
+  int rc = _error ? -1 : 0;
+
+  pthread_mutex_unlock(&_mutex);
+
+  return rc;
+}
+
+void
+IW_Async_Streambuf::writer ()
+{
+  struct iovec * iov = new struct iovec[_nbuffers];
+
+  pthread_mutex_lock(&_mutex);
+
+  while (1)
+  {
+    while (0 == _nqueued && ! _stop)
+    {
+      pthread_cond_wait(&_changed, &_mutex);
+    }
+
+    if (0 == _nqueued)     // must be _stop
+      break;
+
+    int n = _nqueued;
+    int first = (_current - n + _nbuffers) % _nbuffers;
+
+    pthread_mutex_unlock(&_mutex);
+
+    for (int i = 0; i < n; i++)
+    {
+      int j = (first + i) % _nbuffers;
+      iov[i].iov_base = _buffer[j];
+      iov[i].iov_len = _nchars[j];
+    }
+
+    int ok = _write_all(iov, n);
+
+    pthread_mutex_lock(&_mutex);
+
+    _nqueued -= n;
+    if (! ok)
+      _error = 1;
+
+    pthread_cond_broadcast(&_changed);
+
+    if (_error)
+      break;
+  }
+
+  pthread_mutex_unlock(&_mutex);
+
+  delete [] iov;
+
+  return;
+}
@@ -2080,17 +2080,10 @@ IW_Bits_Base::is_subset (const IW_Bits_Base & rhs) const
     abort ();
   }
 
-  unsigned int * w1 = (unsigned int *) _bits;
-  unsigned int * w2 = (unsigned int *) rhs._bits;
-
   int number_words = _nbits / IW_BITS_PER_WORD;
 
-  for (int i = 0; i < number_words; i++)
-  {
-    unsigned int tmp = (w1[i]) & (w2[i]);
-    if (tmp != w2[i])
-      return 0;
-  }
+  if (! ::words_are_subset ((const unsigned int *) rhs._bits, (const unsigned int *) _bits, number_words))
+    return 0;
 
   int extra_bytes = _whole_bytes % IW_BYTES_PER_WORD;
 
@@ -29,6 +29,7 @@
 #ifdef _WIN32
 #else
 #include <unistd.h>
+#include <sys/mman.h>
 #endif
 
 #include <iostream>
@@ -36,6 +37,27 @@ using namespace std;
 
 #include "iwstring_data_source.h"
 
+static int use_mmap = 0;
+
+void
+set_iwstring_data_source_use_mmap (int s)
+{
+	use_mmap = s;
+}
+
+int
+iwstring_data_source_use_mmap ()
+{
+	return use_mmap;
+}
+
+/*
+  _chars_in_read_buffer is an int, so a mapped file is presented to the
+  record reading functions in windows of at most this size
+*/
+
+#define IWSDS_MMAP_WINDOW (1 << 30)
+
 static int
 iw_open_file (const char * fname)
 {
@@ -88,6 +110,11 @@ iwstring_data_source::_default_values (int lrecl)
 
 	_lrecl = lrecl;
 
+	_mmap_data = NULL;
+	_mmap_size = 0;
+	_allocated_read_buffer = _read_buffer;
+	_view_start = -1;
+
 	assert (ok());
 
 	return;
@@ -133,6 +160,9 @@ iwstring_data_source::_setup_stream (const char * fname)
 		{
 			_open = 1;
 			_good = 1;
+
+			if (use_mmap)
+				_setup_mmap();
 		}
 		else
 			cerr << "iwstring_data_source:cannot open '" << fname << "'\n";
@@ -226,6 +256,8 @@ iwstring_data_source::~iwstring_data_source()
 
 		_open = 0;
 
+		_release_mmap();
+
 		if (NULL != _read_buffer)
 			delete [] _read_buffer;
 
@@ -340,6 +372,7 @@ iwstring_data_source::do_close()
 	else
 	{
 		assert (_fd >= 0);
+		_release_mmap();
 		if (_fd > 0)
 			IW_FD_CLOSE (_fd);
 	}
@@ -349,11 +382,74 @@ iwstring_data_source::do_close()
 	return 1;
 }
 
+/*
+  Map the whole of our file. Failure is not an error, we just keep reading
+  the file descriptor.
+  Once mapped, the file offset is always left at the end of the current
+  window, so tellg, seekg and _save_state work as they do with read()
+*/
+
+int
+iwstring_data_source::_setup_mmap()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct stat st;
+	if (0 != fstat (_fd, &st))
+		return 0;
+
+	if (! S_ISREG (st.st_mode) || 0 == st.st_size)
+		return 0;
+
+	void * p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (MAP_FAILED == p)
+		return 0;
+
+	(void) madvise (p, st.st_size, MADV_SEQUENTIAL);
+
+	_mmap_data = reinterpret_cast<char *> (p);
+	_mmap_size = st.st_size;
+
+	return 1;
+#endif
+}
+
+void
+iwstring_data_source::_release_mmap()
+{
+	if (NULL == _mmap_data)
+		return;
+
+#ifndef _WIN32
+	munmap (_mmap_data, _mmap_size);
+#endif
+
+	_mmap_data = NULL;
+	_mmap_size = 0;
+
+	_read_buffer = _allocated_read_buffer;
+	_chars_in_read_buffer = 0;
+	_next_char_in_read_buffer_to_transfer_to_buffer = 0;
+	_view_start = -1;
+
+	return;
+}
+
 int
 iwstring_data_source::push_record()
 {
 	assert (ok());
 
+	if (_view_start >= 0)     // most recent record was a view into the mapping, just back up
+	{
+		_next_char_in_read_buffer_to_transfer_to_buffer = _view_start;
+		_view_start = -1;
+		_lines_read--;
+		_lines_which_are_returned--;
+		return 1;
+	}
+
 	_record_buffered = 1;
 
 	return 1;    // why does this function return anything ?
@@ -525,7 +621,7 @@ iwstring_data_source::_read_more_data_into_read_buffer()
 		if(!_isstringbuffer_loaded)
 		{
 			// copy string from _stringbuffer into _read_buffer, and set the _isstringbuffer_loaded flag.
-			strcpy(_read_buffer, _stringbuffer);
+			memcpy(_read_buffer, _stringbuffer, _stringbuffer_size);    // no room for a trailing null
 			_chars_in_read_buffer = _stringbuffer_size;
 			_next_char_in_read_buffer_to_transfer_to_buffer = 0;
 			_isstringbuffer_loaded = true;
@@ -537,6 +633,8 @@ iwstring_data_source::_read_more_data_into_read_buffer()
 			return 0;
 		}
 	}
+	else if (NULL != _mmap_data)
+		return _read_more_data_from_mapping();
 	else
 	{
 		_chars_in_read_buffer = IW_FD_READ (_fd, _read_buffer, _lrecl);
@@ -570,6 +668,60 @@ iwstring_data_source::_read_more_data_into_read_buffer()
 	}
 }
 
+/*
+  Rather than reading into _read_buffer, point it at the next window of the
+  mapping. The file offset is moved to the end of the window so tellg
+  continues to work.
+*/
+
+int
+iwstring_data_source::_read_more_data_from_mapping()
+{
+	_view_start = -1;
+
+	off_t offset = IW_FD_LSEEK (_fd, 0, SEEK_CUR);
+
+	if (offset < 0)
+	{
+		cerr << "iwstring_data_source::_read_more_data_from_mapping:fatal error\n";
+		_good = 0;
+		return 0;
+	}
+
+	if (offset >= _mmap_size)
+	{
+		_read_buffer = _allocated_read_buffer;
+		_chars_in_read_buffer = 0;
+		_next_char_in_read_buffer_to_transfer_to_buffer = 0;
+
+		_eof = 1;
+		if (_buffer.length())
+		{
+			cerr << "iwstring_data_source::_read_more_data_from_mapping:unterminated record\n";
+			return 1;
+		}
+
+		return 0;
+	}
+
+	off_t remaining = _mmap_size - offset;
+	if (remaining > IWSDS_MMAP_WINDOW)
+		remaining = IWSDS_MMAP_WINDOW;
+
+	_read_buffer = _mmap_data + offset;
+	_chars_in_read_buffer = static_cast<int> (remaining);
+	_next_char_in_read_buffer_to_transfer_to_buffer = 0;
+
+	if (IW_FD_LSEEK (_fd, offset + remaining, SEEK_SET) < 0)
+	{
+		cerr << "iwstring_data_source::_read_more_data_from_mapping:cannot seek to " << (offset + remaining) << endl;
+		_good = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
 int
 iwstring_data_source::_fetch_record_into_buffer()
 {
@@ -623,6 +775,8 @@ Returns 1 if successful
 int
 iwstring_data_source::_fetch_record()
 {
+	_view_start = -1;
+
 	if(_isstringbuffer)
 	{
 		int nchars;
@@ -696,11 +850,104 @@ iwstring_data_source::most_recent_record (IWString & buffer)
 {
 	assert (_lines_read > 0);
 
-	buffer = _buffer;
+	if (_view_start >= 0)
+		buffer = _view;
+	else
+		buffer = _buffer;
 
 	return 1;
 }
 
+/*
+  Records can be returned directly from the mapping as long as none of
+  the filters need to modify the characters
+*/
+
+int
+iwstring_data_source::_can_return_view() const
+{
+	if (NULL == _mmap_data)
+		return 0;
+
+	if (_record_buffered)
+		return 0;
+
+	if (_translate_tabs || _compress_spaces || _convert_to_lowercase || _convert_to_uppercase)
+		return 0;
+
+	return 1;
+}
+
+/*
+  Returns 1 if a record was found, 0 at EOF, and -1 if the next record
+  is not entirely within the current window, in which case the caller
+  must go through _fetch_record.
+  Same filters as _apply_all_filters
+*/
+
+int
+iwstring_data_source::_next_record_from_mapping (const_IWSubstring & buffer)
+{
+	_buffer.resize_keep_storage (0);
+
+	while (1)
+	{
+		if (_next_char_in_read_buffer_to_transfer_to_buffer >= _chars_in_read_buffer)
+		{
+			if (_eof)
+				return 0;
+
+			if (! _read_more_data_into_read_buffer())
+				return 0;
+		}
+
+		const char * s = _read_buffer + _next_char_in_read_buffer_to_transfer_to_buffer;
+		int bytes_available = _chars_in_read_buffer - _next_char_in_read_buffer_to_transfer_to_buffer;
+
+		const char * c = reinterpret_cast<const char *> (memchr (s, _record_delimiter, bytes_available));
+
+		if (NULL == c)
+			return -1;
+
+		int nchars = c - s;
+
+		int record_start = _next_char_in_read_buffer_to_transfer_to_buffer;
+		_next_char_in_read_buffer_to_transfer_to_buffer += nchars + 1;
+
+		_lines_read++;
+
+		if (nchars > _longest_record)
+			_longest_record = nchars;
+
+		buffer.set (s, nchars);
+
+		if (_dos && nchars > 0 && static_cast<char>(13) == s[nchars - 1])
+			buffer.chop();
+
+		if (_strip_trailing_blanks)
+			buffer.strip_trailing_blanks();
+
+		if (_strip_leading_blanks)
+			buffer.strip_leading_blanks();
+
+		if (_skip_blank_lines && 0 == buffer.length())
+			continue;
+
+		if (_ignore_pattern.active() && _ignore_pattern.matches (buffer))
+			continue;
+
+		if (_filter_pattern.active() && ! _filter_pattern.matches (buffer))
+			continue;
+
+		_lines_which_are_returned++;
+
+		_view_start = record_start;
+		_view = buffer;
+
+		return 1;
+	}
+}
+
 template <typename T>
 int
 iwstring_data_source::next_record (T & buffer)
@@ -765,6 +1012,18 @@ iwstring_data_source::next_record (T & buffer)
 			return 0;
 		}
 
+		if (_can_return_view())
+		{
+			const_IWSubstring view;
+			int rc = _next_record_from_mapping (view);
+			if (rc >= 0)
+			{
+				if (rc)
+					buffer = view;
+				return rc;
+			}
+		}
+
 		if (_record_buffered)
 		{
 			_record_buffered = 0;
@@ -929,6 +1188,7 @@ iwstring_data_source::seekg (off_t zoffset,
 	assert (ok());
 
 	_record_buffered = 0;
+	_view_start = -1;
 
 	if (_gzfile.active())
 	{
@@ -1597,8 +1857,7 @@ iwstring_data_source::_copy_read_buffer_to_destination (void * destination,
 
 	memcpy (destination, _read_buffer + _next_char_in_read_buffer_to_transfer_to_buffer, bytes_to_copy);
 
-	_chars_in_read_buffer -= bytes_to_copy;
-	_next_char_in_read_buffer_to_transfer_to_buffer -= bytes_to_copy;
+	_next_char_in_read_buffer_to_transfer_to_buffer += bytes_to_copy;
 
 	nbytes = bytes_to_copy;
 
@@ -1617,9 +1876,16 @@ iwstring_data_source::read_bytes (void * destination,
 	assert (bytes_requested > 0);
 
 	_buffer.resize_keep_storage (0);
+	_view_start = -1;
 
 	if (_gzfile.active())
-		return _gzfile.read_bytes (destination, bytes_requested);
+	{
+		int rc = _gzfile.read_bytes (destination, bytes_requested);
+		if (rc < bytes_requested)
+			_eof = 1;
+
+		return rc;
+	}
 
 	if (! _open || ! _good)
 	{
@@ -1629,7 +1895,7 @@ iwstring_data_source::read_bytes (void * destination,
 
 	int bytes_written = 0;
 
-	if (_chars_in_read_buffer)
+	if (_next_char_in_read_buffer_to_transfer_to_buffer < _chars_in_read_buffer)
 	{
 #ifdef DEBUG_READ_BYTES
 		cerr << "There are " << _chars_in_read_buffer << " chars in read buffer\n";
@@ -1660,9 +1926,7 @@ iwstring_data_source::read_bytes (void * destination,
 			//    cerr << "Could not read more data, good " << _good << endl;
 			if (! _good)
 				return 0;
-			if (_buffer.length())
-				cerr << "iwstring_data_source::_fetch_record_into_buffer:unterminated record\n";
-			return 0;
+			return bytes_written;
 		}
 
 		int nbytes = bytes_requested;     // nbytes will be set to how many bytes get copied
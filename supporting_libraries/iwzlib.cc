@@ -26,10 +26,835 @@
 #ifdef NO_ZLIB
 #else
 
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
 #include "iwstring.h"
+#include "iwaray.h"
 
 #define IWZLIB_BUF_SIZE 1024
 
+static int inflate_threads = 0;
+
+void
+set_iwzlib_inflate_threads (int s)
+{
+  inflate_threads = s;
+}
+
+/*
+  Oct 2026. Optional background inflation.
+
+  A reader thread walks the compressed file. If the file is BGZF (the
+  blocked gzip used by bgzip and samtools) every block is an independent
+  gzip member of known size, so the reader just slices the file into
+  blocks and a pool of threads inflates them in parallel. For any other
+  gzip file member boundaries are not known until the data is inflated,
+  so the reader thread inflates the stream itself - still off the
+  consuming thread.
+
+  Results go into a bounded ring of slots which the consumer takes in
+  order. Sequence numbers only ever increase, slot for sequence number
+  S is S % _nslots.
+
+  For BGZF files the ISIZE trailer of each block gives its uncompressed
+  size, so a block index can be built by reading just the block headers
+  and trailers. seekg uses that to start inflating at the block
+  containing the requested offset, so a run started with -i seek= does
+  not have to inflate everything in front of it.
+*/
+
+#define IWZLIB_SLOT_SIZE (256 * 1024)
+#define BGZF_MAX_BLOCK_SIZE 65536
+#define GZIP_HEADER_SIZE 12
+
+#define SLOT_EMPTY 0
+#define SLOT_COMPRESSED 1
+#define SLOT_INFLATING 2
+#define SLOT_READY 3
+
+struct IWZLib_Slot
+{
+  int state;
+
+  unsigned char * compressed;    // BGZF only
+  int ncompressed;
+  int payload_start;             // start of deflate data within compressed
+
+  char * data;
+  int ndata;                     // for BGZF, the ISIZE from the block trailer
+
+  z_off_t uoffset;               // uncompressed offset of data[0]
+};
+
+class IWZLib_Inflate_Pipeline
+{
+  private:
+    int _fd;       // closed when the pipeline is deleted
+
+    int _bgzf;
+
+    int _nworkers;
+
+    int _nslots;
+    IWZLib_Slot * _slot;
+
+    pthread_mutex_t _mutex;
+    pthread_cond_t _changed;
+
+    off_t _produced;
+    off_t _consumed;
+    off_t _next_to_inflate;
+
+    int _have_current;
+
+    int _producer_done;
+    int _error;
+    int _stop;
+
+    pthread_t _reader;
+    pthread_t * _worker;
+    int _threads_running;
+
+//  Where the reader starts
+
+    off_t _start_coffset;
+    z_off_t _start_uoffset;
+
+//  BGZF block index, compressed and uncompressed offsets of each block.
+//  The last entry is always the end of what has been scanned
+
+    resizable_array<off_t> _block_coffset;
+    resizable_array<off_t> _block_uoffset;
+
+//  private functions
+
+    int _read_bgzf_block_header (off_t coffset, int & bsize, int & payload_start) const;
+    int _bgzf_block_isize (off_t coffset, int bsize) const;
+    int _extend_block_index (z_off_t target);
+
+    void _read_bgzf ();
+    void _read_and_inflate_gzip ();
+    int  _wait_for_empty_slot ();
+    void _publish (int state);
+    void _set_error ();
+    int  _inflate_bgzf_block (z_stream &, IWZLib_Slot &);
+
+  public:
+    IWZLib_Inflate_Pipeline (int fd, int bgzf, int nworkers);
+    ~IWZLib_Inflate_Pipeline ();
+
+    int start (z_off_t target, z_off_t & uoffset);
+    void stop ();
+
+    int next_chunk (const char * & data, int & ndata, z_off_t & uoffset);
+
+    int exhausted ();
+
+    void reader ();
+    void worker ();
+};
+
+/*
+  Is the file open on FD BGZF. Returns 1 if so, 0 if it is some other
+  gzip, and -1 if it does not look like gzip at all
+*/
+
+static int
+identify_gzip_type (int fd)
+{
+  unsigned char hdr[GZIP_HEADER_SIZE + 6];
+
+  int n = pread (fd, hdr, sizeof(hdr), 0);
+
+  if (n < GZIP_HEADER_SIZE || 0x1f != hdr[0] || 0x8b != hdr[1] || 8 != hdr[2])
+    return -1;
+
+  if (0x04 != hdr[3])      // BGZF has FEXTRA and nothing else
+    return 0;
+
+  if (n < GZIP_HEADER_SIZE + 6)
+    return 0;
+
+  int xlen = hdr[10] | (hdr[11] << 8);
+
+  if (xlen < 6 || 'B' != hdr[12] || 'C' != hdr[13] || 2 != hdr[14] || 0 != hdr[15])
+    return 0;
+
+  return 1;
+}
+
+static void *
+iwzlib_reader_thread (void * p)
+{
+  reinterpret_cast<IWZLib_Inflate_Pipeline *>(p)->reader();
+
+  return NULL;
+}
+
+static void *
+iwzlib_worker_thread (void * p)
+{
+  reinterpret_cast<IWZLib_Inflate_Pipeline *>(p)->worker();
+
+  return NULL;
+}
+
+IWZLib_Inflate_Pipeline::IWZLib_Inflate_Pipeline (int fd, int bgzf, int nworkers)
+{
+  _fd = fd;
+  _bgzf = bgzf;
+
+  if (_bgzf)
+    _nworkers = nworkers;
+  else
+    _nworkers = 0;
+
+  _nslots = 2 * _nworkers + 2;
+
+  _slot = new IWZLib_Slot[_nslots];
+
+  for (int i = 0; i < _nslots; i++)
+  {
+    IWZLib_Slot & s = _slot[i];
+
+    s.state = SLOT_EMPTY;
+    if (_bgzf)
+    {
+      s.compressed = new unsigned char[BGZF_MAX_BLOCK_SIZE];
+      s.data = new char[BGZF_MAX_BLOCK_SIZE];
+    }
+    else
+    {
+      s.compressed = NULL;
+      s.data = new char[IWZLIB_SLOT_SIZE];
+    }
+    s.ncompressed = 0;
+    s.payload_start = 0;
+    s.ndata = 0;
+    s.uoffset = 0;
+  }
+
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_changed, NULL);
+
+  _worker = new pthread_t[_nworkers + 1];
+  _threads_running = 0;
+
+  _produced = _consumed = _next_to_inflate = 0;
+  _have_current = 0;
+  _producer_done = 0;
+  _error = 0;
+  _stop = 0;
+
+  _start_coffset = 0;
+  _start_uoffset = 0;
+
+  _block_coffset.add(0);
+  _block_uoffset.add(0);
+
+  return;
+}
+
+IWZLib_Inflate_Pipeline::~IWZLib_Inflate_Pipeline ()
+{
+  stop();
+
+  for (int i = 0; i < _nslots; i++)
+  {
+    if (NULL != _slot[i].compressed)
+      delete [] _slot[i].compressed;
+    delete [] _slot[i].data;
+  }
+
+  delete [] _slot;
+  delete [] _worker;
+
+  ::close(_fd);
+
+  pthread_cond_destroy(&_changed);
+  pthread_mutex_destroy(&_mutex);
+
+  return;
+}
+
+/*
+  Start inflating so that the first chunk returned contains uncompressed
+  offset TARGET. UOFFSET is set to the uncompressed offset of the start
+  of that first chunk
+*/
+
+int
+IWZLib_Inflate_Pipeline::start (z_off_t target, z_off_t & uoffset)
+{
+  assert (0 == _threads_running);
+
+  _start_coffset = 0;
+  _start_uoffset = 0;
+
+  if (_bgzf && target > 0)
+  {
+    if (! _extend_block_index(target))
+      return 0;
+
+//  last block starting at or before TARGET
+
+    int i = _block_uoffset.number_elements() - 1;
+    while (i > 0 && _block_uoffset[i] > target)
+      i--;
+
+    _start_coffset = _block_coffset[i];
+    _start_uoffset = _block_uoffset[i];
+  }
+
+  uoffset = _start_uoffset;
+
+  _produced = _consumed = _next_to_inflate = 0;
+  _have_current = 0;
+  _producer_done = 0;
+  _error = 0;
+  _stop = 0;
+
+  for (int i = 0; i < _nslots; i++)
+  {
+    _slot[i].state = SLOT_EMPTY;
+  }
+
+  if (0 != pthread_create(&_reader, NULL, iwzlib_reader_thread, this))
+  {
+    cerr << "IWZLib_Inflate_Pipeline::start:cannot create reader thread\n";
+    return 0;
+  }
+
+  _threads_running = 1;
+
+  for (int i = 0; i < _nworkers; i++)
+  {
+    if (0 != pthread_create(_worker + i, NULL, iwzlib_worker_thread, this))
+    {
+      cerr << "IWZLib_Inflate_Pipeline::start:cannot create inflate thread\n";
+      stop();
+      return 0;
+    }
+
+    _threads_running++;
+  }
+
+  return 1;
+}
+
+void
+IWZLib_Inflate_Pipeline::stop ()
+{
+  if (0 == _threads_running)
+    return;
+
+  pthread_mutex_lock(&_mutex);
+  _stop = 1;
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  pthread_join(_reader, NULL);
+  for (int i = 0; i < _threads_running - 1; i++)
+  {
+    pthread_join(_worker[i], NULL);
+  }
+
+  _threads_running = 0;
+
+  return;
+}
+
+/*
+  Reader thread waits until the slot for _produced is free
+*/
+
+int
+IWZLib_Inflate_Pipeline::_wait_for_empty_slot ()
+{
+  pthread_mutex_lock(&_mutex);
+
+  while (! _stop && _produced - _consumed >= _nslots)
+  {
+    pthread_cond_wait(&_changed, &_mutex);
+  }
+
+  int rc = ! _stop;
+
+  pthread_mutex_unlock(&_mutex);
+
+  return rc;
+}
+
+void
+IWZLib_Inflate_Pipeline::_publish (int state)
+{
+  pthread_mutex_lock(&_mutex);
+
+  _slot[_produced % _nslots].state = state;
+  _produced++;
+
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  return;
+}
+
+/*
+  The reader and workers run without the lock, so errors are set through here
+*/
+
+void
+IWZLib_Inflate_Pipeline::_set_error ()
+{
+  pthread_mutex_lock(&_mutex);
+  _error = 1;
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  return;
+}
+
+void
+IWZLib_Inflate_Pipeline::reader ()
+{
+  if (_bgzf)
+    _read_bgzf();
+  else
+    _read_and_inflate_gzip();
+
+  pthread_mutex_lock(&_mutex);
+  _producer_done = 1;
+  pthread_cond_broadcast(&_changed);
+  pthread_mutex_unlock(&_mutex);
+
+  return;
+}
+
+/*
+  Returns 1 if a header was found, 0 at EOF, -1 on error
+*/
+
+int
+IWZLib_Inflate_Pipeline::_read_bgzf_block_header (off_t coffset,
+                                                  int & bsize,
+                                                  int & payload_start) const
+{
+  unsigned char hdr[GZIP_HEADER_SIZE];
+
+  int n = pread(_fd, hdr, GZIP_HEADER_SIZE, coffset);
+
+  if (0 == n)
+    return 0;
+
+  if (GZIP_HEADER_SIZE != n || 0x1f != hdr[0] || 0x8b != hdr[1] || 0 == (hdr[3] & 0x04))
+  {
+    cerr << "IW_ZLib_Wrapper:invalid BGZF block header at " << coffset << endl;
+    return -1;
+  }
+
+  int xlen = hdr[10] | (hdr[11] << 8);
+
+  unsigned char extra[BGZF_MAX_BLOCK_SIZE];
+
+  if (xlen != pread(_fd, extra, xlen, coffset + GZIP_HEADER_SIZE))
+  {
+    cerr << "IW_ZLib_Wrapper:truncated BGZF block header at " << coffset << endl;
+    return -1;
+  }
+
+  for (int i = 0; i + 4 <= xlen; )
+  {
+    int slen = extra[i + 2] | (extra[i + 3] << 8);
+
+    if ('B' == extra[i] && 'C' == extra[i + 1] && 2 == slen && i + 6 <= xlen)
+    {
+      bsize = (extra[i + 4] | (extra[i + 5] << 8)) + 1;
+      payload_start = GZIP_HEADER_SIZE + xlen;
+      return 1;
+    }
+
+    i += 4 + slen;
+  }
+
+  cerr << "IW_ZLib_Wrapper:no BGZF block size at " << coffset << endl;
+
+  return -1;
+}
+
+int
+IWZLib_Inflate_Pipeline::_bgzf_block_isize (off_t coffset, int bsize) const
+{
+  unsigned char trailer[4];
+
+  if (4 != pread(_fd, trailer, 4, coffset + bsize - 4))
+    return -1;
+
+  const int isize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (trailer[3] << 24);
+
+  if (isize < 0 || isize > BGZF_MAX_BLOCK_SIZE)
+    return -1;
+
+  return isize;
+}
+
+/*
+  Scan block headers until the index covers uncompressed offset TARGET,
+  or the file is exhausted
+*/
+
+int
+IWZLib_Inflate_Pipeline::_extend_block_index (z_off_t target)
+{
+  off_t coffset = _block_coffset.last_item();
+  off_t uoffset = _block_uoffset.last_item();
+
+  while (uoffset <= target)
+  {
+    int bsize, payload_start;
+
+    int rc = _read_bgzf_block_header(coffset, bsize, payload_start);
+    if (0 == rc)
+      break;
+    if (rc < 0)
+      return 0;
+
+    int isize = _bgzf_block_isize(coffset, bsize);
+    if (isize < 0)
+    {
+      cerr << "IWZLib_Inflate_Pipeline::_extend_block_index:truncated block at " << coffset << endl;
+      return 0;
+    }
+
+    coffset += bsize;
+    uoffset += isize;
+
+    _block_coffset.add(coffset);
+    _block_uoffset.add(uoffset);
+  }
+
+  return 1;
+}
+
+void
+IWZLib_Inflate_Pipeline::_read_bgzf ()
+{
+  off_t coffset = _start_coffset;
+  z_off_t uoffset = _start_uoffset;
+
+  while (_wait_for_empty_slot())
+  {
+    IWZLib_Slot & s = _slot[_produced % _nslots];
+
+    int bsize;
+
+    int rc = _read_bgzf_block_header(coffset, bsize, s.payload_start);
+    if (0 == rc)
+      return;
+
+    if (rc < 0 || bsize > BGZF_MAX_BLOCK_SIZE || bsize < s.payload_start + 8 || bsize != pread(_fd, s.compressed, bsize, coffset))
+    {
+      cerr << "IW_ZLib_Wrapper:cannot read BGZF block at " << coffset << endl;
+      _set_error();
+      return;
+    }
+
+    s.ncompressed = bsize;
+    s.ndata = s.compressed[bsize - 4] | (s.compressed[bsize - 3] << 8) | (s.compressed[bsize - 2] << 16) | (s.compressed[bsize - 1] << 24);
+
+    if (s.ndata < 0 || s.ndata > BGZF_MAX_BLOCK_SIZE)     // ISIZE must fit in the slot
+    {
+      cerr << "IW_ZLib_Wrapper:invalid BGZF block size " << s.ndata << " at " << coffset << endl;
+      _set_error();
+      return;
+    }
+    s.uoffset = uoffset;
+
+    coffset += bsize;
+    uoffset += s.ndata;
+
+    if (0 == s.ndata)     // the EOF marker block, or just empty
+      continue;
+
+    _publish(SLOT_COMPRESSED);
+  }
+
+  return;
+}
+
+/*
+  Not BGZF, so inflate the whole stream here. Concatenated members are
+  handled, trailing junk after a member is ignored, as gzread does
+*/
+
+void
+IWZLib_Inflate_Pipeline::_read_and_inflate_gzip ()
+{
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.next_in = Z_NULL;
+  strm.avail_in = 0;
+
+  if (Z_OK != inflateInit2(&strm, 15 + 16))
+  {
+    cerr << "IW_ZLib_Wrapper:cannot initialise inflate\n";
+    _set_error();
+    return;
+  }
+
+  unsigned char * input = new unsigned char[IWZLIB_SLOT_SIZE];
+
+  off_t coffset = 0;
+  z_off_t uoffset = 0;
+
+  int input_exhausted = 0;
+  int stream_finished = 0;
+  int failed = 0;
+
+  while (! stream_finished && _wait_for_empty_slot())
+  {
+    IWZLib_Slot & s = _slot[_produced % _nslots];
+
+    s.ndata = 0;
+    s.uoffset = uoffset;
+
+    while (s.ndata < IWZLIB_SLOT_SIZE)
+    {
+      if (0 == strm.avail_in && ! input_exhausted)
+      {
+        int n = pread(_fd, input, IWZLIB_SLOT_SIZE, coffset);
+        if (n < 0)
+        {
+          cerr << "IW_ZLib_Wrapper:read error at " << coffset << endl;
+          failed = 1;
+          break;
+        }
+        if (0 == n)
+          input_exhausted = 1;
+
+        coffset += n;
+        strm.next_in = input;
+        strm.avail_in = n;
+      }
+
+      strm.next_out = reinterpret_cast<Bytef *>(s.data + s.ndata);
+      strm.avail_out = IWZLIB_SLOT_SIZE - s.ndata;
+
+      int rc = inflate(&strm, Z_NO_FLUSH);
+
+      s.ndata = IWZLIB_SLOT_SIZE - strm.avail_out;
+
+      if (Z_STREAM_END == rc)
+      {
+        if (0 == strm.avail_in && ! input_exhausted)
+        {
+          int n = pread(_fd, input, IWZLIB_SLOT_SIZE, coffset);
+          if (n > 0)
+          {
+            coffset += n;
+            strm.next_in = input;
+            strm.avail_in = n;
+          }
+          else
+            input_exhausted = 1;
+        }
+
+        if (strm.avail_in > 0 && 0x1f == strm.next_in[0])    // another member
+          inflateReset(&strm);
+        else
+        {
+          stream_finished = 1;
+          break;
+        }
+      }
+      else if (Z_BUF_ERROR == rc && input_exhausted)
+      {
+        cerr << "IW_ZLib_Wrapper:premature end of gzip data\n";
+        failed = 1;
+        break;
+      }
+      else if (Z_OK != rc && Z_BUF_ERROR != rc)
+      {
+        cerr << "IW_ZLib_Wrapper:inflate error '" << (NULL == strm.msg ? "" : strm.msg) << "'\n";
+        failed = 1;
+        break;
+      }
+    }
+
+    if (failed)
+    {
+      _set_error();
+      break;
+    }
+
+    uoffset += s.ndata;
+
+    if (s.ndata > 0)
+      _publish(SLOT_READY);
+  }
+
+  delete [] input;
+
+  inflateEnd(&strm);
+
+  return;
+}
+
+int
+IWZLib_Inflate_Pipeline::_inflate_bgzf_block (z_stream & strm,
+                                              IWZLib_Slot & s)
+{
+  inflateReset(&strm);
+
+  strm.next_in = s.compressed + s.payload_start;
+  strm.avail_in = s.ncompressed - s.payload_start - 8;
+  strm.next_out = reinterpret_cast<Bytef *>(s.data);
+  strm.avail_out = s.ndata;
+
+  if (Z_STREAM_END != inflate(&strm, Z_FINISH) || 0 != strm.avail_out)
+  {
+    cerr << "IW_ZLib_Wrapper:cannot inflate BGZF block at uncompressed offset " << s.uoffset << endl;
+    return 0;
+  }
+
+  const unsigned char * t = s.compressed + s.ncompressed - 8;
+  uLong expected = t[0] | (t[1] << 8) | (t[2] << 16) | (static_cast<uLong>(t[3]) << 24);
+
+  if (expected != crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(s.data), s.ndata))
+  {
+    cerr << "IW_ZLib_Wrapper:crc mismatch in BGZF block at uncompressed offset " << s.uoffset << endl;
+    return 0;
+  }
+
+  return 1;
+}
+
+void
+IWZLib_Inflate_Pipeline::worker ()
+{
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.next_in = Z_NULL;
+  strm.avail_in = 0;
+
+  if (Z_OK != inflateInit2(&strm, -15))
+  {
+    _set_error();
+    return;
+  }
+
+  pthread_mutex_lock(&_mutex);
+
+  while (1)
+  {
+    while (! _stop && ! _error && _next_to_inflate >= _produced && ! _producer_done)
+    {
+      pthread_cond_wait(&_changed, &_mutex);
+    }
+
+    if (_stop || _error || _next_to_inflate >= _produced)
+      break;
+
+    IWZLib_Slot & s = _slot[_next_to_inflate % _nslots];
+    _next_to_inflate++;
+
+    s.state = SLOT_INFLATING;
+
+    pthread_mutex_unlock(&_mutex);
+
+    int ok = _inflate_bgzf_block(strm, s);
+
+    pthread_mutex_lock(&_mutex);
+
+    if (ok)
+      s.state = SLOT_READY;
+    else
+      _error = 1;
+
+    pthread_cond_broadcast(&_changed);
+  }
+
+  pthread_mutex_unlock(&_mutex);
+
+  inflateEnd(&strm);
+
+  return;
+}
+
+/*
+  Give back whatever slot the consumer holds and wait for the next.
+  Returns 1 with data, 0 at end of data, -1 on error
+*/
+
+int
+IWZLib_Inflate_Pipeline::next_chunk (const char * & data,
+                                     int & ndata,
+                                     z_off_t & uoffset)
+{
+  pthread_mutex_lock(&_mutex);
+
+  if (_have_current)
+  {
+    _slot[_consumed % _nslots].state = SLOT_EMPTY;
+    _consumed++;
+    _have_current = 0;
+    pthread_cond_broadcast(&_changed);
+  }
+
+  while (! _error)
+  {
+    if (_consumed < _produced && SLOT_READY == _slot[_consumed % _nslots].state)
+      break;
+
+    if (_producer_done && _consumed == _produced)
+      break;
+
+    pthread_cond_wait(&_changed, &_mutex);
+  }
+
+  int rc;
+
+  if (_error)
+    rc = -1;
+  else if (_consumed == _produced)
+    rc = 0;
+  else
+  {
+    const IWZLib_Slot & s = _slot[_consumed % _nslots];
+    data = s.data;
+    ndata = s.ndata;
+    uoffset = s.uoffset;
+    _have_current = 1;
+    rc = 1;
+  }
+
+  pthread_mutex_unlock(&_mutex);
+
+  return rc;
+}
+
+/*
+  True if there is nothing beyond the chunk currently held
+*/
+
+int
+IWZLib_Inflate_Pipeline::exhausted ()
+{
+  pthread_mutex_lock(&_mutex);
+
+  int rc = _error || (_producer_done && _consumed + _have_current == _produced);
+
+  pthread_mutex_unlock(&_mutex);
+
+  return rc;
+}
+
 IW_ZLib_Wrapper::IW_ZLib_Wrapper ()
 {
   _gzfile = NULL;
@@ -38,6 +863,12 @@ IW_ZLib_Wrapper::IW_ZLib_Wrapper ()
 
  _buffer = NULL;
 
+ _pipeline = NULL;
+
+ _data = NULL;
+
+ _data_offset = 0;
+
  _chars_in_buffer = 0;
 
  _start_of_next_record = 0;
@@ -47,11 +878,11 @@ IW_ZLib_Wrapper::IW_ZLib_Wrapper ()
 
 IW_ZLib_Wrapper::~IW_ZLib_Wrapper ()
 {
-  if (NULL != _gzfile)
-    gzclose (_gzfile);
+  if (NULL != _gzfile || NULL != _pipeline)
+    close_file ();
 
   if (NULL != _buffer)
-    delete _buffer;
+    delete [] _buffer;
   
   return;
 }
@@ -59,9 +890,41 @@ IW_ZLib_Wrapper::~IW_ZLib_Wrapper ()
 int
 IW_ZLib_Wrapper::open_file (const char * fname)
 {
-  if (NULL != _gzfile)
+  if (NULL != _gzfile || NULL != _pipeline)
     close_file ();
 
+  _start_of_next_record = 1;
+
+  _chars_in_buffer = 0;
+
+  _data_offset = 0;
+
+  if (inflate_threads > 0)
+  {
+    int fd = ::open (fname, O_RDONLY);
+
+    int gztype = -1;
+    if (fd >= 0)
+      gztype = identify_gzip_type (fd);
+
+    if (gztype >= 0)
+    {
+      _pipeline = new IWZLib_Inflate_Pipeline (fd, gztype, inflate_threads);
+
+      z_off_t notused;
+      if (_pipeline->start (0, notused))
+        return 1;
+
+      cerr << "IW_ZLib_Wrapper::open_file:cannot start inflate threads for '" << fname << "'\n";
+      delete _pipeline;     // closes fd
+      _pipeline = NULL;
+      fd = -1;
+    }
+
+    if (fd >= 0)       // something gzopen will handle better, uncompressed data for example
+      ::close (fd);
+  }
+
   _gzfile = gzopen (fname, "r");
 
   if (NULL == _gzfile)
@@ -71,11 +934,8 @@ IW_ZLib_Wrapper::open_file (const char * fname)
     return 0;
   }
 
-  _start_of_next_record = 1;
-
-  _chars_in_buffer = 0;
-
-  _buffer = new char[IWZLIB_BUF_SIZE];
+  if (NULL == _buffer)
+    _buffer = new char[IWZLIB_BUF_SIZE];
 
   if (NULL == _buffer)
   {
@@ -83,12 +943,23 @@ IW_ZLib_Wrapper::open_file (const char * fname)
     return 0;
   }
 
+  _data = _buffer;
+
   return 1;
 }
 
 int
 IW_ZLib_Wrapper::close_file ()
 {
+  if (NULL != _pipeline)
+  {
+    _pipeline->stop();
+    delete _pipeline;
+    _pipeline = NULL;
+    _data = NULL;
+    return 1;
+  }
+
   if (NULL == _gzfile)
   {
     cerr << "IW_ZLib_Wrapper::close_file:no file open\n";
@@ -101,33 +972,67 @@ IW_ZLib_Wrapper::close_file ()
   return 1;
 }
 
+/*
+  Get more data into _data. Returns the number of characters available,
+  0 at EOF, or -1 on error
+*/
+
+int
+IW_ZLib_Wrapper::_fill_buffer ()
+{
+  if (NULL == _pipeline)
+  {
+    int rc = gzread (_gzfile, _buffer, IWZLIB_BUF_SIZE);
+
+    if (rc < 0)
+    {
+      int errnum;
+      cerr << "IW_ZLib_Wrapper::next_record:fatal error '" << gzerror (_gzfile, &errnum) << "'\n";
+    }
+
+    return rc;
+  }
+
+  int ndata;
+
+  int rc = _pipeline->next_chunk (_data, ndata, _data_offset);
+
+  if (rc > 0)
+    return ndata;
+
+  if (rc < 0)
+    cerr << "IW_ZLib_Wrapper::next_record:fatal error in background inflation\n";
+
+  return rc;
+}
+
 //#define DEBUG_NEXT_RECORD
 
 size_t
 IW_ZLib_Wrapper::next_record (IWString & destination)
 {
-  assert (NULL != _gzfile);
+  assert (active ());
 
   destination.resize_keep_storage (0);
 
 #ifdef DEBUG_NEXT_RECORD
   cerr << "Fetching record\n";
 
-  cerr << "_chars_in_buffer " << _chars_in_buffer << " EOF? " << gzeof(_gzfile) << endl;
+  cerr << "_chars_in_buffer " << _chars_in_buffer << " EOF? " << eof() << endl;
 #endif
 
-  if (0 == _chars_in_buffer && gzeof (_gzfile))
+  if (0 == _chars_in_buffer && eof ())
     return 0;
 
   while (1)
   {
 #ifdef DEBUG_NEXT_RECORD
-    cerr << "At start of loop _chars_in_buffer = " << _chars_in_buffer << " start " << _start_of_next_record << " gztell " << gztell(_gzfile) << endl;
+    cerr << "At start of loop _chars_in_buffer = " << _chars_in_buffer << " start " << _start_of_next_record << endl;
 #endif
 
     if (_start_of_next_record > _chars_in_buffer)   // read some more data
     {
-      _chars_in_buffer = gzread (_gzfile, _buffer, IWZLIB_BUF_SIZE);
+      _chars_in_buffer = _fill_buffer ();
 
 #ifdef DEBUG_NEXT_RECORD
       cerr << "Read " << _chars_in_buffer << " bytes\n";
@@ -135,9 +1040,9 @@ IW_ZLib_Wrapper::next_record (IWString & destination)
 
       if (_chars_in_buffer < 0)
       {
-        int errnum;
-        cerr << "IW_ZLib_Wrapper::next_record:fatal error '" << gzerror (_gzfile, &errnum) << "'\n";
-        close_file ();
+        _chars_in_buffer = 0;
+        if (NULL == _pipeline)     // a failed pipeline stays open, and reports eof
+          close_file ();
         return 0;
       }
 
@@ -157,16 +1062,16 @@ IW_ZLib_Wrapper::next_record (IWString & destination)
 
 //  Now that our buffer has some data, copy it to DESTINATION
 
-    const void * c = ::memchr (static_cast<const void *> (_buffer + _start_of_next_record), _record_delimiter, _chars_in_buffer - _start_of_next_record);
+    const void * c = ::memchr (static_cast<const void *> (_data + _start_of_next_record), _record_delimiter, _chars_in_buffer - _start_of_next_record);
 
     if (NULL == c)    // no record delimiter found, fetch another record
     {
-      destination.strncat (_buffer + _start_of_next_record, _chars_in_buffer - _start_of_next_record);
+      destination.strncat (_data + _start_of_next_record, _chars_in_buffer - _start_of_next_record);
       _start_of_next_record = _chars_in_buffer + 1;    // force reading more data
       continue;
     }
 
-    int chars_to_copy = static_cast<const char *> (c) - (_buffer + _start_of_next_record);
+    int chars_to_copy = static_cast<const char *> (c) - (_data + _start_of_next_record);
 
     if (0 == chars_to_copy)     // blank line
     {
@@ -178,7 +1083,7 @@ IW_ZLib_Wrapper::next_record (IWString & destination)
     cerr << "Found " << chars_to_copy << " characters to copy\n";
 #endif
 
-    destination.strncat (_buffer + _start_of_next_record, chars_to_copy);
+    destination.strncat (_data + _start_of_next_record, chars_to_copy);
     _start_of_next_record += chars_to_copy + 1;
 
     return 1;
@@ -188,7 +1093,50 @@ IW_ZLib_Wrapper::next_record (IWString & destination)
 int
 IW_ZLib_Wrapper::seekg (z_off_t o)
 {
-  assert (NULL != _gzfile);
+  assert (active ());
+
+  if (NULL != _pipeline)
+  {
+    _pipeline->stop ();
+
+    if (! _pipeline->start (o, _data_offset))
+    {
+      cerr << "IW_ZLib_Wrapper::seekg:cannot seek to " << o << endl;
+      return 0;
+    }
+
+//  Discard anything in front of O in the block we have started in
+
+    _chars_in_buffer = 0;
+    while (1)
+    {
+      int n = _fill_buffer ();
+      if (n < 0)
+        return 0;
+
+      if (0 == n)
+      {
+        if (_data_offset != o)
+        {
+          cerr << "IW_ZLib_Wrapper::seekg:offset " << o << " beyond end of data\n";
+          return 0;
+        }
+        _start_of_next_record = 1;
+        return 1;
+      }
+
+      _chars_in_buffer = n;
+
+      if (o < _data_offset + n)
+        break;
+
+      _data_offset += n;      // only matters at EOF
+    }
+
+    _start_of_next_record = o - _data_offset;
+
+    return 1;
+  }
 
 //cerr << "Seeking to " << o << ", eof? " << gzeof(_gzfile) << endl;
 
@@ -210,7 +1158,15 @@ IW_ZLib_Wrapper::seekg (z_off_t o)
 z_off_t
 IW_ZLib_Wrapper::tellg () const
 {
-  assert (NULL != _gzfile);
+  assert (active ());
+
+  if (NULL != _pipeline)
+  {
+    if (_start_of_next_record > _chars_in_buffer)
+      return _data_offset + _chars_in_buffer;
+
+    return _data_offset + _start_of_next_record;
+  }
 
   z_off_t o = gztell(_gzfile);
 
@@ -234,7 +1190,10 @@ IW_ZLib_Wrapper::tellg () const
 int
 IW_ZLib_Wrapper::eof () const
 {
-  assert (NULL != _gzfile);
+  assert (active ());
+
+  if (NULL != _pipeline)
+    return _pipeline->exhausted ();
 
   return gzeof (_gzfile);
 }
@@ -242,7 +1201,36 @@ IW_ZLib_Wrapper::eof () const
 int
 IW_ZLib_Wrapper::read_bytes (void * destination, int nbytes)
 {
-  assert (NULL != _gzfile);
+  assert (active ());
+
+  if (NULL != _pipeline)
+  {
+    char * d = reinterpret_cast<char *>(destination);
+    int rc = 0;
+    while (rc < nbytes)
+    {
+      if (_start_of_next_record >= _chars_in_buffer)
+      {
+        _chars_in_buffer = _fill_buffer ();
+        _start_of_next_record = 0;
+        if (_chars_in_buffer <= 0)
+        {
+          _chars_in_buffer = 0;
+          break;
+        }
+      }
+
+      int n = _chars_in_buffer - _start_of_next_record;
+      if (n > nbytes - rc)
+        n = nbytes - rc;
+
+      memcpy (d + rc, _data + _start_of_next_record, n);
+      _start_of_next_record += n;
+      rc += n;
+    }
+
+    return rc;
+  }
 
   if (gzeof (_gzfile))
     return 0;
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Benchmarks of the chemistry kernels, and of each stage of the rules as
+# run by Lilly_Medchem_Rules.rb, see Molecule/iwbench.cc
+# The stage commands are those the driver builds with its default
+# options, without the bad0..bad3 files. Keep them in step with the driver
+# Results are written to benchmark.json. If benchmark_baseline.json
+# exists, results are compared with it and the exit status is non zero
+# if anything got slower. To make the current results the baseline
+#   cp benchmark.json benchmark_baseline.json
+# Extra arguments are passed to iwbench, for example -r 5 or -T 20
+
+here=$(cd $(dirname $0) && pwd)
+top=$(dirname $here)
+bin=$top/bin
+queries=$top/queries
+
+for exe in iwbench mc_first_pass tsubstructure iwdemerit
+do
+  if [ ! -x $bin/$exe ]
+  then
+    echo "Cannot find $bin/$exe, check build" >&2
+    exit 1
+  fi
+done
+
+cd $here
+
+baseline=""
+if [ -s benchmark_baseline.json ]
+then
+  baseline="-B benchmark_baseline.json"
+fi
+
+$bin/iwbench -E autocreate -A D -g all -N F:$top/charge_assigner/queries \
+  -q F:$queries/reject1 -q F:$queries/reject2 -q F:$queries/demerits \
+  -e "mc_first_pass=$bin/mc_first_pass -I 0 -A I -A ipp -c 7 -C 40 -E autocreate -o smi -V -g all -g ltltr -i ICTE -i smi -a -S - -" \
+  -e "reject1=$bin/tsubstructure -E autocreate -b -u -i smi -o smi -o asread -A D -M usefp -n - -q F:$queries/reject1 -" \
+  -e "reject2=$bin/tsubstructure -A D -E autocreate -b -u -i smi -o smi -o asread -M usefp -n - -q F:$queries/reject2 -" \
+  -e "demerits=$bin/iwdemerit -x -F -N F:$top/charge_assigner/queries -E autocreate -A D -i smi -o smi -o asread -q F:$queries/demerits -G - -c smax=25 -c hmax=40 -" \
+  -J benchmark.json $baseline "$@" example_molecules.smi 2> benchmark.log
+
+rc=$?
+
+grep -E "REGRESSION|Compared" benchmark.log >&2
+
+if [ $rc -ne 0 ]
+then
+  echo "Benchmark failed or regressed, see benchmark.log" >&2
+  exit $rc
+fi
+
+echo "Results in benchmark.json" >&2
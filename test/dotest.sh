@@ -38,6 +38,16 @@ do
   fi
 done
 
+# Oct 2026. -o asread must not bypass options that change how smiles are written
+
+asread=$(echo "C1=CC=CC=C1CN asread" | ../bin/tsubstructure -A O -A D -i smi -o smi -o asread -s N -m - - 2> /dev/null)
+
+if [ "$asread" != "c1ccccc1CN asread" ]
+then
+  echo "Failure on 'asread', got '${asread}'" >&2
+  let failures++
+fi
+
 if [ $failures -gt 0 ]
 then
   echo "${failures} failed tests" >&2